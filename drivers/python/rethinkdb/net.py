@@ -23,7 +23,7 @@ pResponse = p.Response.ResponseType
 pQuery = p.Query.QueryType
 
 from .errors import *
-from .ast import RqlQuery, RqlTopLevelQuery, DB, Repl
+from .ast import RqlQuery, RqlTopLevelQuery, DB, Repl, Func, expr
 from .ast import recursively_convert_pseudotypes
 
 try:
@@ -67,10 +67,13 @@ class Query(object):
         self.term = term
         self.global_optargs = global_optargs
 
+    def build_term(self):
+        return self.term.build()
+
     def serialize(self):
         message = [self.type]
         if self.term is not None:
-            message.append(self.term.build())
+            message.append(self.build_term())
         if self.global_optargs is not None:
             optargs = {}
             for k, v in dict_items(self.global_optargs):
@@ -81,6 +84,37 @@ class Query(object):
         return query_header + query_str
 
 
+# Sends the arguments of a prepared query instead of its term, which is kept so
+# that errors can show where in the prepared function they happened.
+class ExecuteQuery(Query):
+    def __init__(self, token, prepared, args, global_optargs):
+        Query.__init__(self, pQuery.EXECUTE, token, prepared.query.term, global_optargs)
+        self.args = expr([prepared.query.token] + list(args))
+
+    def build_term(self):
+        return self.args.build()
+
+
+# A function that the server has compiled once, to be run with different
+# arguments.  See `Connection.prepare`.
+class PreparedQuery(object):
+    def __init__(self, conn, query):
+        self.conn = conn
+        self.query = query
+
+    def run(self, *args, **global_optargs):
+        return self.conn._execute(self, args, global_optargs)
+
+    def close(self):
+        self.conn._stop_prepared(self)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, type, value, traceback):
+        self.close()
+
+
 class Response(object):
     def __init__(self, token, json_str):
         try:
@@ -555,6 +589,29 @@ class Connection(object):
         q = Query(pQuery.START, self._new_token(), term, global_optargs)
         return self._instance.run_query(q, global_optargs.get('noreply', False))
 
+    # Compiles `func` on the server once, so that it can be run over and over
+    # with only its arguments sent, as in `conn.prepare(lambda id:
+    # r.table('t').get(id)).run(1)`.  The arguments must be plain values, not
+    # ReQL terms.  Global optargs other than `noreply` and `profile` are given
+    # here rather than to `run`.
+    def prepare(self, func, **global_optargs):
+        self.check_open()
+        if 'db' in global_optargs or self.db is not None:
+            global_optargs['db'] = DB(global_optargs.get('db', self.db))
+        q = Query(pQuery.PREPARE, self._new_token(), Func(func), global_optargs)
+        self._instance.run_query(q, False)
+        return PreparedQuery(self, q)
+
+    def _execute(self, prepared, args, global_optargs):
+        self.check_open()
+        q = ExecuteQuery(self._new_token(), prepared, args, global_optargs)
+        return self._instance.run_query(q, global_optargs.get('noreply', False))
+
+    def _stop_prepared(self, prepared):
+        self.check_open()
+        q = Query(pQuery.STOP, prepared.query.token, None, None)
+        self._instance.run_query(q, False)
+
     def _continue(self, cursor):
         self.check_open()
         q = Query(pQuery.CONTINUE, cursor.query.token, None, None)
@@ -145,6 +145,7 @@ if __name__ == "__main__":
     print "    }"
     print "    bool is_nil() const { return addr.is_nil(); }"
     print "    peer_id_t get_peer() const { return addr.get_peer(); }"
+    print "    threadnum_t get_thread() const { return addr.get_thread(); }"
     print
     print "    friend class mailbox_t<T>;"
     print
@@ -2,17 +2,28 @@
 #include "arch/io/event_watcher.hpp"
 #include "arch/runtime/thread_pool.hpp"
 
-linux_event_watcher_t::linux_event_watcher_t(fd_t f, linux_event_callback_t *eh) :
+#if defined(__linux) && !defined(NO_EPOLL)
+static const bool queue_is_edge_triggered = true;
+#else
+static const bool queue_is_edge_triggered = false;
+#endif
+
+linux_event_watcher_t::linux_event_watcher_t(fd_t f,
+                                             linux_event_callback_t *eh,
+                                             bool _edge_triggered) :
     fd(f), error_handler(eh),
     in_watcher(NULL), out_watcher(NULL),
 #ifdef __linux
     rdhup_watcher(NULL),
 #endif
     watching_for_errors(true),
+    edge_triggered(_edge_triggered && queue_is_edge_triggered),
+    ready_mask(0),
     old_mask(0),
     old_watching_for_errors(false)
 {
-    /* At first, only register for error events */
+    /* At first, only register for error events, unless we're edge-triggered, in
+    which case this is the only time we register. */
     remask();
 }
 
@@ -39,6 +50,9 @@ linux_event_watcher_t::watch_t::watch_t(linux_event_watcher_t *p, int e) :
     rassert(!*parent->get_watch_slot(event), "something's already watching that event.");
     *parent->get_watch_slot(event) = this;
     parent->remask();
+    if (parent->ready_mask & event) {
+        pulse();
+    }
 }
 
 linux_event_watcher_t::watch_t::~watch_t() {
@@ -52,6 +66,11 @@ bool linux_event_watcher_t::is_watching(int event) {
     return *get_watch_slot(event) == NULL;
 }
 
+void linux_event_watcher_t::clear_ready(int event) {
+    assert_thread();
+    ready_mask &= ~event;
+}
+
 linux_event_watcher_t::watch_t **linux_event_watcher_t::get_watch_slot(int event) {
     switch (event) {
     case poll_event_in:    return &in_watcher;
@@ -65,11 +84,25 @@ linux_event_watcher_t::watch_t **linux_event_watcher_t::get_watch_slot(int event
 
 void linux_event_watcher_t::remask() {
     int new_mask = 0;
-    if (in_watcher)    new_mask |= poll_event_in;
-    if (out_watcher)   new_mask |= poll_event_out;
+    if (edge_triggered) {
+        // We only change what we watch when we start or stop watching at all.
+        if (watching_for_errors || in_watcher != NULL || out_watcher != NULL
+#ifdef __linux
+            || rdhup_watcher != NULL
+#endif
+            ) {
+            new_mask = poll_event_in | poll_event_out;
 #ifdef __linux
-    if (rdhup_watcher) new_mask |= poll_event_rdhup;
+            new_mask |= poll_event_rdhup;
 #endif
+        }
+    } else {
+        if (in_watcher)    new_mask |= poll_event_in;
+        if (out_watcher)   new_mask |= poll_event_out;
+#ifdef __linux
+        if (rdhup_watcher) new_mask |= poll_event_rdhup;
+#endif
+    }
 
     // What we do (watch_resource, adjust_resource, forget_resource) depends on whether we are
     // currently registered to watch the resource.
@@ -102,13 +135,25 @@ void linux_event_watcher_t::on_event(int event) {
 #endif
     guarantee((event & (error_mask | old_mask)) == event, "Unexpected event received (from operating system?).");
 
+    if (edge_triggered) {
+        ready_mask |= event & ~(poll_event_err | poll_event_hup);
+    }
+
     if (event & error_mask) {
 #ifdef __linux
-        if (event & ~poll_event_rdhup) {
+        // Edge-triggered watchers get the peer shutting down its end along with
+        // the last of the data, so for them it only goes to `rdhup_watcher` unless
+        // it comes with an error.
+        const int error_handler_mask = edge_triggered
+            ? (poll_event_err | poll_event_hup)
+            : ~poll_event_rdhup;
+        if (event & error_handler_mask) {
             error_handler->on_event(event & error_mask);
         } else {
             rassert(event & poll_event_rdhup);
-            if (!rdhup_watcher->is_pulsed()) rdhup_watcher->pulse();
+            if (rdhup_watcher != NULL && !rdhup_watcher->is_pulsed()) {
+                rdhup_watcher->pulse();
+            }
         }
 #else
         error_handler->on_event(event & error_mask);
@@ -11,13 +11,20 @@ class linux_event_watcher_t :
     private linux_event_callback_t
 {
 public:
-    linux_event_watcher_t(fd_t f, linux_event_callback_t *eh);
+    /* A watcher normally only asks the event queue for the events that have a
+    `watch_t`, which costs a system call every time a `watch_t` comes or goes.  With
+    `edge_triggered`, it asks for every event once and remembers which ones have
+    arrived since they were last `clear_ready()`ed.  That only works with epoll, so
+    elsewhere `edge_triggered` is ignored. */
+    linux_event_watcher_t(fd_t f, linux_event_callback_t *eh, bool edge_triggered);
     ~linux_event_watcher_t();
 
     /* To monitor for a specific event happening, instantiate `watch_t`. It will
     get pulsed the first time that the given event arrives after you create the
     `watch_t`. To wait for the event to happen again, destroy the first
-    `watch_t` and create another one. */
+    `watch_t` and create another one.  If the watcher is edge-triggered, a `watch_t`
+    also gets pulsed right away if the event arrived before it was created and hasn't
+    been cleared since. */
     struct watch_t : public signal_t {
         watch_t(linux_event_watcher_t *p, int e);
         ~watch_t();
@@ -29,6 +36,11 @@ public:
 
     bool is_watching(int event);
 
+    // For edge-triggered watchers, forgets that `event` arrived.  Call it when the
+    // condition is over, e.g. when a read returns EAGAIN, and before creating a
+    // `watch_t` to wait for it to come back.
+    void clear_ready(int event);
+
     // TODO: This is a complete hack, kill yourself out of shame for the human race.
     void stop_watching_for_errors();
 
@@ -45,6 +57,10 @@ private:
 
     bool watching_for_errors;
 
+    const bool edge_triggered;
+    // For edge-triggered watchers, the events that arrived since they were cleared.
+    int ready_mask;
+
     int old_mask;
     bool old_watching_for_errors;
     void remask();
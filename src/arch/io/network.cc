@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -11,6 +12,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
@@ -20,6 +22,7 @@
 #include "arch/timing.hpp"
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/printf_buffer.hpp"
 #include "logger.hpp"
@@ -94,13 +97,14 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
                                    int local_port) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t) :
         write_perfmon(NULL),
         sock(create_socket_wrapper(peer.get_address_family())),
-        event_watcher(new linux_event_watcher_t(sock.get(), this)),
+        event_watcher(new linux_event_watcher_t(sock.get(), this, true)),
         read_in_progress(false), write_in_progress(false),
         read_buffer(IO_BUFFER_SIZE),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
         current_write_buffer(get_write_buffer()),
+        write_corking(false),
         drainer(new auto_drainer_t) {
     guarantee_err(fcntl(sock.get(), F_SETFL, O_NONBLOCK) == 0, "Could not make socket non-blocking");
 
@@ -127,6 +131,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
 
     if (res != 0) {
         if (get_errno() == EINPROGRESS) {
+            event_watcher->clear_ready(poll_event_out);
             linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_out);
             wait_interruptible(&watch, interruptor);
             int error;
@@ -147,13 +152,14 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
 linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
         write_perfmon(NULL),
         sock(s),
-        event_watcher(new linux_event_watcher_t(sock.get(), this)),
+        event_watcher(new linux_event_watcher_t(sock.get(), this, true)),
         read_in_progress(false), write_in_progress(false),
         read_buffer(IO_BUFFER_SIZE),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
         current_write_buffer(get_write_buffer()),
+        write_corking(false),
         drainer(new auto_drainer_t) {
     rassert(sock.get() != INVALID_FD);
 
@@ -167,6 +173,26 @@ void linux_tcp_conn_t::enable_keepalive() {
     guarantee(res != -1, "Could not set SO_KEEPALIVE option.");
 }
 
+void linux_tcp_conn_t::enable_write_corking() {
+#ifdef TCP_CORK
+    write_corking = true;
+#endif
+}
+
+void linux_tcp_conn_t::set_cork(UNUSED bool cork) {
+#ifdef TCP_CORK
+    int optval = cork ? 1 : 0;
+    int res = setsockopt(sock.get(), IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
+    if (res != 0) {
+        /* Corking is only an optimization, so don't bother trying again. */
+        logWRN("Could not set TCP_CORK option: %s", errno_string(get_errno()).c_str());
+        write_corking = false;
+    }
+#else
+    unreachable();
+#endif
+}
+
 linux_tcp_conn_t::write_buffer_t * linux_tcp_conn_t::get_write_buffer() {
     write_buffer_t *buffer;
 
@@ -212,6 +238,7 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
             /* There's no data available right now, so we must wait for a notification from the
             epoll queue, or for an order to shut down. */
 
+            event_watcher->clear_ready(poll_event_in);
             linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_in);
             wait_any_t waiter(&watch, &read_closed);
             waiter.wait_lazily_unordered();
@@ -338,19 +365,67 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
-        parent->perform_write(operation->buffer, operation->size);
-        if (operation->dealloc != NULL) {
-            parent->release_write_buffer(operation->dealloc);
-            parent->write_queue_limiter.unlock(operation->size);
+    /* Take along whatever else has been queued up behind `operation`, so that a
+    burst of small writes (or the chunks of one large buffered write) doesn't
+    cost a system call each. */
+    intrusive_list_t<write_queue_op_t> batch;
+    size_t batch_size = 0;
+    batch_iov.clear();
+    for (write_queue_op_t *op = operation; op != NULL; ) {
+        batch.push_back(op);
+        if (op->iov != NULL) {
+            batch_iov.insert(batch_iov.end(), op->iov, op->iov + op->iovcnt);
+            for (size_t i = 0; i < op->iovcnt; ++i) {
+                batch_size += op->iov[i].iov_len;
+            }
+        } else if (op->buffer != NULL) {
+            iovec iov;
+            iov.iov_base = const_cast<void *>(op->buffer);
+            iov.iov_len = op->size;
+            batch_iov.push_back(iov);
+            batch_size += op->size;
         }
+
+        if (batch_size < WRITE_BATCH_MAX_SIZE
+            && batch_iov.size() < static_cast<size_t>(IOV_MAX)
+            && parent->write_queue.available->get()) {
+            op = parent->write_queue.pop();
+        } else {
+            op = NULL;
+        }
+    }
+
+    const bool cork = parent->write_corking && batch_size >= CORK_MIN_SIZE
+        && !parent->write_closed.is_pulsed();
+    if (cork) {
+        parent->set_cork(true);
+    }
+    parent->perform_writev(batch_iov.data(), batch_iov.size());
+    if (cork && !parent->write_closed.is_pulsed()) {
+        parent->set_cork(false);
+    }
+
+    while (write_queue_op_t *op = batch.head()) {
+        batch.pop_front();
+        finish_op(op);
     }
+}
 
-    if (operation->cond != NULL) {
-        operation->cond->pulse();
+void linux_tcp_conn_t::write_handler_t::finish_op(write_queue_op_t *op) {
+    if (op->dealloc != NULL) {
+        parent->release_write_buffer(op->dealloc);
+        op->dealloc = NULL;
     }
-    if (operation->dealloc != NULL) {
-        parent->release_write_queue_op(operation);
+    if (op->limiter_count > 0) {
+        parent->write_queue_limiter.unlock(op->limiter_count);
+        op->limiter_count = 0;
+    }
+
+    if (op->cond != NULL) {
+        op->cond->pulse();
+    }
+    if (op->recycle) {
+        parent->release_write_queue_op(op);
     }
 }
 
@@ -364,7 +439,9 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->iov = NULL;
     op->cond = NULL;
+    op->recycle = true;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
 
@@ -372,12 +449,36 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     to be released once the write is completed by the coroutine pool */
     rassert(op->size <= WRITE_CHUNK_SIZE);
     rassert(WRITE_CHUNK_SIZE < WRITE_QUEUE_MAX_SIZE);
-    write_queue_limiter.co_lock(op->size);
+    op->limiter_count = op->size;
+    write_queue_limiter.co_lock(op->limiter_count);
 
     write_queue.push(op);
 }
 
+void linux_tcp_conn_t::internal_write_buffered(const char *buf, size_t size) {
+    while (size > 0) {
+        /* Insert the largest chunk that fits in this block */
+        size_t chunk = std::min(size, WRITE_CHUNK_SIZE - current_write_buffer->size);
+
+        memcpy(current_write_buffer->buffer + current_write_buffer->size, buf, chunk);
+        current_write_buffer->size += chunk;
+
+        rassert(current_write_buffer->size <= WRITE_CHUNK_SIZE);
+        if (current_write_buffer->size == WRITE_CHUNK_SIZE) internal_flush_write_buffer();
+
+        buf += chunk;
+        size -= chunk;
+    }
+}
+
 void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+    iovec iov;
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = size;
+    perform_writev(&iov, 1);
+}
+
+void linux_tcp_conn_t::perform_writev(iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -387,12 +488,19 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            ++iov;
+            --iovcnt;
+            continue;
+        }
+
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
             shut down */
+            event_watcher->clear_ready(poll_event_out);
             linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_out);
             wait_any_t waiter(&watch, &write_closed);
             waiter.wait_lazily_unordered();
@@ -426,10 +534,21 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            /* Skip past what was written; the last buffer may only be partly done */
+            size_t written = res;
+            while (written > 0) {
+                rassert(iovcnt > 0);
+                if (written >= iov->iov_len) {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --iovcnt;
+                } else {
+                    iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+                    iov->iov_len -= written;
+                    written = 0;
+                }
+            }
         }
     }
 }
@@ -461,25 +580,32 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
-void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+void linux_tcp_conn_t::writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
-    /* Convert to `char` for ease of pointer arithmetic */
-    const char *buf = reinterpret_cast<const char *>(vbuf);
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
 
-    while (size > 0) {
-        /* Insert the largest chunk that fits in this block */
-        size_t chunk = std::min(size, WRITE_CHUNK_SIZE - current_write_buffer->size);
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
 
-        memcpy(current_write_buffer->buffer + current_write_buffer->size, buf, chunk);
-        current_write_buffer->size += chunk;
+    /* The write handler copies the list into its batch, so it's left alone */
+    op.iov = iov;
+    op.iovcnt = iovcnt;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
 
-        rassert(current_write_buffer->size <= WRITE_CHUNK_SIZE);
-        if (current_write_buffer->size == WRITE_CHUNK_SIZE) internal_flush_write_buffer();
+    /* As in `write()`, the cond gets pulsed even if the connection is closed */
+    to_signal_when_done.wait();
 
-        buf += chunk;
-        size -= chunk;
-    }
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
+void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    /* Convert to `char` for ease of pointer arithmetic */
+    internal_write_buffered(reinterpret_cast<const char *>(vbuf), size);
 
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
@@ -569,7 +695,7 @@ void linux_tcp_conn_t::rethread(threadnum_t new_thread) {
 
     } else if (home_thread() == INVALID_THREAD && new_thread == get_thread_id()) {
         rassert(!event_watcher.has());
-        event_watcher.init(new linux_event_watcher_t(sock.get(), this));
+        event_watcher.init(new linux_event_watcher_t(sock.get(), this, true));
 
     } else {
         crash("linux_tcp_conn_t can be rethread()ed from no thread to the current thread or "
@@ -641,10 +767,12 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb) :
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
+    reuse_port(_reuse_port),
     bound(false),
     socks(),
     last_used_socket_index(0),
@@ -710,7 +838,7 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
             return get_errno();
         }
 
-        event_watchers[i].init(new linux_event_watcher_t(socks[i].get(), this));
+        event_watchers[i].init(new linux_event_watcher_t(socks[i].get(), this, false));
 
         int sock_fd = socks[i].get();
         guarantee_err(sock_fd != INVALID_FD, "Couldn't create socket");
@@ -719,6 +847,18 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            if (res == -1) {
+                logERR("Could not set REUSEPORT option: %s", errno_string(get_errno()).c_str());
+                return get_errno();
+            }
+#else
+            unreachable();
+#endif
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -976,6 +1116,56 @@ int linux_tcp_listener_t::get_port() const {
     return listener->get_port();
 }
 
+linux_tcp_reuseport_listener_t::linux_tcp_reuseport_listener_t(
+    const std::set<ip_address_t> &bind_addresses, int _port, int num_threads,
+    const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback) :
+        port(_port),
+        listeners(num_threads)
+{
+    guarantee(is_supported());
+    guarantee(num_threads > 0);
+
+    /* If we weren't given a port, the first thread's listener picks one, and the
+    others then join it there. */
+    for (int i = 0; i < num_threads; ++i) {
+        bool listening;
+        {
+            on_thread_t thread_switcher((threadnum_t(i)));
+            listeners[i].init(new linux_nonthrowing_tcp_listener_t(
+                bind_addresses, port, callback, true));
+            listening = listeners[i]->begin_listening();
+            port = listeners[i]->get_port();
+        }
+        if (!listening) {
+            pmap(num_threads, std::bind(
+                &linux_tcp_reuseport_listener_t::stop_listening, this, ph::_1));
+            throw address_in_use_exc_t("localhost", port);
+        }
+    }
+}
+
+linux_tcp_reuseport_listener_t::~linux_tcp_reuseport_listener_t() {
+    pmap(listeners.size(), std::bind(
+        &linux_tcp_reuseport_listener_t::stop_listening, this, ph::_1));
+}
+
+bool linux_tcp_reuseport_listener_t::is_supported() {
+#ifdef SO_REUSEPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+int linux_tcp_reuseport_listener_t::get_port() const {
+    return port;
+}
+
+void linux_tcp_reuseport_listener_t::stop_listening(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    listeners[thread].reset();
+}
+
 linux_repeated_nonthrowing_tcp_listener_t::linux_repeated_nonthrowing_tcp_listener_t(
     const std::set<ip_address_t> &bind_addresses,
     int port,
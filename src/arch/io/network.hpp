@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -41,6 +42,11 @@ public:
 
     void enable_keepalive();
 
+    /* Holds back partial segments while a large batch of writes is going out
+    (see `CORK_MIN_SIZE`), so that the tail of each `writev()` isn't sent as a
+    short segment of its own. Only has an effect where TCP_CORK exists. */
+    void enable_write_corking();
+
     class connect_failed_exc_t : public std::exception {
     public:
         explicit connect_failed_exc_t(int en) :
@@ -106,6 +112,10 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but gathers the data from `iovcnt` buffers, so
+    they don't have to be copied into one first. */
+    void writev(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -234,6 +244,14 @@ private:
     static const size_t WRITE_QUEUE_MAX_SIZE = 128 * KILOBYTE;
     static const size_t WRITE_CHUNK_SIZE = 8 * KILOBYTE;
 
+    /* The write handler stops adding queued writes to a batch once it has this
+    many bytes, so that the first writes in it aren't held up for too long. */
+    static const size_t WRITE_BATCH_MAX_SIZE = WRITE_QUEUE_MAX_SIZE;
+
+    /* If write corking is enabled, batches of at least this many bytes are
+    corked. */
+    static const size_t CORK_MIN_SIZE = 64 * KILOBYTE;
+
     /* Structs to avoid over-using dynamic allocation */
     struct write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
         char buffer[WRITE_CHUNK_SIZE];
@@ -241,19 +259,35 @@ private:
     };
 
     struct write_queue_op_t : public intrusive_list_node_t<write_queue_op_t> {
+        write_queue_op_t()
+            : dealloc(NULL), buffer(NULL), size(0), iov(NULL), iovcnt(0),
+              limiter_count(0), recycle(false), cond(NULL) { }
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        /* If `iov` is set, the op writes these buffers instead of `buffer`. */
+        const iovec *iov;
+        size_t iovcnt;
+        /* How much of `write_queue_limiter` the op holds. */
+        int64_t limiter_count;
+        /* True if the op came from `get_write_queue_op()` and goes back there
+        once it's done; false if it belongs to a caller that's waiting on `cond`. */
+        bool recycle;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
 
+    /* Writes out the queued ops. Whatever else is in the queue when it takes an
+    op gets written along with it, in as few `writev()` calls as possible. */
     class write_handler_t : public coro_pool_callback_t<write_queue_op_t*> {
     public:
         explicit write_handler_t(linux_tcp_conn_t *_parent);
     private:
         linux_tcp_conn_t *parent;
         void coro_pool_callback(write_queue_op_t *operation, signal_t *interruptor);
+        void finish_op(write_queue_op_t *op);
+        /* The batch being written; kept around so it doesn't get reallocated. */
+        std::vector<iovec> batch_iov;
     } write_handler;
 
     template <class T>
@@ -283,6 +317,9 @@ private:
     data to be completely written. */
     void internal_flush_write_buffer();
 
+    /* Copies data into `current_write_buffer`, flushing it whenever it's full. */
+    void internal_write_buffered(const char *buf, size_t size);
+
     /* Used to queue up buffers to write. The functions in `write_queue` will all be
     `std::bind()`s of the `perform_write()` function below. */
     unlimited_fifo_queue_t<write_queue_op_t*, intrusive_list_t<write_queue_op_t> > write_queue;
@@ -302,6 +339,12 @@ private:
     `size` bytes from `buffer` to the socket. */
     void perform_write(const void *buffer, size_t size);
 
+    /* Like `perform_write()`, but for a gather write. Modifies `iov` as it goes. */
+    void perform_writev(iovec *iov, size_t iovcnt);
+
+    void set_cork(bool cork);
+    bool write_corking;
+
     scoped_ptr_t<auto_drainer_t> drainer;
 };
 
@@ -332,8 +375,12 @@ the provided callback will be called in a new coroutine every time something con
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
+    /* If `reuse_port` is true, the sockets are bound with SO_REUSEPORT, so other
+    listeners that also set it can share the port; see
+    `linux_tcp_reuseport_listener_t`. */
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback,
+        bool reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -372,6 +419,9 @@ private:
     // The port we're asked to bind to
     int port;
 
+    // Whether to set SO_REUSEPORT on the sockets
+    bool reuse_port;
+
     // Inidicates successful binding to a port
     bool bound;
 
@@ -412,6 +462,35 @@ private:
     scoped_ptr_t<linux_nonthrowing_tcp_listener_t> listener;
 };
 
+/* Listens on the same port from each of the first `num_threads` threads, each with
+sockets of its own that have SO_REUSEPORT set, so that the kernel spreads incoming
+connections over the threads instead of one thread accepting all of them. The
+callback is called on the thread that accepted the connection, so the connection
+can be served there without moving it. Throws `address_in_use_exc_t` like
+`linux_tcp_listener_t`. */
+class linux_tcp_reuseport_listener_t {
+public:
+    linux_tcp_reuseport_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
+        int num_threads,
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+    ~linux_tcp_reuseport_listener_t();
+
+    /* Returns false if this platform doesn't have SO_REUSEPORT. */
+    static bool is_supported();
+
+    int get_port() const;
+
+private:
+    void stop_listening(int thread);
+
+    int port;
+
+    /* One per thread; each one is created and destroyed on its own thread. */
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+
+    DISABLE_COPYING(linux_tcp_reuseport_listener_t);
+};
+
 /* Like a linux tcp listener but repeatedly tries to bind to its port until successful */
 class linux_repeated_nonthrowing_tcp_listener_t {
 public:
@@ -15,6 +15,7 @@
 
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/coro_stack_arena.hpp"
 #include "arch/io/concurrency.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
@@ -38,25 +39,11 @@ bool artificial_stack_context_ref_t::is_nil() {
     return pointer == NULL;
 }
 
-artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
-    : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
-
-    /* Tell the operating system that it can unmap the stack space
-    (except for the first page, which we are definitely going to need).
-    This is an optimization to keep memory consumption in check. */
-    guarantee(stack_size >= static_cast<size_t>(getpagesize()));
-    madvise(stack, stack_size - getpagesize(), MADV_DONTNEED);
-
-    /* Protect the end of the stack so that we crash when we get a stack
-    overflow instead of corrupting memory. */
-#ifndef THREADED_COROUTINES
-    mprotect(stack, getpagesize(), PROT_NONE);
-#else
-    /* Instruments hangs when running with mprotect and having object identification enabled.
-    We don't need it for THREADED_COROUTINES anyway, so don't use it then. */
-#endif
+artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), coro_stack_arena_t *_arena)
+    : arena(_arena), stack_size(_arena->stack_size()) {
+    /* Get the stack.  Its first page is already protected, so that we crash when we
+    get a stack overflow instead of corrupting memory. */
+    stack = arena->allocate();
 
     /* Register our stack with Valgrind so that it understands what's going on
     and doesn't create spurious errors */
@@ -146,25 +133,9 @@ artificial_stack_t::~artificial_stack_t() {
 #endif
 #endif
 
-    /* Undo protections changes */
-#ifndef THREADED_COROUTINES
-    mprotect(stack, getpagesize(), PROT_READ | PROT_WRITE);
-#endif
-
-    /* Return the memory to the operating system right away. This makes
-    sense because we keep our own cache of coroutine stacks around and
-    don't need to rely on the allocator to optimize for the case of
-    us quickly re-allocating an object of the same size.
-    On OS X we use MADV_FREE. On Linux MADV_FREE is not available,
-    and we use MADV_DONTNEED instead. */
-#ifdef __MACH__
-    madvise(stack, stack_size, MADV_FREE);
-#else
-    madvise(stack, stack_size, MADV_DONTNEED);
-#endif
-
-    /* Release the stack we allocated */
-    free(stack);
+    /* Give the stack back.  The arena keeps it (and its protection page) around
+    for the next coroutine, but lets the operating system have its memory. */
+    arena->release(stack);
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
@@ -399,9 +370,9 @@ void threaded_context_ref_t::store_virtual_thread() {
     my_thread = linux_thread_pool_t::get_thread();
 }
 
-threaded_stack_t::threaded_stack_t(void (*initial_fun_)(void), size_t stack_size) :
+threaded_stack_t::threaded_stack_t(void (*initial_fun_)(void), coro_stack_arena_t *arena) :
     initial_fun(initial_fun_),
-    dummy_stack(initial_fun, stack_size) {
+    dummy_stack(initial_fun, arena) {
 
     scoped_ptr_t<system_mutex_t::lock_t> possible_lock_acq;
     if (!coro_t::self()) {
@@ -40,14 +40,16 @@ private:
     DISABLE_COPYING(artificial_stack_context_ref_t);
 };
 
+class coro_stack_arena_t;
+
 class artificial_stack_t {
 public:
 
-    /* `artificial_stack_t()` sets up an artificial context. Once it is set up,
-    you can use `context` to swap into and out of it. When you call
-    `~artificial_stack_t()`, the original context must have been returned to
-    `context` again. */
-    artificial_stack_t(void (*initial_fun)(void), size_t stack_size);
+    /* `artificial_stack_t()` sets up an artificial context on a stack from
+    `arena`. Once it is set up, you can use `context` to swap into and out of it.
+    When you call `~artificial_stack_t()`, the original context must have been
+    returned to `context` again. */
+    artificial_stack_t(void (*initial_fun)(void), coro_stack_arena_t *arena);
     ~artificial_stack_t();
 
     artificial_stack_context_ref_t context;
@@ -66,6 +68,7 @@ public:
     void *get_stack_bound() { return stack; }
 
 private:
+    coro_stack_arena_t *arena;
     void *stack;
     size_t stack_size;
 #ifdef VALGRIND
@@ -159,7 +162,7 @@ void context_switch(threaded_context_ref_t *current_context,
 class threaded_stack_t {
 public:
 
-    threaded_stack_t(void (*initial_fun_)(void), size_t stack_size);
+    threaded_stack_t(void (*initial_fun_)(void), coro_stack_arena_t *arena);
     ~threaded_stack_t();
 
     threaded_context_ref_t context;
@@ -0,0 +1,197 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_sampler.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "arch/runtime/runtime.hpp"
+#include "backtrace.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rethinkdb_backtrace.hpp"
+#include "threading.hpp"
+#include "utils.hpp"
+
+int coro_sampling_threshold = CORO_SAMPLING_INTERVAL;
+
+void set_coro_sampling_interval(int interval) {
+    guarantee(interval >= 0);
+    coro_sampling_threshold = interval == 0 ? INT_MAX : interval;
+}
+
+int get_coro_sampling_interval() {
+    return coro_sampling_threshold == INT_MAX ? 0 : coro_sampling_threshold;
+}
+
+coro_sampler_t::coro_sampler_t()
+    : runs_since_sample_(0), sampled_coro_(NULL), resumed_at_(0),
+      ring_next_(0) { }
+
+void coro_sampler_t::start_sample(const void *coro) {
+    // With sampling off, this only happens every `INT_MAX` runs, to keep the counter
+    // from overflowing.
+    const bool sampling_off = coro_sampling_threshold == INT_MAX;
+    runs_since_sample_ = 0;
+    if (sampling_off) {
+        return;
+    }
+    sampled_coro_ = coro;
+    resumed_at_ = get_ticks();
+}
+
+void coro_sampler_t::finish_sample(const char *spawn_site) {
+    const ticks_t now = get_ticks();
+    sampled_coro_ = NULL;
+    if (ring_.empty()) {
+        ring_.resize(CORO_SAMPLER_RING_SIZE);
+    }
+    coro_sample_t *sample = &ring_[ring_next_];
+    ring_next_ = (ring_next_ + 1) % ring_.size();
+
+    sample->spawn_site = spawn_site;
+    sample->run_ticks = now - resumed_at_;
+
+    // Skip our own frame and the one of `rethinkdb_backtrace()`.
+    const int frames_to_skip = NUM_FRAMES_INSIDE_RETHINKDB_BACKTRACE + 1;
+    void *trace[CORO_SAMPLER_TRACE_DEPTH + frames_to_skip];
+    const int depth = rethinkdb_backtrace(trace, CORO_SAMPLER_TRACE_DEPTH + frames_to_skip);
+    sample->yield_point_depth = std::max(depth - frames_to_skip, 0);
+    memcpy(sample->yield_point, trace + frames_to_skip,
+           sample->yield_point_depth * sizeof(void *));
+}
+
+void coro_sampler_t::get_samples(std::vector<coro_sample_t> *samples_out) const {
+    for (const coro_sample_t &sample : ring_) {
+        // Slots that haven't been written yet have no spawn site.
+        if (sample.spawn_site != NULL) {
+            samples_out->push_back(sample);
+        }
+    }
+}
+
+void *coro_profile_perfmon_t::begin_stats() {
+    return new std::vector<coro_sample_t>[get_num_threads()];
+}
+
+void coro_profile_perfmon_t::visit_stats(void *data) {
+    get_coro_sampler()->get_samples(
+        &static_cast<std::vector<coro_sample_t> *>(data)[get_thread_id().threadnum]);
+}
+
+namespace {
+
+// `spawn_site` is a `__PRETTY_FUNCTION__` that ends in "[with Callable = ...]".  Only
+// the callable's type is interesting.
+std::string describe_spawn_site(const char *spawn_site) {
+    std::string description(spawn_site);
+    const std::string marker = "Callable = ";
+    const size_t start = description.find(marker);
+    if (start != std::string::npos) {
+        description = description.substr(start + marker.size());
+        if (!description.empty() && description[description.size() - 1] == ']') {
+            description.resize(description.size() - 1);
+        }
+    }
+    return description;
+}
+
+std::string describe_frame(void *addr) {
+    backtrace_frame_t frame(addr);
+    frame.initialize_symbols();
+    try {
+        return frame.get_demangled_name();
+    } catch (const demangle_failed_exc_t &) {
+        return strprintf("%p", addr);
+    }
+}
+
+struct site_totals_t {
+    site_totals_t() : samples(0), run_ticks(0) { }
+    int64_t samples;
+    ticks_t run_ticks;
+};
+
+}  // namespace
+
+ql::datum_t coro_profile_perfmon_t::end_stats(void *v_data) {
+    std::unique_ptr<std::vector<coro_sample_t>[]> data(
+        static_cast<std::vector<coro_sample_t> *>(v_data));
+
+    typedef std::pair<const char *, std::vector<void *> > site_t;
+    std::map<site_t, site_totals_t> totals;
+    int64_t total_samples = 0;
+    ticks_t total_ticks = 0;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        for (const coro_sample_t &sample : data[i]) {
+            site_totals_t *site_totals = &totals[site_t(
+                sample.spawn_site,
+                std::vector<void *>(sample.yield_point,
+                                    sample.yield_point + sample.yield_point_depth))];
+            ++site_totals->samples;
+            site_totals->run_ticks += sample.run_ticks;
+            ++total_samples;
+            total_ticks += sample.run_ticks;
+        }
+    }
+
+    std::vector<std::pair<ticks_t, const std::pair<const site_t, site_totals_t> *> >
+        by_time;
+    for (const auto &pair : totals) {
+        by_time.push_back(std::make_pair(pair.second.run_ticks, &pair));
+    }
+    std::sort(by_time.begin(), by_time.end(),
+              [](const std::pair<ticks_t, const std::pair<const site_t, site_totals_t> *> &a,
+                 const std::pair<ticks_t, const std::pair<const site_t, site_totals_t> *> &b) {
+                  return a.first > b.first;
+              });
+    if (by_time.size() > CORO_PROFILE_MAX_SITES) {
+        by_time.resize(CORO_PROFILE_MAX_SITES);
+    }
+
+    // Each sample stands for `interval` runs.
+    const int interval = std::max(get_coro_sampling_interval(), 1);
+    std::vector<ql::datum_t> sites;
+    for (const auto &entry : by_time) {
+        const site_t &site = entry.second->first;
+        const site_totals_t &site_totals = entry.second->second;
+
+        std::vector<ql::datum_t> yield_point;
+        bool in_coroutine_code = true;
+        for (void *addr : site.second) {
+            std::string frame = describe_frame(addr);
+            // The first frames are the ones of `coro_t::wait()` and friends.
+            if (in_coroutine_code && frame.compare(0, 8, "coro_t::") == 0) {
+                continue;
+            }
+            in_coroutine_code = false;
+            yield_point.push_back(ql::datum_t(datum_string_t(frame)));
+        }
+
+        ql::datum_object_builder_t builder;
+        builder.overwrite("spawn_site",
+                          ql::datum_t(datum_string_t(describe_spawn_site(site.first))));
+        builder.overwrite("yield_point",
+                          ql::datum_t(std::move(yield_point),
+                                      ql::configured_limits_t::unlimited));
+        builder.overwrite("samples",
+                          ql::datum_t(static_cast<double>(site_totals.samples)));
+        builder.overwrite("estimated_time_ms",
+                          ql::datum_t(static_cast<double>(site_totals.run_ticks)
+                                      * interval / MILLION));
+        builder.overwrite("share",
+                          ql::datum_t(total_ticks == 0 ? 0.0 :
+                              static_cast<double>(site_totals.run_ticks) / total_ticks));
+        sites.push_back(std::move(builder).to_datum());
+    }
+
+    ql::datum_object_builder_t builder;
+    builder.overwrite("sampling_interval", ql::datum_t(static_cast<double>(interval)));
+    builder.overwrite("samples", ql::datum_t(static_cast<double>(total_samples)));
+    builder.overwrite("sites",
+                      ql::datum_t(std::move(sites), ql::configured_limits_t::unlimited));
+    return std::move(builder).to_datum();
+}
@@ -0,0 +1,99 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_SAMPLER_HPP_
+#define ARCH_RUNTIME_CORO_SAMPLER_HPP_
+
+#include <limits.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "perfmon/core.hpp"
+#include "time.hpp"
+
+/* The coroutine sampler finds out which coroutines use up a thread's time.  Unlike
+`coro_profiler_t`, it's in every build and cheap enough to always be on: out of every
+`get_coro_sampling_interval()` times that a coroutine starts running on a thread, the
+thread times one run, and when the coroutine yields it records where the coroutine was
+spawned, where it yielded and how long it ran.  The other runs only cost a counter
+decrement.  The samples go in a per-thread ring buffer, which `coro_profile_perfmon_t`
+aggregates into the `coro_profile` stat (shown by `rethinkdb._debug_coro_profile`).
+That one symbolizes the yield points, so it's only gathered when it's asked for by
+name, not with the other stats. */
+
+// An interval of 0 turns sampling off.  Every thread uses a new interval from its
+// next coroutine run on.
+void set_coro_sampling_interval(int interval);
+int get_coro_sampling_interval();
+
+// How many runs a thread lets go by between samples; `INT_MAX` when sampling is off.
+// Only `set_coro_sampling_interval()` changes it.
+extern int coro_sampling_threshold;
+
+struct coro_sample_t {
+    // The `__PRETTY_FUNCTION__` of the `coro_t::get_and_init_coro()` that spawned
+    // the coroutine, which includes the type of the function it runs.
+    const char *spawn_site;
+    void *yield_point[CORO_SAMPLER_TRACE_DEPTH];
+    int yield_point_depth;
+    ticks_t run_ticks;
+};
+
+class coro_sampler_t {
+public:
+    coro_sampler_t();
+
+    // Called when `coro` starts or continues running.
+    void on_resume(const void *coro) {
+        if (++runs_since_sample_ >= coro_sampling_threshold) {
+            start_sample(coro);
+        }
+    }
+
+    // Called when `coro`, which was spawned at `spawn_site`, stops running.
+    void on_yield(const void *coro, const char *spawn_site) {
+        if (coro == sampled_coro_) {
+            finish_sample(spawn_site);
+        }
+    }
+
+    // Appends the samples in the ring buffer to `samples_out`.
+    void get_samples(std::vector<coro_sample_t> *samples_out) const;
+
+private:
+    void start_sample(const void *coro);
+    void finish_sample(const char *spawn_site);
+
+    int runs_since_sample_;
+    const void *sampled_coro_;
+    ticks_t resumed_at_;
+
+    // Allocated when the first sample is taken, then overwritten in a circle.
+    std::vector<coro_sample_t> ring_;
+    size_t ring_next_;
+
+    DISABLE_COPYING(coro_sampler_t);
+};
+
+// Returns the current thread's sampler.
+coro_sampler_t *get_coro_sampler();
+
+/* Collects the samples from every thread and shows the spawn site and yield point
+pairs that took the most time. */
+class coro_profile_perfmon_t : public perfmon_t {
+public:
+    coro_profile_perfmon_t() { }
+
+    void *begin_stats();
+    void visit_stats(void *data);
+    ql::datum_t end_stats(void *data);
+
+private:
+    DISABLE_COPYING(coro_profile_perfmon_t);
+};
+
+// Returns the `coro_profile` stat, which isn't in the global perfmon collection.
+coro_profile_perfmon_t *get_coro_profile_perfmon();
+
+#endif  // ARCH_RUNTIME_CORO_SAMPLER_HPP_
@@ -0,0 +1,90 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_stack_arena.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "arch/runtime/numa.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "math.hpp"
+#include "perfmon/perfmon.hpp"
+
+coro_stack_arena_t::coro_stack_arena_t(size_t stack_size,
+                                       perfmon_counter_t *pm_reserved_bytes)
+    : stack_size_(ceil_aligned(stack_size, static_cast<size_t>(getpagesize()))),
+      stacks_per_chunk_(std::max<size_t>(1, COROUTINE_STACK_CHUNK_SIZE / stack_size_)),
+      pm_reserved_bytes_(pm_reserved_bytes),
+      madv_free_unsupported_(false) {
+    guarantee(stack_size_ > static_cast<size_t>(getpagesize()));
+}
+
+coro_stack_arena_t::~coro_stack_arena_t() {
+    for (void *chunk : chunks_) {
+        const int res = munmap(chunk, stacks_per_chunk_ * stack_size_);
+        guarantee_err(res == 0, "Could not unmap coroutine stacks");
+    }
+    *pm_reserved_bytes_ -= reserved_bytes();
+}
+
+void *coro_stack_arena_t::allocate() {
+    if (free_stacks_.empty()) {
+        reserve_chunk();
+    }
+    void *stack = free_stacks_.back();
+    free_stacks_.pop_back();
+    return stack;
+}
+
+void coro_stack_arena_t::release(void *stack) {
+    /* Let the OS have the stack's pages back.  With `MADV_FREE` it only takes them
+    when it needs the memory, and doesn't have to fault fresh pages in if we reuse the
+    stack before then.  `MADV_DONTNEED` frees them right away. */
+    char *pages = static_cast<char *>(stack) + getpagesize();
+    const size_t pages_size = stack_size_ - getpagesize();
+#ifdef MADV_FREE
+    if (!madv_free_unsupported_) {
+        if (madvise(pages, pages_size, MADV_FREE) != 0) {
+            // Linux only has `MADV_FREE` since 4.5.
+            madv_free_unsupported_ = true;
+        }
+    }
+    if (madv_free_unsupported_) {
+        madvise(pages, pages_size, MADV_DONTNEED);
+    }
+#else
+    madvise(pages, pages_size, MADV_DONTNEED);
+#endif
+    free_stacks_.push_back(stack);
+}
+
+void coro_stack_arena_t::reserve_chunk() {
+    const size_t chunk_size = stacks_per_chunk_ * stack_size_;
+    void *chunk = mmap(NULL, chunk_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    guarantee_err(chunk != MAP_FAILED, "Could not reserve memory for coroutine stacks");
+    // Coroutines can move to other threads, but they mostly run on the thread
+    // they were spawned on.
+    const int node = get_thread_numa_node(get_thread_id());
+    if (node != -1) {
+        prefer_numa_node_for_memory(chunk, chunk_size, node);
+    }
+    chunks_.push_back(chunk);
+    *pm_reserved_bytes_ += chunk_size;
+
+    // Pushed in reverse, so the stacks get handed out in address order.
+    for (size_t i = stacks_per_chunk_; i-- > 0;) {
+        char *stack = static_cast<char *>(chunk) + i * stack_size_;
+#ifndef THREADED_COROUTINES
+        /* Protect the end of the stack so that we crash when we get a stack
+        overflow instead of corrupting memory. */
+        mprotect(stack, getpagesize(), PROT_NONE);
+#else
+        /* Instruments hangs when running with mprotect and having object identification
+        enabled.  We don't need it for THREADED_COROUTINES anyway, so don't use it then. */
+#endif
+        free_stacks_.push_back(stack);
+    }
+}
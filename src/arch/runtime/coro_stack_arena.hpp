@@ -0,0 +1,52 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_STACK_ARENA_HPP_
+#define ARCH_RUNTIME_CORO_STACK_ARENA_HPP_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include "perfmon/types.hpp"
+
+/* `coro_stack_arena_t` provides the memory for one thread's coroutine stacks.  It
+reserves address space for many stacks at once and protects each stack's guard page
+just once, when the space is reserved.  After that, handing out a stack and taking it
+back don't need any system calls, except for telling the OS that it may reclaim the
+pages of a stack that was given back.  It isn't thread-safe; each thread has its own
+(see `coro_globals_t`). */
+class coro_stack_arena_t {
+public:
+    // `pm_reserved_bytes` tracks how much address space the arena has reserved.
+    coro_stack_arena_t(size_t stack_size, perfmon_counter_t *pm_reserved_bytes);
+    ~coro_stack_arena_t();
+
+    /* Returns `stack_size()` bytes of page-aligned memory, whose first page is
+    protected so that overflowing the stack crashes instead of corrupting memory. */
+    void *allocate();
+    void release(void *stack);
+
+    size_t stack_size() const { return stack_size_; }
+    size_t reserved_bytes() const { return chunks_.size() * stacks_per_chunk_ * stack_size_; }
+
+private:
+    void reserve_chunk();
+
+    const size_t stack_size_;
+    const size_t stacks_per_chunk_;
+    perfmon_counter_t *const pm_reserved_bytes_;
+
+    // The start of every chunk of address space we've reserved.
+    std::vector<void *> chunks_;
+
+    // Stacks that aren't in use.  The most recently released ones are at the back, so
+    // they get reused first, while their pages may still be around.
+    std::vector<void *> free_stacks_;
+
+    // Set once we find out that the OS doesn't know `MADV_FREE`.
+    bool madv_free_unsupported_;
+
+    DISABLE_COPYING(coro_stack_arena_t);
+};
+
+#endif  // ARCH_RUNTIME_CORO_STACK_ARENA_HPP_
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
 #include <functional>
 #ifndef NDEBUG
 #include <map>
@@ -13,11 +14,14 @@
 
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coro_profiler.hpp"
+#include "arch/runtime/coro_sampler.hpp"
+#include "arch/runtime/coro_stack_arena.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "config/args.hpp"
 #include "debug.hpp"
 #include "do_on_thread.hpp"
+#include "math.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rethinkdb_backtrace.hpp"
 #include "thread_local.hpp"
@@ -41,9 +45,24 @@ struct coro_globals_t {
     /* The previous context. */
     coro_t *prev_coro;
 
+    /* Times some of the coroutines' runs. */
+    coro_sampler_t sampler;
+
+    /* Where the coroutines' stacks come from. */
+    coro_stack_arena_t stack_arena;
+
     /* A list of coro_t objects that are not in use. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* How many coro_t objects `free_coros` may hold.  It's recomputed every
+    `COROUTINE_FREE_LIST_WINDOW` spawns from the most coroutines that were running
+    at once during that time, so a thread that keeps starting bursts of coroutines
+    doesn't have to set up new ones for every burst. */
+    size_t free_list_limit;
+    size_t running_coros;
+    size_t peak_running_coros;
+    int spawns_in_window;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -69,16 +88,7 @@ struct coro_globals_t {
 
 #endif  // NDEBUG
 
-    coro_globals_t()
-        : current_coro(NULL)
-        , prev_coro(NULL)
-#ifndef NDEBUG
-        , coro_count(0)
-        , printed_high_coro_count_warning(false)
-        , assert_no_coro_waiting_counter(0)
-        , assert_finite_coro_waiting_counter(0)
-#endif
-        { }
+    coro_globals_t();
 
     ~coro_globals_t() {
         /* We shouldn't be shutting down from within a coroutine */
@@ -98,10 +108,41 @@ TLS_with_init(coro_globals_t *, cglobals, NULL);
 // These must be initialized after TLS_cglobals, because perfmon_multi_membership_t
 // construction depends on coro_t::coroutines_have_been_initialized() which in turn
 // depends on cglobals.
-static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+// `pm_thread_switches` counts every time a coroutine moves to another thread, each
+// of which is a message through the thread's message hub.
+// `pm_coroutine_stack_bytes` is the address space reserved for stacks, and
+// `pm_coroutine_stacks_created` and `pm_coroutine_stacks_destroyed` count how often
+// coroutines (and so their stacks) are set up and torn down.
+static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines,
+    pm_thread_switches, pm_coroutine_stack_bytes, pm_coroutine_stacks_created,
+    pm_coroutine_stacks_destroyed;
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
-    &pm_allocated_coroutines, "allocated_coroutines");
+    &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_thread_switches, "thread_switches",
+    &pm_coroutine_stack_bytes, "coroutine_stack_bytes",
+    &pm_coroutine_stacks_created, "coroutine_stacks_created",
+    &pm_coroutine_stacks_destroyed, "coroutine_stacks_destroyed");
+
+// Not in the global collection, since gathering it is too slow for every stats
+// request; see `get_coro_profile_perfmon()`.
+static coro_profile_perfmon_t pm_coro_profile;
+
+coro_globals_t::coro_globals_t()
+    : current_coro(NULL)
+    , prev_coro(NULL)
+    , stack_arena(coro_stack_size, &pm_coroutine_stack_bytes)
+    , free_list_limit(COROUTINE_FREE_LIST_SIZE)
+    , running_coros(0)
+    , peak_running_coros(0)
+    , spawns_in_window(0)
+#ifndef NDEBUG
+    , coro_count(0)
+    , printed_high_coro_count_warning(false)
+    , assert_no_coro_waiting_counter(0)
+    , assert_finite_coro_waiting_counter(0)
+#endif
+    { }
 
 coro_runtime_t::coro_runtime_t() {
     rassert(!TLS_get_cglobals(), "coro runtime initialized twice on this thread");
@@ -128,8 +169,9 @@ TLS_with_init(int64_t, coro_selfname_counter, 0);
 #endif
 
 coro_t::coro_t() :
-    stack(&coro_t::run, coro_stack_size),
+    stack(&coro_t::run, &TLS_get_cglobals()->stack_arena),
     current_thread_(linux_thread_pool_t::get_thread_id()),
+    spawn_site_(NULL),
     notified_(false),
     waiting_(false)
 #ifndef NDEBUG
@@ -144,6 +186,7 @@ coro_t::coro_t() :
 #endif
 {
     ++pm_allocated_coroutines;
+    ++pm_coroutine_stacks_created;
 
 #ifndef NDEBUG
     TLS_get_cglobals()->coro_count++;
@@ -158,11 +201,12 @@ coro_t::coro_t() :
 
 void coro_t::return_coro_to_free_list(coro_t *coro) {
     TLS_get_cglobals()->free_coros.push_back(coro);
+    --TLS_get_cglobals()->running_coros;
 }
 
 void coro_t::maybe_evict_from_free_list() {
     coro_globals_t *cglobals = TLS_get_cglobals();
-    while (cglobals->free_coros.size() > COROUTINE_FREE_LIST_SIZE) {
+    while (cglobals->free_coros.size() > cglobals->free_list_limit) {
         coro_t *coro_to_delete = cglobals->free_coros.tail();
         cglobals->free_coros.remove(coro_to_delete);
         delete coro_to_delete;
@@ -177,6 +221,7 @@ coro_t::~coro_t() {
     TLS_get_cglobals()->coro_count--;
 #endif
     --pm_allocated_coroutines;
+    ++pm_coroutine_stacks_destroyed;
 }
 
 void coro_t::run() {
@@ -201,7 +246,9 @@ void coro_t::run() {
         TLS_get_cglobals()->active_coroutines.insert(coro);
 #endif
         PROFILER_CORO_RESUME;
+        TLS_get_cglobals()->sampler.on_resume(coro);
         coro->action_wrapper.run();
+        TLS_get_cglobals()->sampler.on_yield(coro, coro->spawn_site_);
         PROFILER_CORO_YIELD(0);
 #ifndef NDEBUG
         TLS_get_cglobals()->running_coroutine_counts[coro->coroutine_type]--;
@@ -212,6 +259,7 @@ void coro_t::run() {
 
         // Destroy the Callable object which was either allocated within the coro_t or on the heap
         coro->action_wrapper.reset();
+        coro->switch_count_.reset();
 
         /* Return the context to the free-contexts list we took it from. */
         do_on_thread(coro->home_thread(), std::bind(&coro_t::return_coro_to_free_list, coro));
@@ -255,11 +303,13 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = true;
 
     PROFILER_CORO_YIELD(1);
+    TLS_get_cglobals()->sampler.on_yield(self(), self()->spawn_site_);
     if (TLS_get_cglobals()->prev_coro) {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
     } else {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->scheduler);
     }
+    TLS_get_cglobals()->sampler.on_resume(self());
     PROFILER_CORO_RESUME;
 
     rassert(self());
@@ -297,6 +347,7 @@ void coro_t::notify_now_deprecated() {
 
     if (coro_t::self() != NULL) {
         PROFILER_CORO_YIELD(1);
+        TLS_get_cglobals()->sampler.on_yield(self(), self()->spawn_site_);
     }
     coro_t *prev_prev_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = TLS_get_cglobals()->current_coro;
@@ -312,6 +363,7 @@ void coro_t::notify_now_deprecated() {
     TLS_get_cglobals()->current_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = prev_prev_coro;
     if (coro_t::self() != NULL) {
+        TLS_get_cglobals()->sampler.on_resume(self());
         PROFILER_CORO_RESUME;
     }
 
@@ -347,11 +399,32 @@ void coro_t::move_to_thread(threadnum_t thread) {
         // If we're trying to switch to the thread we're currently on, do nothing.
         return;
     }
+    ++pm_thread_switches;
+    if (self()->switch_count_.has()) {
+        self()->switch_count_->add();
+    }
     self()->current_thread_ = thread;
     self()->notify_later_ordered();
     wait();
 }
 
+count_thread_switches_t::count_thread_switches_t()
+    : coro(coro_t::self()),
+      count(make_counted<thread_switch_count_t>()) {
+    rassert(coro != NULL, "count_thread_switches_t made outside a coroutine.");
+    outer_count = std::move(coro->switch_count_);
+    coro->switch_count_ = count;
+}
+
+count_thread_switches_t::~count_thread_switches_t() {
+    rassert(coro_t::self() == coro);
+    coro->switch_count_ = std::move(outer_count);
+}
+
+int64_t count_thread_switches_t::get() const {
+    return count->get();
+}
+
 void coro_t::on_thread_switch() {
     rassert(notified_);
     notified_ = false;
@@ -377,6 +450,14 @@ bool is_coroutine_stack_overflow(void *addr) {
     return TLS_get_cglobals()->current_coro && TLS_get_cglobals()->current_coro->stack.address_is_stack_overflow(addr);
 }
 
+coro_sampler_t *get_coro_sampler() {
+    return &TLS_get_cglobals()->sampler;
+}
+
+coro_profile_perfmon_t *get_coro_profile_perfmon() {
+    return &pm_coro_profile;
+}
+
 bool coroutines_have_been_initialized() {
     return TLS_get_cglobals() != NULL;
 }
@@ -385,6 +466,19 @@ coro_t * coro_t::get_coro() {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    ++cglobals->running_coros;
+    cglobals->peak_running_coros =
+        std::max(cglobals->peak_running_coros, cglobals->running_coros);
+    if (++cglobals->spawns_in_window == COROUTINE_FREE_LIST_WINDOW) {
+        // Keep enough coroutines around for half of the recent peak.
+        cglobals->free_list_limit = clamp<size_t>(cglobals->peak_running_coros / 2,
+                                                  COROUTINE_FREE_LIST_SIZE,
+                                                  COROUTINE_MAX_FREE_LIST_SIZE);
+        cglobals->peak_running_coros = cglobals->running_coros;
+        cglobals->spawns_in_window = 0;
+    }
+
     if (TLS_get_cglobals()->free_coros.size() == 0) {
         coro = new coro_t();
     } else {
@@ -9,6 +9,7 @@
 #include "arch/runtime/callable_action.hpp"
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/runtime_utils.hpp"
+#include "containers/counted.hpp"
 #include "threading.hpp"
 #include "time.hpp"
 
@@ -23,6 +24,21 @@ const size_t MAX_COROUTINE_STACK_SIZE = 8*1024*1024;
 threadnum_t get_thread_id();
 struct coro_globals_t;
 
+/* The number of thread switches made by the coroutines of a
+`count_thread_switches_t`. */
+class thread_switch_count_t : public slow_atomic_countable_t<thread_switch_count_t> {
+public:
+    thread_switch_count_t() : count(0) { }
+    int64_t get() const {
+        return static_cast<const volatile int64_t &>(count);
+    }
+    void add() {
+        __sync_add_and_fetch(&count, 1);
+    }
+private:
+    int64_t count;
+};
+
 
 struct coro_profiler_mixin_t {
 #ifdef ENABLE_CORO_PROFILER
@@ -163,6 +179,8 @@ private:
     // Generates a spawn-time backtrace and stores it into `spawn_backtrace`.
     void grab_spawn_backtrace();
 
+    friend class count_thread_switches_t;
+
     // If this function footprint ever changes, you may need to update the parse_coroutine_info function
     template<class Callable>
     static coro_t *get_and_init_coro(Callable &&action) {
@@ -170,6 +188,7 @@ private:
 #ifndef NDEBUG
         coro->parse_coroutine_type(__PRETTY_FUNCTION__);
 #endif
+        coro->spawn_site_ = __PRETTY_FUNCTION__;
         coro->grab_spawn_backtrace();
         coro->action_wrapper.reset(std::forward<Callable>(action));
 
@@ -177,6 +196,8 @@ private:
         // caller's priority.
         if (self() != NULL) {
             coro->set_priority(self()->get_priority());
+            // Likewise for where its thread switches are counted.
+            coro->switch_count_ = self()->switch_count_;
         } else {
             // Otherwise, just reset to the default.
             coro->set_priority(MESSAGE_SCHEDULER_DEFAULT_PRIORITY);
@@ -202,12 +223,18 @@ private:
 
     threadnum_t current_thread_;
 
+    // Where the coroutine was spawned, for the coroutine sampler.
+    const char *spawn_site_;
+
     // Sanity check variables
     bool notified_;
     bool waiting_;
 
     callable_action_wrapper_t action_wrapper;
 
+    // Where to count the coroutine's thread switches, if anywhere.
+    counted_t<thread_switch_count_t> switch_count_;
+
 #ifndef NDEBUG
     int64_t selfname_number;
     std::string coroutine_type;
@@ -226,6 +253,28 @@ private:
 bool is_coroutine_stack_overflow(void *addr);
 bool coroutines_have_been_initialized();
 
+/* `count_thread_switches_t` counts the thread switches of the coroutine it's made in
+until it's destroyed, along with those of every coroutine spawned from that
+coroutine in the meantime, and from those in turn.  So it counts the mailbox
+messages that a query sends to other threads, and their replies, as well as the
+query moving between threads itself.  Coroutines that outlive it keep counting
+into `get()`.  It has to be destroyed in the coroutine it was made in; while it
+exists, it takes the place of any counter the coroutine had before. */
+class count_thread_switches_t {
+public:
+    count_thread_switches_t();
+    ~count_thread_switches_t();
+
+    int64_t get() const;
+
+private:
+    coro_t *coro;
+    counted_t<thread_switch_count_t> count;
+    counted_t<thread_switch_count_t> outer_count;
+
+    DISABLE_COPYING(count_thread_switches_t);
+};
+
 class home_coro_mixin_t {
 private:
     coro_t *home_coro;
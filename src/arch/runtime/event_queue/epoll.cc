@@ -46,7 +46,8 @@ int epoll_to_user(int mode) {
 }
 
 epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
-    : parent(_parent) {
+    : parent(_parent), nevents(0),
+      batch_size(MIN_IO_EVENT_PROCESSING_BATCH_SIZE), ctl_calls(0) {
     // Create a poll fd
 
     epoll_fd = epoll_create1(0);
@@ -59,7 +60,7 @@ void epoll_event_queue_t::run() {
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+        res = epoll_wait(epoll_fd, events, batch_size, -1);
 
         // epoll_wait might return with EINTR in some cases (in
         // particular under GDB), we just need to retry.
@@ -78,6 +79,15 @@ void epoll_event_queue_t::run() {
         // nevents might be used by forget_resource during the loop
         nevents = res;
 
+        // Take more events at a time while we keep filling the batch, and fewer
+        // again once the load goes down, so a busy thread spends less time in
+        // `epoll_wait()` and an idle one doesn't starve its message queue.
+        if (nevents == batch_size) {
+            batch_size = std::min(batch_size * 2, MAX_IO_EVENT_PROCESSING_BATCH_SIZE);
+        } else if (nevents < batch_size / 4) {
+            batch_size = std::max(batch_size / 2, MIN_IO_EVENT_PROCESSING_BATCH_SIZE);
+        }
+
 #ifndef NDEBUG
         /* Sanity check: Make sure epoll() didn't give us any events we didn't ask for */
         for (int i = 0; i < nevents; i++) {
@@ -134,6 +144,7 @@ void epoll_event_queue_t::watch_resource(fd_t resource, int watch_mode, linux_ev
     event.events = EPOLLET | user_to_epoll(watch_mode);
     event.data.ptr = cb;
 
+    ++ctl_calls;
     int res = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, resource, &event);
     guarantee_err(res == 0, "Could not watch resource\n");
 
@@ -147,6 +158,7 @@ void epoll_event_queue_t::adjust_resource(fd_t resource, int watch_mode, linux_e
     event.events = EPOLLET | user_to_epoll(watch_mode);
     event.data.ptr = cb;
 
+    ++ctl_calls;
     int res = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, resource, &event);
     guarantee_err(res == 0, "Could not adjust resource");
 
@@ -169,6 +181,7 @@ void epoll_event_queue_t::forget_resource(fd_t resource, linux_event_callback_t
     event.events = EPOLLIN;
     event.data.ptr = NULL;
 
+    ++ctl_calls;
     int res = epoll_ctl(epoll_fd, EPOLL_CTL_DEL, resource, &event);
     guarantee_err(res == 0, "Couldn't remove resource from watching");
 
@@ -2,6 +2,7 @@
 #ifndef ARCH_RUNTIME_EVENT_QUEUE_EPOLL_HPP_
 #define ARCH_RUNTIME_EVENT_QUEUE_EPOLL_HPP_
 
+#include <stdint.h>
 #include <sys/epoll.h>
 
 #ifndef NDEBUG
@@ -25,6 +26,9 @@ public:
     void adjust_resource(fd_t resource, int events, linux_event_callback_t *cb);
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
+    // How many times `epoll_ctl()` was called, for benchmarks.
+    uint64_t num_ctl_calls() const { return ctl_calls; }
+
 private:
     linux_queue_parent_t *parent;
 
@@ -36,6 +40,12 @@ private:
     epoll_event events[MAX_IO_EVENT_PROCESSING_BATCH_SIZE];
     int nevents;
 
+    // How many events we ask `epoll_wait()` for, between
+    // MIN_IO_EVENT_PROCESSING_BATCH_SIZE and MAX_IO_EVENT_PROCESSING_BATCH_SIZE.
+    int batch_size;
+
+    uint64_t ctl_calls;
+
 #ifndef NDEBUG
     /* In debug mode, check to make sure epoll() doesn't give us events that
     we didn't ask for. The ints stored here are combinations of poll_event_in
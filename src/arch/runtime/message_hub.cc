@@ -20,7 +20,9 @@ linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          threadnum_t current_thread)
     : queue_(queue),
       thread_pool_(thread_pool),
-      is_woken_up_(false),
+      num_pending_threads_(0),
+      incoming_head_(NULL),
+      is_woken_up_(0),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -44,12 +46,17 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(num_pending_threads_ == 0);
+    guarantee(incoming_head_ == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
     rassert(0 <= nthread.threadnum && nthread.threadnum < thread_pool_->n_threads);
-    queues_[nthread.threadnum].msg_local_list.push_back(msg);
+    msg_list_t *list = &queues_[nthread.threadnum].msg_local_list;
+    if (list->empty()) {
+        pending_threads_[num_pending_threads_++] = nthread.threadnum;
+    }
+    list->push_back(msg);
 }
 
 // Collects a message for a given thread onto a local list.
@@ -91,15 +98,39 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    push_incoming_messages(&msgs);
+}
+
+void linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    rassert(!msgs->empty());
+
+    // Link the messages newest first, the way they're kept on the stack.
+    linux_thread_message_t *oldest = msgs->head();
+    linux_thread_message_t *newest = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->incoming_next_ = newest;
+        newest = m;
+    }
+
+    linux_thread_message_t *old_head;
+    do {
+        old_head = incoming_head_;
+        oldest->incoming_next_ = old_head;
+    } while (!__sync_bool_compare_and_swap(&incoming_head_, old_head, newest));
+
+    // If the stack wasn't empty, whoever made it non-empty has taken care of waking
+    // up our thread.
+    if (old_head == NULL) {
+        wake_up();
     }
+}
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+void linux_message_hub_t::wake_up() {
+    if (__sync_fetch_and_or(&is_woken_up_, 1) == 0) {
+        // Wakey wakey eggs and bakey
         event_.wakey_wakey();
     }
 }
@@ -175,36 +206,32 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
-                event_.wakey_wakey();
-            }
+            wake_up();
             break;
         }
     }
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
-
-    // 1. Pull the messages
-    msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    // 1. Take the whole stack.  Clearing is_woken_up_ first means that anyone who
+    // pushes onto the stack after we take it wakes us up again.  (Both are full
+    // barriers.)
+    __sync_fetch_and_and(&is_woken_up_, 0);
+    linux_thread_message_t *newest = __sync_lock_test_and_set(&incoming_head_, NULL);
+
+    // 2. Reverse it, so the messages are in the order they were pushed in.
+    linux_thread_message_t *oldest = NULL;
+    while (newest != NULL) {
+        linux_thread_message_t *next = newest->incoming_next_;
+        newest->incoming_next_ = oldest;
+        oldest = newest;
+        newest = next;
     }
 
-    // 2. Sort the messages into their respective priority queues
-    while (linux_thread_message_t *m = new_messages.head()) {
-        new_messages.remove(m);
+    // 3. Sort the messages into their respective priority queues
+    while (linux_thread_message_t *m = oldest) {
+        oldest = m->incoming_next_;
+        m->incoming_next_ = NULL;
         int effective_priority = m->priority;
         if (m->is_ordered) {
             // Ordered messages are treated as if they had
@@ -218,38 +245,15 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
     }
 }
 
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
-}
-
-// Pushes messages collected locally global lists available to all
-// threads.
+// Pushes messages collected locally onto the incoming stacks of the threads
+// they're going to.
 void linux_message_hub_t::push_messages() {
-    for (int i = 0; i < thread_pool_->n_threads; i++) {
-        // Append the local list for ith thread to that thread's global
-        // message list.
+    for (int j = 0; j < num_pending_threads_; ++j) {
+        const int i = pending_threads_[j];
         thread_queue_t *queue = &queues_[i];
-        if (!queue->msg_local_list.empty()) {
-            // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
-        }
+        rassert(!queue->msg_local_list.empty());
+        thread_pool_->threads[i]->message_hub.push_incoming_messages(
+            &queue->msg_local_list);
     }
+    num_pending_threads_ = 0;
 }
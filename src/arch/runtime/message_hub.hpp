@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -24,7 +23,14 @@ class linux_thread_pool_t;
 /* There is one message hub per thread, NOT one message hub for the entire program.
 
 Each message hub stores messages that are going from that message hub's home thread to
-other threads. It keeps a separate queue for messages destined for each other thread. */
+other threads. It keeps a separate queue for messages destined for each other thread.
+
+Messages for a hub's own thread arrive on a lock-free stack, which any thread can push
+a batch of messages onto with one compare-and-swap.  The receiving thread takes the
+whole stack at once, and reverses it to get the messages back in the order they were
+sent.  The receiving thread is only woken up through its eventfd when a batch goes onto
+an empty stack and nobody has woken it up since it last took the stack, so while it's
+busy processing messages, senders don't make any system calls. */
 
 class linux_message_hub_t : private linux_event_callback_t {
 public:
@@ -33,8 +39,8 @@ public:
     linux_message_hub_t(linux_event_queue_t *queue, linux_thread_pool_t *thread_pool,
                         threadnum_t current_thread);
 
-    /* For each thread, transfer messages from our msg_local_list for that thread to our
-    msg_global_list for that thread */
+    /* For each thread we have stored messages for, push the messages from our
+    msg_local_list for that thread onto that thread's incoming stack */
     void push_messages();
 
     /* Schedules the given message to be sent to the given thread by pushing it onto our
@@ -56,7 +62,15 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Pushes all of `msgs` onto our incoming stack, and wakes up our thread if it
+    // needs to be.  May be called on any thread.
+    void push_incoming_messages(msg_list_t *msgs);
+
+    // Wakes up our thread, unless it has been woken up since it last took the
+    // incoming stack.  May be called on any thread.
+    void wake_up();
+
+    // Moves messages from the incoming stack into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
@@ -69,16 +83,23 @@ private:
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed to the other thread's incoming
+        stack, so that we only do one compare-and-swap per thread per event loop
+        iteration */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    // The threads whose msg_local_list isn't empty, in no particular order, so that
+    // push_messages() doesn't have to look at every thread's list.
+    int pending_threads_[MAX_THREADS];
+    int num_pending_threads_;
+
+    // The most recently pushed incoming message, linked to the ones pushed before it
+    // through their incoming_next_.  Only touched with atomic operations.
+    linux_thread_message_t *incoming_head_;
+    // Nonzero if our thread has been woken up since it last took the incoming
+    // stack.  Only touched with atomic operations.
+    int is_woken_up_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -91,7 +112,7 @@ private:
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto the incoming stack.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
@@ -0,0 +1,169 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#include <string>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+static bool numa_placement = false;
+
+void set_numa_placement(bool enabled) {
+    numa_placement = enabled;
+}
+
+bool get_numa_placement() {
+    return numa_placement;
+}
+
+namespace {
+
+// Reads a sysfs list like "0-3,8-11".  Returns false if the file can't be read.
+bool read_id_list(const std::string &path, std::vector<int> *ids_out) {
+    ids_out->clear();
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    char buf[4096];
+    const bool ok = fgets(buf, sizeof(buf), file) != NULL;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    char *pos = buf;
+    for (;;) {
+        char *end;
+        const long first = strtol(pos, &end, 10);  // NOLINT(runtime/int)
+        if (end == pos) {
+            break;
+        }
+        long last = first;  // NOLINT(runtime/int)
+        pos = end;
+        if (*pos == '-') {
+            ++pos;
+            last = strtol(pos, &end, 10);
+            if (end == pos) {
+                return false;
+            }
+            pos = end;
+        }
+        for (long id = first; id <= last; ++id) {  // NOLINT(runtime/int)
+            ids_out->push_back(static_cast<int>(id));
+        }
+        if (*pos != ',') {
+            break;
+        }
+        ++pos;
+    }
+    return true;
+}
+
+#ifdef _GNU_SOURCE
+// Leaves out the CPUs that `taskset` or a cgroup keeps us off.
+bool may_run_on(int cpu) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return true;
+    }
+    return cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed);
+}
+#else
+bool may_run_on(int) {
+    return true;
+}
+#endif
+
+#ifdef __linux__
+std::vector<unsigned long> node_mask(int node) {  // NOLINT(runtime/int)
+    const size_t bits_per_word = 8 * sizeof(unsigned long);  // NOLINT(runtime/int)
+    std::vector<unsigned long> mask(node / bits_per_word + 1, 0);  // NOLINT(runtime/int)
+    mask[node / bits_per_word] = 1UL << (node % bits_per_word);
+    return mask;
+}
+
+// Memory policies only help, so we don't want a warning from every thread when
+// they aren't available.
+void warn_no_mempolicy(int err) {
+    static int warned = 0;
+    if (__sync_bool_compare_and_swap(&warned, 0, 1)) {
+        logWRN("Could not keep memory on the local NUMA node: %s",
+               errno_string(err).c_str());
+    }
+}
+#endif
+
+}  // namespace
+
+numa_topology_t::numa_topology_t() {
+    std::vector<int> nodes;
+    if (read_id_list("/sys/devices/system/node/online", &nodes)) {
+        for (int node : nodes) {
+            std::vector<int> cpus;
+            if (read_id_list(strprintf("/sys/devices/system/node/node%d/cpulist", node),
+                             &cpus)) {
+                add_node(node, cpus);
+            }
+        }
+    }
+    if (cpus_by_node_.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+            cpus.push_back(cpu);
+        }
+        nodes_.clear();
+        cpu_nodes_.clear();
+        add_node(0, cpus);
+    }
+    guarantee(!cpus_by_node_.empty(), "Found no CPUs to run on");
+}
+
+void numa_topology_t::add_node(int node, const std::vector<int> &cpus) {
+    bool any = false;
+    for (int cpu : cpus) {
+        if (may_run_on(cpu)) {
+            cpus_by_node_.push_back(cpu);
+            cpu_nodes_.push_back(node);
+            any = true;
+        }
+    }
+    if (any) {
+        nodes_.push_back(node);
+    }
+}
+
+#ifdef __linux__
+void prefer_numa_node_for_thread(int node) {
+    std::vector<unsigned long> mask = node_mask(node);  // NOLINT(runtime/int)
+    // The kernel ignores the last bit of `maxnode`.
+    const long res = syscall(SYS_set_mempolicy, MPOL_PREFERRED,  // NOLINT(runtime/int)
+                             mask.data(), 8 * sizeof(mask[0]) * mask.size() + 1);
+    if (res != 0) {
+        warn_no_mempolicy(get_errno());
+    }
+}
+
+void prefer_numa_node_for_memory(void *addr, size_t size, int node) {
+    std::vector<unsigned long> mask = node_mask(node);  // NOLINT(runtime/int)
+    const long res = syscall(SYS_mbind, addr, size, MPOL_PREFERRED,  // NOLINT(runtime/int)
+                             mask.data(), 8 * sizeof(mask[0]) * mask.size() + 1, 0);
+    if (res != 0) {
+        warn_no_mempolicy(get_errno());
+    }
+}
+#else
+void prefer_numa_node_for_thread(int) { }
+
+void prefer_numa_node_for_memory(void *, size_t, int) { }
+#endif
@@ -0,0 +1,57 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "errors.hpp"
+
+/* NUMA placement is off unless `--numa` is given.  When it's on, the thread pool pins
+each of its threads to one core, giving consecutive threads cores on the same node, and
+each thread prefers memory from its own node.  Since a thread's page caches and
+coroutine stacks are allocated (and first touched) by that thread, they end up in
+node-local memory.  A table's stores are put on threads of a single node, so a query
+for one table doesn't keep crossing between sockets. */
+
+// Must be called before the thread pool starts.
+void set_numa_placement(bool enabled);
+bool get_numa_placement();
+
+/* The CPUs that this process may run on, grouped by NUMA node.  It's read from sysfs;
+if that's not available, or the machine isn't NUMA, there's one node with every CPU. */
+class numa_topology_t {
+public:
+    numa_topology_t();
+
+    size_t num_nodes() const { return nodes_.size(); }
+
+    // The CPUs of each node in turn, so CPUs that are next to each other in this list
+    // are on the same node wherever possible.
+    const std::vector<int> &cpus_by_node() const { return cpus_by_node_; }
+
+    // The node that the `i`th CPU of `cpus_by_node()` belongs to.
+    int node_of(size_t i) const { return cpu_nodes_[i]; }
+
+private:
+    void add_node(int node, const std::vector<int> &cpus);
+
+    std::vector<int> nodes_;
+    std::vector<int> cpus_by_node_;
+    std::vector<int> cpu_nodes_;
+
+    DISABLE_COPYING(numa_topology_t);
+};
+
+/* Both of these only set a preference, so memory still comes from another node once
+the preferred one is full.  They log a warning and do nothing if the kernel doesn't
+support memory policies. */
+
+// The current thread's future allocations come from `node`.
+void prefer_numa_node_for_thread(int node);
+
+// Pages in `[addr, addr + size)` that aren't touched yet come from `node`.
+void prefer_numa_node_for_memory(void *addr, size_t size, int node);
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
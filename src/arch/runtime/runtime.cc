@@ -5,6 +5,7 @@
 
 #include <functional>
 
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/starter.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "do_on_thread.hpp"
@@ -20,6 +21,14 @@ int get_num_threads() {
     return linux_thread_pool_t::get_thread_pool()->n_threads;
 }
 
+int get_thread_numa_node(threadnum_t thread) {
+    if (thread.threadnum < 0) {
+        return -1;
+    }
+    assert_good_thread_id(thread);
+    return linux_thread_pool_t::get_thread_pool()->thread_numa_nodes[thread.threadnum];
+}
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread) {
     rassert(thread.threadnum >= 0, "(thread = %" PRIi32 ")", thread.threadnum);
@@ -64,7 +73,7 @@ private:
 
 // Runs the action 'fun()' on thread zero.
 void run_in_thread_pool(const std::function<void()> &fun, int worker_threads) {
-    linux_thread_pool_t thread_pool(worker_threads, false);
+    linux_thread_pool_t thread_pool(worker_threads, get_numa_placement());
     starter_t starter(&thread_pool, fun);
     thread_pool.run_thread_pool(&starter);
 }
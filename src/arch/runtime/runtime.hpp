@@ -11,6 +11,9 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The NUMA node that `thread` runs on, or -1 if NUMA placement is off.
+int get_thread_numa_node(threadnum_t thread);
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
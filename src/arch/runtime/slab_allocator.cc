@@ -0,0 +1,424 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/slab_allocator.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "arch/runtime/numa.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/spinlock.hpp"
+#include "math.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+/* Each slab is `SLAB_ALLOCATOR_SLAB_SIZE`-aligned and starts with a header, so the
+header of any object in the region is found by masking the object's address.  A slab
+only holds objects of one size class, and they start at a multiple of their size (or
+of 64 bytes for the smallest classes), which is what makes them aligned. */
+struct slab_header_t {
+    // NULL once the owner has been destroyed with objects of the slab still in use.
+    slab_allocator_t *volatile owner;
+    // How many threads are handing objects of the slab back to `owner`.  The owner
+    // isn't destroyed until there are none.
+    volatile int32_t senders;
+    int owner_thread;
+    int size_class;
+    // How many objects of the slab are allocated.  Only touched by the owner, or
+    // with atomics once there's no owner.
+    size_t live;
+};
+
+static const size_t MIN_OBJECT_OFFSET = 64;
+static_assert(sizeof(slab_header_t) <= MIN_OBJECT_OFFSET, "The slab header must fit before the first object");
+
+// Set by `reserve_region()`, before there's more than one thread.
+static char *region_begin = NULL;
+static char *region_end = NULL;
+// The first slab that hasn't been handed out yet.  Only touched with atomics.
+static uintptr_t region_next = 0;
+
+// Slabs that no thread is using.
+static spinlock_t empty_slabs_lock;
+static std::vector<slab_header_t *> empty_slabs;
+
+TLS_with_init(slab_allocator_t *, slab_allocator, NULL);
+
+static bool in_region(const void *ptr) {
+    return static_cast<const char *>(ptr) >= region_begin
+        && static_cast<const char *>(ptr) < region_end;
+}
+
+static slab_header_t *slab_of(void *ptr) {
+    return reinterpret_cast<slab_header_t *>(
+        reinterpret_cast<uintptr_t>(ptr) & ~(SLAB_ALLOCATOR_SLAB_SIZE - 1));
+}
+
+static size_t first_object_offset(int size_class) {
+    return std::max(slab_allocator_t::object_size(size_class), MIN_OBJECT_OFFSET);
+}
+
+static void release_slab(slab_header_t *slab) {
+    madvise(slab, SLAB_ALLOCATOR_SLAB_SIZE, MADV_DONTNEED);
+    spinlock_acq_t acq(&empty_slabs_lock);
+    empty_slabs.push_back(slab);
+}
+
+static void free_orphaned(slab_header_t *slab) {
+    rassert(slab->owner == NULL);
+    if (__sync_sub_and_fetch(&slab->live, 1) == 0) {
+        release_slab(slab);
+    }
+}
+
+/* Another thread pins a slab before it reads the slab's owner, and keeps it pinned
+while it hands objects to the owner.  The owner clears `owner` before it waits for
+the slab to be unpinned, so whoever pins the slab after that sees that it has no owner.
+Both sides go through full barriers, so one of them always sees the other. */
+static slab_allocator_t *pin_slab(slab_header_t *slab) {
+    __sync_fetch_and_add(&slab->senders, 1);
+    return slab->owner;
+}
+
+static void unpin_slab(slab_header_t *slab) {
+    __sync_fetch_and_sub(&slab->senders, 1);
+}
+
+static slab_header_t *acquire_slab() {
+    {
+        spinlock_acq_t acq(&empty_slabs_lock);
+        if (!empty_slabs.empty()) {
+            slab_header_t *slab = empty_slabs.back();
+            empty_slabs.pop_back();
+            return slab;
+        }
+    }
+    if (region_begin == NULL) {
+        return NULL;
+    }
+    const uintptr_t slab = __sync_fetch_and_add(&region_next, SLAB_ALLOCATOR_SLAB_SIZE);
+    if (slab + SLAB_ALLOCATOR_SLAB_SIZE > reinterpret_cast<uintptr_t>(region_end)) {
+        return NULL;
+    }
+    return reinterpret_cast<slab_header_t *>(slab);
+}
+
+void slab_allocator_t::reserve_region() {
+    /* Valgrind can't tell our objects apart if they don't come from `malloc()`, and
+    with threaded coroutines a coroutine doesn't stay on its thread's allocator. */
+#if !defined(VALGRIND) && !defined(THREADED_COROUTINES)
+    if (region_begin != NULL) {
+        return;
+    }
+    // Like coroutine stacks, the slabs only use memory once they're touched.
+    const size_t size = SLAB_ALLOCATOR_REGION_SIZE + SLAB_ALLOCATOR_SLAB_SIZE;
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        // Everything comes from `malloc()` instead.
+        return;
+    }
+    region_begin = reinterpret_cast<char *>(
+        ceil_aligned(reinterpret_cast<uintptr_t>(region),
+                     static_cast<uintptr_t>(SLAB_ALLOCATOR_SLAB_SIZE)));
+    region_end = region_begin + SLAB_ALLOCATOR_REGION_SIZE;
+    region_next = reinterpret_cast<uintptr_t>(region_begin);
+#endif
+}
+
+int slab_allocator_t::size_class_of(size_t size) {
+    rassert(size <= SLAB_ALLOCATOR_MAX_OBJECT_SIZE);
+    if (size <= 256) {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+    // 512 bytes is class 16.
+    const int log2_ceil = 64 - __builtin_clzll(size - 1);
+    return 16 + log2_ceil - 9;
+}
+
+size_t slab_allocator_t::object_size(int size_class) {
+    return size_class < 16
+        ? (size_class + 1) * 16
+        : static_cast<size_t>(512) << (size_class - 16);
+}
+
+slab_allocator_t::slab_allocator_t(threadnum_t thread)
+    : thread_(thread), incoming_(NULL) {
+    // `NUM_SIZE_CLASSES` goes up to 16 KB.
+    CT_ASSERT(SLAB_ALLOCATOR_MAX_OBJECT_SIZE == 16 * KILOBYTE);
+    for (int i = 0; i < NUM_SIZE_CLASSES; ++i) {
+        size_classes_[i].unused_begin = NULL;
+        size_classes_[i].unused_end = NULL;
+        size_classes_[i].trim_at = SLAB_ALLOCATOR_MAX_CACHED_BYTES;
+    }
+    rassert(TLS_get_slab_allocator() == NULL);
+    TLS_set_slab_allocator(this);
+}
+
+slab_allocator_t::~slab_allocator_t() {
+    // What we freed for other threads still goes to them.  Whatever gets freed on
+    // this thread from now on goes through `free_foreign()`.
+    for (int thread : outgoing_threads_) {
+        send_remote_frees(thread);
+    }
+    outgoing_threads_.clear();
+    TLS_set_slab_allocator(NULL);
+
+    // Once a slab has no owner, it goes back when the objects that are still in use
+    // are freed.  The objects that were sent to us before that are freed below.
+    for (slab_header_t *slab : slabs_) {
+        if (slab->live == 0) {
+            release_slab(slab);
+            continue;
+        }
+        slab->owner = NULL;
+        __sync_synchronize();
+        while (__sync_fetch_and_add(&slab->senders, 0) != 0) {
+            // Whoever pinned it is just pushing a batch onto `incoming_`.
+        }
+    }
+    remote_batch_t *batch = __sync_lock_test_and_set(&incoming_, NULL);
+    while (batch != NULL) {
+        for (void *ptr : batch->objects) {
+            free_orphaned(slab_of(ptr));
+        }
+        remote_batch_t *next = batch->next;
+        delete batch;
+        batch = next;
+    }
+}
+
+void *slab_allocator_t::allocate(size_t size) {
+    const int size_class = size_class_of(size);
+    size_class_t *sc = &size_classes_[size_class];
+    void *ptr;
+    if (!sc->free_objects.empty()) {
+        ptr = sc->free_objects.back();
+        sc->free_objects.pop_back();
+    } else {
+        const size_t obj_size = object_size(size_class);
+        if (sc->unused_begin == sc->unused_end) {
+            slab_header_t *slab = acquire_slab();
+            if (slab == NULL) {
+                return NULL;
+            }
+            const int node = get_thread_numa_node(thread_);
+            if (node != -1) {
+                prefer_numa_node_for_memory(slab, SLAB_ALLOCATOR_SLAB_SIZE, node);
+            }
+            slab->owner = this;
+            rassert(slab->senders == 0);
+            slab->owner_thread = thread_.threadnum;
+            slab->size_class = size_class;
+            slab->live = 0;
+            slabs_.push_back(slab);
+            const size_t offset = first_object_offset(size_class);
+            sc->unused_begin = reinterpret_cast<char *>(slab) + offset;
+            sc->unused_end = sc->unused_begin
+                + (SLAB_ALLOCATOR_SLAB_SIZE - offset) / obj_size * obj_size;
+        }
+        ptr = sc->unused_begin;
+        sc->unused_begin += obj_size;
+    }
+    ++slab_of(ptr)->live;
+    return ptr;
+}
+
+void slab_allocator_t::free(void *ptr) {
+    slab_header_t *slab = slab_of(ptr);
+    if (slab->owner == this) {
+        free_local(slab, ptr);
+    } else {
+        free_remote(slab, ptr);
+    }
+}
+
+void slab_allocator_t::free_local(slab_header_t *slab, void *ptr) {
+    rassert(slab->owner == this);
+    rassert(slab->live > 0);
+    --slab->live;
+    size_class_t *sc = &size_classes_[slab->size_class];
+    const size_t obj_size = object_size(slab->size_class);
+    if (obj_size >= static_cast<size_t>(getpagesize())
+        && sc->free_objects.size() * obj_size >= SLAB_ALLOCATOR_MAX_CACHED_BYTES) {
+        // We hold on to the address, but not to the memory.
+        madvise(ptr, obj_size, MADV_DONTNEED);
+    }
+    sc->free_objects.push_back(ptr);
+    if (sc->free_objects.size() * obj_size >= sc->trim_at) {
+        trim(slab->size_class);
+    }
+}
+
+void slab_allocator_t::trim(int size_class) {
+    size_class_t *sc = &size_classes_[size_class];
+    // The slab that we're still handing out new objects from isn't empty even if
+    // nothing in it is in use.
+    slab_header_t *current = sc->unused_begin != sc->unused_end
+        ? slab_of(sc->unused_begin) : NULL;
+    auto is_empty = [&](slab_header_t *slab) {
+        return slab->live == 0 && slab != current;
+    };
+
+    std::vector<void *> *free_objects = &sc->free_objects;
+    free_objects->erase(
+        std::remove_if(free_objects->begin(), free_objects->end(),
+                       [&](void *ptr) { return is_empty(slab_of(ptr)); }),
+        free_objects->end());
+    auto empty_begin = std::partition(
+        slabs_.begin(), slabs_.end(), [&](slab_header_t *slab) {
+            return slab->size_class != size_class || !is_empty(slab);
+        });
+    for (auto it = empty_begin; it != slabs_.end(); ++it) {
+        release_slab(*it);
+    }
+    slabs_.erase(empty_begin, slabs_.end());
+
+    // If what's left is still a lot, it's spread over slabs that are in use, so
+    // there's no point in looking again until it has doubled.
+    sc->trim_at = std::max<size_t>(SLAB_ALLOCATOR_MAX_CACHED_BYTES,
+                                   2 * free_objects->size() * object_size(size_class));
+}
+
+void slab_allocator_t::free_remote(slab_header_t *slab, void *ptr) {
+    const int thread = slab->owner_thread;
+    std::vector<void *> *outgoing = &outgoing_[thread];
+    if (outgoing->empty()) {
+        outgoing_threads_.push_back(thread);
+    }
+    outgoing->push_back(ptr);
+    if (outgoing->size() >= SLAB_ALLOCATOR_REMOTE_BATCH_SIZE) {
+        send_remote_frees(thread);
+    }
+}
+
+void slab_allocator_t::send_remote_frees(int thread) {
+    std::vector<void *> *outgoing = &outgoing_[thread];
+    if (outgoing->empty()) {
+        return;
+    }
+    std::vector<void *> objects;
+    objects.swap(*outgoing);
+
+    /* The objects usually all belong to the thread's current allocator, but if it has
+    been destroyed since some of them were freed, those have no owner anymore, and
+    if another allocator has been made for the thread, the rest may belong to it.  So
+    each object goes by its own slab.  A slab can't go to another owner while it's
+    pinned, since it still has our objects in use. */
+    std::vector<std::pair<slab_allocator_t *, remote_batch_t *> > batches;
+    std::vector<slab_header_t *> pinned;
+    std::vector<slab_header_t *> orphaned;
+    slab_header_t *last_slab = NULL;
+    slab_allocator_t *last_owner = NULL;
+    for (void *ptr : objects) {
+        slab_header_t *slab = slab_of(ptr);
+        if (slab != last_slab) {
+            last_slab = slab;
+            last_owner = pin_slab(slab);
+            pinned.push_back(slab);
+        }
+        if (last_owner == NULL) {
+            orphaned.push_back(slab);
+            continue;
+        }
+        auto it = std::find_if(
+            batches.begin(), batches.end(),
+            [&](const std::pair<slab_allocator_t *, remote_batch_t *> &b) {
+                return b.first == last_owner;
+            });
+        if (it == batches.end()) {
+            batches.push_back(std::make_pair(last_owner, new remote_batch_t));
+            it = batches.end() - 1;
+        }
+        it->second->objects.push_back(ptr);
+    }
+    for (const auto &b : batches) {
+        b.first->push_incoming(b.second);
+    }
+    for (slab_header_t *slab : pinned) {
+        unpin_slab(slab);
+    }
+    // Freeing these may release their slabs, which mustn't be pinned by then.
+    for (slab_header_t *slab : orphaned) {
+        free_orphaned(slab);
+    }
+}
+
+void slab_allocator_t::push_incoming(remote_batch_t *batch) {
+    remote_batch_t *head = incoming_;
+    for (;;) {
+        batch->next = head;
+        remote_batch_t *seen = __sync_val_compare_and_swap(&incoming_, head, batch);
+        if (seen == head) {
+            break;
+        }
+        head = seen;
+    }
+}
+
+void slab_allocator_t::free_foreign(void *ptr) {
+    slab_header_t *slab = slab_of(ptr);
+    slab_allocator_t *owner = pin_slab(slab);
+    if (owner != NULL) {
+        remote_batch_t *batch = new remote_batch_t;
+        batch->objects.push_back(ptr);
+        owner->push_incoming(batch);
+    }
+    unpin_slab(slab);
+    if (owner == NULL) {
+        free_orphaned(slab);
+    }
+}
+
+void slab_allocator_t::exchange_remote_frees_slow() {
+    for (int thread : outgoing_threads_) {
+        send_remote_frees(thread);
+    }
+    outgoing_threads_.clear();
+    free_incoming();
+}
+
+void slab_allocator_t::free_incoming() {
+    remote_batch_t *batch = __sync_lock_test_and_set(&incoming_, NULL);
+    while (batch != NULL) {
+        for (void *ptr : batch->objects) {
+            free_local(slab_of(ptr), ptr);
+        }
+        remote_batch_t *next = batch->next;
+        delete batch;
+        batch = next;
+    }
+}
+
+void *slab_malloc(size_t size) {
+    if (size <= SLAB_ALLOCATOR_MAX_OBJECT_SIZE) {
+        slab_allocator_t *allocator = TLS_get_slab_allocator();
+        if (allocator != NULL) {
+            void *ptr = allocator->allocate(size);
+            if (ptr != NULL) {
+                return ptr;
+            }
+        }
+    }
+    if (size != 0 && size % DEVICE_BLOCK_SIZE == 0) {
+        return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+    return rmalloc(size);
+}
+
+void slab_free(void *ptr) {
+    if (!in_region(ptr)) {
+        ::free(ptr);
+        return;
+    }
+    slab_allocator_t *allocator = TLS_get_slab_allocator();
+    if (allocator != NULL) {
+        allocator->free(ptr);
+    } else {
+        slab_allocator_t::free_foreign(ptr);
+    }
+}
@@ -0,0 +1,109 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
+#define ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "threading.hpp"
+
+/* `slab_malloc()` is for the small objects that we allocate and free all the time, like
+page cache buffers, datum arrays and terms.  On a thread of the thread pool, it takes
+them from that thread's `slab_allocator_t`, which keeps a free list per size class and
+never takes a lock.  Everywhere else, and for sizes over
+`SLAB_ALLOCATOR_MAX_OBJECT_SIZE`, it calls `malloc()`.
+
+The result is aligned like `malloc()`'s, and to `DEVICE_BLOCK_SIZE` if `size` is a
+multiple of it.  `slab_free()` takes memory from either `slab_malloc()` or `malloc()`,
+on any thread.  An object that's freed on a thread other than the one that allocated it
+is sent back to that thread in a batch the next time the freeing thread's event loop
+comes around, so no thread ever touches another thread's free lists.  Objects that are
+freed outside of the thread pool are sent back one at a time.  Once a thread has shut
+down, its slabs go back to the other threads when the last of their objects is freed.
+
+When a thread has more than `SLAB_ALLOCATOR_MAX_CACHED_BYTES` of free objects of one
+size, it hands the slabs that have no objects in use back, and the OS gets their
+memory. */
+void *slab_malloc(size_t size);
+void slab_free(void *ptr);
+
+struct slab_header_t;
+
+class slab_allocator_t {
+public:
+    // Reserves the address space that every thread's slabs come from.  Only does
+    // anything the first time it's called, which must be before the thread pool's
+    // threads start.
+    static void reserve_region();
+
+    // Makes this the current thread's allocator, until it's destroyed.
+    explicit slab_allocator_t(threadnum_t thread);
+    ~slab_allocator_t();
+
+    // Returns NULL if there's no address space left for a new slab.
+    void *allocate(size_t size);
+    void free(void *ptr);
+
+    // For frees on threads that don't have an allocator.
+    static void free_foreign(void *ptr);
+
+    // How many slabs this allocator has, for tests.
+    size_t num_slabs() const { return slabs_.size(); }
+
+    // Sends the objects that this thread freed for other threads back to them, and
+    // frees the ones that other threads sent back to this one.  Called every time
+    // around the event loop.
+    void exchange_remote_frees() {
+        if (!outgoing_threads_.empty() || incoming_ != NULL) {
+            exchange_remote_frees_slow();
+        }
+    }
+
+    // Size classes go up by 16 bytes to 256 bytes, and then double up to 16 KB.
+    static const int NUM_SIZE_CLASSES = 22;
+    static int size_class_of(size_t size);
+    static size_t object_size(int size_class);
+
+private:
+    struct remote_batch_t {
+        std::vector<void *> objects;
+        remote_batch_t *next;
+    };
+
+    struct size_class_t {
+        std::vector<void *> free_objects;
+        // The part of the newest slab that hasn't been handed out yet.
+        char *unused_begin;
+        char *unused_end;
+        // How big `free_objects` may get, in bytes, before we look for empty slabs.
+        size_t trim_at;
+    };
+
+    void free_local(slab_header_t *slab, void *ptr);
+    void free_remote(slab_header_t *slab, void *ptr);
+    void send_remote_frees(int thread);
+    void exchange_remote_frees_slow();
+    void free_incoming();
+    void push_incoming(remote_batch_t *batch);
+    void trim(int size_class);
+
+    const threadnum_t thread_;
+    size_class_t size_classes_[NUM_SIZE_CLASSES];
+    std::vector<slab_header_t *> slabs_;
+
+    // Objects of other threads' slabs that this thread has freed, by thread, and the
+    // threads that have any.
+    std::vector<void *> outgoing_[MAX_THREADS];
+    std::vector<int> outgoing_threads_;
+
+    // Batches that other threads have sent back.  It's a lock-free stack, which other
+    // threads push onto with compare-and-swap.
+    remote_batch_t *volatile incoming_;
+
+    DISABLE_COPYING(slab_allocator_t);
+};
+
+#endif  // ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
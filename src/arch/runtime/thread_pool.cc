@@ -10,6 +10,7 @@
 #include "arch/barrier.hpp"
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "errors.hpp"
@@ -43,18 +44,35 @@ NOINLINE void linux_thread_pool_t::set_thread(linux_thread_t *val) {
     thread = val;
 }
 
-linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity) :
+linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _numa_placement) :
 #ifndef NDEBUG
       coroutine_summary(false),
 #endif
       interrupt_message(NULL),
       generic_blocker_pool(NULL),
       n_threads(worker_threads + 1),    // we create an extra utility thread
-      do_set_affinity(_do_set_affinity)
+      numa_placement(_numa_placement)
 {
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    slab_allocator_t::reserve_region();
+
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_cpus[i] = -1;
+        thread_numa_nodes[i] = -1;
+    }
+    if (numa_placement) {
+        // Consecutive threads go on the same node, so a node's cores fill up before
+        // the next node's do.
+        numa_topology_t topology;
+        const size_t num_cpus = topology.cpus_by_node().size();
+        for (int i = 0; i < n_threads; ++i) {
+            thread_cpus[i] = topology.cpus_by_node()[i % num_cpus];
+            thread_numa_nodes[i] = topology.node_of(i % num_cpus);
+        }
+    }
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, NULL);
@@ -100,6 +118,24 @@ void *linux_thread_pool_t::start_thread(void *arg) {
 
     thread_data_t *tdata = reinterpret_cast<thread_data_t *>(arg);
 
+    // This has to happen before the thread allocates anything, so that the memory
+    // comes from the right node.
+    {
+        const int cpu = tdata->thread_pool->thread_cpus[tdata->current_thread];
+        const int node = tdata->thread_pool->thread_numa_nodes[tdata->current_thread];
+        if (cpu != -1) {
+            // On Apple, the thread affinity API has awful documentation, so we don't even bother.
+#ifdef _GNU_SOURCE
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpu, &mask);
+            int res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+            guarantee_xerr(res == 0, res, "Could not set thread affinity");
+#endif
+            prefer_numa_node_for_thread(node);
+        }
+    }
+
     // Set thread-local variables
     set_thread_pool(tdata->thread_pool);
     set_thread_id(tdata->current_thread);
@@ -199,19 +235,6 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
 
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
-
-        if (do_set_affinity) {
-            // On Apple, the thread affinity API has awful documentation, so we don't even bother.
-#ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
-            cpu_set_t mask;
-            CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
-            res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
-            guarantee_xerr(res == 0, res, "Could not set thread affinity");
-#endif
-        }
     }
 
     // Mark the main thread (for use in assertions etc.)
@@ -376,7 +399,8 @@ linux_thread_pool_t::~linux_thread_pool_t() {
 }
 
 linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
-    : queue(this),
+    : slab_allocator(threadnum_t(thread_id)),
+      queue(this),
       message_hub(&queue, parent_pool, threadnum_t(thread_id)),
       timer_handler(&queue),
       do_shutdown(false)
@@ -406,6 +430,7 @@ linux_thread_t::~linux_thread_t() {
 }
 
 void linux_thread_t::pump() {
+    slab_allocator.exchange_remote_frees();
     message_hub.push_messages();
 }
 
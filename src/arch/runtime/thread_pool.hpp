@@ -12,6 +12,8 @@
 #include "arch/runtime/system_event.hpp"
 #include "arch/runtime/message_hub.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/slab_allocator.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/timer.hpp"
@@ -39,7 +41,9 @@ and shutting down the threads and event queues. */
 
 class linux_thread_pool_t {
 public:
-    linux_thread_pool_t(int worker_threads, bool do_set_affinity);
+    // With `numa_placement`, each thread gets pinned to a core and prefers memory from
+    // that core's NUMA node; see `arch/runtime/numa.hpp`.
+    linux_thread_pool_t(int worker_threads, bool numa_placement);
 
     // When the process receives a SIGINT or SIGTERM, interrupt_message will be delivered to the
     // same thread that initial_message was delivered to, and interrupt_message will be set to
@@ -90,7 +94,10 @@ public:
     static void run_in_blocker_pool(const Callable &);
 
     int n_threads;
-    bool do_set_affinity;
+    bool numa_placement;
+    // The core and NUMA node of each thread, or -1 without `numa_placement`.
+    int thread_cpus[MAX_THREADS];
+    int thread_numa_nodes[MAX_THREADS];
 
     // Non-inlinable getters and setters for the thread local variables.
     // See thread_local.hpp for an explanation of why these must not be
@@ -160,6 +167,10 @@ public:
     linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id);
     ~linux_thread_t();
 
+    // This comes first so that everything else can still free objects while it's
+    // being destroyed.
+    slab_allocator_t slab_allocator;
+
     linux_event_queue_t queue;
     linux_message_hub_t message_hub;
     timer_handler_t timer_handler;
@@ -1,17 +1,21 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/timer.hpp"
 
+#include <stdint.h>
+
+#include <algorithm>
+
 #include "arch/runtime/thread_pool.hpp"
 #include "time.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+class timer_token_t : public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
-
-    friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
+    timer_token_t()
+        : interval_nanos(-1), next_time_in_nanos(-1), expiry_tick(-1),
+          level(-1), index(-1), callback(NULL) { }
 
     // The time between rings, if a repeating timer, otherwise zero.
     int64_t interval_nanos;
@@ -19,54 +23,246 @@ private:
     // The time of the next 'ring'.
     int64_t next_time_in_nanos;
 
+    // The first wheel tick that isn't before `next_time_in_nanos`.
+    int64_t expiry_tick;
+
+    // The bucket the token is in: `level` 0 is `level0`, `level` i > 0 is
+    // `upper_levels[i - 1]`, and `FIRING_LEVEL` is `firing`.
+    int level;
+    int index;
+
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
     DISABLE_COPYING(timer_token_t);
 };
 
-bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right) {
-    return left->next_time_in_nanos < right->next_time_in_nanos;
+namespace {
+
+const int FIRING_LEVEL = -1;
+
+int64_t nanos_to_tick(int64_t nanos) {
+    return (nanos + MILLION - 1) / MILLION;
 }
 
+// Returns how far past `start` the first set bit is, wrapping around from the last bit
+// to the first, or -1 if no bit is set.
+int first_occupied_from(const uint64_t *words, int num_words, int start) {
+    const int num_bits = num_words * 64;
+    const int start_word = start / 64;
+    const int start_bit = start % 64;
+    // The start word gets looked at twice: first its bits from `start` on, and then,
+    // after wrapping around, its bits before `start`.
+    for (int i = 0; i <= num_words; ++i) {
+        const int word = (start_word + i) % num_words;
+        uint64_t bits = words[word];
+        if (i == 0) {
+            bits &= ~static_cast<uint64_t>(0) << start_bit;
+        } else if (i == num_words) {
+            bits &= ~(~static_cast<uint64_t>(0) << start_bit);
+        }
+        if (bits != 0) {
+            const int bit = word * 64 + __builtin_ctzll(bits);
+            return (bit - start + num_bits) % num_bits;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(0),
+      current_tick(get_ticks() / MILLION),
+      scheduled_tick(INT64_MAX),
+      num_timers(0) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
+    for (int i = 0; i < LEVEL0_SIZE / 64; ++i) {
+        level0_occupied[i] = 0;
+    }
+    for (int i = 0; i < NUM_UPPER_LEVELS; ++i) {
+        upper_occupied[i] = 0;
+    }
 }
 
 timer_handler_t::~timer_handler_t() {
-    guarantee(token_queue.empty());
+    guarantee(num_timers == 0);
 }
 
 void timer_handler_t::on_oneshot() {
     // If the timer_provider tends to return its callback a touch early, we don't want to make a
     // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
-    // threshold.  So we bump the real time up to the threshold when processing the priority queue.
+    // threshold.  So we bump the real time up to the threshold when processing the wheel.
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
 
-    while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
+    scheduled_tick = INT64_MAX;
+    advance_to(real_ticks, ticks / MILLION);
 
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
-        if (token->interval_nanos != 0) {
-            token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+    // We've processed young tokens.  Now schedule a new one-shot (if necessary).
+    schedule_next_oneshot();
+}
+
+void timer_handler_t::advance_to(const int64_t real_ticks, const int64_t now_tick) {
+    for (;;) {
+        const int64_t tick = next_event_tick();
+        if (tick > now_tick) {
+            break;
         }
 
-        token->callback->on_timer();
+        current_tick = tick;
+
+        // Spread out the higher buckets that start at this tick.  The lower levels go
+        // first, so nothing lands in a bucket that has already been spread out.
+        int shift = LEVEL0_BITS;
+        for (int i = 0; i < NUM_UPPER_LEVELS; ++i) {
+            if ((tick & ((static_cast<int64_t>(1) << shift) - 1)) != 0) {
+                break;
+            }
+            cascade(i + 1, (tick >> shift) & (LEVELN_SIZE - 1));
+            shift += LEVELN_BITS;
+        }
 
-        // Delete nonrepeating timer tokens.
-        if (token->interval_nanos == 0) {
-            delete token;
+        // Every timer in the tick's bucket is due.  They're moved out of the wheel
+        // before any callback runs, so that timers added by the callbacks can't end
+        // up in the bucket we're firing.
+        const int index = tick & (LEVEL0_SIZE - 1);
+        rassert(firing.empty());
+        firing.append_and_clear(&level0[index]);
+        level0_occupied[index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+        for (timer_token_t *t = firing.head(); t != NULL; t = firing.next(t)) {
+            t->level = FIRING_LEVEL;
+        }
+        current_tick = tick + 1;
+
+        while (timer_token_t *token = firing.head()) {
+            firing.remove(token);
+
+            // Put the repeating timer back in the wheel before the callback can be called (so
+            // that it may be canceled).
+            if (token->interval_nanos != 0) {
+                token->next_time_in_nanos = real_ticks + token->interval_nanos;
+                token->expiry_tick = nanos_to_tick(token->next_time_in_nanos);
+                insert(token);
+            } else {
+                --num_timers;
+            }
+
+            token->callback->on_timer();
+
+            // Delete nonrepeating timer tokens.
+            if (token->interval_nanos == 0) {
+                delete token;
+            }
         }
     }
 
-    // We've processed young tokens.  Now schedule a new one-shot (if necessary).
-    if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+    // Nothing is due between here and `now_tick`, so we can skip ahead.
+    current_tick = std::max(current_tick, now_tick + 1);
+}
+
+int64_t timer_handler_t::next_event_tick() const {
+    if (num_timers == 0) {
+        return INT64_MAX;
+    }
+
+    int64_t next = INT64_MAX;
+    const int level0_start = current_tick & (LEVEL0_SIZE - 1);
+    const int level0_distance =
+        first_occupied_from(level0_occupied, LEVEL0_SIZE / 64, level0_start);
+    if (level0_distance != -1) {
+        next = current_tick + level0_distance;
+    }
+
+    // A bucket on a higher level gets spread out when the wheel gets to its first tick.
+    int shift = LEVEL0_BITS;
+    for (int i = 0; i < NUM_UPPER_LEVELS; ++i) {
+        const int64_t first_period =
+            (current_tick + (static_cast<int64_t>(1) << shift) - 1) >> shift;
+        const int distance = first_occupied_from(
+            &upper_occupied[i], 1, first_period & (LEVELN_SIZE - 1));
+        if (distance != -1) {
+            next = std::min(next, (first_period + distance) << shift);
+        }
+        shift += LEVELN_BITS;
+    }
+    return next;
+}
+
+void timer_handler_t::cascade(int level, int index) {
+    intrusive_list_t<timer_token_t> *bucket = &upper_levels[level - 1][index];
+    upper_occupied[level - 1] &= ~(static_cast<uint64_t>(1) << index);
+    intrusive_list_t<timer_token_t> moving;
+    moving.append_and_clear(bucket);
+    while (timer_token_t *token = moving.head()) {
+        moving.remove(token);
+        insert(token);
+    }
+}
+
+void timer_handler_t::schedule_next_oneshot() {
+    const int64_t next = next_event_tick();
+    if (next == scheduled_tick) {
+        return;
+    }
+    if (next == INT64_MAX) {
+        timer_provider.unschedule_oneshot();
+    } else {
+        expected_oneshot_time_in_nanos = next * MILLION;
+        timer_provider.schedule_oneshot(expected_oneshot_time_in_nanos, this);
+    }
+    scheduled_tick = next;
+}
+
+void timer_handler_t::insert(timer_token_t *token) {
+    // A timer that's already due goes in the bucket that's next to fire.
+    int64_t expiry = std::max(token->expiry_tick, current_tick);
+    const int64_t delta = expiry - current_tick;
+    if (delta < LEVEL0_SIZE) {
+        token->level = 0;
+        token->index = expiry & (LEVEL0_SIZE - 1);
+        level0[token->index].push_back(token);
+        level0_occupied[token->index / 64] |= static_cast<uint64_t>(1) << (token->index % 64);
+        return;
+    }
+
+    int level = 1;
+    int shift = LEVEL0_BITS;
+    while (level < NUM_UPPER_LEVELS
+           && delta >= (static_cast<int64_t>(1) << (shift + LEVELN_BITS))) {
+        ++level;
+        shift += LEVELN_BITS;
+    }
+    const int64_t max_delta = (static_cast<int64_t>(1) << (shift + LEVELN_BITS)) - 1;
+    if (delta > max_delta) {
+        // Too far out for the wheel.  The timer gets put back in the top level (with
+        // its real expiry) every time its bucket comes up, until it's close enough.
+        expiry = current_tick + max_delta;
+    }
+    token->level = level;
+    token->index = (expiry >> shift) & (LEVELN_SIZE - 1);
+    upper_levels[level - 1][token->index].push_back(token);
+    upper_occupied[level - 1] |= static_cast<uint64_t>(1) << token->index;
+}
+
+void timer_handler_t::remove(timer_token_t *token) {
+    if (token->level == FIRING_LEVEL) {
+        firing.remove(token);
+    } else if (token->level == 0) {
+        intrusive_list_t<timer_token_t> *bucket = &level0[token->index];
+        bucket->remove(token);
+        if (bucket->empty()) {
+            level0_occupied[token->index / 64] &=
+                ~(static_cast<uint64_t>(1) << (token->index % 64));
+        }
+    } else {
+        intrusive_list_t<timer_token_t> *bucket =
+            &upper_levels[token->level - 1][token->index];
+        bucket->remove(token);
+        if (bucket->empty()) {
+            upper_occupied[token->level - 1] &= ~(static_cast<uint64_t>(1) << token->index);
+        }
     }
 }
 
@@ -79,24 +275,30 @@ timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callb
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
     token->next_time_in_nanos = next_time_in_nanos;
+    token->expiry_tick = nanos_to_tick(next_time_in_nanos);
     token->callback = callback;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
+    insert(token);
+    ++num_timers;
 
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+    const int64_t tick = std::max(token->expiry_tick, current_tick);
+    if (tick < scheduled_tick) {
+        expected_oneshot_time_in_nanos = tick * MILLION;
+        timer_provider.schedule_oneshot(expected_oneshot_time_in_nanos, this);
+        scheduled_tick = tick;
     }
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    remove(token);
     delete token;
+    --num_timers;
 
-    if (token_queue.empty()) {
+    if (num_timers == 0) {
         timer_provider.unschedule_oneshot();
+        scheduled_tick = INT64_MAX;
     }
 }
 
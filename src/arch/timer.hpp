@@ -2,7 +2,9 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
-#include "containers/intrusive_priority_queue.hpp"
+#include <stdint.h>
+
+#include "containers/intrusive_list.hpp"
 #include "arch/io/timer_provider.hpp"
 
 class timer_token_t;
@@ -14,7 +16,13 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * The application timers are kept in a hierarchical timing wheel with millisecond ticks, so
+ * adding and canceling a timer takes constant time no matter how many there are.  Level 0 has a
+ * bucket for each of the next 256 ticks, and each level above it has 64 buckets that each cover a
+ * whole turn of the level below.  When the wheel gets to the start of a bucket on a higher level,
+ * that bucket's timers get spread over the lower levels. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
@@ -24,8 +32,27 @@ public:
     void cancel_timer(timer_token_t *timer);
 
 private:
+    static const int LEVEL0_BITS = 8;
+    static const int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+    static const int LEVELN_BITS = 6;
+    static const int LEVELN_SIZE = 1 << LEVELN_BITS;
+    static const int NUM_UPPER_LEVELS = 4;
+
     void on_oneshot();
 
+    // Fires every timer that's due at or before `now_tick`.  Repeating timers are rearmed
+    // relative to `real_ticks`.
+    void advance_to(int64_t real_ticks, int64_t now_tick);
+    // The earliest tick at which a level 0 bucket has timers to fire or a higher bucket has
+    // timers to spread out, or INT64_MAX if there are no timers.
+    int64_t next_event_tick() const;
+    // Moves the timers of a bucket on a higher level to where they belong now.
+    void cascade(int level, int index);
+    void schedule_next_oneshot();
+
+    void insert(timer_token_t *token);
+    void remove(timer_token_t *token);
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
@@ -33,8 +60,24 @@ private:
     // time, we pretend that it had arrived on time.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
-    intrusive_priority_queue_t<timer_token_t> token_queue;
+    // The next tick that hasn't been processed.  Every timer due before it has fired.
+    int64_t current_tick;
+
+    // The tick we've asked the timer provider to wake us up at, or INT64_MAX.
+    int64_t scheduled_tick;
+
+    int64_t num_timers;
+
+    intrusive_list_t<timer_token_t> level0[LEVEL0_SIZE];
+    intrusive_list_t<timer_token_t> upper_levels[NUM_UPPER_LEVELS][LEVELN_SIZE];
+
+    // The timers of the bucket being fired that haven't fired yet.
+    intrusive_list_t<timer_token_t> firing;
+
+    // A bit for each bucket, set when the bucket isn't empty, so finding the next timer doesn't
+    // have to look at every bucket.
+    uint64_t level0_occupied[LEVEL0_SIZE / 64];
+    uint64_t upper_occupied[NUM_UPPER_LEVELS];
 
     DISABLE_COPYING(timer_handler_t);
 };
@@ -129,6 +129,13 @@ bool artificial_reql_cluster_interface_t::table_find(
         interruptor, table_out, error_out);
 }
 
+bool artificial_reql_cluster_interface_t::table_get_read_thread(
+        const namespace_id_t &table_id, ql::datum_t pval, bool *table_gone_out,
+        threadnum_t *thread_out) {
+    // Artificial tables don't have read threads, so this can only be a real table.
+    return next->table_get_read_thread(table_id, pval, table_gone_out, thread_out);
+}
+
 bool artificial_reql_cluster_interface_t::table_estimate_doc_counts(
         counted_t<const ql::db_t> db,
         const name_string_t &name,
@@ -392,6 +399,16 @@ admin_artificial_tables_t::admin_artificial_tables_t(
     backends[name_string_t::guarantee_valid("_debug_stats")] =
         std::make_pair(debug_stats_backend.get(), debug_stats_backend.get());
 
+    debug_coro_profile_backend.init(new debug_coro_profile_artificial_table_backend_t(
+        metadata_field(&cluster_semilattice_metadata_t::servers,
+            _semilattice_view),
+        _server_config_client,
+        _directory_map_view,
+        _mailbox_manager));
+    backends[name_string_t::guarantee_valid("_debug_coro_profile")] =
+        std::make_pair(debug_coro_profile_backend.get(),
+                       debug_coro_profile_backend.get());
+
     debug_table_status_backend.init(new debug_table_status_artificial_table_backend_t(
         _semilattice_view,
         _reactor_directory_view,
@@ -26,6 +26,8 @@
 
 #include "arch/io/disk.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/coro_sampler.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/starter.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/main/cache_size.hpp"
@@ -647,6 +649,7 @@ service_address_ports_t get_service_address_ports(const std::map<std::string, op
         exists_option(opts, "--no-http-admin"),
         offseted_port(get_single_int(opts, "--http-port"), port_offset),
         offseted_port(get_single_int(opts, "--driver-port"), port_offset),
+        exists_option(opts, "--driver-reuseport"),
         port_offset);
 }
 
@@ -1078,6 +1081,10 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--driver-reuseport"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-reuseport", "accept client driver connections on every thread using SO_REUSEPORT sockets");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -1098,12 +1105,83 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
     return help;
 }
 
+options::help_section_t get_query_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Query options");
+    options_out->push_back(options::option_t(options::names_t("--query-result-cache"),
+                                             options::OPTIONAL_REPEAT));
+    help.add("--query-result-cache db.table", "cache the results of read queries on this table, can be specified multiple times");
+    options_out->push_back(options::option_t(options::names_t("--query-result-cache-size"),
+                                             options::OPTIONAL,
+                                             "64"));
+    help.add("--query-result-cache-size mb", "total size (in megabytes) of the query result cache");
+    options_out->push_back(options::option_t(options::names_t("--json-cache-size"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--json-cache-size mb", "size (in megabytes) of each thread's cache of the JSON sent for documents that are read often, or no cache if 0");
+    return help;
+}
+
+ql::result_cache_config_t parse_query_result_cache_options(
+        const std::map<std::string, options::values_t> &opts) {
+    ql::result_cache_config_t config;
+    for (const std::string &name : opts.at("--query-result-cache").values) {
+        const size_t dot = name.find('.');
+        name_string_t db_name;
+        name_string_t table_name;
+        if (dot == std::string::npos
+            || !db_name.assign_value(name.substr(0, dot))
+            || !table_name.assign_value(name.substr(dot + 1))) {
+            throw std::runtime_error(strprintf(
+                "--query-result-cache %s is invalid, it should be db.table (%s)\n",
+                name.c_str(), name_string_t::valid_char_msg));
+        }
+        if (db_name.str() == "rethinkdb") {
+            throw std::runtime_error(strprintf(
+                "--query-result-cache %s is invalid, system tables can't be "
+                "cached\n", name.c_str()));
+        }
+        config.tables.insert(std::make_pair(db_name, table_name));
+    }
+
+    const std::string size_opt = get_single_option(opts, "--query-result-cache-size");
+    uint64_t size_megs;
+    if (!strtou64_strict(size_opt, 10, &size_megs)) {
+        throw std::runtime_error(strprintf(
+            "ERROR: query-result-cache-size should be a number, got '%s'",
+            size_opt.c_str()));
+    }
+    config.max_memory = size_megs * MEGABYTE;
+    return config;
+}
+
+size_t parse_json_cache_size_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const std::string size_opt = get_single_option(opts, "--json-cache-size");
+    uint64_t size_megs;
+    if (!strtou64_strict(size_opt, 10, &size_megs)) {
+        throw std::runtime_error(strprintf(
+            "ERROR: json-cache-size should be a number, got '%s'",
+            size_opt.c_str()));
+    }
+    return size_megs * MEGABYTE;
+}
+
 options::help_section_t get_cpu_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("CPU options");
     options_out->push_back(options::option_t(options::names_t("--cores", "-c"),
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--coro-sampling-interval"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", CORO_SAMPLING_INTERVAL)));
+    help.add("--coro-sampling-interval n",
+             "time one out of every n coroutine runs for the "
+             "`rethinkdb._debug_coro_profile` table, or none if n is 0");
+    options_out->push_back(options::option_t(options::names_t("--numa"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--numa", "pin each thread to a core, and keep each thread's memory and "
+             "each table's shards on one NUMA node");
     return help;
 }
 
@@ -1118,6 +1196,21 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+MUST_USE bool parse_coro_sampling_option(
+        const std::map<std::string, options::values_t> &opts) {
+    int interval = get_single_int(opts, "--coro-sampling-interval");
+    if (interval < 0) {
+        fprintf(stderr, "ERROR: coro-sampling-interval must not be negative\n");
+        return false;
+    }
+    set_coro_sampling_interval(interval);
+    return true;
+}
+
+void parse_numa_option(const std::map<std::string, options::values_t> &opts) {
+    set_numa_placement(exists_option(opts, "--numa"));
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1166,6 +1259,7 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
                                  std::vector<options::option_t> *options_out) {
     help_out->push_back(get_file_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
+    help_out->push_back(get_query_options(options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
     help_out->push_back(get_service_options(options_out));
@@ -1178,6 +1272,7 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
 void get_rethinkdb_proxy_options(std::vector<options::help_section_t> *help_out,
                                  std::vector<options::option_t> *options_out) {
     help_out->push_back(get_network_options(true, options_out));
+    help_out->push_back(get_query_options(options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
@@ -1191,6 +1286,7 @@ void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_
     help_out->push_back(get_file_options(options_out));
     help_out->push_back(get_server_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
+    help_out->push_back(get_query_options(options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
     help_out->push_back(get_service_options(options_out));
@@ -1422,6 +1518,12 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_coro_sampling_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        parse_numa_option(opts);
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
@@ -1462,6 +1564,8 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 std::move(web_path),
                                 do_update_checking,
                                 address_ports,
+                                parse_query_result_cache_options(opts),
+                                parse_json_cache_size_option(opts),
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
 
@@ -1545,6 +1649,8 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 std::move(web_path),
                                 update_check_t::do_not_perform,
                                 address_ports,
+                                parse_query_result_cache_options(opts),
+                                parse_json_cache_size_option(opts),
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
 
@@ -1652,6 +1758,12 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_coro_sampling_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        parse_numa_option(opts);
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
@@ -1712,6 +1824,8 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 std::move(web_path),
                                 do_update_checking,
                                 address_ports,
+                                parse_query_result_cache_options(opts),
+                                parse_json_cache_size_option(opts),
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
 
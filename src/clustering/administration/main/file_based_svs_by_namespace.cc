@@ -4,6 +4,7 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/runtime/runtime.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "logger.hpp"
@@ -123,10 +124,13 @@ file_based_svs_by_namespace_t::get_svs(
         = stores_out->stores();
     stores_out_stores->init(num_stores);
 
+    // With NUMA placement, the stores go on the serializer's node, so that the table
+    // doesn't have to move data between sockets.
     const threadnum_t serializer_thread = next_thread(num_db_threads);
+    const int node = get_thread_numa_node(serializer_thread);
     std::vector<threadnum_t> store_threads;
     for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+        store_threads.push_back(next_thread_on_node(num_db_threads, node));
     }
 
     scoped_ptr_t<serializer_t> serializer;
@@ -242,3 +246,15 @@ threadnum_t file_based_svs_by_namespace_t::next_thread(int num_db_threads) {
     thread_counter_ = (thread_counter_ + 1) % num_db_threads;
     return threadnum_t(thread_counter_);
 }
+
+threadnum_t file_based_svs_by_namespace_t::next_thread_on_node(int num_db_threads,
+                                                               int node) {
+    threadnum_t thread = next_thread(num_db_threads);
+    for (int i = 1; i < num_db_threads && node != -1; ++i) {
+        if (get_thread_numa_node(thread) == node) {
+            break;
+        }
+        thread = next_thread(num_db_threads);
+    }
+    return thread;
+}
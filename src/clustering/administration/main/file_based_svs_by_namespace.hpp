@@ -36,6 +36,9 @@ private:
     const base_path_t base_path_;
 
     threadnum_t next_thread(int num_db_threads);
+    // Like `next_thread`, but skips threads that aren't on NUMA node `node`, unless
+    // `node` is -1.
+    threadnum_t next_thread_on_node(int num_db_threads, int node);
     int thread_counter_; // should only be used by `next_thread`
 
     outdated_index_issue_tracker_t outdated_index_tracker;
@@ -29,6 +29,7 @@
 #include "clustering/administration/servers/network_logger.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "extproc/extproc_pool.hpp"
+#include "rdb_protocol/json_cache.hpp"
 #include "rdb_protocol/query_server.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/directory/map_read_manager.hpp"
@@ -275,7 +276,9 @@ bool do_serve(io_backender_t *io_backender,
                               NULL,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              i_am_a_server ? io_backender : NULL,
+                              base_path);
         jobs_manager.set_rdb_context(&rdb_ctx);
 
         real_reql_cluster_interface_t real_reql_cluster_interface(
@@ -310,6 +313,20 @@ bool do_serve(io_backender_t *io_backender,
         circular reference. */
         rdb_ctx.cluster_interface = admin_tables.get_reql_cluster_interface();
 
+        /* The result cache watches its tables through the `reql_cluster_interface_t`,
+        so it has to be created after it's filled in, and destroyed before the admin
+        tables are. */
+        scoped_ptr_t<ql::result_cache_t> result_cache;
+        if (!serve_info.result_cache.tables.empty()) {
+            result_cache.init(
+                new ql::result_cache_t(&rdb_ctx, serve_info.result_cache));
+        }
+        scoped_ptr_t<ql::json_caches_t> json_caches;
+        if (serve_info.json_cache_size != 0) {
+            json_caches.init(
+                new ql::json_caches_t(&rdb_ctx, serve_info.json_cache_size));
+        }
+
         {
             scoped_ptr_t<cache_balancer_t> cache_balancer;
 
@@ -357,6 +374,7 @@ bool do_serve(io_backender_t *io_backender,
                 rdb_query_server_t rdb_query_server(
                     serve_info.ports.local_addresses,
                     serve_info.ports.reql_port,
+                    serve_info.ports.reql_reuse_port,
                     &rdb_ctx);
                 logNTC("Listening for client driver connections on port %d\n",
                        rdb_query_server.get_port());
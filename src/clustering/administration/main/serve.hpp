@@ -11,6 +11,7 @@
 #include "clustering/administration/persist.hpp"
 #include "clustering/administration/main/version_check.hpp"
 #include "arch/address.hpp"
+#include "rdb_protocol/result_cache.hpp"
 
 class os_signal_cond_t;
 
@@ -46,6 +47,7 @@ struct service_address_ports_t {
         client_port(0),
         http_port(0),
         reql_port(0),
+        reql_reuse_port(false),
         port_offset(0) { }
 
     service_address_ports_t(const std::set<ip_address_t> &_local_addresses,
@@ -55,6 +57,7 @@ struct service_address_ports_t {
                             bool _http_admin_is_disabled,
                             int _http_port,
                             int _reql_port,
+                            bool _reql_reuse_port,
                             int _port_offset) :
         local_addresses(_local_addresses),
         canonical_addresses(_canonical_addresses),
@@ -63,6 +66,7 @@ struct service_address_ports_t {
         http_admin_is_disabled(_http_admin_is_disabled),
         http_port(_http_port),
         reql_port(_reql_port),
+        reql_reuse_port(_reql_reuse_port),
         port_offset(_port_offset)
     {
             sanitize_port(port, "port", port_offset);
@@ -82,6 +86,7 @@ struct service_address_ports_t {
     bool http_admin_is_disabled;
     int http_port;
     int reql_port;
+    bool reql_reuse_port;
     int port_offset;
 };
 
@@ -94,6 +99,8 @@ public:
                  std::string &&_web_assets,
                  update_check_t _do_version_checking,
                  service_address_ports_t _ports,
+                 const ql::result_cache_config_t &_result_cache,
+                 size_t _json_cache_size,
                  boost::optional<std::string> _config_file,
                  std::vector<std::string> &&_argv) :
         joins(std::move(_joins)),
@@ -101,6 +108,8 @@ public:
         web_assets(std::move(_web_assets)),
         do_version_checking(_do_version_checking),
         ports(_ports),
+        result_cache(_result_cache),
+        json_cache_size(_json_cache_size),
         config_file(_config_file),
         argv(std::move(_argv))
     { }
@@ -115,6 +124,9 @@ public:
     std::string web_assets;
     update_check_t do_version_checking;
     service_address_ports_t ports;
+    ql::result_cache_config_t result_cache;
+    // Per thread; 0 if the JSON caches are turned off.
+    size_t json_cache_size;
     boost::optional<std::string> config_file;
     /* The original arguments, so we can display them in `server_status`. All the
     argument parsing has already been completed at this point. */
@@ -181,28 +181,7 @@ namespace_interface_access_t namespace_repo_t::get_namespace_interface(
     construct a real `namespace_interface_access_t` with a non-`NULL` namespace
     interface, and then delete `temporary_holder`. */
     namespace_interface_access_t temporary_holder;
-    namespace_cache_entry_t *cache_entry;
-    {
-        ASSERT_FINITE_CORO_WAITING;
-        namespace_cache_t *cache = namespace_caches.get();
-        if (cache->entries.find(ns_id) == cache->entries.end()) {
-            cache_entry = new namespace_cache_entry_t;
-            cache_entry->ref_count = 0;
-            cache_entry->pulse_when_ref_count_becomes_zero = NULL;
-            cache_entry->pulse_when_ref_count_becomes_nonzero = NULL;
-
-            namespace_id_t id(ns_id);
-            cache->entries.insert(std::make_pair(id,
-                scoped_ptr_t<namespace_cache_entry_t>(cache_entry)));
-
-            coro_t::spawn_sometime(boost::bind(
-                &namespace_repo_t::create_and_destroy_namespace_interface, this,
-                cache, ns_id,
-                auto_drainer_t::lock_t(&cache->drainer)));
-        } else {
-            cache_entry = cache->entries[ns_id].get();
-        }
-    }
+    namespace_cache_entry_t *cache_entry = get_cache_entry(ns_id);
     wait_interruptible(cache_entry->namespace_interface.get_ready_signal(), interruptor);
     return namespace_interface_access_t(
         cache_entry->namespace_interface.wait(),
@@ -210,3 +189,36 @@ namespace_interface_access_t namespace_repo_t::get_namespace_interface(
         get_thread_id());
 }
 
+bool namespace_repo_t::find_namespace_interface(
+        const namespace_id_t &ns_id, namespace_interface_access_t *access_out) {
+    ASSERT_NO_CORO_WAITING;
+    namespace_cache_entry_t *cache_entry = get_cache_entry(ns_id);
+    namespace_interface_t *namespace_interface;
+    if (!cache_entry->namespace_interface.try_get_value(&namespace_interface)) {
+        return false;
+    }
+    *access_out = namespace_interface_access_t(
+        namespace_interface, cache_entry, get_thread_id());
+    return true;
+}
+
+namespace_repo_t::namespace_cache_entry_t *namespace_repo_t::get_cache_entry(
+        const namespace_id_t &ns_id) {
+    ASSERT_NO_CORO_WAITING;
+    namespace_cache_t *cache = namespace_caches.get();
+    auto it = cache->entries.find(ns_id);
+    if (it != cache->entries.end()) {
+        return it->second.get();
+    }
+    namespace_cache_entry_t *cache_entry = new namespace_cache_entry_t;
+    cache_entry->ref_count = 0;
+    cache_entry->pulse_when_ref_count_becomes_zero = NULL;
+    cache_entry->pulse_when_ref_count_becomes_nonzero = NULL;
+    cache->entries.insert(std::make_pair(ns_id,
+        scoped_ptr_t<namespace_cache_entry_t>(cache_entry)));
+    coro_t::spawn_sometime(boost::bind(
+        &namespace_repo_t::create_and_destroy_namespace_interface, this,
+        cache, ns_id,
+        auto_drainer_t::lock_t(&cache->drainer)));
+    return cache_entry;
+}
@@ -39,10 +39,20 @@ public:
     namespace_interface_access_t get_namespace_interface(const namespace_id_t &ns_id,
         signal_t *interruptor);
 
+    /* Like `get_namespace_interface()`, but never blocks: if the table's namespace
+    interface on this thread isn't ready for use yet, returns false, and starts
+    setting it up if nothing else has. */
+    bool find_namespace_interface(const namespace_id_t &ns_id,
+        namespace_interface_access_t *access_out);
+
 private:
     struct namespace_cache_t;
     struct namespace_cache_entry_t;
 
+    /* Finds the cache entry for the table on this thread, or makes one and starts
+    setting up its namespace interface. */
+    namespace_cache_entry_t *get_cache_entry(const namespace_id_t &ns_id);
+
     void create_and_destroy_namespace_interface(
             namespace_cache_t *cache,
             const uuid_u &namespace_id,
@@ -393,6 +393,27 @@ bool real_reql_cluster_interface_t::table_find(
     return true;
 }
 
+bool real_reql_cluster_interface_t::table_get_read_thread(
+        const namespace_id_t &table_id, ql::datum_t pval, bool *table_gone_out,
+        threadnum_t *thread_out) {
+    *table_gone_out = false;
+    cow_ptr_t<namespaces_semilattice_metadata_t> namespaces_metadata
+        = get_namespaces_metadata();
+    auto it = namespaces_metadata->namespaces.find(table_id);
+    if (it == namespaces_metadata->namespaces.end() || it->second.is_deleted()) {
+        *table_gone_out = true;
+        return false;
+    }
+    /* Routing mustn't wait for a namespace interface to be set up; if there isn't
+    one on this thread, the query will make one wherever it runs. */
+    namespace_interface_access_t access;
+    if (!namespace_repo.find_namespace_interface(table_id, &access)) {
+        return false;
+    }
+    return access.get()->get_read_thread(
+        store_key_t(pval.print_primary()), thread_out);
+}
+
 bool real_reql_cluster_interface_t::table_estimate_doc_counts(
         counted_t<const ql::db_t> db,
         const name_string_t &name,
@@ -64,6 +64,8 @@ public:
             boost::optional<admin_identifier_format_t> identifier_format,
             signal_t *interruptor, counted_t<base_table_t> *table_out,
             std::string *error_out);
+    bool table_get_read_thread(const namespace_id_t &table_id,
+            ql::datum_t pval, bool *table_gone_out, threadnum_t *thread_out);
     bool table_estimate_doc_counts(
             counted_t<const ql::db_t> db,
             const name_string_t &name,
@@ -43,7 +43,8 @@ bool debug_stats_artificial_table_backend_t::format_row(
 
     ql::datum_t stats;
     std::string stats_error;
-    if (stats_for_server(server_id, interruptor, &stats, &stats_error)) {
+    if (stats_for_server(server_id, std::vector<std::string>(), interruptor, &stats,
+                         &stats_error)) {
         builder.overwrite("stats", stats);
     } else {
         builder.overwrite("error", ql::datum_t(datum_string_t(stats_error)));
@@ -55,6 +56,7 @@ bool debug_stats_artificial_table_backend_t::format_row(
 
 bool debug_stats_artificial_table_backend_t::stats_for_server(
         const server_id_t &server_id,
+        const std::vector<std::string> &path,
         signal_t *interruptor,
         ql::datum_t *stats_out,
         std::string *error_out) {
@@ -76,9 +78,8 @@ bool debug_stats_artificial_table_backend_t::stats_for_server(
         return false;
     }
 
-    /* Make a filter that includes everything */
     std::set<std::vector<std::string> > filter;
-    filter.insert(std::vector<stat_manager_t::stat_id_t>());
+    filter.insert(path);
 
     return fetch_stats_from_server(
         mailbox_manager,
@@ -89,3 +90,48 @@ bool debug_stats_artificial_table_backend_t::stats_for_server(
         error_out);
 }
 
+
+debug_coro_profile_artificial_table_backend_t::debug_coro_profile_artificial_table_backend_t(
+        boost::shared_ptr<semilattice_readwrite_view_t<servers_semilattice_metadata_t> >
+            _servers_sl_view,
+        server_config_client_t *_server_config_client,
+        watchable_map_t<peer_id_t, cluster_directory_metadata_t> *_directory_view,
+        mailbox_manager_t *_mailbox_manager) :
+    debug_stats_artificial_table_backend_t(_servers_sl_view, _server_config_client,
+                                           _directory_view, _mailbox_manager)
+    { }
+
+bool debug_coro_profile_artificial_table_backend_t::write_row(
+        UNUSED ql::datum_t primary_key,
+        UNUSED bool pkey_was_autogenerated,
+        UNUSED ql::datum_t *new_value_inout,
+        UNUSED signal_t *interruptor,
+        std::string *error_out) {
+    *error_out = "It's illegal to write to the `rethinkdb._debug_coro_profile` table.";
+    return false;
+}
+
+bool debug_coro_profile_artificial_table_backend_t::format_row(
+        name_string_t const & server_name,
+        server_id_t const & server_id,
+        UNUSED server_semilattice_metadata_t const & server,
+        signal_t *interruptor,
+        ql::datum_t *row_out,
+        UNUSED std::string *error_out) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("name", convert_name_to_datum(server_name));
+    builder.overwrite("id", convert_uuid_to_datum(server_id));
+
+    ql::datum_t stats;
+    std::string stats_error;
+    if (stats_for_server(server_id, std::vector<std::string>(1, coro_profile_stat_id),
+                         interruptor, &stats, &stats_error)) {
+        ql::datum_t profile = stats.get_field(coro_profile_stat_id, ql::NOTHROW);
+        builder.overwrite("profile", profile.has() ? profile : ql::datum_t::null());
+    } else {
+        builder.overwrite("error", ql::datum_t(datum_string_t(stats_error)));
+    }
+
+    *row_out = std::move(builder).to_datum();
+    return true;
+}
@@ -36,7 +36,7 @@ public:
             signal_t *interruptor,
             std::string *error_out);
 
-private:
+protected:
     bool format_row(
             name_string_t const & name,
             server_id_t const & server_id,
@@ -45,15 +45,50 @@ private:
             ql::datum_t *row_out,
             std::string *error_out);
 
+    /* Fetches the stats under the given path from the server, or all of them if
+    `path` is empty. */
     bool stats_for_server(
             const server_id_t &server_id,
+            const std::vector<std::string> &path,
             signal_t *interruptor,
             ql::datum_t *stats_out,
             std::string *error_out);
 
+private:
     watchable_map_t<peer_id_t, cluster_directory_metadata_t> *directory_view;
     mailbox_manager_t *mailbox_manager;
 };
 
+/* `rethinkdb._debug_coro_profile` shows each server's `coro_profile` stat, which
+tells where the server's coroutines spend their time (see
+`arch/runtime/coro_sampler.hpp`). */
+class debug_coro_profile_artificial_table_backend_t :
+    public debug_stats_artificial_table_backend_t
+{
+public:
+    debug_coro_profile_artificial_table_backend_t(
+            boost::shared_ptr< semilattice_readwrite_view_t<
+                servers_semilattice_metadata_t> > _servers_sl_view,
+            server_config_client_t *_server_config_client,
+            watchable_map_t<peer_id_t, cluster_directory_metadata_t> *_directory_view,
+            mailbox_manager_t *_mailbox_manager);
+
+    bool write_row(
+            ql::datum_t primary_key,
+            bool pkey_was_autogenerated,
+            ql::datum_t *new_value_inout,
+            signal_t *interruptor,
+            std::string *error_out);
+
+private:
+    bool format_row(
+            name_string_t const & name,
+            server_id_t const & server_id,
+            server_semilattice_metadata_t const & server,
+            signal_t *interruptor,
+            ql::datum_t *row_out,
+            std::string *error_out);
+};
+
 #endif /* CLUSTERING_ADMINISTRATION_SERVERS_DEBUG_STATS_BACKEND_HPP_ */
 
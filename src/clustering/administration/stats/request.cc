@@ -33,7 +33,8 @@ const char *table_server_stats_request_t::table_server_request_type = "table_ser
 parsed_stats_t::server_stats_t::server_stats_t() :
     responsive(false),
     queries_per_sec(0), queries_total(0),
-    client_connections(0), clients_active(0) { }
+    client_connections(0), clients_active(0),
+    result_cache_hits(0), result_cache_misses(0) { }
 
 parsed_stats_t::table_stats_t::table_stats_t() :
     read_docs_per_sec(0), read_docs_total(0),
@@ -165,6 +166,9 @@ void parsed_stats_t::store_query_engine_stats(const ql::datum_t &qe_perf,
     store_perfmon_value(qe_perf, "queries_total", &stats_out->queries_total);
     store_perfmon_value(qe_perf, "client_connections", &stats_out->client_connections);
     store_perfmon_value(qe_perf, "clients_active", &stats_out->clients_active);
+    store_perfmon_value(qe_perf, "result_cache_hits", &stats_out->result_cache_hits);
+    store_perfmon_value(qe_perf, "result_cache_misses",
+                        &stats_out->result_cache_misses);
 }
 
 void parsed_stats_t::store_table_stats(const namespace_id_t &table_id,
@@ -311,6 +315,8 @@ bool cluster_stats_request_t::to_datum(const parsed_stats_t &stats,
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, queries_per_sec);
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, client_connections);
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, clients_active);
+    ADD_CLUSTER_SERVER_STAT(qe_builder, stats, result_cache_hits);
+    ADD_CLUSTER_SERVER_STAT(qe_builder, stats, result_cache_misses);
     ADD_CLUSTER_TABLE_STAT(qe_builder, stats, read_docs_per_sec);
     ADD_CLUSTER_TABLE_STAT(qe_builder, stats, written_docs_per_sec);
     row_builder.overwrite("query_engine", std::move(qe_builder).to_datum());
@@ -462,6 +468,8 @@ bool server_stats_request_t::to_datum(const parsed_stats_t &stats,
         ADD_STAT(qe_builder, server_stats, clients_active);
         ADD_STAT(qe_builder, server_stats, queries_per_sec);
         ADD_STAT(qe_builder, server_stats, queries_total);
+        ADD_STAT(qe_builder, server_stats, result_cache_hits);
+        ADD_STAT(qe_builder, server_stats, result_cache_misses);
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_per_sec);
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_total);
         ADD_SERVER_STAT(qe_builder, stats, server_id, written_docs_per_sec);
@@ -45,6 +45,8 @@ public:
         double queries_total;
         double client_connections;
         double clients_active;
+        double result_cache_hits;
+        double result_cache_misses;
 
         std::map<namespace_id_t, table_stats_t> tables;
     };
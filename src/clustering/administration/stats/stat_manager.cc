@@ -3,12 +3,15 @@
 
 #include <functional>
 
+#include "arch/runtime/coro_sampler.hpp"
 #include "clustering/administration/datum_adapter.hpp"
 #include "concurrency/watchable.hpp"
 #include "perfmon/collect.hpp"
 #include "perfmon/filter.hpp"
 #include "stl_utils.hpp"
 
+const char *const coro_profile_stat_id = "coro_profile";
+
 stat_manager_t::stat_manager_t(mailbox_manager_t* mm,
                                server_id_t _own_server_id) :
     own_server_id(_own_server_id),
@@ -26,12 +29,24 @@ void stat_manager_t::on_stats_request(
         UNUSED signal_t *interruptor,
         const return_address_t& reply_address,
         const std::set<std::vector<stat_id_t> >& requested_stats) {
-    perfmon_filter_t request(requested_stats);
-    ql::datum_t perfmon_result(perfmon_get_stats());
-    perfmon_result = request.filter(perfmon_result);
+    // The coroutine profile is only gathered if it's asked for by exactly this path,
+    // since it's expensive (see `arch/runtime/coro_sampler.hpp`).
+    std::set<std::vector<stat_id_t> > perfmon_stats = requested_stats;
+    const bool coro_profile_requested =
+        perfmon_stats.erase(std::vector<stat_id_t>(1, coro_profile_stat_id)) != 0;
+
+    ql::datum_t perfmon_result = ql::datum_t::empty_object();
+    if (!coro_profile_requested || !perfmon_stats.empty()) {
+        perfmon_filter_t request(perfmon_stats);
+        perfmon_result = request.filter(perfmon_get_stats());
+    }
 
     // Add in our own server id so the other side does not need to perform lookups
     ql::datum_object_builder_t stats(perfmon_result);
+    if (coro_profile_requested) {
+        stats.overwrite(coro_profile_stat_id,
+                        perfmon_get_stats(get_coro_profile_perfmon()));
+    }
     stats.overwrite("server_id", convert_uuid_to_datum(own_server_id));
     send(mailbox_manager, reply_address, std::move(stats).to_datum());
 }
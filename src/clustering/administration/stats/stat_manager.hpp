@@ -9,6 +9,10 @@
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
 
+/* The stat that `rethinkdb._debug_coro_profile` shows.  It isn't part of the other
+stats; a request only gets it by asking for this path on its own. */
+extern const char *const coro_profile_stat_id;
+
 class stat_manager_t {
 public:
     typedef std::string stat_id_t;
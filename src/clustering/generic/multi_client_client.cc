@@ -61,6 +61,12 @@ void multi_client_client_t<request_type>::spawn_request(
     send(mailbox_manager, intro_promise.wait(), request);
 }
 
+template <class request_type>
+const typename multi_client_client_t<request_type>::server_business_card_t &
+multi_client_client_t<request_type>::get_server_business_card() const {
+    return intro_promise.wait();
+}
+
 template <class request_type>
 boost::optional<boost::optional<registrar_business_card_t<typename multi_client_business_card_t<
             request_type>::client_business_card_t> > >
@@ -39,6 +39,9 @@ public:
 
     void spawn_request(const request_type &request);
 
+    /* Returns the address of the mailbox that requests are sent to. */
+    const server_business_card_t &get_server_business_card() const;
+
 private:
     static boost::optional<boost::optional<registrar_business_card_t<client_business_card_t> > >
     extract_registrar_business_card(
@@ -28,6 +28,12 @@ public:
         return region;
     }
 
+    /* Returns the thread that the master handles our requests on. That's only
+    meaningful if the master is on this server. */
+    threadnum_t get_master_thread() const {
+        return multi_client_client.get_server_business_card().get_thread();
+    }
+
     signal_t *get_failed_signal() {
         return multi_client_client.get_failed_signal();
     }
@@ -123,6 +123,26 @@ cluster_namespace_interface_t::get_sharding_scheme() THROWS_ONLY(cannot_perform_
     return std::set<region_t>(s.begin(), s.end());
 }
 
+bool cluster_namespace_interface_t::get_read_thread(const store_key_t &key,
+                                                    threadnum_t *thread_out) {
+    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+        if (!region_contains_key(it->first, key)) {
+            continue;
+        }
+        for (relationship_t *relationship : it->second) {
+            if (relationship->master_access != NULL) {
+                if (!relationship->is_local) {
+                    return false;
+                }
+                *thread_out = relationship->master_access->get_master_thread();
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t::dispatch_immediate_op(
     /* `how_to_make_token` and `how_to_run_query` have type pointer-to-
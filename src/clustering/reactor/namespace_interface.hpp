@@ -59,6 +59,8 @@ public:
 
     std::set<region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t);
 
+    bool get_read_thread(const store_key_t &key, threadnum_t *thread_out);
+
 private:
     class relationship_t {
     public:
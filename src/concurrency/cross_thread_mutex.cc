@@ -26,35 +26,69 @@ void cross_thread_mutex_t::acq_t::reset(cross_thread_mutex_t *l) {
 }
 
 void cross_thread_mutex_t::co_lock() {
-    bool do_wait = false;
+    coro_t *self = coro_t::self();
+    if (__sync_bool_compare_and_swap(&lock_holder, NULL, self)) {
+        locked_count = 1;
+        return;
+    }
+    if (lock_holder == self) {
+        guarantee(is_recursive,
+            "Deadlock detected. A coroutine tried to acquire a mutex which it is "
+            "already holding.");
+        ++locked_count;
+        return;
+    }
+
     {
         spinlock_acq_t acq(&spinlock);
-        if (locked_count > 0 && lock_holder != coro_t::self()) {
-            waiters.push_back(coro_t::self());
-            do_wait = true;
-        } else {
-            guarantee(locked_count == 0 || is_recursive,
-                "Deadlock detected. A coroutine tried to acquire a mutex which it is "
-                "already holding.");
-            lock_holder = coro_t::self();
-            ++locked_count;
+        // Once `has_waiters` is set, whoever unlocks the mutex next looks at
+        // `waiters`.  So if we still can't get the mutex after setting it, it's
+        // safe to wait.
+        has_waiters = true;
+        __sync_synchronize();
+        if (__sync_bool_compare_and_swap(&lock_holder, NULL, self)) {
+            locked_count = 1;
+            if (waiters.empty()) {
+                has_waiters = false;
+            }
+            return;
         }
+        waiters.push_back(self);
     }
-    if (do_wait) {
-        coro_t::wait();
-    }
+    // `wake_waiter()` sets `locked_count` and `lock_holder` for us.
+    coro_t::wait();
+    rassert(lock_holder == self);
 }
 
 void cross_thread_mutex_t::unlock() {
-    spinlock_acq_t acq(&spinlock);
     rassert(locked_count > 0);
     rassert(lock_holder == coro_t::self());
     --locked_count;
-    if (locked_count == 0 && !waiters.empty()) {
-        coro_t *next = waiters.front();
+    if (locked_count > 0) {
+        return;
+    }
+    DEBUG_VAR bool released = __sync_bool_compare_and_swap(&lock_holder, coro_t::self(), NULL);
+    rassert(released);
+    if (has_waiters) {
+        wake_waiter();
+    }
+}
+
+void cross_thread_mutex_t::wake_waiter() {
+    spinlock_acq_t acq(&spinlock);
+    if (waiters.empty()) {
+        has_waiters = false;
+        return;
+    }
+    coro_t *next = waiters.front();
+    // If some other coroutine got the mutex in the meantime, it wakes the waiter
+    // when it unlocks, since `has_waiters` is still set.
+    if (__sync_bool_compare_and_swap(&lock_holder, NULL, next)) {
         waiters.pop_front();
-        ++locked_count;
-        lock_holder = next;
+        locked_count = 1;
+        if (waiters.empty()) {
+            has_waiters = false;
+        }
         next->notify_sometime();
     }
 }
@@ -17,7 +17,10 @@ class cross_thread_mutex_t;
  * `{ on_thread_t t(mutex_home_thread); co_lock_mutex(&m); }`
  * because the thread switch is avoided.
  * In single-threaded use cases, it comes with more overhead than a regular
- * `mutex_t` though. */
+ * `mutex_t` though.
+ * Locking and unlocking a mutex that nobody else is waiting for only takes an
+ * atomic compare-and-swap; the spinlock and the waiter queue are only used
+ * under contention. */
 class cross_thread_mutex_t {
 public:
     class acq_t {
@@ -40,17 +43,14 @@ public:
     };
 
     explicit cross_thread_mutex_t(bool recursive = false) :
-        is_recursive(recursive), locked_count(0), lock_holder(NULL) { }
+        is_recursive(recursive), locked_count(0), lock_holder(NULL),
+        has_waiters(false) { }
     ~cross_thread_mutex_t() {
-#ifndef NDEBUG
-        spinlock_acq_t acq(&spinlock);
-        rassert(locked_count == 0);
-#endif
+        rassert(lock_holder == NULL);
     }
 
     bool is_locked() {
-        spinlock_acq_t acq(&spinlock);
-        return locked_count > 0;
+        return __sync_fetch_and_add(&lock_holder, 0) != NULL;
     }
 
 private:
@@ -58,10 +58,20 @@ private:
     void co_lock();
     void unlock();
 
-    spinlock_t spinlock;
+    // Hands the mutex to the first waiter, if there is one and the mutex is free.
+    void wake_waiter();
+
     bool is_recursive;
+    // Only touched by the coroutine that holds the mutex.
     int locked_count;
-    coro_t *lock_holder;
+    // NULL when the mutex is free.  Only changed with compare-and-swap.
+    coro_t *volatile lock_holder;
+
+    // `spinlock` protects `waiters`.  `has_waiters` is set under it before a
+    // coroutine tries to get in line, and is only cleared under it once `waiters`
+    // is empty, so `unlock()` only has to take the spinlock when it's set.
+    spinlock_t spinlock;
+    volatile bool has_waiters;
     std::deque<coro_t *> waiters;
 
     DISABLE_COPYING(cross_thread_mutex_t);
@@ -6,13 +6,16 @@
 #include "containers/intrusive_list.hpp"
 #include "concurrency/interruptor.hpp"
 #include "concurrency/promise.hpp"
-#include "arch/io/concurrency.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/spinlock.hpp"
 
 // This class implements a semaphore that can be used across threads
 // Each element acquired from the semaphore is an item of type value_t, which may
 //  be changed before being returned to the semaphore with `unlock()`
+// Taking an element that's available and giving it back only holds a spinlock for
+//  a few instructions.  If somebody is waiting, `unlock()` sends the element
+//  straight to the waiter's thread in a single message.
 template <class value_t>
 class cross_thread_semaphore_t {
 public:
@@ -92,16 +95,37 @@ private:
         request_node_t *request;
     };
 
+    // Message that takes a released item to the thread of the request it's for
+    class handoff_t : public linux_thread_message_t {
+    public:
+        handoff_t(cross_thread_semaphore_t *_parent, request_node_t *_request,
+                  value_t *_value) :
+            parent(_parent), request(_request), value(_value) { }
+
+        void on_thread_switch() {
+            if (request->is_abandoned()) {
+                // No one is waiting anymore, re-release the item
+                parent->unlock(value);
+            } else {
+                request->fulfill_promise(value);
+            }
+            delete request;
+            delete this;
+        }
+
+    private:
+        cross_thread_semaphore_t *parent;
+        request_node_t *request;
+        value_t *value;
+        DISABLE_COPYING(handoff_t);
+    };
+
     value_t *lock(signal_t *interruptor);
     void unlock(value_t *value);
 
-    // Mutex to control access, since a lock may be constructed from any thread
-    // The mutex is guaranteed to be released within constant time
-    system_mutex_t mutex;
-
-    // Coroutine to switch to the target thread and hand off the acquired item
-    void pass_value_coroutine(request_node_t *request,
-                              value_t *value);
+    // Spinlock to control access, since a lock may be constructed from any thread
+    // The spinlock is guaranteed to be released within constant time
+    spinlock_t spinlock;
 
     size_t available_value_index;
     scoped_array_t<value_t *> values;
@@ -118,46 +142,32 @@ cross_thread_semaphore_t<value_t>::~cross_thread_semaphore_t() {
     }
 }
 
-template <class value_t>
-void cross_thread_semaphore_t<value_t>::pass_value_coroutine(request_node_t *request,
-                                                             value_t *value) {
-    on_thread_t rethreader(request->get_thread());
-
-    if (request->is_abandoned()) {
-        // No one is waiting anymore, re-release the item
-        delete request;
-        unlock(value);
-    } else {
-        request->fulfill_promise(value);
-        delete request;
-    }
-}
-
 template <class value_t>
 value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
-    system_mutex_t::lock_t lock(&mutex);
-    value_t *result = NULL;
-
-    if (available_value_index == values.size()) {
-        request_t request(this);
-        lock.unlock();
-        result = request.wait_and_get(interruptor);
-    } else {
-        result = values[available_value_index];
-        values[available_value_index] = NULL;
-        ++available_value_index;
+    {
+        spinlock_acq_t acq(&spinlock);
+        if (available_value_index < values.size()) {
+            value_t *result = values[available_value_index];
+            values[available_value_index] = NULL;
+            ++available_value_index;
+            guarantee(result != NULL);
+            return result;
+        }
     }
 
+    // `request_t` checks again under the spinlock before it queues itself
+    request_t request(this);
+    value_t *result = request.wait_and_get(interruptor);
     guarantee(result != NULL);
     return result;
 }
 
 template <class value_t>
 void cross_thread_semaphore_t<value_t>::unlock(value_t *value) {
-    system_mutex_t::lock_t lock(&mutex);
+    request_node_t *request = NULL;
+    {
+        spinlock_acq_t acq(&spinlock);
 
-    if (request_queue.size() > 0) {
-        request_node_t *request = NULL;
         while (request_queue.size() > 0) {
             request = request_queue.head();
             request_queue.remove(request);
@@ -170,18 +180,22 @@ void cross_thread_semaphore_t<value_t>::unlock(value_t *value) {
             request = NULL;
         }
 
-        if (request != NULL) {
-            coro_t::spawn_sometime(std::bind(&cross_thread_semaphore_t<value_t>::pass_value_coroutine,
-                                             this, request, value));
+        if (request == NULL) {
+            // There were no valid requests in the queue
+            guarantee(available_value_index > 0);
+            guarantee(values[available_value_index - 1] == NULL);
+            values[available_value_index - 1] = value;
+            --available_value_index;
             return;
         }
     }
 
-    // If we get here, there were no valid requests in the queue
-    guarantee(available_value_index > 0);
-    guarantee(values[available_value_index - 1] == NULL);
-    values[available_value_index - 1] = value;
-    --available_value_index;
+    // The request may still be abandoned before the handoff gets there, in which
+    //  case the handoff releases the item again
+    handoff_t *handoff = new handoff_t(this, request, value);
+    if (continue_on_thread(request->get_thread(), handoff)) {
+        call_later_on_this_thread(handoff);
+    }
 }
 
 template <class value_t>
@@ -190,13 +204,25 @@ cross_thread_semaphore_t<value_t>::request_t::request_t(cross_thread_semaphore_t
     value_returned(false),
     request(new request_node_t(&value_promise))
 {
-    parent->request_queue.push_back(request);
+    spinlock_acq_t acq(&parent->spinlock);
+    if (parent->available_value_index < parent->values.size()) {
+        // An item was released after `lock()` looked
+        value_t *value = parent->values[parent->available_value_index];
+        parent->values[parent->available_value_index] = NULL;
+        ++parent->available_value_index;
+        request->fulfill_promise(value);
+        delete request;
+        request = NULL;
+    } else {
+        parent->request_queue.push_back(request);
+    }
 }
 
 template <class value_t>
 cross_thread_semaphore_t<value_t>::request_t::~request_t() {
     if (!value_promise.is_pulsed()) {
         // No item was given to us, just abandon the request
+        guarantee(request != NULL);
         request->abandon();
     } else if (!value_returned) {
         // We were given an item, but no one took it, release it
@@ -2,11 +2,13 @@
 #ifndef CONCURRENCY_CROSS_THREAD_WATCHABLE_HPP_
 #define CONCURRENCY_CROSS_THREAD_WATCHABLE_HPP_
 
+#include <map>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
 #include "concurrency/watchable.hpp"
 #include "concurrency/watchable_map.hpp"
 #include "concurrency/auto_drainer.hpp"
-#include "concurrency/queue/single_value_producer.hpp"
-#include "concurrency/coro_pool.hpp"
 
 /* `cross_thread_watchable_variable_t` is used to "proxy" a `watchable_t` from
 one thread to another. Create the `cross_thread_watchable_variable_t` on the
@@ -15,14 +17,17 @@ usable on the `_dest_thread` that you passed to the constructor.
 
 `cross_thread_watchable_map_var_t` is similar but for `watchable_map_t`.
 
-See also: `cross_thread_signal_t`, which is the same thing for `signal_t`. */
+See also: `cross_thread_signal_t`, which is the same thing for `signal_t`.
+
+Changes that come in while the previous one is still on its way are sent together. */
 
 template <class value_t>
 class cross_thread_watchable_variable_t
 {
 public:
-    cross_thread_watchable_variable_t(const clone_ptr_t<watchable_t<value_t> > &watchable,
-                                      threadnum_t _dest_thread);
+    cross_thread_watchable_variable_t(
+            const clone_ptr_t<watchable_t<value_t> > &watchable,
+            threadnum_t _dest_thread);
 
     clone_ptr_t<watchable_t<value_t> > get_watchable() {
         return clone_ptr_t<watchable_t<value_t> >(watchable.clone());
@@ -40,7 +45,7 @@ public:
 private:
     friend class cross_thread_watcher_subscription_t;
     void on_value_changed();
-    void deliver(value_t new_value);
+    void deliver_changes(auto_drainer_t::lock_t keepalive);
 
     static void call(const std::function<void()> &f) {
         f();
@@ -102,16 +107,18 @@ private:
         cross_thread_watchable_variable_t *parent;
     } rethreader;
 
+    // Only touched on `watchable_thread`.
+    bool changed;
+    bool coro_running;
+
+    auto_drainer_t drainer;
+
     /* The destructor for `subs` must be run before the destructor for `drainer`
     because `drainer`'s destructor will block until all the
     `auto_drainer_t::lock_t` objects are gone, and `subs`'s callback holds an
     `auto_drainer_t::lock_t`. */
     typename watchable_t<value_t>::subscription_t subs;
 
-    single_value_producer_t<value_t> value_producer;
-    std_function_callback_t<value_t> deliver_cb;
-    coro_pool_t<value_t> messanger_pool;
-
     DISABLE_COPYING(cross_thread_watchable_variable_t);
 };
 
@@ -11,9 +11,9 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
     watchable_thread(get_thread_id()),
     dest_thread(_dest_thread),
     rethreader(this),
-    subs(std::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this)),
-    deliver_cb(std::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, ph::_1)),
-    messanger_pool(1, &value_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
+    changed(false),
+    coro_running(false),
+    subs(std::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this))
 {
     rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
     typename watchable_t<value_t>::freeze_t freeze(original);
@@ -23,14 +23,33 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
 
 template <class value_t>
 void cross_thread_watchable_variable_t<value_t>::on_value_changed() {
-    value_producer.give_value(original->get());
+    // Nothing is copied until the changes are actually sent.
+    changed = true;
+    if (!coro_running) {
+        coro_running = true;
+        auto_drainer_t::lock_t keepalive(&drainer);
+        coro_t::spawn_sometime([this, keepalive]() {
+            this->deliver_changes(keepalive);
+        });
+    }
 }
 
 template <class value_t>
-void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
-    on_thread_t thread_switcher(dest_thread);
-    value = new_value;
-    publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
+void cross_thread_watchable_variable_t<value_t>::deliver_changes(
+        auto_drainer_t::lock_t keepalive) {
+    guarantee(get_thread_id() == watchable_thread);
+    while (true) {
+        if (!changed || keepalive.get_drain_signal()->is_pulsed()) {
+            coro_running = false;
+            return;
+        }
+        value_t new_value = original->get();
+        changed = false;
+
+        on_thread_t thread_switcher(dest_thread);
+        value = std::move(new_value);
+        publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
+    }
 }
 
 template <class value_t>
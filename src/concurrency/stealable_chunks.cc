@@ -0,0 +1,150 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "concurrency/stealable_chunks.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/counted.hpp"
+#include "do_on_thread.hpp"
+#include "threading.hpp"
+
+namespace {
+
+// Shared by the current thread and its helpers.  A helper may only get to it after
+// `run_stealable_chunks()` has returned, so it's counted, and helpers only look at
+// `run_chunk` after they have claimed a chunk.
+class stealable_chunks_t : public slow_atomic_countable_t<stealable_chunks_t> {
+public:
+    stealable_chunks_t(size_t _num_chunks,
+                       const std::function<void(size_t)> *_run_chunk)
+        : num_chunks(_num_chunks),
+          run_chunk(_run_chunk),
+          home_thread(get_thread_id()),
+          next_chunk(0),
+          chunks_done(0),
+          first_failed(_num_chunks),
+          errors(_num_chunks),
+          waiter(NULL) { }
+
+    // Claims and runs chunks until there are none left.  Returns true if this
+    // finished the last chunk.
+    bool run_chunks() {
+        bool finished_last = false;
+        for (;;) {
+            const size_t chunk = __sync_fetch_and_add(&next_chunk, 1);
+            if (chunk >= num_chunks) {
+                return finished_last;
+            }
+            // Chunks after one that threw don't need to run, since only the
+            // lowest error is rethrown.
+            if (chunk < __sync_add_and_fetch(&first_failed, 0)) {
+                try {
+                    (*run_chunk)(chunk);
+                } catch (...) {
+                    errors[chunk] = std::current_exception();
+                    set_failed(chunk);
+                }
+            }
+            // This is a full barrier, so the chunk's results and error are visible
+            // to whoever sees the count.
+            finished_last = __sync_add_and_fetch(&chunks_done, 1) == num_chunks;
+        }
+    }
+
+    void set_failed(size_t chunk) {
+        size_t old_first = first_failed;
+        while (chunk < old_first) {
+            const size_t seen =
+                __sync_val_compare_and_swap(&first_failed, old_first, chunk);
+            if (seen == old_first) {
+                break;
+            }
+            old_first = seen;
+        }
+    }
+
+    bool all_done() {
+        return __sync_add_and_fetch(&chunks_done, 0) == num_chunks;
+    }
+
+    const size_t num_chunks;
+    const std::function<void(size_t)> *const run_chunk;
+    const threadnum_t home_thread;
+
+    // Only touched with atomic operations.
+    size_t next_chunk;
+    size_t chunks_done;
+    // The lowest chunk that threw, or `num_chunks`.
+    size_t first_failed;
+
+    // Each one is only set by the thread that ran the chunk.
+    std::vector<std::exception_ptr> errors;
+
+    // Set while the home thread waits for the helpers.  Only touched on the home
+    // thread.
+    cond_t *waiter;
+};
+
+void wake_home_thread(counted_t<stealable_chunks_t> chunks) {
+    if (chunks->waiter != NULL) {
+        chunks->waiter->pulse_if_not_already_pulsed();
+    }
+}
+
+void help(counted_t<stealable_chunks_t> chunks) {
+    if (chunks->run_chunks()) {
+        do_on_thread(chunks->home_thread, std::bind(&wake_home_thread, chunks));
+    }
+}
+
+void spawn_helper(counted_t<stealable_chunks_t> chunks) {
+    coro_t::spawn_sometime(std::bind(&help, chunks));
+}
+
+}  // namespace
+
+void run_stealable_chunks(size_t num_chunks,
+                          int max_helpers,
+                          const std::function<void(size_t)> &run_chunk) {
+    const int num_db_threads = get_num_db_threads();
+    const int current_thread = get_thread_id().threadnum;
+    max_helpers = std::min(max_helpers, num_db_threads - 1);
+    if (num_chunks <= static_cast<size_t>(std::max(max_helpers, 0))) {
+        // There's no point in offering a chunk to more than one other thread.
+        max_helpers = static_cast<int>(num_chunks) - 1;
+    }
+    if (current_thread >= num_db_threads || max_helpers <= 0) {
+        for (size_t i = 0; i < num_chunks; ++i) {
+            run_chunk(i);
+        }
+        return;
+    }
+
+    counted_t<stealable_chunks_t> chunks =
+        make_counted<stealable_chunks_t>(num_chunks, &run_chunk);
+    for (int i = 1; i <= max_helpers; ++i) {
+        // `do_on_thread` would run `help` outside of a coroutine, and the chunks
+        // may need to block.
+        do_on_thread(threadnum_t((current_thread + i) % num_db_threads),
+                     std::bind(&spawn_helper, chunks));
+    }
+    chunks->run_chunks();
+    if (!chunks->all_done()) {
+        // Whoever finishes the last chunk wakes us up.
+        cond_t done;
+        chunks->waiter = &done;
+        if (!chunks->all_done()) {
+            done.wait();
+        }
+        chunks->waiter = NULL;
+    }
+
+    for (const std::exception_ptr &error : chunks->errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_STEALABLE_CHUNKS_HPP_
+#define CONCURRENCY_STEALABLE_CHUNKS_HPP_
+
+#include <stddef.h>
+
+#include <functional>
+
+/* `run_stealable_chunks()` runs `run_chunk(i)` for every `i` in `[0, num_chunks)`,
+for CPU-bound work that would otherwise keep one thread busy while the others sit
+idle.  The current thread runs chunks itself, in order, and offers them to up to
+`max_helpers` other db threads too.  Each chunk is claimed by exactly one thread, so
+the other threads only take chunks while they're idle enough to get to them before the
+current thread does.  A thread that's busy for the whole time costs the current thread
+nothing but one message.
+
+`run_chunk` may be called on any db thread, so it must not touch anything that belongs
+to the current thread, and the chunks must be independent of each other.  Returns once
+every chunk has run.  If chunks throw, the exception of the lowest-numbered one is
+rethrown, and the chunks after it may or may not have run. */
+void run_stealable_chunks(size_t num_chunks,
+                          int max_helpers,
+                          const std::function<void(size_t)> &run_chunk);
+
+#endif  // CONCURRENCY_STEALABLE_CHUNKS_HPP_
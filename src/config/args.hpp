@@ -35,8 +35,11 @@
 
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
-// decrease concurrency
-#define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
+// decrease concurrency.  The epoll queue starts with the minimum, and
+// doubles or halves its batch size as the number of ready events goes up
+// or down.
+#define MIN_IO_EVENT_PROCESSING_BATCH_SIZE        50
+#define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        512
 
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
@@ -168,14 +171,49 @@
 
 #define COROUTINE_STACK_SIZE                      131072
 
-// How many unused coroutine stacks to keep around (maximally), before they are
-// freed. This value is per thread.
+// How much address space to reserve for coroutine stacks at a time. The pages
+// only get used once a coroutine touches them.
+#define COROUTINE_STACK_CHUNK_SIZE                (32 * MEGABYTE)
+
+// How many unused coroutines (and their stacks) to keep around before they are
+// freed. The limit is per thread, and it grows with the number of coroutines the
+// thread had running at once lately, up to COROUTINE_MAX_FREE_LIST_SIZE.
 #define COROUTINE_FREE_LIST_SIZE                  64
+#define COROUTINE_MAX_FREE_LIST_SIZE              4096
+
+// After how many coroutine spawns on a thread to adjust its free list limit.
+#define COROUTINE_FREE_LIST_WINDOW                16384
+
+// The coroutine sampler (see arch/runtime/coro_sampler.hpp) times one out of this
+// many coroutine runs by default, keeps this many samples per thread, and records
+// this many frames of where each sampled coroutine yielded.
+#define CORO_SAMPLING_INTERVAL                    1000
+#define CORO_SAMPLER_RING_SIZE                    4096
+#define CORO_SAMPLER_TRACE_DEPTH                  8
+
+// How many of the spawn site and yield point pairs that took the most time the
+// `coro_profile` stat shows.
+#define CORO_PROFILE_MAX_SITES                    100
 
 // In debug mode, we print a warning if more than this many coroutines have been
 // allocated on one thread.
 #define COROS_PER_THREAD_WARN_LEVEL               10000
 
+// The slab allocator (see arch/runtime/slab_allocator.hpp) reserves this much
+// address space once, hands it out to threads a slab at a time, and serves
+// allocations up to SLAB_ALLOCATOR_MAX_OBJECT_SIZE bytes from it.
+#define SLAB_ALLOCATOR_REGION_SIZE                (64 * GIGABYTE)
+#define SLAB_ALLOCATOR_SLAB_SIZE                  MEGABYTE
+#define SLAB_ALLOCATOR_MAX_OBJECT_SIZE            (16 * KILOBYTE)
+
+// A thread sends objects that it frees back to the thread that owns them once per
+// event loop iteration, or once it has this many for one thread.
+#define SLAB_ALLOCATOR_REMOTE_BATCH_SIZE          256
+
+// Beyond this many bytes of free objects of one size, a thread lets the OS have
+// the pages of page-sized objects back.
+#define SLAB_ALLOCATOR_MAX_CACHED_BYTES           (4 * MEGABYTE)
+
 
 // Minimal time we nap before re-checking if a goal is satisfied in the reactor (in ms).
 // This is an optimization to save CPU time. Checking for whether the goal is
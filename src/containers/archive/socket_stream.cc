@@ -53,7 +53,7 @@ void blocking_fd_watcher_t::init_callback(UNUSED linux_event_callback_t *cb) {}
 linux_event_fd_watcher_t::linux_event_fd_watcher_t(fd_t fd)
     : io_in_progress_(false),
       event_callback_(NULL),
-      event_watcher_(fd, this)
+      event_watcher_(fd, this, false)
 {
     int res = fcntl(fd, F_SETFL, O_NONBLOCK);
     guarantee_err(res == 0, "Could not make fd non-blocking.");
@@ -0,0 +1,91 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "containers/chained_buffer.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+const size_t chained_buffer_t::min_block_size = 4 * KILOBYTE;
+const size_t chained_buffer_t::max_block_size = 64 * KILOBYTE;
+
+chained_buffer_t::chained_buffer_t()
+    : used_blocks(0), full_blocks_size(0), pos(NULL), block_end(NULL) { }
+
+void chained_buffer_t::append(const char *data, size_t size) {
+    while (size > 0) {
+        if (pos == block_end) {
+            next_block();
+        }
+        const size_t chunk = std::min(size, static_cast<size_t>(block_end - pos));
+        memcpy(pos, data, chunk);
+        pos += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+size_t chained_buffer_t::size() const {
+    if (used_blocks == 0) {
+        return 0;
+    }
+    return full_blocks_size + (pos - blocks[used_blocks - 1].data());
+}
+
+void chained_buffer_t::truncate(size_t new_size) {
+    guarantee(new_size <= size());
+    used_blocks = 0;
+    full_blocks_size = 0;
+    pos = NULL;
+    block_end = NULL;
+    while (new_size > 0) {
+        char *block = blocks[used_blocks].data();
+        const size_t block_size = blocks[used_blocks].size();
+        ++used_blocks;
+        block_end = block + block_size;
+        if (new_size <= block_size) {
+            pos = block + new_size;
+            break;
+        }
+        full_blocks_size += block_size;
+        new_size -= block_size;
+    }
+}
+
+void chained_buffer_t::append_iovecs(std::vector<iovec> *out) const {
+    for (size_t i = 0; i < used_blocks; ++i) {
+        iovec iov;
+        iov.iov_base = blocks[i].data();
+        iov.iov_len = i + 1 < used_blocks
+            ? blocks[i].size()
+            : static_cast<size_t>(pos - blocks[i].data());
+        if (iov.iov_len > 0) {
+            out->push_back(iov);
+        }
+    }
+}
+
+void chained_buffer_t::append_to_string(std::string *out) const {
+    std::vector<iovec> iovs;
+    append_iovecs(&iovs);
+    out->reserve(out->size() + size());
+    for (const auto &iov : iovs) {
+        out->append(static_cast<const char *>(iov.iov_base), iov.iov_len);
+    }
+}
+
+void chained_buffer_t::next_block() {
+    if (used_blocks > 0) {
+        full_blocks_size += blocks[used_blocks - 1].size();
+    }
+    if (used_blocks == blocks.size()) {
+        const size_t block_size = blocks.empty()
+            ? min_block_size
+            : std::min(max_block_size, 2 * blocks.back().size());
+        blocks.push_back(scoped_array_t<char>(block_size));
+    }
+    pos = blocks[used_blocks].data();
+    block_end = pos + blocks[used_blocks].size();
+    ++used_blocks;
+}
@@ -0,0 +1,64 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_CHAINED_BUFFER_HPP_
+#define CONTAINERS_CHAINED_BUFFER_HPP_
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "errors.hpp"
+
+// An append-only output buffer made of a chain of blocks.  Unlike a
+// `rapidjson::StringBuffer` it never reallocates and copies what has already been
+// written when it grows, and its contents can be handed to `writev` block by block
+// as they are.  Blocks start small and double up to `max_block_size`, so small
+// outputs stay cheap.  Blocks are kept by `truncate` and reused.
+//
+// It can be used as a rapidjson output stream.
+class chained_buffer_t {
+public:
+    typedef char Ch;  // For rapidjson
+
+    static const size_t min_block_size;
+    static const size_t max_block_size;
+
+    chained_buffer_t();
+
+    void Put(char c) {
+        if (pos == block_end) {
+            next_block();
+        }
+        *pos++ = c;
+    }
+    void Flush() { }
+
+    void append(const char *data, size_t size);
+
+    size_t size() const;
+
+    // Drops everything after the first `new_size` bytes.
+    void truncate(size_t new_size);
+
+    // Appends one iovec per non-empty block to `out`.  They point into this
+    // buffer, so they are only valid until it's next modified.
+    void append_iovecs(std::vector<iovec> *out) const;
+
+    void append_to_string(std::string *out) const;
+
+private:
+    void next_block();
+
+    std::vector<scoped_array_t<char> > blocks;
+    // The number of blocks that hold data; the rest are waiting to be reused.
+    size_t used_blocks;
+    // The total size of the used blocks before the last one.
+    size_t full_blocks_size;
+    char *pos;
+    char *block_end;
+
+    DISABLE_COPYING(chained_buffer_t);
+};
+
+#endif  // CONTAINERS_CHAINED_BUFFER_HPP_
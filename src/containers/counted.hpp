@@ -290,6 +290,10 @@ public:
     template <class... Args>
     explicit countable_wrapper_t(Args &&... args)
         : T(std::forward<Args>(args)...) { }
+
+    // Datum arrays and objects are these, and we make lots of them.
+    static void *operator new(size_t size) { return slab_malloc(size); }
+    static void operator delete(void *ptr) { slab_free(ptr); }
 };
 
 #endif  // CONTAINERS_COUNTED_HPP_
@@ -81,6 +81,10 @@ public:
             return cache_list_.end();
         }
     }
+    void erase(iterator it) {
+        cache_map_.erase(it->first);
+        cache_list_.erase(it);
+    }
 private:
     V &insert(const K &key) {
         cache_list_.push_front(std::make_pair(key, V()));
@@ -6,6 +6,7 @@
 
 #include <utility>
 
+#include "arch/runtime/slab_allocator.hpp"
 #include "errors.hpp"
 #include "utils.hpp"
 
@@ -222,7 +223,8 @@ private:
     DISABLE_COPYING(scoped_array_t);
 };
 
-// For dumb structs that get rmalloc/free for allocation.
+// For dumb structs that get rmalloc/free for allocation.  The memory may also come
+// from slab_malloc (see arch/runtime/slab_allocator.hpp).
 
 template <class T>
 class scoped_malloc_t {
@@ -254,7 +256,7 @@ public:
     }
 
     ~scoped_malloc_t() {
-        free(ptr_);
+        slab_free(ptr_);
     }
 
     void operator=(scoped_malloc_t &&movee) noexcept {
@@ -3,12 +3,13 @@
 
 #include <stdlib.h>
 
+#include "arch/runtime/slab_allocator.hpp"
 #include "utils.hpp"
 
 counted_t<shared_buf_t> shared_buf_t::create(size_t size) {
     // This allocates size bytes for the data_ field (which is declared as char[1])
     size_t memory_size = sizeof(shared_buf_t) + size - 1;
-    void *raw_result = ::rmalloc(memory_size);
+    void *raw_result = slab_malloc(memory_size);
     shared_buf_t *result = static_cast<shared_buf_t *>(raw_result);
     result->refcount_ = 0;
     result->size_ = size;
@@ -16,7 +17,7 @@ counted_t<shared_buf_t> shared_buf_t::create(size_t size) {
 }
 
 void shared_buf_t::operator delete(void *p) {
-    ::free(p);
+    slab_free(p);
 }
 
 char *shared_buf_t::data(size_t offset) {
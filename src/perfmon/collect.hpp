@@ -10,4 +10,7 @@
  */
 ql::datum_t perfmon_get_stats();
 
+/* Does the same for a `perfmon_t` that isn't in the global collection. */
+ql::datum_t perfmon_get_stats(perfmon_t *perfmon);
+
 #endif  // PERFMON_COLLECT_HPP_
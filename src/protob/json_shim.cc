@@ -2,215 +2,265 @@
 
 #include <inttypes.h>
 
+#include <utility>
+#include <vector>
+
 #include "debug.hpp"
-#include "rapidjson/document.h"
-#include "rapidjson/stringbuffer.h"
-#include "rapidjson/writer.h"
+#include "rapidjson/reader.h"
 #include "rdb_protocol/ql2.pb.h"
 #include "utils.hpp"
 
-using rapidjson::Value;
-using rapidjson::StringBuffer;
-using rapidjson::Document;
-using rapidjson::Writer;
-
 namespace json_shim {
 
-class exc_t : public std::exception {
+// Builds a `Query` straight from the parser's events, so we never build a rapidjson
+// DOM.  The result is exactly what converting the DOM would have produced from the
+// same JSON (the unit tests check it against that, in `unittest/json_shim_dom.hpp`).
+// Each open array or object has a frame on `frames` that says what its elements
+// turn into.
+class query_builder_t
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, query_builder_t> {
 public:
-    exc_t() { }
-    ~exc_t() throw () { }
-    const char *what() const throw () { return "json_shim::exc_t"; }
-};
+    explicit query_builder_t(Query *_query) : query(_query) { }
 
-// The first value is != nullptr if this is a key/value pair from an object.
-// In that case it is the key and the second value the value.
-template<class T>
-typename std::enable_if<!((std::is_enum<T>::value || std::is_fundamental<T>::value)
-                          && !std::is_same<T, bool>::value)>::type
-extract(const Value *, const Value &, T *);
-
-template<class T>
-typename std::enable_if<(std::is_enum<T>::value || std::is_fundamental<T>::value)
-                        && !std::is_same<T, bool>::value>::type
-extract(const Value *, const Value &field, T *dest) {
-    if (!field.IsNumber()) {
-        throw exc_t();
+    bool Null() {
+        return scalar([](Datum *d) { d->set_type(Datum::R_NULL); });
     }
-    T t = static_cast<T>(field.GetDouble());
-    if (static_cast<double>(t) != field.GetDouble()) {
-        throw exc_t();
+    bool Bool(bool b) {
+        return scalar([b](Datum *d) {
+            d->set_type(Datum::R_BOOL);
+            d->set_r_bool(b);
+        });
     }
-    *dest = t;
-}
-
-template<class T>
-void safe_extract(const Value *key, const Value &val, T *t) {
-    if (t != nullptr) {
-        extract(key, val, t);
+    bool Int(int i) { return number(static_cast<double>(i)); }
+    bool Uint(unsigned u) { return number(static_cast<double>(u)); }
+    bool Int64(int64_t i) { return number(static_cast<double>(i)); }
+    bool Uint64(uint64_t u) { return number(static_cast<double>(u)); }
+    bool Double(double d) { return number(d); }
+    bool String(const char *str, rapidjson::SizeType length, bool) {
+        return scalar([str, length](Datum *d) {
+            d->set_type(Datum::R_STR);
+            d->set_r_str(str, length);
+        });
     }
-}
 
-template<class T, class U>
-void transfer(const Value &json, T *dest, void (T::*setter)(U)) {
-    U tmp;
-    safe_extract(nullptr, json, &tmp);
-    (dest->*setter)(std::move(tmp));
-}
-
-template<class T, class U>
-void transfer(const Value &json, T *dest, U *(T::*mut)()) {
-    safe_extract(nullptr, json, (dest->*mut)());
-}
-
-template<class T, class U>
-void transfer_arr(const Value &arr, T *dest, U *(T::*adder)()) {
-    if (arr.IsArray()) {
-        for (Value::ConstValueIterator it = arr.Begin(); it != arr.End(); ++it) {
-            safe_extract(nullptr, *it, (dest->*adder)());
+    bool StartObject() {
+        slot_t slot = next_slot();
+        switch (slot.type) {
+        case slot_type_t::TERM:
+            slot.term->set_type(Term::MAKE_OBJ);
+            frames.push_back(frame_t(frame_type_t::OPTARGS, slot.term, nullptr));
+            return true;
+        case slot_type_t::ARGS:
+            frames.push_back(frame_t(frame_type_t::ARGS, slot.term, nullptr));
+            return true;
+        case slot_type_t::OPTARGS:
+            frames.push_back(frame_t(frame_type_t::OPTARGS, slot.term, slot.query));
+            return true;
+        case slot_type_t::SKIP:
+            frames.push_back(frame_t(frame_type_t::SKIP, nullptr, nullptr));
+            return true;
+        case slot_type_t::QUERY: // fallthru
+        case slot_type_t::QUERY_TYPE: // fallthru
+        case slot_type_t::TERM_TYPE: // fallthru
+        case slot_type_t::INVALID:
+            return false;
+        default:
+            unreachable();
         }
-    } else if (arr.IsObject()) {
-        for (Value::ConstMemberIterator it = arr.MemberBegin();
-             it != arr.MemberEnd();
-             ++it) {
-            safe_extract(&it->name, it->value, (dest->*adder)());
+    }
+    bool Key(const char *str, rapidjson::SizeType length, bool) {
+        frame_t *frame = &frames.back();
+        if (frame->type == frame_type_t::OPTARGS) {
+            if (frame->term != nullptr) {
+                Term::AssocPair *ap = frame->term->add_optargs();
+                ap->set_key(str, length);
+                frame->pending = ap->mutable_val();
+            } else {
+                Query::AssocPair *ap = frame->query->add_global_optargs();
+                ap->set_key(str, length);
+                frame->pending = ap->mutable_val();
+            }
         }
-    } else {
-        throw exc_t();
+        // The keys of objects used as argument lists are ignored.
+        return true;
     }
-}
-
-template<>
-void extract(const Value *, const Value &field, std::string *s) {
-    if (!field.IsString()) {
-        throw exc_t();
-    } else {
-        *s = std::string(field.GetString(), field.GetStringLength());
+    bool EndObject(rapidjson::SizeType) {
+        frames.pop_back();
+        return true;
     }
-}
 
-template<>
-void extract(const Value *, const Value &field, bool *dest) {
-    if (!field.IsBool()) {
-        throw exc_t();
-    } else {
-        *dest = field.GetBool();
+    bool StartArray() {
+        slot_t slot = next_slot();
+        switch (slot.type) {
+        case slot_type_t::QUERY:
+            query->set_accepts_r_json(true);
+            frames.push_back(frame_t(frame_type_t::QUERY, nullptr, query));
+            return true;
+        case slot_type_t::TERM:
+            frames.push_back(frame_t(frame_type_t::TERM, slot.term, nullptr));
+            return true;
+        case slot_type_t::ARGS:
+            frames.push_back(frame_t(frame_type_t::ARGS, slot.term, nullptr));
+            return true;
+        case slot_type_t::OPTARGS:
+            // Optional arguments can't be given as an array, unless it's empty.
+            frames.push_back(frame_t(frame_type_t::EMPTY, nullptr, nullptr));
+            return true;
+        case slot_type_t::SKIP:
+            frames.push_back(frame_t(frame_type_t::SKIP, nullptr, nullptr));
+            return true;
+        case slot_type_t::QUERY_TYPE: // fallthru
+        case slot_type_t::TERM_TYPE: // fallthru
+        case slot_type_t::INVALID:
+            return false;
+        default:
+            unreachable();
+        }
     }
-}
+    bool EndArray(rapidjson::SizeType) {
+        frames.pop_back();
+        return true;
+    }
+
+private:
+    enum class frame_type_t { QUERY, TERM, ARGS, OPTARGS, EMPTY, SKIP };
+    struct frame_t {
+        frame_t(frame_type_t _type, Term *_term, Query *_query)
+            : type(_type), index(0), term(_term), query(_query), pending(nullptr) { }
+        frame_type_t type;
+        size_t index;
+        Term *term;
+        Query *query;
+        // For `OPTARGS`, where the value of the last key goes.
+        Term *pending;
+    };
 
-template<>
-void extract(const Value *, const Value &json, Term *t) {
-    if (json.IsArray()) {
-        if (json.Size() > 0) {
-            transfer(json[0], t, &Term::set_type);
+    // What the next value turns into.
+    enum class slot_type_t { QUERY, QUERY_TYPE, TERM, TERM_TYPE, ARGS, OPTARGS,
+                             SKIP, INVALID };
+    struct slot_t {
+        slot_t(slot_type_t _type, Term *_term, Query *_query)
+            : type(_type), term(_term), query(_query) { }
+        slot_type_t type;
+        Term *term;
+        Query *query;
+    };
+
+    slot_t next_slot() {
+        if (frames.empty()) {
+            return slot_t(slot_type_t::QUERY, nullptr, nullptr);
         }
-        if (json.Size() > 1) {
-            transfer_arr(json[1], t, &Term::add_args);
+        frame_t *frame = &frames.back();
+        switch (frame->type) {
+        case frame_type_t::QUERY:
+            switch (frame->index++) {
+            case 0: return slot_t(slot_type_t::QUERY_TYPE, nullptr, nullptr);
+            case 1: return slot_t(slot_type_t::TERM, query->mutable_query(), nullptr);
+            case 2: return slot_t(slot_type_t::OPTARGS, nullptr, query);
+            default: return slot_t(slot_type_t::SKIP, nullptr, nullptr);
+            }
+        case frame_type_t::TERM:
+            switch (frame->index++) {
+            case 0: return slot_t(slot_type_t::TERM_TYPE, frame->term, nullptr);
+            case 1: return slot_t(slot_type_t::ARGS, frame->term, nullptr);
+            case 2: return slot_t(slot_type_t::OPTARGS, frame->term, nullptr);
+            default: return slot_t(slot_type_t::SKIP, nullptr, nullptr);
+            }
+        case frame_type_t::ARGS:
+            return slot_t(slot_type_t::TERM, frame->term->add_args(), nullptr);
+        case frame_type_t::OPTARGS:
+            guarantee(frame->pending != nullptr);
+            return slot_t(slot_type_t::TERM, frame->pending, nullptr);
+        case frame_type_t::EMPTY:
+            return slot_t(slot_type_t::INVALID, nullptr, nullptr);
+        case frame_type_t::SKIP:
+            return slot_t(slot_type_t::SKIP, nullptr, nullptr);
+        default:
+            unreachable();
         }
-        if (json.Size() > 2) {
-            transfer_arr(json[2], t, &Term::add_optargs);
+    }
+
+    // Checks that `d` is integral, like the DOM-based parser does for enums.
+    template <class T>
+    static bool to_enum(double d, T *out) {
+        T t = static_cast<T>(d);
+        if (static_cast<double>(t) != d) {
+            return false;
         }
-    } else if (json.IsObject()) {
-        t->set_type(Term::MAKE_OBJ);
-        transfer_arr(json, t, &Term::add_optargs);
-    } else {
-        t->set_type(Term::DATUM);
-        transfer(json, t, &Term::mutable_datum);
+        *out = t;
+        return true;
     }
-}
 
-template<>
-void extract(const Value *, const Value &json, Datum *d) {
-    switch(json.GetType()) {
-    case rapidjson::kNullType:
-        d->set_type(Datum::R_NULL);
-        break;
-    case rapidjson::kFalseType: // fallthru
-    case rapidjson::kTrueType:
-        d->set_type(Datum::R_BOOL);
-        d->set_r_bool(json.GetBool());
-        break;
-    case rapidjson::kObjectType:
-        d->set_type(Datum::R_OBJECT);
-        for (Value::ConstMemberIterator it = json.MemberBegin();
-             it != json.MemberEnd();
-             ++it) {
-            Datum::AssocPair *ap = d->add_r_object();
-            ap->set_key(it->name.GetString(), it->name.GetStringLength());
-            extract(nullptr, it->value, ap->mutable_val());
+    bool number(double d) {
+        slot_t slot = next_slot();
+        switch (slot.type) {
+        case slot_type_t::QUERY_TYPE: {
+            Query::QueryType type;
+            if (!to_enum(d, &type)) return false;
+            query->set_type(type);
+            return true;
+        }
+        case slot_type_t::TERM_TYPE: {
+            Term::TermType type;
+            if (!to_enum(d, &type)) return false;
+            slot.term->set_type(type);
+            return true;
         }
-        break;
-    case rapidjson::kArrayType:
-        d->set_type(Datum::R_ARRAY);
-        for (Value::ConstValueIterator it = json.Begin(); it != json.End(); ++it) {
-            extract(nullptr, *it, d->add_r_array());
+        case slot_type_t::QUERY: // fallthru
+        case slot_type_t::TERM: // fallthru
+        case slot_type_t::ARGS: // fallthru
+        case slot_type_t::OPTARGS: // fallthru
+        case slot_type_t::SKIP: // fallthru
+        case slot_type_t::INVALID:
+            return scalar_in_slot(slot, [d](Datum *datum) {
+                datum->set_type(Datum::R_NUM);
+                datum->set_r_num(d);
+            });
+        default:
+            unreachable();
         }
-        break;
-    case rapidjson::kStringType:
-        d->set_type(Datum::R_STR);
-        d->set_r_str(json.GetString(), json.GetStringLength());
-        break;
-    case rapidjson::kNumberType:
-        d->set_type(Datum::R_NUM);
-        d->set_r_num(json.GetDouble());
-        break;
-    default:
-        unreachable();
     }
-}
-
-template<>
-void extract(const Value *key, const Value &val, Query::AssocPair *ap) {
-    if (key == nullptr || !key->IsString()) throw exc_t();
-    ap->set_key(key->GetString(), key->GetStringLength());
-    extract(nullptr, val, ap->mutable_val());
-}
-
-template<>
-void extract(const Value *key, const Value &val, Term::AssocPair *ap) {
-    if (key == nullptr || !key->IsString()) throw exc_t();
-    ap->set_key(key->GetString(), key->GetStringLength());
-    extract(nullptr, val, ap->mutable_val());
-}
-
-template<>
-void extract(const Value *key, const Value &val, Datum::AssocPair *ap) {
-    if (key == nullptr || !key->IsString()) throw exc_t();
-    ap->set_key(key->GetString(), key->GetStringLength());
-    extract(nullptr, val, ap->mutable_val());
-}
 
-template<>
-void extract(const Value *, const Value &json, Query *q) {
-    if (!json.IsArray()) throw exc_t();
-    if (json.Size() > 0) {
-        transfer(json[0], q, &Query::set_type);
+    template <class callable_t>
+    bool scalar(callable_t &&fill_datum) {
+        return scalar_in_slot(next_slot(), std::forward<callable_t>(fill_datum));
     }
-    if (json.Size() > 1) {
-        transfer(json[1], q, &Query::mutable_query);
-    }
-    q->set_accepts_r_json(true);
-    if (json.Size() > 2) {
-        transfer_arr(json[2], q, &Query::add_global_optargs);
+
+    template <class callable_t>
+    bool scalar_in_slot(const slot_t &slot, callable_t &&fill_datum) {
+        switch (slot.type) {
+        case slot_type_t::TERM:
+            slot.term->set_type(Term::DATUM);
+            fill_datum(slot.term->mutable_datum());
+            return true;
+        case slot_type_t::SKIP:
+            return true;
+        case slot_type_t::QUERY: // fallthru
+        case slot_type_t::QUERY_TYPE: // fallthru
+        case slot_type_t::TERM_TYPE: // fallthru
+        case slot_type_t::ARGS: // fallthru
+        case slot_type_t::OPTARGS: // fallthru
+        case slot_type_t::INVALID:
+            return false;
+        default:
+            unreachable();
+        }
     }
-}
+
+    Query *query;
+    std::vector<frame_t> frames;
+};
 
 bool parse_json_pb(Query *q, int64_t token, char *str) THROWS_NOTHING {
     try {
         q->Clear();
         q->set_token(token);
-        Document json;
-        json.ParseInsitu(str);
+        query_builder_t builder(q);
+        rapidjson::InsituStringStream stream(str);
+        rapidjson::Reader reader;
         // TODO: We should return not just `false`, but the error message
-        if (json.HasParseError()) {
-            return false;
-        }
-        extract(nullptr, json, q);
-        return true;
-    } catch (const exc_t &) {
-        // This happens if the user provides bad JSON.  TODO: Give the user a
-        // more specific error than "malformed query".
-        return false;
+        return !reader.Parse<rapidjson::kParseDefaultFlags | rapidjson::kParseInsituFlag>(
+            stream, builder).IsError();
     } catch (const google::protobuf::FatalException &) {
         return false;
     } catch (...) {
@@ -226,83 +276,4 @@ bool parse_json_pb(Query *q, int64_t token, char *str) THROWS_NOTHING {
     }
 }
 
-void write_json_pb(const Response &r, StringBuffer *s) THROWS_NOTHING {
-    // Note: We must keep any existing prefix in `s` intact.
-#ifdef NDEBUG
-    const size_t start_offset = s->GetSize();
-#endif
-    Writer<StringBuffer> writer(*s);
-    try {
-        writer.StartObject();
-        writer.Key("t", 1);
-        writer.Int(r.type());
-        writer.Key("r", 1);
-        writer.StartArray();
-        for (int i = 0; i < r.response_size(); ++i) {
-            const Datum *d = &r.response(i);
-            if (d->type() == Datum::R_JSON) {
-                // Just put the raw JSON onto the buffer
-                writer.RawJson(d->r_str());
-            } else if (d->type() == Datum::R_STR) {
-                writer.String(d->r_str());
-            } else {
-                unreachable();
-            }
-        }
-        writer.EndArray();
-
-        writer.Key("n", 1);
-        writer.StartArray();
-        for (int i = 0; i < r.notes_size(); ++i) {
-            writer.Int(r.notes(i));
-        }
-        writer.EndArray();
-
-        if (r.has_backtrace()) {
-            writer.Key("b", 1);
-            writer.StartArray();
-            const Backtrace *bt = &r.backtrace();
-            for (int i = 0; i < bt->frames_size(); ++i) {
-                const Frame *f = &bt->frames(i);
-                switch (f->type()) {
-                case Frame::POS:
-                    writer.Uint(f->pos());
-                    break;
-                case Frame::OPT:
-                    writer.String(f->opt());
-                    break;
-                default:
-                    unreachable();
-                }
-            }
-            writer.EndArray();
-        }
-
-        if (r.has_profile()) {
-            writer.Key("p", 1);
-            const Datum *d = &r.profile();
-            guarantee(d->type() == Datum::R_JSON);
-            writer.RawJson(d->r_str());
-        }
-
-        writer.EndObject();
-    } catch (...) {
-#ifndef NDEBUG
-        throw;
-#else
-        // Reset s to it's original state, then write an error response.
-        s->Pop(s->GetSize() - start_offset);
-        writer.StartObject();
-        writer.Key("t", 1);
-        writer.Int(Response::RUNTIME_ERROR);
-        writer.Key("r", 1);
-        writer.StartArray();
-        writer.String("Internal error in `write_json_pb`, please report this.");
-        writer.EndArray();
-        writer.EndObject();
-#endif // NDEBUG
-    }
-}
-
-
 } // namespace json_shim
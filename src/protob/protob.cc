@@ -15,14 +15,18 @@
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "concurrency/queue/limited_fifo.hpp"
 #include "containers/auth_key.hpp"
 #include "perfmon/perfmon.hpp"
 #include "protob/json_shim.hpp"
-#include "rapidjson/stringbuffer.h"
+#include "protob/query_threads.hpp"
 #include "rdb_protocol/backtrace.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/response.hpp"
 #include "rpc/semilattice/view.hpp"
+#include "rpc/semilattice/watchable.hpp"
 #include "utils.hpp"
 
 #include "rdb_protocol/ql2.pb.h"
@@ -148,87 +152,140 @@ std::string too_large_response_message(size_t size) {
                      size, TOO_LARGE_RESPONSE_SIZE - 1);
 }
 
+// Reads a query in the JSON format, which the JSON and binary protocols share.
+// `protocol_t` is the protocol to send error responses with.
+template <class protocol_t>
+bool parse_json_query(tcp_conn_t *conn,
+                      signal_t *interruptor,
+                      query_handler_t *handler,
+                      ql::protob_t<Query> *query_out) {
+    int64_t token;
+    uint32_t size;
+    conn->read(&token, sizeof(token), interruptor);
+    conn->read(&size, sizeof(size), interruptor);
+
+    if (size >= TOO_LARGE_QUERY_SIZE) {
+        ql::response_t error_response(protocol_t::response_format);
+        error_response.set_token(token);
+        ql::fill_error(&error_response, Response::CLIENT_ERROR,
+                       too_large_query_message(size),
+                       ql::backtrace_registry_t::EMPTY_BACKTRACE);
+        protocol_t::send_response(&error_response, handler, conn, interruptor);
+        throw tcp_conn_read_closed_exc_t();
+    } else {
+        scoped_array_t<char> data(size + 1);
+        conn->read(data.data(), size, interruptor);
+        data[size] = 0; // Null terminate the string, which the json parser requires
+
+        if (!json_shim::parse_json_pb(query_out->get(),
+                                      token,
+                                      data.data())) {
+            ql::response_t error_response(protocol_t::response_format);
+            error_response.set_token(token);
+            ql::fill_error(&error_response, Response::CLIENT_ERROR,
+                           unparseable_query_message,
+                           ql::backtrace_registry_t::EMPTY_BACKTRACE);
+            protocol_t::send_response(&error_response, handler, conn, interruptor);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends a response of `data_size` bytes, which `iovs` point to, preceded by the
+// token and the size.  The first element of `iovs` is left for those.  They go in
+// a buffer of their own, so the data can be sent straight from the blocks they
+// were serialized into.
+void send_with_token_and_size(int64_t token,
+                              size_t data_size,
+                              std::vector<iovec> *iovs,
+                              tcp_conn_t *conn,
+                              signal_t *interruptor) {
+    guarantee(data_size < TOO_LARGE_RESPONSE_SIZE);
+    const uint32_t data_size32 = static_cast<uint32_t>(data_size);
+    char prefix[sizeof(token) + sizeof(data_size32)];
+    memcpy(&prefix[0], &token, sizeof(token));
+    memcpy(&prefix[sizeof(token)], &data_size32, sizeof(data_size32));
+
+    guarantee(!iovs->empty());
+    (*iovs)[0].iov_base = prefix;
+    (*iovs)[0].iov_len = sizeof(prefix);
+    conn->writev(iovs->data(), iovs->size(), interruptor);
+}
+
 class json_protocol_t {
 public:
+    static const ql::response_format_t response_format = ql::response_format_t::JSON;
+
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
                             ql::protob_t<Query> *query_out) {
-        int64_t token;
-        uint32_t size;
-        conn->read(&token, sizeof(token), interruptor);
-        conn->read(&size, sizeof(size), interruptor);
+        return parse_json_query<json_protocol_t>(conn, interruptor, handler, query_out);
+    }
 
-        if (size >= TOO_LARGE_QUERY_SIZE) {
-            Response error_response;
+    static void send_response(ql::response_t *response,
+                              query_handler_t *handler,
+                              tcp_conn_t *conn,
+                              signal_t *interruptor) {
+        const int64_t token = response->token();
+        const chained_buffer_t &data = response->finish_json();
+
+        if (data.size() >= TOO_LARGE_RESPONSE_SIZE) {
+            ql::response_t error_response(response_format);
             error_response.set_token(token);
-            ql::fill_error(&error_response, Response::CLIENT_ERROR,
-                           too_large_query_message(size),
+            ql::fill_error(&error_response, Response::RUNTIME_ERROR,
+                           too_large_response_message(data.size()),
                            ql::backtrace_registry_t::EMPTY_BACKTRACE);
-            send_response(error_response, handler, conn, interruptor);
-            throw tcp_conn_read_closed_exc_t();
-        } else {
-            scoped_array_t<char> data(size + 1);
-            conn->read(data.data(), size, interruptor);
-            data[size] = 0; // Null terminate the string, which the json parser requires
-
-            if (!json_shim::parse_json_pb(query_out->get(),
-                                          token,
-                                          data.data())) {
-                Response error_response;
-                error_response.set_token(token);
-                ql::fill_error(&error_response, Response::CLIENT_ERROR,
-                               unparseable_query_message,
-                               ql::backtrace_registry_t::EMPTY_BACKTRACE);
-                send_response(error_response, handler, conn, interruptor);
-                return false;
-            }
+            send_response(&error_response, handler, conn, interruptor);
+            return;
         }
-        return true;
+
+        std::vector<iovec> iovs(1);
+        data.append_iovecs(&iovs);
+        send_with_token_and_size(token, data.size(), &iovs, conn, interruptor);
     }
+};
 
-    static void send_response(const Response &response,
+// Like the JSON protocol, but the data in responses are in the binary datum
+// format.
+class binary_protocol_t {
+public:
+    static const ql::response_format_t response_format = ql::response_format_t::BINARY;
+
+    static bool parse_query(tcp_conn_t *conn,
+                            signal_t *interruptor,
+                            query_handler_t *handler,
+                            ql::protob_t<Query> *query_out) {
+        return parse_json_query<binary_protocol_t>(conn, interruptor, handler, query_out);
+    }
+
+    static void send_response(ql::response_t *response,
                               query_handler_t *handler,
                               tcp_conn_t *conn,
                               signal_t *interruptor) {
-        const int64_t token = response.token();
+        const int64_t token = response->token();
+        std::vector<iovec> iovs(1);
+        const size_t data_size = response->finish_binary(&iovs);
 
-        uint32_t data_size; // filled in below
-        const size_t prefix_size = sizeof(token) + sizeof(data_size);
-        // Reserve space for the token and the size
-        rapidjson::StringBuffer str;
-        str.Push(prefix_size);
-
-        json_shim::write_json_pb(response, &str);
-        guarantee(str.GetSize() >= prefix_size);
-
-        if (str.GetSize() - prefix_size >= TOO_LARGE_RESPONSE_SIZE) {
-            Response error_response;
-            error_response.set_token(response.token());
+        if (data_size >= TOO_LARGE_RESPONSE_SIZE) {
+            ql::response_t error_response(response_format);
+            error_response.set_token(token);
             ql::fill_error(&error_response, Response::RUNTIME_ERROR,
-                           too_large_response_message(str.GetSize() - prefix_size),
+                           too_large_response_message(data_size),
                            ql::backtrace_registry_t::EMPTY_BACKTRACE);
-            send_response(error_response, handler, conn, interruptor);
+            send_response(&error_response, handler, conn, interruptor);
             return;
         }
 
-        data_size = static_cast<uint32_t>(str.GetSize() - prefix_size);
-
-        // Fill in the prefix.
-        char *mutable_str = str.GetMutableBuffer();
-        for (size_t i = 0; i < sizeof(token); ++i) {
-            mutable_str[i] = reinterpret_cast<const char *>(&token)[i];
-        }
-        for (size_t i = 0; i < sizeof(data_size); ++i) {
-            mutable_str[i + sizeof(token)] = reinterpret_cast<const char *>(&data_size)[i];
-        }
-
-        conn->write(str.GetString(), str.GetSize(), interruptor);
+        send_with_token_and_size(token, data_size, &iovs, conn, interruptor);
     }
 };
 
 class protobuf_protocol_t {
 public:
+    static const ql::response_format_t response_format = ql::response_format_t::PROTOBUF;
+
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
@@ -237,50 +294,51 @@ public:
         conn->read(&size, sizeof(size), interruptor);
 
         if (size >= TOO_LARGE_QUERY_SIZE) {
-            Response error_response;
+            ql::response_t error_response(response_format);
             error_response.set_token(0); // We don't actually know the token
             ql::fill_error(&error_response, Response::CLIENT_ERROR,
                            too_large_query_message(size),
                            ql::backtrace_registry_t::EMPTY_BACKTRACE);
-            send_response(error_response, handler, conn, interruptor);
+            send_response(&error_response, handler, conn, interruptor);
             return false;
         } else {
             scoped_array_t<char> data(size);
             conn->read(data.data(), size, interruptor);
 
             if (!query_out->get()->ParseFromArray(data.data(), size)) {
-                Response error_response;
+                ql::response_t error_response(response_format);
                 error_response.set_token(query_out->get()->has_token() ?
                                          query_out->get()->token() : 0);
                 ql::fill_error(&error_response, Response::CLIENT_ERROR,
                                unparseable_query_message,
                                ql::backtrace_registry_t::EMPTY_BACKTRACE);
-                send_response(error_response, handler, conn, interruptor);
+                send_response(&error_response, handler, conn, interruptor);
                 return false;
             }
         }
         return true;
     }
 
-    static void send_response(const Response &response,
+    static void send_response(ql::response_t *response,
                               query_handler_t *handler,
                               tcp_conn_t *conn,
                               signal_t *interruptor) {
-        const uint32_t data_size = static_cast<uint32_t>(response.ByteSize());
+        const Response &pb = response->protobuf();
+        const uint32_t data_size = static_cast<uint32_t>(pb.ByteSize());
         if (data_size >= TOO_LARGE_RESPONSE_SIZE) {
-            Response error_response;
-            error_response.set_token(response.token());
+            ql::response_t error_response(response_format);
+            error_response.set_token(pb.token());
             ql::fill_error(&error_response, Response::RUNTIME_ERROR,
                            too_large_response_message(data_size),
                            ql::backtrace_registry_t::EMPTY_BACKTRACE);
-            send_response(error_response, handler, conn, interruptor);
+            send_response(&error_response, handler, conn, interruptor);
         } else {
             const size_t prefix_size = sizeof(data_size);
             const size_t total_size = prefix_size + data_size;
 
             scoped_array_t<char> scoped_array(total_size);
             memcpy(scoped_array.data(), &data_size, sizeof(data_size));
-            response.SerializeToArray(scoped_array.data() + prefix_size, data_size);
+            pb.SerializeToArray(scoped_array.data() + prefix_size, data_size);
 
             conn->write(scoped_array.data(), total_size, interruptor);
         }
@@ -290,6 +348,7 @@ public:
 query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
                                const std::set<ip_address_t> &local_addresses,
                                int port,
+                               bool reuse_port,
                                query_handler_t *_handler,
                                uint32_t http_timeout_sec) :
         rdb_ctx(_rdb_ctx),
@@ -297,10 +356,33 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
         http_conn_cache(http_timeout_sec),
         next_thread(0) {
     rassert(rdb_ctx != NULL);
+    if (reuse_port && !tcp_reuseport_listener_t::is_supported()) {
+        logWRN("SO_REUSEPORT is not supported on this platform, so client driver "
+               "connections will be accepted on a single thread.");
+        reuse_port = false;
+    }
     try {
-        tcp_listener.init(new tcp_listener_t(local_addresses, port,
-            std::bind(&query_server_t::handle_conn,
-                      this, ph::_1, auto_drainer_t::lock_t(&drainer))));
+        if (reuse_port) {
+            // Each thread needs its own view of the auth key, since that's
+            // checked before the connection's first query.
+            thread_auth_metadata.init(get_num_db_threads());
+            for (int i = 0; i < get_num_db_threads(); ++i) {
+                thread_auth_metadata[i].init(
+                    new cross_thread_watchable_variable_t<auth_semilattice_metadata_t>(
+                        clone_ptr_t<semilattice_watchable_t<auth_semilattice_metadata_t> >(
+                            new semilattice_watchable_t<auth_semilattice_metadata_t>(
+                                rdb_ctx->auth_metadata)),
+                        threadnum_t(i)));
+            }
+            thread_drainers.init(new one_per_thread_t<auto_drainer_t>());
+            reuseport_listener.init(new tcp_reuseport_listener_t(
+                local_addresses, port, get_num_db_threads(),
+                std::bind(&query_server_t::handle_thread_conn, this, ph::_1)));
+        } else {
+            tcp_listener.init(new tcp_listener_t(local_addresses, port,
+                std::bind(&query_server_t::handle_conn,
+                          this, ph::_1, auto_drainer_t::lock_t(&drainer))));
+        }
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(
             strprintf("Could not bind to RDB protocol port: %s", ex.what()));
@@ -310,7 +392,9 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
 query_server_t::~query_server_t() { }
 
 int query_server_t::get_port() const {
-    return tcp_listener->get_port();
+    return reuseport_listener.has()
+        ? reuseport_listener->get_port()
+        : tcp_listener->get_port();
 }
 
 std::string query_server_t::read_sized_string(tcp_conn_t *conn,
@@ -356,6 +440,24 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
 
+    serve_conn(nconn, auth_key, &ct_keepalive);
+}
+
+void query_server_t::handle_thread_conn(
+        const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    auto_drainer_t::lock_t keepalive(thread_drainers->get());
+    auth_key_t auth_key;
+    thread_auth_metadata[get_thread_id().threadnum]->apply_read(
+        [&](const auth_semilattice_metadata_t *metadata) {
+            auth_key = metadata->auth_key.get_ref();
+        });
+
+    serve_conn(nconn, auth_key, keepalive.get_drain_signal());
+}
+
+void query_server_t::serve_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                                const auth_key_t &auth_key,
+                                signal_t *interruptor) {
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
     conn->enable_keepalive();
@@ -367,7 +469,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 
     try {
         int32_t client_magic_number;
-        conn->read(&client_magic_number, sizeof(client_magic_number), &ct_keepalive);
+        conn->read(&client_magic_number, sizeof(client_magic_number), interruptor);
 
         bool pre_2 = client_magic_number == VersionDummy::V0_1;
         bool pre_3 = pre_2 || client_magic_number == VersionDummy::V0_2;
@@ -381,7 +483,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                     "Authorization required but client does not support it.");
             }
         } else if (legal) {
-            auth_key_t provided_auth = read_auth_key(conn.get(), &ct_keepalive);
+            auth_key_t provided_auth = read_auth_key(conn.get(), interruptor);
             if (!timing_sensitive_equals(provided_auth, auth_key)) {
                 throw protob_server_exc_t("Incorrect authorization key.");
             }
@@ -396,15 +498,20 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
         // With version 0_3, the client driver specifies which protocol to use
         int32_t wire_protocol = VersionDummy::PROTOBUF;
         if (!pre_3) {
-            conn->read(&wire_protocol, sizeof(wire_protocol), &ct_keepalive);
+            conn->read(&wire_protocol, sizeof(wire_protocol), interruptor);
         }
 
+        const ql::return_empty_normal_batches_t return_empty_normal_batches =
+            pre_4 ? ql::return_empty_normal_batches_t::YES :
+                    ql::return_empty_normal_batches_t::NO;
         ql::query_cache_t query_cache(rdb_ctx, client_addr_port,
-                                      pre_4 ? ql::return_empty_normal_batches_t::YES :
-                                              ql::return_empty_normal_batches_t::NO);
+                                      return_empty_normal_batches);
+        query_threads_t query_threads(rdb_ctx, client_addr_port,
+                                      return_empty_normal_batches, &query_cache);
 
         switch (wire_protocol) {
             case VersionDummy::JSON:
+            case VersionDummy::BINARY:
             case VersionDummy::PROTOBUF: break;
             default: {
                 throw protob_server_exc_t(strprintf("Unrecognized protocol specified: '%d'",
@@ -414,15 +521,26 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 
         if (!pre_2) {
             const char *success_msg = "SUCCESS";
-            conn->write(success_msg, strlen(success_msg) + 1, &ct_keepalive);
+            conn->write(success_msg, strlen(success_msg) + 1, interruptor);
+        }
+        if (wire_protocol == VersionDummy::BINARY) {
+            // `ql::response_t` writes data in this format.
+            const int32_t binary_format = VersionDummy::BINARY_DATUM_V1;
+            conn->write(&binary_format, sizeof(binary_format), interruptor);
         }
 
         if (wire_protocol == VersionDummy::JSON) {
             connection_loop<json_protocol_t>(
-                conn.get(), max_concurrent_queries, &query_cache, &ct_keepalive);
+                conn.get(), max_concurrent_queries, &query_cache, &query_threads,
+                interruptor);
+        } else if (wire_protocol == VersionDummy::BINARY) {
+            connection_loop<binary_protocol_t>(
+                conn.get(), max_concurrent_queries, &query_cache, &query_threads,
+                interruptor);
         } else if (wire_protocol == VersionDummy::PROTOBUF) {
             connection_loop<protobuf_protocol_t>(
-                conn.get(), max_concurrent_queries, &query_cache, &ct_keepalive);
+                conn.get(), max_concurrent_queries, &query_cache, &query_threads,
+                interruptor);
         } else {
             unreachable();
         }
@@ -440,7 +558,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 
     if (!init_error.empty()) {
         try {
-            conn->write(init_error.c_str(), init_error.length() + 1, &ct_keepalive);
+            conn->write(init_error.c_str(), init_error.length() + 1, interruptor);
             conn->shutdown_write();
         } catch (const tcp_conn_write_closed_exc_t &) {
             // Do nothing
@@ -451,8 +569,8 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 void query_server_t::make_error_response(bool is_draining,
                                          const tcp_conn_t &conn,
                                          const std::string &err_str,
-                                         Response *response_out) {
-    response_out->Clear();
+                                         ql::response_t *response_out) {
+    response_out->clear();
 
     // Best guess at the error that occurred
     if (!conn.is_write_open()) {
@@ -493,6 +611,7 @@ template <class protocol_t>
 void query_server_t::connection_loop(tcp_conn_t *conn,
                                      size_t max_concurrent_queries,
                                      ql::query_cache_t *query_cache,
+                                     query_threads_t *query_threads,
                                      signal_t *drain_signal) {
     std::exception_ptr err;
     std::string err_str;
@@ -533,16 +652,16 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
             ql::protob_t<Query> query_pb(std::move(query_it->second));
             query_list.erase(query_it);
             wait_any_t cb_interruptor(pool_interruptor, &interruptor);
-            Response response;
+            ql::response_t response(protocol_t::response_format);
             bool replied = false;
 
             save_exception(&err, &err_str, &abort, [&]() {
-                    handler->run_query(std::move(query_id), query_pb, &response,
-                                       query_cache, &cb_interruptor);
+                    query_threads->run_query(handler, std::move(query_id), query_pb,
+                                             &response, &cb_interruptor);
                     if (!ql::is_noreply(query_pb)) {
                         response.set_token(query_pb->token());
                         new_mutex_acq_t send_lock(&send_mutex, &cb_interruptor);
-                        protocol_t::send_response(response, handler,
+                        protocol_t::send_response(&response, handler,
                                                   conn, &cb_interruptor);
                         replied = true;
                     }
@@ -554,7 +673,7 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
                                             err_str, &response);
                         response.set_token(query_pb->token());
                         new_mutex_acq_t send_lock(&send_mutex, drain_signal);
-                        protocol_t::send_response(response, handler, conn, drain_signal);
+                        protocol_t::send_response(&response, handler, conn, drain_signal);
                     });
             }
         });
@@ -584,13 +703,13 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
     // Respond to any queries still in the run queue
     for (auto const &pair : query_list) {
         if (!ql::is_noreply(pair.second)) {
-            Response response;
+            ql::response_t response(protocol_t::response_format);
             save_exception(&err, &err_str, &abort, [&]() {
                     make_error_response(drain_signal->is_pulsed(), *conn,
                                         err_str, &response);
                     response.set_token(pair.second->token());
                     new_mutex_acq_t send_lock(&send_mutex, drain_signal);
-                    protocol_t::send_response(response, handler, conn, drain_signal);
+                    protocol_t::send_response(&response, handler, conn, drain_signal);
                 });
         }
     }
@@ -633,7 +752,7 @@ void query_server_t::handle(const http_req_t &req,
     }
 
     ql::protob_t<Query> query(ql::make_counted_query());
-    Response response;
+    ql::response_t response(ql::response_format_t::JSON);
     int64_t token;
 
     if (req.body.size() < sizeof(token)) {
@@ -709,27 +828,25 @@ void query_server_t::handle(const http_req_t &req,
 
     response.set_token(token);
 
-    rapidjson::StringBuffer str;
-    json_shim::write_json_pb(response, &str);
-    if (str.GetSize() >= TOO_LARGE_RESPONSE_SIZE) {
-        Response error_response;
-        error_response.set_token(response.token());
+    const chained_buffer_t *response_data = &response.finish_json();
+    ql::response_t error_response(ql::response_format_t::JSON);
+    if (response_data->size() >= TOO_LARGE_RESPONSE_SIZE) {
+        error_response.set_token(token);
         ql::fill_error(&error_response, Response::RUNTIME_ERROR,
-                       too_large_response_message(str.GetSize()),
+                       too_large_response_message(response_data->size()),
                        ql::backtrace_registry_t::EMPTY_BACKTRACE);
-        str.Clear();
-        json_shim::write_json_pb(error_response, &str);
+        response_data = &error_response.finish_json();
     }
-    uint32_t size = static_cast<uint32_t>(str.GetSize());
+    uint32_t size = static_cast<uint32_t>(response_data->size());
 
     char header_buffer[sizeof(token) + sizeof(size)];
     memcpy(&header_buffer[0], &token, sizeof(token));
     memcpy(&header_buffer[sizeof(token)], &size, sizeof(size));
 
     std::string body_data;
-    body_data.reserve(sizeof(header_buffer) + str.GetSize());
+    body_data.reserve(sizeof(header_buffer) + response_data->size());
     body_data.append(&header_buffer[0], sizeof(header_buffer));
-    body_data.append(str.GetString(), str.GetSize());
+    response_data->append_to_string(&body_data);
     result->set_body("application/octet-stream", body_data);
     result->code = http_status_code_t::OK;
 }
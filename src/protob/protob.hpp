@@ -24,12 +24,16 @@
 
 class auth_key_t;
 class auth_semilattice_metadata_t;
+template <class> class cross_thread_watchable_variable_t;
+template <class> class one_per_thread_t;
 template <class> class semilattice_readwrite_view_t;
 
+class query_threads_t;
 class rdb_context_t;
 namespace ql {
 class query_id_t;
 class query_cache_t;
+class response_t;
 }
 
 class http_conn_cache_t : public repeating_timer_callback_t,
@@ -80,7 +84,7 @@ public:
 
     virtual void run_query(ql::query_id_t &&query_id,
                            const ql::protob_t<Query> &query,
-                           Response *response_out,
+                           ql::response_t *response_out,
                            ql::query_cache_t *query_cache,
                            signal_t *interruptor) = 0;
 };
@@ -91,6 +95,7 @@ public:
         rdb_context_t *rdb_ctx,
         const std::set<ip_address_t> &local_addresses,
         int port,
+        bool reuse_port,
         query_handler_t *_handler,
         uint32_t http_timeout_sec);
     ~query_server_t();
@@ -107,17 +112,24 @@ private:
     void make_error_response(bool is_draining,
                              const tcp_conn_t &conn,
                              const std::string &err,
-                             Response *response_out);
+                             ql::response_t *response_out);
 
     // For the client driver socket
     void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
                      auto_drainer_t::lock_t);
+    // Like `handle_conn`, but for connections that were accepted on the thread
+    // that serves them (see `tcp_reuseport_listener_t`).
+    void handle_thread_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
+    void serve_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                    const auth_key_t &auth_key,
+                    signal_t *interruptor);
 
     // This is templatized based on the wire protocol requested by the client
     template<class protocol_t>
     void connection_loop(tcp_conn_t *conn,
                          size_t max_concurrent_queries,
                          ql::query_cache_t *query_cache,
+                         query_threads_t *query_threads,
                          signal_t *interruptor);
 
     // For HTTP server
@@ -133,6 +145,13 @@ private:
     http_conn_cache_t http_conn_cache;
     scoped_ptr_t<tcp_listener_t> tcp_listener;
 
+    // Only used with `reuse_port`; indexed by thread number.
+    scoped_array_t<scoped_ptr_t<
+        cross_thread_watchable_variable_t<auth_semilattice_metadata_t> > >
+            thread_auth_metadata;
+    scoped_ptr_t<one_per_thread_t<auto_drainer_t> > thread_drainers;
+    scoped_ptr_t<tcp_reuseport_listener_t> reuseport_listener;
+
     int next_thread;
 };
 
@@ -0,0 +1,280 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "protob/query_threads.hpp"
+
+#include <inttypes.h>
+
+#include <exception>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
+#include "protob/protob.hpp"
+#include "rdb_protocol/backtrace.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/response.hpp"
+
+// How many tables a connection remembers for routing point `get`s.
+static const size_t point_get_tables_size = 16;
+
+static bool get_string_datum(const Term &term, std::string *str_out) {
+    if (term.type() != Term::DATUM || term.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *str_out = term.datum().r_str();
+    return true;
+}
+
+// Returns true if `query` is `r.table(...).get(key)` or `r.db(...).table(...).get(key)`
+// with literal names and key, and nothing else.
+static bool parse_point_get(const Query &query,
+                            std::string *db_name_out,
+                            std::string *table_name_out,
+                            ql::datum_t *key_out) {
+    if (query.type() != Query::START || !query.has_query()) {
+        return false;
+    }
+    const Term &get = query.query();
+    if (get.type() != Term::GET || get.args_size() != 2 || get.optargs_size() != 0) {
+        return false;
+    }
+    const Term &table = get.args(0);
+    if (table.type() != Term::TABLE
+        || table.args_size() < 1 || table.args_size() > 2
+        || table.optargs_size() != 0
+        || !get_string_datum(table.args(table.args_size() - 1), table_name_out)) {
+        return false;
+    }
+
+    const Term *db = NULL;
+    if (table.args_size() == 2) {
+        db = &table.args(0);
+    } else {
+        for (int i = 0; i < query.global_optargs_size(); ++i) {
+            if (query.global_optargs(i).key() == "db") {
+                db = &query.global_optargs(i).val();
+            }
+        }
+    }
+    if (db == NULL) {
+        *db_name_out = ql::default_db_name;
+    } else if (db->type() != Term::DB || db->args_size() != 1
+               || !get_string_datum(db->args(0), db_name_out)) {
+        return false;
+    }
+
+    if (get.args(1).type() != Term::DATUM) {
+        return false;
+    }
+    const Datum &key = get.args(1).datum();
+    if (key.type() == Datum::R_STR) {
+        *key_out = ql::datum_t(datum_string_t(key.r_str()));
+    } else if (key.type() == Datum::R_NUM) {
+        *key_out = ql::datum_t(key.r_num());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+query_threads_t::query_threads_t(
+        rdb_context_t *_rdb_ctx,
+        ip_and_port_t _client_addr_port,
+        ql::return_empty_normal_batches_t _return_empty_normal_batches,
+        ql::query_cache_t *_home_query_cache)
+    : rdb_ctx(_rdb_ctx),
+      client_addr_port(_client_addr_port),
+      return_empty_normal_batches(_return_empty_normal_batches),
+      home_query_cache(_home_query_cache),
+      query_caches(get_num_db_threads()),
+      running_queries(0),
+      next_thread(home_thread().threadnum),
+      point_get_tables(point_get_tables_size) {
+    home_query_cache->assert_thread();
+}
+
+query_threads_t::~query_threads_t() {
+    assert_thread();
+    pmap(query_caches.size(), [&](int64_t i) {
+        if (query_caches[i].has()) {
+            on_thread_t rethreader((threadnum_t(i)));
+            query_caches[i].reset();
+        }
+    });
+}
+
+void query_threads_t::run_query(query_handler_t *handler,
+                                ql::query_id_t &&query_id,
+                                const ql::protob_t<Query> &query,
+                                ql::response_t *response_out,
+                                signal_t *interruptor) {
+    assert_thread();
+    threadnum_t thread = home_thread();
+    token_info_t *token;
+    if (!pick_thread(*query, interruptor, &thread, &token)) {
+        ql::fill_error(response_out, Response::CLIENT_ERROR,
+                       strprintf("ERROR: duplicate token %" PRIi64, query->token()),
+                       ql::backtrace_registry_t::EMPTY_BACKTRACE);
+        return;
+    }
+    ++running_queries;
+    if (token != NULL) {
+        ++token->running;
+    }
+
+    count_thread_switches_t thread_switches;
+    std::exception_ptr exc;
+    if (thread == home_thread()) {
+        try {
+            handler->run_query(std::move(query_id), query, response_out,
+                               home_query_cache, interruptor);
+        } catch (...) {
+            exc = std::current_exception();
+        }
+    } else {
+        // `query_id` stays here until the query is done, for NOREPLY_WAIT; the
+        // query gets another one from the query cache it runs in.
+        cross_thread_signal_t ct_interruptor(interruptor, thread);
+        on_thread_t rethreader(thread);
+        try {
+            ql::query_cache_t *query_cache = get_query_cache();
+            handler->run_query(ql::query_id_t(query_cache), query, response_out,
+                               query_cache, &ct_interruptor);
+        } catch (...) {
+            exc = std::current_exception();
+        }
+    }
+
+    --running_queries;
+    rdb_ctx->stats.thread_switches_per_query.record(thread_switches.get());
+    // Don't keep the token around for a query that didn't finish.
+    finish_query(*query, token, exc ? NULL : response_out);
+    if (exc) {
+        std::rethrow_exception(exc);
+    }
+}
+
+bool query_threads_t::pick_thread(const Query &query,
+                                  signal_t *interruptor,
+                                  threadnum_t *thread_out,
+                                  token_info_t **token_out) {
+    *thread_out = home_thread();
+    *token_out = NULL;
+    if (query.type() == Query::NOREPLY_WAIT) {
+        return true;
+    }
+
+    auto it = token_threads.find(query.token());
+    if (query.type() == Query::CONTINUE || query.type() == Query::STOP) {
+        // If the token isn't in use, the home query cache reports that.
+        if (it != token_threads.end()) {
+            *thread_out = it->second.thread;
+            *token_out = &it->second;
+        }
+        return true;
+    }
+    if (it != token_threads.end()) {
+        return false;
+    }
+
+    if (query.type() == Query::START) {
+        if (get_point_get_thread(query, interruptor, thread_out)) {
+            ++rdb_ctx->stats.queries_on_read_thread;
+        } else if (running_queries != 0) {
+            *thread_out = threadnum_t(next_thread);
+            next_thread = (next_thread + 1) % get_num_db_threads();
+        }
+    }
+    // So that a STOP can find the query while it's still running.
+    auto res = token_threads.insert(
+        std::make_pair(query.token(), token_info_t(*thread_out)));
+    *token_out = &res.first->second;
+    return true;
+}
+
+bool query_threads_t::get_point_get_thread(const Query &query,
+                                           signal_t *interruptor,
+                                           threadnum_t *thread_out) {
+    std::pair<std::string, std::string> names;
+    ql::datum_t key;
+    if (!parse_point_get(query, &names.first, &names.second, &key)) {
+        return false;
+    }
+
+    threadnum_t thread = home_thread();
+    auto it = point_get_tables.find(names);
+    try {
+        if (it != point_get_tables.end()) {
+            bool table_gone;
+            if (!rdb_ctx->cluster_interface->table_get_read_thread(
+                    it->second, key, &table_gone, &thread)) {
+                if (table_gone) {
+                    // Another table may have been made with the same name, so look
+                    // it up again next time.
+                    point_get_tables.erase(it);
+                }
+                return false;
+            }
+        } else {
+            name_string_t db_name, table_name;
+            if (!db_name.assign_value(names.first)
+                || !table_name.assign_value(names.second)) {
+                return false;
+            }
+            // If these fail the query will fail the same way, wherever it runs.
+            counted_t<const ql::db_t> db;
+            counted_t<base_table_t> table;
+            std::string error;
+            if (!rdb_ctx->cluster_interface->db_find(
+                    db_name, interruptor, &db, &error)
+                || !rdb_ctx->cluster_interface->table_find(
+                    table_name, db, boost::none, interruptor, &table, &error)
+                || !table->get_read_thread(key, &thread)) {
+                return false;
+            }
+            namespace_id_t table_id;
+            if (str_to_uuid(table->get_id().as_str().to_std(), &table_id)) {
+                point_get_tables[names] = table_id;
+            }
+        }
+    } catch (const ql::base_exc_t &) {
+        // The key isn't valid; let the query report that.
+        return false;
+    }
+    if (thread.threadnum >= get_num_db_threads()) {
+        return false;
+    }
+    *thread_out = thread;
+    return true;
+}
+
+void query_threads_t::finish_query(const Query &query,
+                                   token_info_t *token,
+                                   const ql::response_t *response) {
+    if (token == NULL) {
+        return;
+    }
+    --token->running;
+    if (response == NULL || query.type() == Query::STOP) {
+        token->done = true;
+    } else if (query.type() == Query::PREPARE) {
+        // A prepared query keeps its token until it's stopped.
+        token->done = response->type() != Response::SUCCESS_ATOM;
+    } else if (response->type() != Response::SUCCESS_PARTIAL) {
+        token->done = true;
+    }
+    if (token->done && token->running == 0) {
+        token_threads.erase(query.token());
+    }
+}
+
+ql::query_cache_t *query_threads_t::get_query_cache() {
+    scoped_ptr_t<ql::query_cache_t> *query_cache =
+        &query_caches[get_thread_id().threadnum];
+    if (!query_cache->has()) {
+        query_cache->init(new ql::query_cache_t(rdb_ctx, client_addr_port,
+                                                return_empty_normal_batches));
+    }
+    return query_cache->get();
+}
@@ -0,0 +1,131 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef PROTOB_QUERY_THREADS_HPP_
+#define PROTOB_QUERY_THREADS_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/address.hpp"
+#include "containers/counted.hpp"
+#include "containers/lru_cache.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "threading.hpp"
+
+class base_table_t;
+class query_handler_t;
+class rdb_context_t;
+class signal_t;
+namespace ql {
+class query_cache_t;
+class query_id_t;
+class response_t;
+}
+
+// Spreads the queries of a client connection over the db threads, so that a
+// connection with many queries in flight isn't limited to the thread it was
+// accepted on.  While a connection only has one query running, queries run on
+// the connection's thread, which saves two thread switches per query; beyond
+// that they're handed out round robin.  Each thread gets a query cache of its
+// own for the connection, so a query that returns a stream stays on its
+// thread, and its CONTINUE and STOP queries are sent there.  Responses are sent
+// from the connection's thread as each query finishes, in whatever order that
+// is.
+//
+// A point `get` on a table whose primary replica is on this server always runs
+// on the thread that handles its reads (see `base_table_t::get_read_thread`).
+// There the read needs no mailbox messages to get to the primary and back, so
+// the query takes two thread switches fewer than on any other thread but the
+// connection's, and no more than on the connection's.  The `query_engine` stat
+// `thread_switches_per_query` shows how many queries take, including those of the
+// mailbox messages they send.
+//
+// NOREPLY_WAIT always runs on the connection's thread.  Every query gets a query
+// id from the connection's own query cache when it's read, and keeps it until
+// it's done wherever it runs, so waiting on that cache still waits for all of
+// them.
+//
+// PREPARE and EXECUTE queries also always run on the connection's thread, since
+// the prepared queries are kept in its query cache.
+//
+// Since a query's token decides where its CONTINUE and STOP queries go, a START,
+// PREPARE or EXECUTE query whose token is still in use, wherever that is, fails
+// with a CLIENT_ERROR before it's sent anywhere.
+class query_threads_t : public home_thread_mixin_t {
+public:
+    query_threads_t(rdb_context_t *rdb_ctx,
+                    ip_and_port_t client_addr_port,
+                    ql::return_empty_normal_batches_t return_empty_normal_batches,
+                    ql::query_cache_t *home_query_cache);
+    ~query_threads_t();
+
+    // Like `query_handler_t::run_query`, but picks the thread and query cache.
+    // `query_id` must come from the home query cache.
+    void run_query(query_handler_t *handler,
+                   ql::query_id_t &&query_id,
+                   const ql::protob_t<Query> &query,
+                   ql::response_t *response_out,
+                   signal_t *interruptor);
+
+private:
+    // Where a token's queries run, and whether it can be used again.
+    struct token_info_t {
+        explicit token_info_t(threadnum_t _thread)
+            : thread(_thread), running(0), done(false) { }
+        threadnum_t thread;
+        // How many of the token's queries are running.
+        int running;
+        // Set once the token's query is finished or stopped; the token is
+        // dropped when nothing is running for it any more.
+        bool done;
+    };
+
+    // Returns false if `query` reuses a token that's still in use.  Otherwise
+    // sets `thread_out`, and sets `token_out` to the token's entry in
+    // `token_threads`, or NULL for a query that doesn't have one.
+    bool pick_thread(const Query &query,
+                     signal_t *interruptor,
+                     threadnum_t *thread_out,
+                     token_info_t **token_out);
+    // Returns true and sets `thread_out` if `query` is a point `get` whose read
+    // thread we know.
+    bool get_point_get_thread(const Query &query,
+                              signal_t *interruptor,
+                              threadnum_t *thread_out);
+    // `response` is NULL if the query threw.
+    void finish_query(const Query &query,
+                      token_info_t *token,
+                      const ql::response_t *response);
+
+    // Returns the connection's query cache for the current thread, creating it the
+    // first time.
+    ql::query_cache_t *get_query_cache();
+
+    rdb_context_t *const rdb_ctx;
+    const ip_and_port_t client_addr_port;
+    const ql::return_empty_normal_batches_t return_empty_normal_batches;
+    ql::query_cache_t *const home_query_cache;
+
+    // Indexed by thread number; each one is only touched on its own thread.
+    std::vector<scoped_ptr_t<ql::query_cache_t> > query_caches;
+
+    // The threads of the queries that are running or might be continued, and of
+    // the prepared queries, by token.
+    std::map<int64_t, token_info_t> token_threads;
+    size_t running_queries;
+    int next_thread;
+
+    // The IDs of the tables that recent point `get`s were on, by database and table
+    // name.  We keep the IDs rather than the tables, so that a table that has been
+    // dropped isn't kept around.  They're only used to find the read thread, so it
+    // doesn't matter if one has been renamed since.
+    lru_cache_t<std::pair<std::string, std::string>, namespace_id_t> point_get_tables;
+
+    DISABLE_COPYING(query_threads_t);
+};
+
+#endif  // PROTOB_QUERY_THREADS_HPP_
@@ -76,6 +76,13 @@ public:
     virtual std::set<region_t> get_sharding_scheme()
         THROWS_ONLY(cannot_perform_query_exc_t) = 0;
 
+    /* Returns true and sets `thread_out` if reads of `key` are handled by a thread
+    on this server, so that a query could be run there to save thread switches. */
+    virtual bool get_read_thread(UNUSED const store_key_t &key,
+                                 UNUSED threadnum_t *thread_out) {
+        return false;
+    }
+
     virtual signal_t *get_initial_ready_signal() { return NULL; }
 
     virtual bool check_readiness(table_readiness_t readiness,
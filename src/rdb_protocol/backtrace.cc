@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "rdb_protocol/response.hpp"
+
 namespace ql {
 
 const datum_t backtrace_registry_t::EMPTY_BACKTRACE = datum_t::empty_array();
@@ -61,21 +63,11 @@ void fill_backtrace(Backtrace *bt_out,
     }
 }
 
-void fill_error(Response *res,
+void fill_error(response_t *res,
                 Response::ResponseType type,
                 const std::string &message,
                 datum_t backtrace) {
-    guarantee(type == Response::CLIENT_ERROR ||
-              type == Response::COMPILE_ERROR ||
-              type == Response::RUNTIME_ERROR);
-    Datum error_msg;
-    error_msg.set_type(Datum::R_STR);
-    error_msg.set_r_str(message);
-    res->set_type(type);
-    res->clear_response();
-    res->clear_profile();
-    *res->add_response() = error_msg;
-    fill_backtrace(res->mutable_backtrace(), backtrace);
+    res->set_error(type, message, backtrace);
 }
 
 } // namespace ql
@@ -13,6 +13,7 @@
 namespace ql {
 
 class backtrace_registry_t;
+class response_t;
 
 // A query-language exception with its backtrace resolved to a datum_t
 // This should only be thrown from outside term evaluation - it is only meant
@@ -64,7 +65,7 @@ private:
 void fill_backtrace(Backtrace *bt_out,
                     datum_t backtrace);
 
-void fill_error(Response *res_out,
+void fill_error(response_t *res_out,
                 Response::ResponseType type,
                 const std::string &message,
                 datum_t backtrace);
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
 #include <functional>
 #include <iterator>
 #include <set>
@@ -637,11 +638,27 @@ public:
             transformers.push_back(ql::make_op(_transforms[i]));
         }
         guarantee(transformers.size() == _transforms.size());
+        // A projection only means anything as the very first transformation;
+        // after that the rows have already been loaded.
+        const ql::project_wire_func_t *project = _transforms.empty()
+            ? NULL
+            : boost::get<ql::project_wire_func_t>(&_transforms[0]);
+        has_projection = project != NULL;
+        projection_excludes = has_projection && project->exclude;
+        if (has_projection) {
+            for (const auto &field : project->fields) {
+                projection_fields.push_back(datum_string_t(field));
+            }
+            std::sort(projection_fields.begin(), projection_fields.end());
+        }
     }
     job_data_t(job_data_t &&jd)
         : env(jd.env),
           batcher(std::move(jd.batcher)),
           transformers(std::move(jd.transformers)),
+          has_projection(jd.has_projection),
+          projection_excludes(jd.projection_excludes),
+          projection_fields(std::move(jd.projection_fields)),
           sorting(jd.sorting),
           accumulator(jd.accumulator.release()) {
     }
@@ -650,6 +667,10 @@ private:
     ql::env_t *const env;
     ql::batcher_t batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    // Set if the transformations only look at some top-level fields of the rows.
+    bool has_projection;
+    bool projection_excludes;
+    std::vector<datum_string_t> projection_fields; // sorted
     sorting_t sorting;
     scoped_ptr_t<ql::accumulator_t> accumulator;
 };
@@ -735,7 +756,15 @@ done_traversing_t rget_cb_t::handle_pair(
     io.slice->stats.pm_keys_read.record();
     io.slice->stats.pm_total_keys_read += 1;
     // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
+    if (job.has_projection && !sindex) {
+        // The secondary index function needs the whole row, but otherwise we
+        // only have to load the fields the transformations are going to use.
+        val = get_data_projection(static_cast<const rdb_value_t *>(keyvalue.value()),
+                                  keyvalue.expose_buf(),
+                                  job.projection_fields,
+                                  job.projection_excludes);
+        row.reset();
+    } else if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
         val = row.get();
     } else {
         row.reset();
@@ -17,23 +17,42 @@ rdb_context_t::stats_t::stats_t(perfmon_collection_t *global_stats)
       queries_per_sec_membership(&qe_stats_collection,
                                  &queries_per_sec, "queries_per_sec"),
       queries_total_membership(&qe_stats_collection,
-                               &queries_total, "queries_total") { }
+                               &queries_total, "queries_total"),
+      queries_on_read_thread_membership(&qe_stats_collection,
+                                        &queries_on_read_thread,
+                                        "queries_on_read_thread"),
+      thread_switches_per_query(secs_to_ticks(1), false),
+      thread_switches_per_query_membership(&qe_stats_collection,
+                                           &thread_switches_per_query,
+                                           "thread_switches_per_query"),
+      result_cache_hits_membership(&qe_stats_collection,
+                                   &result_cache_hits, "result_cache_hits"),
+      result_cache_misses_membership(&qe_stats_collection,
+                                     &result_cache_misses, "result_cache_misses") { }
 
 rdb_context_t::rdb_context_t()
     : extproc_pool(nullptr),
       cluster_interface(nullptr),
+      io_backender(nullptr),
+      base_path(""),
       manager(nullptr),
       reql_http_proxy(),
-      stats(&get_global_perfmon_collection()) { }
+      stats(&get_global_perfmon_collection()),
+      result_cache(nullptr),
+      json_caches(nullptr) { }
 
 rdb_context_t::rdb_context_t(
         extproc_pool_t *_extproc_pool,
         reql_cluster_interface_t *_cluster_interface)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
+      io_backender(nullptr),
+      base_path(""),
       manager(nullptr),
       reql_http_proxy(),
-      stats(&get_global_perfmon_collection()) { }
+      stats(&get_global_perfmon_collection()),
+      result_cache(nullptr),
+      json_caches(nullptr) { }
 
 rdb_context_t::rdb_context_t(
         extproc_pool_t *_extproc_pool,
@@ -42,13 +61,19 @@ rdb_context_t::rdb_context_t(
         boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
             _auth_metadata,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
+      io_backender(_io_backender),
+      base_path(_base_path),
       auth_metadata(_auth_metadata),
       manager(_mailbox_manager),
       reql_http_proxy(_reql_http_proxy),
-      stats(global_stats)
+      stats(global_stats),
+      result_cache(nullptr),
+      json_caches(nullptr)
 { }
 
 rdb_context_t::~rdb_context_t() { }
@@ -38,6 +38,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 class auth_semilattice_metadata_t;
 class ellipsoid_spec_t;
 class extproc_pool_t;
+class io_backender_t;
 class name_string_t;
 class namespace_interface_t;
 template <class> class semilattice_readwrite_view_t;
@@ -49,7 +50,9 @@ enum class sindex_geo_bool_t;
 namespace ql {
 class configured_limits_t;
 class env_t;
+class json_caches_t;
 class query_cache_t;
+class result_cache_t;
 class db_t : public single_threaded_countable_t<db_t> {
 public:
     db_t(uuid_u _id, const name_string_t &_name) : id(_id), name(_name) { }
@@ -143,6 +146,14 @@ public:
     virtual std::map<std::string, ql::datum_t> sindex_status(
         ql::env_t *env, const std::set<std::string> &sindexes) = 0;
 
+    /* Returns true and sets `thread_out` if reads of the row with primary key `pval`
+    are handled by a thread on this server. This is only a hint for where to run
+    queries; it doesn't block. */
+    virtual bool get_read_thread(UNUSED ql::datum_t pval,
+                                 UNUSED threadnum_t *thread_out) {
+        return false;
+    }
+
     /* This must be public */
     virtual ~base_table_t() { }
 };
@@ -193,6 +204,13 @@ public:
             boost::optional<admin_identifier_format_t> identifier_format,
             signal_t *interruptor, counted_t<base_table_t> *table_out,
             std::string *error_out) = 0;
+    /* Sets `*thread_out` to the thread that a read of the row with primary key `pval`
+    from the table with ID `table_id` would go to, like `get_read_thread()` on the
+    table.  Returns false if the thread isn't known, and also sets `*table_gone_out`
+    if that's because there's no such table anymore.  This is for routing queries, so
+    it never blocks, and nothing has to hold on to the table in the meantime. */
+    virtual bool table_get_read_thread(const namespace_id_t &table_id,
+            ql::datum_t pval, bool *table_gone_out, threadnum_t *thread_out) = 0;
     virtual bool table_estimate_doc_counts(
             counted_t<const ql::db_t> db,
             const name_string_t &name,
@@ -270,7 +288,8 @@ public:
     rdb_context_t(extproc_pool_t *_extproc_pool,
                   reql_cluster_interface_t *_cluster_interface);
 
-    // The "real" constructor used outside of unit tests.
+    // The "real" constructor used outside of unit tests.  `_io_backender` is
+    // NULL on proxies, which have no data directory to spill query results into.
     rdb_context_t(extproc_pool_t *_extproc_pool,
                   mailbox_manager_t *_mailbox_manager,
                   reql_cluster_interface_t *_cluster_interface,
@@ -278,13 +297,21 @@ public:
                     semilattice_readwrite_view_t<
                         auth_semilattice_metadata_t> > _auth_metadata,
                   perfmon_collection_t *global_stats,
-                  const std::string &_reql_http_proxy);
+                  const std::string &_reql_http_proxy,
+                  io_backender_t *_io_backender,
+                  const base_path_t &_base_path);
 
     ~rdb_context_t();
 
     extproc_pool_t *extproc_pool;
     reql_cluster_interface_t *cluster_interface;
 
+    // Used to create temporary files for queries whose intermediate results don't
+    // fit in memory (see `rdb_protocol/disk_spill.hpp`).  `io_backender` may be
+    // NULL, in which case spilling is unavailable.
+    io_backender_t *io_backender;
+    const base_path_t base_path;
+
     boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
         auth_metadata;
 
@@ -306,10 +333,31 @@ public:
         perfmon_membership_t queries_per_sec_membership;
         perfmon_counter_t queries_total;
         perfmon_membership_t queries_total_membership;
+        // Queries that were run on the thread that handles their reads, rather
+        // than on their connection's thread.
+        perfmon_counter_t queries_on_read_thread;
+        perfmon_membership_t queries_on_read_thread_membership;
+        // The least, most and average thread switches per query over the last
+        // second, counting those of the mailbox messages the query sent (see
+        // `count_thread_switches_t`).
+        perfmon_sampler_t thread_switches_per_query;
+        perfmon_membership_t thread_switches_per_query_membership;
+        // Queries that were, and weren't, answered from the result cache.  Only
+        // queries that could be cached count as misses.
+        perfmon_counter_t result_cache_hits;
+        perfmon_membership_t result_cache_hits_membership;
+        perfmon_counter_t result_cache_misses;
+        perfmon_membership_t result_cache_misses_membership;
     private:
         DISABLE_COPYING(stats_t);
     } stats;
 
+    // Set by `serve` if the result cache is enabled; NULL otherwise.
+    ql::result_cache_t *result_cache;
+
+    // Set by `serve` if the JSON caches are enabled; NULL otherwise.
+    ql::json_caches_t *json_caches;
+
     std::set<ql::query_cache_t *> *get_query_caches_for_this_thread();
 
 private:
@@ -15,6 +15,7 @@
 
 #include "cjson/json.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/chained_buffer.hpp"
 #include "containers/scoped.hpp"
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/rapidjson.h"
@@ -1431,6 +1432,8 @@ template void datum_t::write_json(
     rapidjson::Writer<rapidjson::StringBuffer> *writer) const;
 template void datum_t::write_json(
     rapidjson::PrettyWriter<rapidjson::StringBuffer> *writer) const;
+template void datum_t::write_json(
+    rapidjson::Writer<chained_buffer_t> *writer) const;
 
 cJSON *datum_t::as_json_raw() const {
     switch (get_type()) {
@@ -1637,6 +1640,83 @@ int datum_t::cmp(const datum_t &rhs) const {
     }
 }
 
+namespace {
+const uint64_t datum_hash_seed = 0xcbf29ce484222325ULL;
+
+uint64_t datum_hash_mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+uint64_t datum_hash_bytes(uint64_t h, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return datum_hash_mix(h, size);
+}
+}  // namespace
+
+uint64_t datum_t::hash() const {
+    if (is_ptype() && !pseudo_compares_as_obj()) {
+        uint64_t h = datum_hash_seed;
+        if (get_type() == R_BINARY) {
+            const datum_string_t &bin = as_binary();
+            return datum_hash_bytes(datum_hash_mix(h, R_BINARY), bin.data(), bin.size());
+        }
+        const std::string reql_type = get_reql_type();
+        h = datum_hash_bytes(h, reql_type.data(), reql_type.size());
+        if (reql_type == pseudo::time_string) {
+            // Times compare equal iff their epoch times do (see `time_cmp`).
+            return datum_hash_mix(h, datum_t(pseudo::time_to_epoch_time(*this)).hash());
+        }
+        // Other pseudotypes can't be compared at all, so anything consistent goes.
+        return h;
+    }
+
+    uint64_t h = datum_hash_mix(datum_hash_seed, get_type());
+    switch (get_type()) {
+    case R_NULL: // fallthru
+    case MINVAL: // fallthru
+    case MAXVAL: return h;
+    case R_BOOL: return datum_hash_mix(h, as_bool() ? 1 : 0);
+    case R_NUM: {
+        double d = as_num();
+        // `0.0 == -0.0`, so they have to hash the same.
+        if (d == 0.0) {
+            d = 0.0;
+        }
+        uint64_t bits;
+        static_assert(sizeof(bits) == sizeof(d), "double is not 64 bits wide");
+        memcpy(&bits, &d, sizeof(bits));
+        return datum_hash_mix(h, bits);
+    }
+    case R_STR: {
+        const datum_string_t &str = as_str();
+        return datum_hash_bytes(h, str.data(), str.size());
+    }
+    case R_ARRAY: {
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            h = datum_hash_mix(h, unchecked_get(i).hash());
+        }
+        return datum_hash_mix(h, sz);
+    }
+    case R_OBJECT: {
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            auto pair = unchecked_get_pair(i);
+            h = datum_hash_bytes(h, pair.first.data(), pair.first.size());
+            h = datum_hash_mix(h, pair.second.hash());
+        }
+        return datum_hash_mix(h, sz);
+    }
+    case R_BINARY: // This should be handled by the ptype code above
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 bool datum_t::operator==(const datum_t &rhs) const { return cmp(rhs) == 0; }
 bool datum_t::operator!=(const datum_t &rhs) const { return cmp(rhs) != 0; }
 bool datum_t::operator<(const datum_t &rhs) const { return cmp(rhs) < 0; }
@@ -289,8 +289,9 @@ public:
                   const configured_limits_t &limits,
                   std::set<std::string> *conditions) const;
 
-    // json_writer_t can be rapidjson::Writer<rapidjson::StringBuffer>
-    // or rapidjson::PrettyWriter<rapidjson::StringBuffer>
+    // json_writer_t can be rapidjson::Writer<rapidjson::StringBuffer>,
+    // rapidjson::PrettyWriter<rapidjson::StringBuffer> or
+    // rapidjson::Writer<chained_buffer_t>
     template <class json_writer_t> void write_json(json_writer_t *writer) const;
 
     // DEPRECATED: Used for backwards compatibility with reql_versions before 2.1
@@ -314,6 +315,12 @@ public:
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
 
+    // A hash that is consistent with `operator==`: any two data which compare
+    // equal hash to the same value.  (So e.g. times hash only their epoch time,
+    // and `0` and `-0` hash the same.)  Not stable across versions; don't
+    // persist it.
+    uint64_t hash() const;
+
     void runtime_fail(base_exc_t::type_t exc_type,
                       const char *test, const char *file, int line,
                       std::string msg) const NORETURN;
@@ -0,0 +1,213 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_HASH_MAP_HPP_
+#define RDB_PROTOCOL_DATUM_HASH_MAP_HPP_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+// An open-addressing (linear probing) hash map keyed on `datum_t`.  All the
+// entries live in one flat array, so finding a key costs a hash and usually a
+// single equality comparison, rather than a walk down a tree of full datum
+// comparisons like `std::map<datum_t, T, optional_datum_less_t>`.
+//
+// Uninitialized data are allowed as keys (they're what ungrouped streams use
+// as their only group).  Iteration order is unspecified, so don't use this
+// anywhere the order of groups is visible.  Inserting invalidates iterators and
+// pointers to values; erasing invalidates iterators.
+template <class T>
+class datum_hash_map_t {
+private:
+    struct slot_t {
+        slot_t() : used(false), hash(0) { }
+        bool used;
+        uint64_t hash;
+        datum_t key;
+        T value;
+    };
+
+public:
+    class iterator {
+    public:
+        iterator() : slots(NULL), pos(0) { }
+        const datum_t &key() const { return (*slots)[pos].key; }
+        T &value() const { return (*slots)[pos].value; }
+        iterator &operator++() {
+            ++pos;
+            skip_unused();
+            return *this;
+        }
+        bool operator==(const iterator &other) const {
+            return slots == other.slots && pos == other.pos;
+        }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+    private:
+        friend class datum_hash_map_t;
+        iterator(std::vector<slot_t> *_slots, size_t _pos)
+            : slots(_slots), pos(_pos) {
+            skip_unused();
+        }
+        void skip_unused() {
+            while (pos < slots->size() && !(*slots)[pos].used) {
+                ++pos;
+            }
+        }
+        std::vector<slot_t> *slots;
+        size_t pos;
+    };
+
+    datum_hash_map_t() : count(0) { }
+    datum_hash_map_t(datum_hash_map_t &&movee)
+        : slots(std::move(movee.slots)), count(movee.count) {
+        movee.count = 0;
+    }
+
+    iterator begin() { return iterator(&slots, 0); }
+    iterator end() { return iterator(&slots, slots.size()); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        slots.clear();
+        count = 0;
+    }
+
+    // Returns NULL if `key` isn't present.
+    T *find(const datum_t &key) {
+        if (count == 0) {
+            return NULL;
+        }
+        const uint64_t h = hash_key(key);
+        for (size_t i = h & mask(); ; i = (i + 1) & mask()) {
+            slot_t *slot = &slots[i];
+            if (!slot->used) {
+                return NULL;
+            }
+            if (slot->hash == h && keys_equal(slot->key, key)) {
+                return &slot->value;
+            }
+        }
+    }
+
+    // Returns the value for `key`, inserting a copy of `default_val` if the key
+    // wasn't already present.  `*inserted_out` (if non-NULL) is set to whether the
+    // insertion happened.
+    T *find_or_insert(const datum_t &key, const T &default_val,
+                      bool *inserted_out = NULL) {
+        maybe_grow();
+        const uint64_t h = hash_key(key);
+        for (size_t i = h & mask(); ; i = (i + 1) & mask()) {
+            slot_t *slot = &slots[i];
+            if (!slot->used) {
+                slot->used = true;
+                slot->hash = h;
+                slot->key = key;
+                slot->value = default_val;
+                ++count;
+                if (inserted_out != NULL) *inserted_out = true;
+                return &slot->value;
+            }
+            if (slot->hash == h && keys_equal(slot->key, key)) {
+                if (inserted_out != NULL) *inserted_out = false;
+                return &slot->value;
+            }
+        }
+    }
+    T *find_or_insert(const datum_t &key) {
+        return find_or_insert(key, T());
+    }
+
+    // Returns whether `key` was present.  We use backward-shift deletion rather
+    // than tombstones, so a table that sees a lot of churn doesn't degrade.
+    bool erase(const datum_t &key) {
+        if (count == 0) {
+            return false;
+        }
+        const uint64_t h = hash_key(key);
+        size_t i = h & mask();
+        for (;; i = (i + 1) & mask()) {
+            if (!slots[i].used) {
+                return false;
+            }
+            if (slots[i].hash == h && keys_equal(slots[i].key, key)) {
+                break;
+            }
+        }
+        size_t hole = i;
+        for (size_t j = (hole + 1) & mask(); slots[j].used; j = (j + 1) & mask()) {
+            const size_t home = slots[j].hash & mask();
+            // Move `j` into the hole unless its home lies cyclically in (hole, j].
+            const bool home_in_range = hole <= j
+                ? (hole < home && home <= j)
+                : (hole < home || home <= j);
+            if (!home_in_range) {
+                slots[hole] = std::move(slots[j]);
+                hole = j;
+            }
+        }
+        slots[hole] = slot_t();
+        --count;
+        return true;
+    }
+
+    // A rough estimate of the memory held by the table itself (not counting
+    // anything the keys or values point to).
+    size_t table_memory_usage() const {
+        return slots.capacity() * sizeof(slot_t);
+    }
+
+private:
+    static const size_t min_capacity = 16;
+
+    static uint64_t hash_key(const datum_t &key) {
+        // Mix the high bits down, since we only look at the low ones.
+        uint64_t h = key.has() ? key.hash() : 0x5bd1e9955bd1e995ULL;
+        return h ^ (h >> 29) ^ (h >> 47);
+    }
+
+    static bool keys_equal(const datum_t &a, const datum_t &b) {
+        if (a.has() != b.has()) {
+            return false;
+        }
+        return !a.has() || a == b;
+    }
+
+    size_t mask() const { return slots.size() - 1; }
+
+    void maybe_grow() {
+        // Keep the load factor at or below 1/2 so that probe sequences stay short.
+        if (slots.size() != 0 && (count + 1) * 2 <= slots.size()) {
+            return;
+        }
+        std::vector<slot_t> old_slots(
+            std::max<size_t>(min_capacity, slots.size() * 2));
+        old_slots.swap(slots);
+        for (auto &&old : old_slots) {
+            if (old.used) {
+                size_t i = old.hash & mask();
+                while (slots[i].used) {
+                    i = (i + 1) & mask();
+                }
+                slots[i] = std::move(old);
+            }
+        }
+    }
+
+    std::vector<slot_t> slots;
+    size_t count;
+
+    DISABLE_COPYING(datum_hash_map_t);
+};
+
+template <class T>
+const size_t datum_hash_map_t<T>::min_capacity;
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_HASH_MAP_HPP_
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <algorithm>
 #include <map>
 
 #include "boost_utils.hpp"
@@ -1057,6 +1058,129 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// SPILLED_SORT_DATUM_STREAM_T
+
+// The most spilled runs we keep open at once, which is also the most we merge at
+// once.  Each run keeps a disk-backed queue (and its cache) open, so this bounds
+// our memory use and the number of open files, however big the input is.
+static const size_t MAX_SORT_MERGE_FAN_IN = 16;
+// How many merged elements we buffer before writing them to an intermediate run.
+static const size_t SORT_MERGE_WRITE_CHUNK_SIZE = 1024;
+
+spilled_sort_datum_stream_t::spilled_sort_datum_stream_t(
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> _lt_cmp,
+    backtrace_id_t bt)
+    : eager_datum_stream_t(bt), lt_cmp(_lt_cmp) { }
+
+void spilled_sort_datum_stream_t::add_sorted_run(
+    env_t *env, const std::vector<datum_t> &sorted_run) {
+    if (sorted_run.empty()) {
+        return;
+    }
+    profile::sampler_t sampler("Spilling a sorted run to disk.", env->trace);
+    // Merging opens one more queue for its output, so we make room for that and
+    // for the new run.
+    while (runs.size() + 1 >= MAX_SORT_MERGE_FAN_IN) {
+        merge_some(env, &sampler);
+    }
+    runs.push_back(sorted_run_t());
+    runs.back().queue = make_scoped<datum_spill_queue_t>(env);
+    runs.back().queue->push(sorted_run);
+}
+
+bool spilled_sort_datum_stream_t::is_exhausted() const {
+    return runs.empty() && batch_cache_exhausted();
+}
+feed_type_t spilled_sort_datum_stream_t::cfeed_type() const {
+    return feed_type_t::not_feed;
+}
+bool spilled_sort_datum_stream_t::is_infinite() const {
+    return false;
+}
+
+datum_t spilled_sort_datum_stream_t::pop_smallest(
+    env_t *env, profile::sampler_t *sampler, std::vector<sorted_run_t> *from) {
+    r_sanity_check(!from->empty());
+    size_t best = 0;
+    for (size_t i = 0; i < from->size(); ++i) {
+        sorted_run_t *run = &(*from)[i];
+        if (!run->head.has()) {
+            run->head = run->queue->pop();
+        }
+        if (i != 0 && lt_cmp(env, sampler, run->head, (*from)[best].head)) {
+            best = i;
+        }
+    }
+    sorted_run_t *run = &(*from)[best];
+    datum_t ret = std::move(run->head);
+    run->head.reset();
+    if (run->queue->empty()) {
+        from->erase(from->begin() + best);
+    }
+    return ret;
+}
+
+void spilled_sort_datum_stream_t::merge_some(
+    env_t *env, profile::sampler_t *sampler) {
+    r_sanity_check(runs.size() >= 2);
+    // We merge the last stretch of two or more adjacent runs of the same level, so
+    // that runs of about the same length get merged and every element is only
+    // rewritten a logarithmic number of times.  If there is no such stretch, we
+    // merge the last two runs.  We only ever merge adjacent runs, and keep the
+    // merged run in their place, so that ties keep their input order.
+    size_t begin = runs.size() - 2;
+    size_t end = runs.size();
+    for (size_t stretch_end = runs.size(); stretch_end > 1; ) {
+        size_t stretch_begin = stretch_end - 1;
+        while (stretch_begin > 0
+               && runs[stretch_begin - 1].level == runs[stretch_end - 1].level) {
+            --stretch_begin;
+        }
+        if (stretch_end - stretch_begin >= 2) {
+            begin = stretch_begin;
+            end = stretch_end;
+            break;
+        }
+        stretch_end = stretch_begin;
+    }
+
+    std::vector<sorted_run_t> group;
+    group.reserve(end - begin);
+    sorted_run_t merged;
+    for (size_t i = begin; i < end; ++i) {
+        merged.level = std::max(merged.level, runs[i].level + 1);
+        group.push_back(std::move(runs[i]));
+    }
+    runs.erase(runs.begin() + begin, runs.begin() + end);
+    merged.queue = make_scoped<datum_spill_queue_t>(env);
+    std::vector<datum_t> chunk;
+    while (!group.empty()) {
+        chunk.push_back(pop_smallest(env, sampler, &group));
+        if (chunk.size() >= SORT_MERGE_WRITE_CHUNK_SIZE || group.empty()) {
+            merged.queue->push(chunk);
+            chunk.clear();
+        }
+    }
+    runs.insert(runs.begin() + begin, std::move(merged));
+}
+
+std::vector<datum_t>
+spilled_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs from disk.", env->trace);
+    while (!runs.empty() && !batcher.should_send_batch()) {
+        datum_t d = pop_smallest(env, &sampler, &runs);
+        batcher.note_el(d);
+        ret.push_back(std::move(d));
+    }
+    return ret;
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
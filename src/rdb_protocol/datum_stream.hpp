@@ -19,6 +19,7 @@
 #include "containers/scoped.hpp"
 #include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/context.hpp"
+#include "rdb_protocol/disk_spill.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/real_table.hpp"
@@ -27,6 +28,7 @@
 namespace ql {
 
 class env_t;
+class response_t;
 class scope_env_t;
 class func_t;
 
@@ -70,7 +72,7 @@ class datum_stream_t : public single_threaded_countable_t<datum_stream_t>,
                        public bt_rcheckable_t {
 public:
     virtual ~datum_stream_t() { }
-    virtual void set_notes(Response *) const { }
+    virtual void set_notes(response_t *) const { }
 
     virtual std::vector<changespec_t> get_changespecs() = 0;
     virtual void add_transformation(transform_variant_t &&tv, backtrace_id_t bt) = 0;
@@ -258,6 +260,60 @@ size_t index;
 std::vector<datum_t> data;
 };
 
+// Streams the result of an unindexed `order_by` (or `distinct`) whose input didn't
+// fit under the array size limit.  The term sorts its input in memory one run at a
+// time and hands each sorted run to `add_sorted_run`, which spills it to disk; this
+// then does a k-way merge of the runs, keeping only one element per run in memory.
+class spilled_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    spilled_sort_datum_stream_t(
+        std::function<bool(env_t *,  // NOLINT(readability/casting)
+                           profile::sampler_t *,
+                           const datum_t &,
+                           const datum_t &)> lt_cmp,
+        backtrace_id_t bt);
+
+    // Spills `sorted_run`, which comes after all the runs added before it in the
+    // input.  To keep the number of spill files that are open at once bounded, this
+    // may first merge some of the earlier runs.  Must be called before the stream is
+    // read from.
+    void add_sorted_run(env_t *env, const std::vector<datum_t> &sorted_run);
+
+    virtual bool is_exhausted() const;
+    virtual feed_type_t cfeed_type() const;
+    virtual bool is_infinite() const;
+
+private:
+    // Every run in `runs` has either a `head` or a non-empty `queue`; runs are
+    // removed as soon as they run dry.
+    struct sorted_run_t {
+        sorted_run_t() : level(0) { }
+        scoped_ptr_t<datum_spill_queue_t> queue;
+        datum_t head;
+        // One more than the highest level of the runs that were merged into this
+        // one, or 0 if it came straight from `add_sorted_run`.
+        int level;
+    };
+
+    virtual bool is_array() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // Merges a stretch of adjacent runs into one.  Requires `runs.size() >= 2`.
+    void merge_some(env_t *env, profile::sampler_t *sampler);
+    // Removes and returns the smallest head in `*from`.  Ties go to the earliest
+    // run, which keeps the sort stable.  Requires `!from->empty()`.
+    datum_t pop_smallest(env_t *env,
+                         profile::sampler_t *sampler,
+                         std::vector<sorted_run_t> *from);
+
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> lt_cmp;
+    std::vector<sorted_run_t> runs;
+};
+
 struct coro_info_t;
 class coro_stream_t;
 
@@ -0,0 +1,65 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/disk_spill.hpp"
+
+#include <algorithm>
+
+#include "containers/uuid.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/env.hpp"
+
+namespace ql {
+
+// How many datums we serialize before handing them to the queue in one
+// transaction.
+static const size_t SPILL_PUSH_CHUNK_SIZE = 1024;
+
+bool can_spill_to_disk(env_t *env) {
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    return ctx != NULL && ctx->io_backender != NULL && !ctx->base_path.path().empty();
+}
+
+datum_spill_queue_t::datum_spill_queue_t(env_t *env) {
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    guarantee(can_spill_to_disk(env));
+    queue.init(new internal_disk_backed_queue_t(
+                   ctx->io_backender,
+                   serializer_filepath_t(
+                       ctx->base_path,
+                       "query_spill_" + uuid_to_str(generate_uuid())),
+                   &stats));
+}
+
+void datum_spill_queue_t::push(const datum_t &d) {
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, d);
+    queue->push(wm);
+}
+
+void datum_spill_queue_t::push(const std::vector<datum_t> &ds) {
+    for (size_t i = 0; i < ds.size(); i += SPILL_PUSH_CHUNK_SIZE) {
+        const size_t n = std::min(SPILL_PUSH_CHUNK_SIZE, ds.size() - i);
+        scoped_array_t<write_message_t> wms(n);
+        for (size_t j = 0; j < n; ++j) {
+            serialize<cluster_version_t::LATEST_OVERALL>(&wms[j], ds[i + j]);
+        }
+        queue->push(wms);
+    }
+}
+
+datum_t datum_spill_queue_t::pop() {
+    guarantee(!queue->empty());
+    datum_t ret;
+    deserializing_viewer_t<datum_t> viewer(&ret);
+    queue->pop(&viewer);
+    return ret;
+}
+
+bool datum_spill_queue_t::empty() {
+    return queue->empty();
+}
+
+int64_t datum_spill_queue_t::size() {
+    return queue->size();
+}
+
+}  // namespace ql
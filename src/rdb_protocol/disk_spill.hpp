@@ -0,0 +1,50 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DISK_SPILL_HPP_
+#define RDB_PROTOCOL_DISK_SPILL_HPP_
+
+#include <vector>
+
+#include "containers/disk_backed_queue.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/core.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+class env_t;
+
+// Whether queries evaluated in `env` can spill intermediate results to
+// temporary files.  This is false on proxies (which have no data directory) and
+// in unit tests that don't set up an `io_backender_t`.
+bool can_spill_to_disk(env_t *env);
+
+// A FIFO of datums backed by a temporary file in the server's data directory.
+// Operators whose intermediate results don't fit under `array_size_limit` (for
+// example unindexed `order_by`) use these to keep their memory use bounded.  The
+// file is removed when the queue is destroyed.
+class datum_spill_queue_t {
+public:
+    // Requires `can_spill_to_disk(env)`.
+    explicit datum_spill_queue_t(env_t *env);
+
+    void push(const datum_t &d);
+    // Pushes all of `ds` in as few transactions as we reasonably can.
+    void push(const std::vector<datum_t> &ds);
+
+    // Requires `!empty()`.
+    datum_t pop();
+
+    bool empty();
+    int64_t size();
+
+private:
+    // Not attached to any parent; the queue wants a collection of its own.
+    perfmon_collection_t stats;
+    scoped_ptr_t<internal_disk_backed_queue_t> queue;
+
+    DISABLE_COPYING(datum_spill_queue_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DISK_SPILL_HPP_
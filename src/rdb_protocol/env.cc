@@ -53,6 +53,8 @@ wire_func_t construct_optarg_wire_func(const Term &val) {
     return wire_func_t(func);
 }
 
+const char *const default_db_name = "test";
+
 std::map<std::string, wire_func_t> parse_global_optargs(protob_t<Query> q) {
     std::map<std::string, wire_func_t> optargs;
     for (int i = 0; i < q->global_optargs_size(); ++i) {
@@ -67,9 +69,9 @@ std::map<std::string, wire_func_t> parse_global_optargs(protob_t<Query> q) {
         }
     }
 
-    // Supply a default db of "test" if there is no "db" optarg.
+    // Supply the default db if there is no "db" optarg.
     if (!optargs.count("db")) {
-        Term arg = r::db("test").get();
+        Term arg = r::db(default_db_name).get();
         optargs["db"] = construct_optarg_wire_func(arg);
     }
 
@@ -177,6 +179,24 @@ env_t::env_t(signal_t *_interruptor,
     rassert(interruptor != NULL);
 }
 
+env_t::env_t(signal_t *_interruptor,
+             return_empty_normal_batches_t _return_empty_normal_batches,
+             reql_version_t reql_version,
+             const configured_limits_t &limits,
+             profile::trace_t *_trace)
+    : global_optargs_(),
+      limits_(limits),
+      reql_version_(reql_version),
+      regex_cache_(LRU_CACHE_SIZE),
+      return_empty_normal_batches(_return_empty_normal_batches),
+      interruptor(_interruptor),
+      trace(_trace),
+      evals_since_yield_(0),
+      rdb_ctx_(NULL),
+      eval_callback_(NULL) {
+    rassert(interruptor != NULL);
+}
+
 profile_bool_t profile_bool_optarg(const protob_t<Query> &query) {
     rassert(query.has());
     datum_t profile_arg = static_optarg("profile", query);
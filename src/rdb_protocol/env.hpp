@@ -35,6 +35,9 @@ datum_t static_optarg(const std::string &key, const protob_t<const Query> q);
 
 bool is_noreply(const protob_t<const Query> &q);
 
+// The database that queries use when they have no "db" optarg.
+extern const char *const default_db_name;
+
 std::map<std::string, wire_func_t> parse_global_optargs(protob_t<Query> q);
 
 class global_optargs_t {
@@ -76,6 +79,15 @@ public:
                    return_empty_normal_batches_t return_empty_normal_batches,
                    reql_version_t reql_version);
 
+    // Used to evaluate deterministic functions on behalf of a query on another
+    // thread.  Deterministic functions don't use the global optargs or the context.
+    // `trace` may be NULL, and may only be used on the current thread.
+    env_t(signal_t *interruptor,
+          return_empty_normal_batches_t return_empty_normal_batches,
+          reql_version_t reql_version,
+          const configured_limits_t &limits,
+          profile::trace_t *trace);
+
     ~env_t();
 
     // Will yield after EVALS_BEFORE_YIELD calls
@@ -0,0 +1,140 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/json_cache.hpp"
+
+#include <string.h>
+
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "utils.hpp"
+
+namespace ql {
+
+const size_t json_cache_t::max_document_size = 16 * KILOBYTE;
+
+// Must be a power of two.
+static const size_t recently_seen_size = 4096;
+
+// A rough guess at what the hash table and the allocator add to each entry.
+static const size_t entry_overhead = 64;
+
+// Hashes eight bytes at a time, since we hash every cacheable document we send.
+static uint64_t hash_serialization(const char *data, size_t size) {
+    const uint64_t mul = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = 0xcbf29ce484222325ULL ^ (size * mul);
+    while (size >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+        data += sizeof(word);
+        size -= sizeof(word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data, size);
+    h = (h ^ tail) * mul;
+    h ^= h >> 29;
+    return h;
+}
+
+json_cache_t::json_cache_t(size_t _max_memory)
+    : max_memory(_max_memory),
+      memory_usage_(0),
+      recently_seen(recently_seen_size, 0) { }
+
+json_cache_t::~json_cache_t() {
+    while (entry_t *entry = lru.head()) {
+        remove(entry);
+    }
+}
+
+bool json_cache_t::make_key(const datum_t &doc, key_t *key_out) {
+    if (doc.get_type() != datum_t::R_OBJECT) {
+        return false;
+    }
+    const shared_buf_ref_t<char> *buf_ref = doc.get_buf_ref();
+    if (buf_ref == NULL) {
+        return false;
+    }
+    // For an object that still has its serialization this just reads the size
+    // back, which includes the type byte that isn't part of `buf_ref`.
+    const size_t size =
+        datum_serialized_size(doc, check_datum_serialization_errors_t::NO) - 1;
+    if (size > max_document_size) {
+        return false;
+    }
+    key_out->data = buf_ref->get();
+    key_out->size = size;
+    key_out->hash = hash_serialization(key_out->data, key_out->size);
+    return true;
+}
+
+const std::string *json_cache_t::find(const key_t &key) {
+    auto it = entries.find(key.hash);
+    if (it == entries.end()) {
+        return NULL;
+    }
+    entry_t *entry = it->second;
+    if (entry->serialization.size() != key.size
+        || memcmp(entry->serialization.data(), key.data, key.size) != 0) {
+        return NULL;
+    }
+    lru.remove(entry);
+    lru.push_front(entry);
+    return &entry->json;
+}
+
+bool json_cache_t::should_insert(const key_t &key) {
+    uint64_t *seen = &recently_seen[key.hash & (recently_seen_size - 1)];
+    if (*seen == key.hash) {
+        *seen = 0;
+        return true;
+    }
+    *seen = key.hash;
+    return false;
+}
+
+void json_cache_t::insert(const key_t &key, const char *json, size_t json_size) {
+    auto it = entries.find(key.hash);
+    if (it != entries.end()) {
+        // A different document with the same hash; the newer one wins.
+        remove(it->second);
+    }
+
+    entry_t *entry = new entry_t;
+    entry->hash = key.hash;
+    entry->serialization.assign(key.data, key.size);
+    entry->json.assign(json, json_size);
+    entries.insert(std::make_pair(key.hash, entry));
+    lru.push_front(entry);
+    memory_usage_ += entry_memory_usage(*entry);
+
+    while (memory_usage_ > max_memory) {
+        remove(lru.tail());
+    }
+}
+
+size_t json_cache_t::entry_memory_usage(const entry_t &entry) {
+    return sizeof(entry_t) + entry_overhead
+        + entry.serialization.size() + entry.json.size();
+}
+
+void json_cache_t::remove(entry_t *entry) {
+    memory_usage_ -= entry_memory_usage(*entry);
+    entries.erase(entry->hash);
+    lru.remove(entry);
+    delete entry;
+}
+
+json_caches_t::json_caches_t(rdb_context_t *_ctx, size_t max_memory)
+    : ctx(_ctx), caches(max_memory) {
+    guarantee(ctx->json_caches == NULL);
+    ctx->json_caches = this;
+}
+
+json_caches_t::~json_caches_t() {
+    guarantee(ctx->json_caches == this);
+    ctx->json_caches = NULL;
+}
+
+}  // namespace ql
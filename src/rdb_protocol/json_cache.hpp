@@ -0,0 +1,109 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_JSON_CACHE_HPP_
+#define RDB_PROTOCOL_JSON_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrency/one_per_thread.hpp"
+#include "containers/intrusive_list.hpp"
+#include "errors.hpp"
+
+class rdb_context_t;
+
+namespace ql {
+
+class datum_t;
+
+// Remembers the JSON encoding of documents, keyed on their serialization.
+// Documents that were read from disk (or received from another server) keep their
+// serialization around (see `datum_t::get_buf_ref`), so when the same row is read
+// over and over, as rows of config and session tables are, looking up its JSON
+// here is much cheaper than walking the document to encode it again.  Since the
+// key is the serialization itself, an entry can't go stale: once the row is
+// modified, reads return a different serialization and miss.
+//
+// There's one cache per thread (see `json_caches_t`), and it evicts the least
+// recently used documents once it's over `max_memory`.  So that a table
+// scan doesn't flush out the hot documents, a document is only added the second
+// time it's seen within a short while.
+class json_cache_t {
+public:
+    static const size_t max_document_size;
+
+    // Where a document's serialization is, and its hash.
+    class key_t {
+    public:
+        key_t() : data(NULL), size(0), hash(0) { }
+    private:
+        friend class json_cache_t;
+        const char *data;
+        size_t size;
+        uint64_t hash;
+    };
+
+    explicit json_cache_t(size_t max_memory);
+    ~json_cache_t();
+
+    // Returns false if `doc` isn't a document whose JSON we can cache: it's not
+    // an object, it doesn't have its serialization any more, or it's too large.
+    static bool make_key(const datum_t &doc, key_t *key_out);
+
+    // Returns the JSON for `key`, or `NULL`.  The result is valid until the next
+    // call to `insert`.
+    const std::string *find(const key_t &key);
+
+    // Returns true if the document should be encoded and passed to `insert`.
+    // Call this after `find` missed.
+    bool should_insert(const key_t &key);
+    void insert(const key_t &key, const char *json, size_t json_size);
+
+    size_t size() const { return entries.size(); }
+    size_t memory_usage() const { return memory_usage_; }
+
+private:
+    struct entry_t : public intrusive_list_node_t<entry_t> {
+        uint64_t hash;
+        std::string serialization;
+        std::string json;
+    };
+
+    static size_t entry_memory_usage(const entry_t &entry);
+    void remove(entry_t *entry);
+
+    const size_t max_memory;
+    std::unordered_map<uint64_t, entry_t *> entries;
+    // Most recently used first.
+    intrusive_list_t<entry_t> lru;
+    size_t memory_usage_;
+
+    // The hashes of recently seen documents that haven't been added yet.
+    std::vector<uint64_t> recently_seen;
+
+    DISABLE_COPYING(json_cache_t);
+};
+
+// The JSON caches of all the threads, which only exist if they're turned on with
+// `--json-cache-size`.  `max_memory` is per thread.
+class json_caches_t {
+public:
+    // Sets `ctx->json_caches` for as long as the caches exist.
+    json_caches_t(rdb_context_t *ctx, size_t max_memory);
+    ~json_caches_t();
+
+    // Returns the cache for the current thread.
+    json_cache_t *get() { return caches.get(); }
+
+private:
+    rdb_context_t *ctx;
+    one_per_thread_t<json_cache_t> caches;
+
+    DISABLE_COPYING(json_caches_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_JSON_CACHE_HPP_
@@ -24,6 +24,34 @@ ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
     return data;
 }
 
+ql::datum_t get_data_projection(const rdb_value_t *value,
+                                buf_parent_t parent,
+                                const std::vector<datum_string_t> &fields,
+                                bool exclude) {
+    // A value that fits in one block costs the same to read either way.
+    if (value->value_size()
+        <= static_cast<int64_t>(parent.cache()->max_block_size().value())) {
+        return get_data(value, parent);
+    }
+    rdb_blob_wrapper_t blob(parent.cache()->max_block_size(),
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            blob::btree_maxreflen);
+    ql::datum_t data = ql::datum_deserialize_object_fields(
+        value->value_size(),
+        [&](size_t offset, size_t size, char *out) {
+            blob_acq_t acq_group;
+            buffer_group_t buffer_group;
+            blob.expose_region(parent, access_t::read, offset, size,
+                               &buffer_group, &acq_group);
+            buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+            int64_t res = force_read(&read_stream, out, size);
+            guarantee(res == static_cast<int64_t>(size), "rdb value region");
+        },
+        fields,
+        exclude);
+    return data.has() ? data : get_data(value, parent);
+}
+
 const ql::datum_t &lazy_json_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
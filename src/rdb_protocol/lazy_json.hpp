@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <vector>
+
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/blob.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -30,6 +32,16 @@ public:
 ql::datum_t get_data(const rdb_value_t *value,
                                       buf_parent_t parent);
 
+// Like `get_data`, but only loads the top-level `fields` of the value (or, if
+// `exclude` is true, all fields but those).  For values that span several blocks
+// this only touches the blocks holding the fields we want.  Values that aren't
+// objects are loaded in full, so the caller must still apply the projection
+// itself.  `fields` must be sorted.
+ql::datum_t get_data_projection(const rdb_value_t *value,
+                                buf_parent_t parent,
+                                const std::vector<datum_string_t> &fields,
+                                bool exclude);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
         : rdb_value(_rdb_value), parent(_parent) {
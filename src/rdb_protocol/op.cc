@@ -191,6 +191,30 @@ op_term_t::~op_term_t() { }
 
 scoped_ptr_t<val_t> op_term_t::term_eval(scope_env_t *env,
                                          eval_flags_t eval_flags) const {
+    return eval_op(env, eval_flags, NULL);
+}
+
+scoped_ptr_t<val_t> op_term_t::term_eval_prefix(scope_env_t *env,
+                                                size_t n,
+                                                eval_flags_t eval_flags) const {
+    return eval_op(env, eval_flags, &n);
+}
+
+scoped_ptr_t<val_t> op_term_t::eval_impl_prefix(scope_env_t *env,
+                                                args_t *args,
+                                                size_t,
+                                                eval_flags_t eval_flags) const {
+    return eval_impl(env, args, eval_flags);
+}
+
+scoped_ptr_t<val_t> op_term_t::eval_op(scope_env_t *env,
+                                       eval_flags_t eval_flags,
+                                       const size_t *prefix_n) const {
+    auto call_impl = [&](args_t *args) {
+        return prefix_n == NULL
+            ? eval_impl(env, args, eval_flags)
+            : eval_impl_prefix(env, args, *prefix_n, eval_flags);
+    };
     argvec_t argv = arg_terms->start_eval(env, eval_flags);
     if (can_be_grouped()) {
         counted_t<grouped_data_t> gd;
@@ -205,19 +229,20 @@ scoped_ptr_t<val_t> op_term_t::term_eval(scope_env_t *env,
             for (auto kv = gd->begin(); kv != gd->end(); ++kv) {
                 arg_terms->start_eval(env, eval_flags);
                 args_t args(this, argv, make_scoped<val_t>(kv->second, backtrace()));
-                (*out)[kv->first] = eval_impl(env, &args, eval_flags)->as_datum();
+                (*out)[kv->first] = call_impl(&args)->as_datum();
             }
             return make_scoped<val_t>(out, backtrace());
         } else {
             args_t args(this, std::move(argv), std::move(arg0));
-            return eval_impl(env, &args, eval_flags);
+            return call_impl(&args);
         }
     } else {
         args_t args(this, std::move(argv));
-        return eval_impl(env, &args, eval_flags);
+        return call_impl(&args);
     }
 }
 
+boost::optional<size_t> op_term_t::arg0_prefix_size() const { return boost::none; }
 bool op_term_t::can_be_grouped() const { return true; }
 bool op_term_t::is_grouped_seq_op() const { return false; }
 
@@ -288,7 +313,11 @@ void op_term_t::maybe_grouped_data(scope_env_t *env,
         grouped_data_out->reset();
         arg0_out->reset();
     } else {
-        scoped_ptr_t<val_t> arg0 = argv->remove(0)->eval(env, flags);
+        counted_t<const runtime_term_t> arg0_term = argv->remove(0);
+        boost::optional<size_t> prefix_n = arg0_prefix_size();
+        scoped_ptr_t<val_t> arg0 = prefix_n
+            ? arg0_term->eval_prefix(env, *prefix_n, flags)
+            : arg0_term->eval(env, flags);
 
         counted_t<grouped_data_t> gd = is_grouped_seq_op()
             ? arg0->maybe_as_grouped_data()
@@ -9,6 +9,9 @@
 #include <set>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/term.hpp"
@@ -144,9 +147,26 @@ private:
 
     virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env,
                                           eval_flags_t eval_flags) const;
+    virtual scoped_ptr_t<val_t> term_eval_prefix(scope_env_t *env,
+                                                 size_t n,
+                                                 eval_flags_t eval_flags) const;
+    // `prefix_n` is NULL unless only a prefix of the result is needed.
+    scoped_ptr_t<val_t> eval_op(scope_env_t *env,
+                                eval_flags_t eval_flags,
+                                const size_t *prefix_n) const;
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env,
                                           args_t *args,
                                           eval_flags_t eval_flags) const = 0;
+    // Called instead of `eval_impl` when the caller only needs the first `n`
+    // elements of the result.  Defaults to `eval_impl`.
+    virtual scoped_ptr_t<val_t> eval_impl_prefix(scope_env_t *env,
+                                                 args_t *args,
+                                                 size_t n,
+                                                 eval_flags_t eval_flags) const;
+    // If this returns a value, only that many elements of args[0] are needed
+    // (e.g. `limit` with a constant argument), and args[0] is evaluated with
+    // `eval_prefix`.
+    virtual boost::optional<size_t> arg0_prefix_size() const;
     virtual bool can_be_grouped() const;
     virtual bool is_grouped_seq_op() const;
 
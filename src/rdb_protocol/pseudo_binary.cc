@@ -141,9 +141,8 @@ datum_string_t decode_base64(const datum_string_t &data) {
 }
 
 // Given a raw data string, encodes it into a `r.binary` pseudotype with base64 encoding
-void encode_base64_ptype(
-        const datum_string_t &data,
-        rapidjson::Writer<rapidjson::StringBuffer> *writer) {
+template <class json_writer_t>
+void encode_base64_ptype_impl(const datum_string_t &data, json_writer_t *writer) {
     writer->StartObject();
     writer->Key(datum_t::reql_type_string.data(), datum_t::reql_type_string.size());
     writer->String(binary_string);
@@ -153,6 +152,18 @@ void encode_base64_ptype(
     writer->EndObject();
 }
 
+void encode_base64_ptype(
+        const datum_string_t &data,
+        rapidjson::Writer<rapidjson::StringBuffer> *writer) {
+    encode_base64_ptype_impl(data, writer);
+}
+
+void encode_base64_ptype(
+        const datum_string_t &data,
+        rapidjson::Writer<chained_buffer_t> *writer) {
+    encode_base64_ptype_impl(data, writer);
+}
+
 scoped_cJSON_t encode_base64_ptype(const datum_string_t &data) {
     scoped_cJSON_t res(cJSON_CreateObject());
     res.AddItemToObject(datum_t::reql_type_string.to_std().c_str(),
@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "containers/chained_buffer.hpp"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 #include "rdb_protocol/datum_string.hpp"
@@ -20,6 +21,9 @@ extern const char *const data_key;
 void encode_base64_ptype(
         const datum_string_t &data,
         rapidjson::Writer<rapidjson::StringBuffer> *writer);
+void encode_base64_ptype(
+        const datum_string_t &data,
+        rapidjson::Writer<chained_buffer_t> *writer);
 // DEPRECATED
 scoped_cJSON_t encode_base64_ptype(const datum_string_t &data);
 void write_binary_to_protobuf(Datum *d, const datum_string_t &data);
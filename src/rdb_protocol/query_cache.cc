@@ -2,6 +2,7 @@
 #include "rdb_protocol/query_cache.hpp"
 
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 #include "debug.hpp"
@@ -79,39 +80,124 @@ query_cache_t::const_iterator query_cache_t::end() const {
     return queries.end();
 }
 
-scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(
-        int64_t token,
-        protob_t<Query> original_query,
-        use_json_t use_json,
-        signal_t *interruptor) {
-    if (queries.find(token) != queries.end()) {
-        throw bt_exc_t(Response::CLIENT_ERROR,
-            strprintf("ERROR: duplicate token %" PRIi64, token),
-            backtrace_registry_t::EMPTY_BACKTRACE);
-    }
-
-    counted_t<const term_t> root_term;
-    backtrace_registry_t bt_reg;
-    std::map<std::string, wire_func_t> global_optargs;
+// Preprocesses and compiles the term of `query`, and parses its global optargs.
+static counted_t<const term_t> compile_query(
+        protob_t<Query> query,
+        backtrace_registry_t *bt_reg,
+        std::map<std::string, wire_func_t> *optargs_out) {
     try {
-        preprocess_term(original_query->mutable_query(), &bt_reg);
-        global_optargs = parse_global_optargs(original_query);
+        preprocess_term(query->mutable_query(), bt_reg);
+        *optargs_out = parse_global_optargs(query);
 
-        Term *t = original_query->mutable_query();
+        Term *t = query->mutable_query();
         compile_env_t compile_env((var_visibility_t()));
-        root_term = compile_term(&compile_env, original_query.make_child(t));
+        return compile_term(&compile_env, query.make_child(t));
     } catch (const exc_t &e) {
         throw bt_exc_t(Response::COMPILE_ERROR, e.what(),
-                       bt_reg.datum_backtrace(e));
+                       bt_reg->datum_backtrace(e));
     } catch (const datum_exc_t &e) {
         throw bt_exc_t(Response::COMPILE_ERROR, e.what(),
                        backtrace_registry_t::EMPTY_BACKTRACE);
     }
+}
+
+// Whether `t` calls `r.now()`, which `preprocess_term` replaces with the time.
+static bool term_uses_now(const Term &t) {
+    if (t.type() == Term::NOW && t.args_size() == 0) {
+        return true;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (term_uses_now(t.args(i))) {
+            return true;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (term_uses_now(t.optargs(i).val())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns a copy of `query` that can be preprocessed without changing it.
+static protob_t<Query> copy_query(const Query &query) {
+    protob_t<Query> copy = make_counted_query();
+    copy->CopyFrom(query);
+    return copy;
+}
+
+// Converts a term made only of literal values, the way drivers send the
+// arguments of an EXECUTE query, to a datum.
+static datum_t literal_term_to_datum(const Term &t) {
+    if (t.type() == Term::DATUM) {
+        return to_datum(&t.datum(), configured_limits_t::unlimited,
+                        reql_version_t::LATEST);
+    } else if (t.type() == Term::MAKE_ARRAY) {
+        rcheck_toplevel(t.optargs_size() == 0, base_exc_t::GENERIC,
+                        "MAKE_ARRAY takes no optional arguments.");
+        datum_array_builder_t array(configured_limits_t::unlimited);
+        array.reserve(t.args_size());
+        for (int i = 0; i < t.args_size(); ++i) {
+            array.add(literal_term_to_datum(t.args(i)));
+        }
+        return std::move(array).to_datum();
+    } else if (t.type() == Term::MAKE_OBJ) {
+        rcheck_toplevel(t.args_size() == 0, base_exc_t::GENERIC,
+                        "MAKE_OBJ takes no positional arguments.");
+        datum_object_builder_t object;
+        for (int i = 0; i < t.optargs_size(); ++i) {
+            const Term::AssocPair &field = t.optargs(i);
+            const bool dup = object.add(datum_string_t(field.key()),
+                                        literal_term_to_datum(field.val()));
+            rcheck_toplevel(!dup, base_exc_t::GENERIC,
+                            strprintf("Duplicate object key: %s.",
+                                      field.key().c_str()));
+        }
+        return std::move(object).to_datum();
+    } else {
+        rfail_toplevel(base_exc_t::GENERIC,
+                       "The arguments of an EXECUTE query must be literal values.");
+    }
+}
+
+void query_cache_t::check_token_unused(int64_t token) const {
+    if (queries.find(token) != queries.end()
+        || prepared_queries.find(token) != prepared_queries.end()) {
+        throw bt_exc_t(Response::CLIENT_ERROR,
+            strprintf("ERROR: duplicate token %" PRIi64, token),
+            backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+}
+
+scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(
+        int64_t token,
+        protob_t<Query> original_query,
+        use_json_t use_json,
+        signal_t *interruptor) {
+    check_token_unused(token);
+
+    // This has to look at the query before it's preprocessed.
+    scoped_ptr_t<result_cache_t::key_t> result_cache_key;
+    result_cache_t::written_tables_t written_tables;
+    if (rdb_ctx->result_cache != NULL) {
+        result_cache_key.init(new result_cache_t::key_t);
+        if (!rdb_ctx->result_cache->make_key(
+                *original_query, result_cache_key.get(), &written_tables)) {
+            result_cache_key.reset();
+        }
+    }
+
+    backtrace_registry_t bt_reg;
+    std::map<std::string, wire_func_t> global_optargs;
+    counted_t<const term_t> root_term =
+        compile_query(original_query, &bt_reg, &global_optargs);
 
     scoped_ptr_t<entry_t> entry(new entry_t(original_query,
                                             std::move(bt_reg),
                                             std::move(global_optargs),
                                             std::move(root_term)));
+    entry->result_cache_key = std::move(result_cache_key);
+    entry->written_tables = std::move(written_tables);
     scoped_ptr_t<ref_t> ref(new ref_t(this,
                                       token,
                                       entry.get(),
@@ -140,6 +226,119 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::get(
                                          interruptor));
 }
 
+void query_cache_t::prepare(int64_t token, protob_t<Query> original_query) {
+    assert_thread();
+    check_token_unused(token);
+    if (original_query->query().type() != Term::FUNC) {
+        throw bt_exc_t(Response::COMPILE_ERROR,
+            "A PREPARE query must be a function, whose arguments are the "
+            "parameters of the prepared query.",
+            backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+
+    // This has to look at the query before it's preprocessed.
+    result_cache_t::written_tables_t written_tables;
+    if (rdb_ctx->result_cache != NULL) {
+        // A prepared query's results are never cached, since the key would have
+        // to include the arguments; this is only for the tables it writes to.
+        result_cache_t::key_t unused_key;
+        rdb_ctx->result_cache->make_key(
+            *original_query, &unused_key, &written_tables);
+    }
+
+    protob_t<Query> unprocessed_query;
+    if (term_uses_now(original_query->query())) {
+        unprocessed_query = copy_query(*original_query);
+    }
+
+    backtrace_registry_t bt_reg;
+    std::map<std::string, wire_func_t> global_optargs;
+    counted_t<const term_t> func_term =
+        compile_query(original_query, &bt_reg, &global_optargs);
+
+    counted_t<prepared_t> prepared = make_counted<prepared_t>(
+        original_query, unprocessed_query, std::move(bt_reg),
+        std::move(global_optargs), func_term);
+    prepared->written_tables = std::move(written_tables);
+    prepared_queries.insert(std::make_pair(token, std::move(prepared)));
+}
+
+scoped_ptr_t<query_cache_t::ref_t> query_cache_t::execute(
+        int64_t token,
+        protob_t<Query> original_query,
+        use_json_t use_json,
+        signal_t *interruptor) {
+    assert_thread();
+    check_token_unused(token);
+
+    // The query is an array of the prepared query's token and the arguments.
+    const Term &t = original_query->query();
+    int64_t prepared_token;
+    if (t.type() != Term::MAKE_ARRAY
+        || t.args_size() == 0
+        || t.args(0).type() != Term::DATUM
+        || t.args(0).datum().type() != Datum::R_NUM
+        || !number_as_integer(t.args(0).datum().r_num(), &prepared_token)) {
+        throw bt_exc_t(Response::CLIENT_ERROR,
+            "An EXECUTE query must be an array of the token of a prepared query "
+            "followed by its arguments.",
+            backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+    auto it = prepared_queries.find(prepared_token);
+    if (it == prepared_queries.end()) {
+        throw bt_exc_t(Response::CLIENT_ERROR,
+            strprintf("Token %" PRIi64 " is not a prepared query.", prepared_token),
+            backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+    counted_t<const prepared_t> prepared = it->second;
+
+    std::vector<datum_t> args;
+    try {
+        for (int i = 0; i < original_query->global_optargs_size(); ++i) {
+            const std::string &key = original_query->global_optargs(i).key();
+            rcheck_toplevel(key == "noreply" || key == "profile",
+                            base_exc_t::GENERIC,
+                            strprintf("An EXECUTE query can't have the global "
+                                      "optional argument `%s`; pass it to the "
+                                      "PREPARE query instead.", key.c_str()));
+        }
+        args.reserve(t.args_size() - 1);
+        for (int i = 1; i < t.args_size(); ++i) {
+            args.push_back(literal_term_to_datum(t.args(i)));
+        }
+    } catch (const base_exc_t &e) {
+        throw bt_exc_t(Response::COMPILE_ERROR, e.what(),
+                       backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+
+    // A query that uses `r.now()` has to see the time it's executed at.
+    backtrace_registry_t bt_reg;
+    std::map<std::string, wire_func_t> global_optargs;
+    counted_t<const term_t> func_term;
+    if (prepared->unprocessed_query.has()) {
+        func_term = compile_query(copy_query(*prepared->unprocessed_query),
+                                  &bt_reg, &global_optargs);
+    } else {
+        global_optargs = prepared->global_optargs;
+        func_term = prepared->func_term;
+    }
+    scoped_ptr_t<entry_t> entry(new entry_t(original_query,
+                                            std::move(bt_reg),
+                                            std::move(global_optargs),
+                                            func_term));
+    entry->written_tables = prepared->written_tables;
+    entry->prepared = std::move(prepared);
+    entry->args = std::move(args);
+    scoped_ptr_t<ref_t> ref(new ref_t(this,
+                                      token,
+                                      entry.get(),
+                                      use_json,
+                                      interruptor));
+    auto insert_res = queries.insert(std::make_pair(token, std::move(entry)));
+    guarantee(insert_res.second);
+    return ref;
+}
+
 void query_cache_t::noreply_wait(const query_id_t &query_id,
                                  int64_t token,
                                  signal_t *interruptor) {
@@ -162,6 +361,8 @@ void query_cache_t::terminate_query(int64_t token) {
     if (entry_it != queries.end()) {
         terminate_internal(entry_it->second.get());
     }
+    // EXECUTE queries that are still running keep their own reference.
+    prepared_queries.erase(token);
 }
 
 void query_cache_t::terminate_internal(query_cache_t::entry_t *entry) {
@@ -212,7 +413,7 @@ query_cache_t::ref_t::~ref_t() {
     }
 }
 
-void query_cache_t::ref_t::fill_response(Response *res) {
+void query_cache_t::ref_t::fill_response(response_t *res) {
     query_cache->assert_thread();
     if (entry->state != entry_t::state_t::START &&
         entry->state != entry_t::state_t::STREAM) {
@@ -241,7 +442,7 @@ void query_cache_t::ref_t::fill_response(Response *res) {
         }
 
         if (trace.has()) {
-            trace->as_datum().write_to_protobuf(res->mutable_profile(), use_json);
+            res->set_profile(trace->as_datum(), use_json);
         }
     } catch (const interrupted_exc_t &ex) {
         if (entry->persistent_interruptor.is_pulsed()) {
@@ -251,7 +452,7 @@ void query_cache_t::ref_t::fill_response(Response *res) {
                     backtrace_registry_t::EMPTY_BACKTRACE);
             }
             // For compatibility, we return a SUCCESS_SEQUENCE in this case
-            res->Clear();
+            res->clear();
             res->set_type(Response::SUCCESS_SEQUENCE);
         } else {
             query_cache->terminate_internal(entry);
@@ -260,7 +461,7 @@ void query_cache_t::ref_t::fill_response(Response *res) {
     } catch (const exc_t &ex) {
         query_cache->terminate_internal(entry);
         throw bt_exc_t(Response::RUNTIME_ERROR, ex.what(),
-                       entry->bt_reg.datum_backtrace(ex));
+                       entry->backtraces().datum_backtrace(ex));
     } catch (const std::exception &ex) {
         query_cache->terminate_internal(entry);
         throw bt_exc_t(Response::RUNTIME_ERROR, ex.what(),
@@ -268,27 +469,44 @@ void query_cache_t::ref_t::fill_response(Response *res) {
     }
 }
 
-void query_cache_t::ref_t::run(env_t *env, Response *res) {
+void query_cache_t::ref_t::run(env_t *env, response_t *res) {
     // The state will be overwritten if we end up with a stream
     entry->state = entry_t::state_t::DONE;
 
+    result_cache_t *result_cache = query_cache->rdb_ctx->result_cache;
+    if (entry->result_cache_key.has()) {
+        datum_t cached = result_cache->find(*entry->result_cache_key);
+        if (cached.has()) {
+            res->set_type(Response::SUCCESS_ATOM);
+            res->add_datum(cached, use_json);
+            return;
+        }
+    }
+    result_cache_t::write_t write(entry->written_tables);
+
     scope_env_t scope_env(env, var_scope_t());
 
+    // Set if the result is an atom.
+    datum_t atom;
     scoped_ptr_t<val_t> val = entry->root_term->eval(&scope_env);
+    if (entry->prepared.has()) {
+        val = val->as_func()->call(env, entry->args);
+    }
     if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
+        atom = val->as_datum();
         res->set_type(Response::SUCCESS_ATOM);
-        val->as_datum().write_to_protobuf(res->add_response(), use_json);
+        res->add_datum(atom, use_json);
     } else if (counted_t<grouped_data_t> gd =
             val->maybe_as_promiscuous_grouped_data(scope_env.env)) {
-        datum_t d = to_datum_for_client_serialization(std::move(*gd), env->limits());
+        atom = to_datum_for_client_serialization(std::move(*gd), env->limits());
         res->set_type(Response::SUCCESS_ATOM);
-        d.write_to_protobuf(res->add_response(), use_json);
+        res->add_datum(atom, use_json);
     } else if (val->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
         counted_t<datum_stream_t> seq = val->as_seq(env);
-        const datum_t arr = seq->as_array(env);
-        if (arr.has()) {
+        atom = seq->as_array(env);
+        if (atom.has()) {
             res->set_type(Response::SUCCESS_ATOM);
-            arr.write_to_protobuf(res->add_response(), use_json);
+            res->add_datum(atom, use_json);
         } else {
             entry->stream = seq;
             entry->has_sent_batch = false;
@@ -300,9 +518,13 @@ void query_cache_t::ref_t::run(env_t *env, Response *res) {
                        "DATUM, GROUPED_DATA, or STREAM (got %s).",
                        val->get_type().name());
     }
+
+    if (atom.has() && entry->result_cache_key.has()) {
+        result_cache->insert(*entry->result_cache_key, atom);
+    }
 }
 
-void query_cache_t::ref_t::serve(env_t *env, Response *res) {
+void query_cache_t::ref_t::serve(env_t *env, response_t *res) {
     guarantee(entry->stream.has());
 
     batch_type_t batch_type = entry->has_sent_batch
@@ -312,7 +534,7 @@ void query_cache_t::ref_t::serve(env_t *env, Response *res) {
             env, batchspec_t::user(batch_type, env));
     entry->has_sent_batch = true;
     for (auto d = ds.begin(); d != ds.end(); ++d) {
-        d->write_to_protobuf(res->add_response(), use_json);
+        res->add_datum(*d, use_json);
     }
 
     // Note that `SUCCESS_SEQUENCE` is possible for feeds if you call `.limit`
@@ -332,19 +554,19 @@ void query_cache_t::ref_t::serve(env_t *env, Response *res) {
         // `case` statement is that feeds can sometimes have 0-size responses
         // for other reasons (e.g. in their first batch, or just whenever with a
         // V0_3 protocol).
-        if (res->response_size() == 0) res->set_type(Response::SUCCESS_SEQUENCE);
+        if (res->datum_count() == 0) res->set_type(Response::SUCCESS_SEQUENCE);
         break;
     case feed_type_t::stream:
-        res->add_notes(Response::SEQUENCE_FEED);
+        res->add_note(Response::SEQUENCE_FEED);
         break;
     case feed_type_t::point:
-        res->add_notes(Response::ATOM_FEED);
+        res->add_note(Response::ATOM_FEED);
         break;
     case feed_type_t::orderby_limit:
-        res->add_notes(Response::ORDER_BY_LIMIT_FEED);
+        res->add_note(Response::ORDER_BY_LIMIT_FEED);
         break;
     case feed_type_t::unioned:
-        res->add_notes(Response::UNIONED_FEED);
+        res->add_note(Response::UNIONED_FEED);
         break;
     default: unreachable();
     }
@@ -367,4 +589,16 @@ query_cache_t::entry_t::entry_t(protob_t<Query> _original_query,
 
 query_cache_t::entry_t::~entry_t() { }
 
+query_cache_t::prepared_t::prepared_t(
+            protob_t<Query> _original_query,
+            protob_t<Query> _unprocessed_query,
+            backtrace_registry_t &&_bt_reg,
+            std::map<std::string, wire_func_t> &&_global_optargs,
+            counted_t<const term_t> _func_term) :
+        original_query(_original_query),
+        unprocessed_query(_unprocessed_query),
+        bt_reg(std::move(_bt_reg)),
+        global_optargs(std::move(_global_optargs)),
+        func_term(_func_term) { }
+
 } // namespace ql
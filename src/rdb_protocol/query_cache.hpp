@@ -8,6 +8,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "arch/address.hpp"
 #include "concurrency/auto_drainer.hpp"
@@ -23,6 +24,8 @@
 #include "rdb_protocol/backtrace.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/response.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/term.hpp"
 
 namespace ql {
@@ -49,6 +52,7 @@ private:
 
 class query_cache_t : public home_thread_mixin_t {
     struct entry_t;
+    struct prepared_t;
 public:
     query_cache_t(rdb_context_t *_rdb_ctx,
                   ip_and_port_t _client_addr_port,
@@ -60,7 +64,7 @@ public:
     class ref_t {
     public:
         ~ref_t();
-        void fill_response(Response *res);
+        void fill_response(response_t *res);
     private:
         friend class query_cache_t;
         ref_t(query_cache_t *_query_cache,
@@ -69,8 +73,8 @@ public:
               use_json_t _use_json,
               signal_t *interruptor);
 
-        void run(env_t *env, Response *res); // Run a new query
-        void serve(env_t *env, Response *res); // Serve a batch from a stream
+        void run(env_t *env, response_t *res); // Run a new query
+        void serve(env_t *env, response_t *res); // Serve a batch from a stream
 
         query_cache_t::entry_t *const entry;
         const int64_t token;
@@ -106,11 +110,44 @@ public:
                             use_json_t use_json,
                             signal_t *interruptor);
 
+    // Compiles the function of a PREPARE query and keeps it under the query's
+    // token until that token is stopped or the connection is closed.
+    void prepare(int64_t token, protob_t<Query> original_query);
+
+    // Starts an EXECUTE query, which calls a prepared function with the
+    // arguments it carries.  It's run and continued like a START query.
+    scoped_ptr_t<ref_t> execute(int64_t token,
+                                protob_t<Query> original_query,
+                                use_json_t use_json,
+                                signal_t *interruptor);
+
     void noreply_wait(const query_id_t &query_id,
                       int64_t token,
                       signal_t *interruptor);
 
 private:
+    struct prepared_t : public single_threaded_countable_t<prepared_t> {
+        prepared_t(protob_t<Query> _original_query,
+                   protob_t<Query> _unprocessed_query,
+                   backtrace_registry_t &&_bt_reg,
+                   std::map<std::string, wire_func_t> &&_global_optargs,
+                   counted_t<const term_t> _func_term);
+
+        const protob_t<Query> original_query;
+        // A copy of the query from before it was preprocessed, which is only kept
+        // if it uses `r.now()`.  Preprocessing replaces `r.now()` with the time,
+        // so these queries are compiled again from this for every EXECUTE.
+        const protob_t<Query> unprocessed_query;
+        const backtrace_registry_t bt_reg;
+        const std::map<std::string, wire_func_t> global_optargs;
+        const counted_t<const term_t> func_term;
+        // The cached tables the query might write to.
+        result_cache_t::written_tables_t written_tables;
+
+    private:
+        DISABLE_COPYING(prepared_t);
+    };
+
     struct entry_t {
         entry_t(protob_t<Query> _original_query,
                 backtrace_registry_t &&_bt_reg,
@@ -138,6 +175,24 @@ private:
         counted_t<datum_stream_t> stream;
         bool has_sent_batch;
 
+        // Set if the result can be cached (see `result_cache_t`).
+        scoped_ptr_t<result_cache_t::key_t> result_cache_key;
+        // The cached tables the query might write to.
+        result_cache_t::written_tables_t written_tables;
+
+        // Set for EXECUTE queries, whose root term is the prepared function,
+        // which gets called with `args`.
+        counted_t<const prepared_t> prepared;
+        std::vector<datum_t> args;
+
+        // The backtraces of the root term, which are the prepared query's for an
+        // EXECUTE query that wasn't compiled again.
+        const backtrace_registry_t &backtraces() const {
+            return prepared.has() && !prepared->unprocessed_query.has()
+                ? prepared->bt_reg
+                : bt_reg;
+        }
+
         // The order of these is very important, do not move them around
         new_mutex_t mutex; // Only one coroutine may be using this query at a time
         auto_drainer_t drainer; // Keep this entry alive until all refs are destroyed
@@ -146,6 +201,8 @@ private:
         DISABLE_COPYING(entry_t);
     };
 
+    // Throws if a query or prepared query already has `token`.
+    void check_token_unused(int64_t token) const;
     void terminate_internal(entry_t *entry);
     static void async_destroy_entry(entry_t *entry);
 
@@ -153,6 +210,8 @@ private:
     ip_and_port_t client_addr_port;
     return_empty_normal_batches_t return_empty_normal_batches;
     std::map<int64_t, scoped_ptr_t<entry_t> > queries;
+    // These are counted because running EXECUTE queries hold on to them.
+    std::map<int64_t, counted_t<const prepared_t> > prepared_queries;
 
     // Used for noreply waiting, this contains all allocated-but-incomplete query ids
     friend class query_id_t;
@@ -7,14 +7,18 @@
 #include "rdb_protocol/backtrace.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/json_cache.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/response.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
 rdb_query_server_t::rdb_query_server_t(const std::set<ip_address_t> &local_addresses,
                                        int port,
+                                       bool reuse_port,
                                        rdb_context_t *_rdb_ctx) :
-    server(_rdb_ctx, local_addresses, port, this, default_http_timeout_sec),
+    server(_rdb_ctx, local_addresses, port, reuse_port, this,
+           default_http_timeout_sec),
     rdb_ctx(_rdb_ctx),
     thread_counters(0) { }
 
@@ -30,14 +34,14 @@ int rdb_query_server_t::get_port() const {
 namespace ql {
     void run(ql::query_id_t &&query_id,
              protob_t<Query> q,
-             Response *response_out,
+             ql::response_t *response_out,
              ql::query_cache_t *query_cache,
              signal_t *interruptor);
 }
 
 void rdb_query_server_t::run_query(ql::query_id_t &&query_id,
                                    const ql::protob_t<Query> &query,
-                                   Response *response_out,
+                                   ql::response_t *response_out,
                                    ql::query_cache_t *query_cache,
                                    signal_t *interruptor) {
     guarantee(query_cache != NULL);
@@ -45,6 +49,7 @@ void rdb_query_server_t::run_query(ql::query_id_t &&query_id,
     try {
         scoped_perfmon_counter_t client_active(&rdb_ctx->stats.clients_active); // TODO: make this correct for parallelized queries
         guarantee(rdb_ctx->cluster_interface);
+        response_out->set_json_caches(rdb_ctx->json_caches);
         // `ql::run` will set the status code
         ql::run(std::move(query_id), query, response_out, query_cache, interruptor);
     } catch (const interrupted_exc_t &ex) {
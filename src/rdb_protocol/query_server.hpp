@@ -14,6 +14,7 @@ namespace ql {
 template <class> class protob_t;
 class query_id_t;
 class query_cache_t;
+class response_t;
 }
 class rdb_context_t;
 
@@ -25,6 +26,7 @@ class rdb_query_server_t : public query_handler_t {
 public:
     rdb_query_server_t(const std::set<ip_address_t> &local_addresses,
                        int port,
+                       bool reuse_port,
                        rdb_context_t *_rdb_ctx);
 
     http_app_t *get_http_app();
@@ -32,7 +34,7 @@ public:
 
     void run_query(ql::query_id_t &&query_id,
                    const ql::protob_t<Query> &query,
-                   Response *response_out,
+                   ql::response_t *response_out,
                    ql::query_cache_t *query_cache,
                    signal_t *interruptor);
 public:
@@ -82,6 +82,11 @@ ql::datum_t real_table_t::read_row(ql::env_t *env,
     return p_res->data;
 }
 
+bool real_table_t::get_read_thread(ql::datum_t pval, threadnum_t *thread_out) {
+    return namespace_access.get()->get_read_thread(
+        store_key_t(pval.print_primary()), thread_out);
+}
+
 counted_t<ql::datum_stream_t> real_table_t::read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -130,6 +130,8 @@ public:
     std::map<std::string, ql::datum_t> sindex_status(ql::env_t *env,
         const std::set<std::string> &sindexes);
 
+    bool get_read_thread(ql::datum_t pval, threadnum_t *thread_out);
+
     /* These are not part of the `base_table_t` interface. They wrap the `read()`,
     `read_outdated()`, and `write()` methods of the underlying `namespace_interface_t` to
     add profiling information. Specifically, they:
@@ -0,0 +1,252 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/response.hpp"
+
+#include <string.h>
+
+#include <limits>
+
+#include "rdb_protocol/backtrace.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace ql {
+
+// The keys are single characters for compatibility with `json_shim`'s old output.
+static const char json_data_prefix[] = "{\"r\":[";
+
+response_t::response_t(response_format_t format)
+    : format_(format),
+      datum_count_(0),
+      has_json_profile(false),
+      json_finished(false),
+      json_caches(NULL),
+      binary_header_size(0) {
+    if (format_ == response_format_t::JSON) {
+        start_json();
+    } else if (format_ == response_format_t::BINARY) {
+        binary_data.init(new write_message_t());
+    }
+}
+
+void response_t::start_json() {
+    json_data.truncate(0);
+    json_data.append(json_data_prefix, strlen(json_data_prefix));
+}
+
+void response_t::clear() {
+    pb.Clear();
+    datum_count_ = 0;
+    if (format_ != response_format_t::PROTOBUF) {
+        json_data.truncate(0);
+        json_profile.Clear();
+        has_json_profile = false;
+        json_finished = false;
+    }
+    if (format_ == response_format_t::JSON) {
+        start_json();
+    } else if (format_ == response_format_t::BINARY) {
+        binary_data.init(new write_message_t());
+    }
+}
+
+void response_t::add_datum(const datum_t &datum, use_json_t use_json) {
+    switch (format_) {
+    case response_format_t::PROTOBUF: {
+        Datum d;
+        datum.write_to_protobuf(&d, use_json);
+        pb.add_response()->Swap(&d);
+    } break;
+    case response_format_t::JSON: {
+        guarantee(!json_finished);
+        const size_t old_size = json_data.size();
+        try {
+            if (datum_count_ != 0) {
+                json_data.Put(',');
+            }
+            json_cache_t::key_t key;
+            if (json_caches != NULL && json_cache_t::make_key(datum, &key)) {
+                add_cacheable_json(datum, key);
+            } else {
+                json_writer.Reset(json_data);
+                datum.write_json(&json_writer);
+            }
+        } catch (...) {
+            json_data.truncate(old_size);
+            throw;
+        }
+    } break;
+    case response_format_t::BINARY: {
+        guarantee(!json_finished);
+        // This is `VersionDummy::BINARY_DATUM_V1` as long as `datum_serialize`
+        // doesn't change its output, which the `Response.BinaryDatumFormat` unit
+        // test checks.  For data that were read from disk, this just reads the
+        // size from the serialization, and `datum_serialize` then copies it as it
+        // is.
+        const size_t size =
+            datum_serialized_size(datum, check_datum_serialization_errors_t::NO);
+        rcheck_datum(size <= std::numeric_limits<uint32_t>::max(),
+                     base_exc_t::GENERIC,
+                     strprintf("Datum too large to send (%zu bytes).", size).c_str());
+        const uint32_t size32 = static_cast<uint32_t>(size);
+        binary_data->append(&size32, sizeof(size32));
+        datum_serialize(binary_data.get(), datum,
+                        check_datum_serialization_errors_t::NO);
+    } break;
+    default: unreachable();
+    }
+    ++datum_count_;
+}
+
+void response_t::add_cacheable_json(const datum_t &datum,
+                                    const json_cache_t::key_t &key) {
+    json_cache_t *cache = json_caches->get();
+    if (const std::string *json = cache->find(key)) {
+        json_data.append(json->data(), json->size());
+    } else if (cache->should_insert(key)) {
+        rapidjson::StringBuffer buf;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+        datum.write_json(&writer);
+        cache->insert(key, buf.GetString(), buf.GetSize());
+        json_data.append(buf.GetString(), buf.GetSize());
+    } else {
+        json_writer.Reset(json_data);
+        datum.write_json(&json_writer);
+    }
+}
+
+void response_t::set_profile(const datum_t &profile, use_json_t use_json) {
+    switch (format_) {
+    case response_format_t::PROTOBUF: {
+        profile.write_to_protobuf(pb.mutable_profile(), use_json);
+    } break;
+    case response_format_t::JSON: // fallthru
+    case response_format_t::BINARY: {
+        guarantee(!json_finished);
+        json_profile.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(json_profile);
+        profile.write_json(&writer);
+        has_json_profile = true;
+    } break;
+    default: unreachable();
+    }
+}
+
+void response_t::set_error(Response::ResponseType type,
+                           const std::string &message,
+                           datum_t backtrace) {
+    guarantee(type == Response::CLIENT_ERROR ||
+              type == Response::COMPILE_ERROR ||
+              type == Response::RUNTIME_ERROR);
+    pb.set_type(type);
+    pb.clear_response();
+    pb.clear_profile();
+    switch (format_) {
+    case response_format_t::PROTOBUF: {
+        Datum *error_msg = pb.add_response();
+        error_msg->set_type(Datum::R_STR);
+        error_msg->set_r_str(message);
+    } break;
+    case response_format_t::JSON: {
+        guarantee(!json_finished);
+        start_json();
+        json_writer.Reset(json_data);
+        json_writer.String(message.data(), message.size());
+        json_profile.Clear();
+        has_json_profile = false;
+    } break;
+    case response_format_t::BINARY: {
+        guarantee(!json_finished);
+        binary_data.init(new write_message_t());
+        add_datum(datum_t(datum_string_t(message)), use_json_t::NO);
+        json_profile.Clear();
+        has_json_profile = false;
+    } break;
+    default: unreachable();
+    }
+    datum_count_ = 1;
+    fill_backtrace(pb.mutable_backtrace(), backtrace);
+}
+
+const Response &response_t::protobuf() const {
+    guarantee(format_ == response_format_t::PROTOBUF);
+    return pb;
+}
+
+void response_t::write_json_fields() {
+    json_data.append("\"t\":", 4);
+    json_writer.Reset(json_data);
+    json_writer.Int(pb.type());
+
+    json_data.append(",\"n\":", 5);
+    json_writer.Reset(json_data);
+    json_writer.StartArray();
+    for (int i = 0; i < pb.notes_size(); ++i) {
+        json_writer.Int(pb.notes(i));
+    }
+    json_writer.EndArray();
+
+    if (pb.has_backtrace()) {
+        json_data.append(",\"b\":", 5);
+        json_writer.Reset(json_data);
+        json_writer.StartArray();
+        const Backtrace &bt = pb.backtrace();
+        for (int i = 0; i < bt.frames_size(); ++i) {
+            const Frame &f = bt.frames(i);
+            switch (f.type()) {
+            case Frame::POS:
+                json_writer.Uint64(f.pos());
+                break;
+            case Frame::OPT:
+                json_writer.String(f.opt().data(), f.opt().size());
+                break;
+            default:
+                unreachable();
+            }
+        }
+        json_writer.EndArray();
+    }
+
+    if (has_json_profile) {
+        json_data.append(",\"p\":", 5);
+        json_data.append(json_profile.GetString(), json_profile.GetSize());
+    }
+}
+
+const chained_buffer_t &response_t::finish_json() {
+    guarantee(format_ == response_format_t::JSON);
+    guarantee(!json_finished);
+    json_finished = true;
+
+    json_data.append("],", 2);
+    write_json_fields();
+    json_data.Put('}');
+    return json_data;
+}
+
+size_t response_t::finish_binary(std::vector<iovec> *out) {
+    guarantee(format_ == response_format_t::BINARY);
+    guarantee(!json_finished);
+    json_finished = true;
+
+    json_data.truncate(0);
+    json_data.Put('{');
+    write_json_fields();
+    json_data.Put('}');
+    binary_header_size = static_cast<uint32_t>(json_data.size());
+
+    iovec size_iov;
+    size_iov.iov_base = &binary_header_size;
+    size_iov.iov_len = sizeof(binary_header_size);
+    out->push_back(size_iov);
+    json_data.append_iovecs(out);
+
+    intrusive_list_t<write_buffer_t> *buffers = binary_data->unsafe_expose_buffers();
+    for (write_buffer_t *b = buffers->head(); b != NULL; b = buffers->next(b)) {
+        iovec iov;
+        iov.iov_base = b->data;
+        iov.iov_len = b->size;
+        out->push_back(iov);
+    }
+    return sizeof(binary_header_size) + json_data.size() + binary_data->size();
+}
+
+} // namespace ql
@@ -0,0 +1,115 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESPONSE_HPP_
+#define RDB_PROTOCOL_RESPONSE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+#include "containers/chained_buffer.hpp"
+#include "containers/scoped.hpp"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/json_cache.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+// How the response is going to be sent to the client; this is decided by the
+// wire protocol the client asked for.
+enum class response_format_t { PROTOBUF, JSON, BINARY };
+
+// The response to a query, as it's built up while the query runs.
+//
+// With the protobuf format everything goes into a `Response` protobuf.  With the
+// JSON format the data are written as JSON straight into a `chained_buffer_t` as
+// they're added (documents that are read often can come from `json_cache_t`), and the
+// protobuf only holds the small stuff (type, notes and backtrace) until
+// `finish_json` appends it to the end of the JSON object.  That way a large batch
+// is serialized exactly once, and its buffers can be handed to `writev` as they
+// are.
+//
+// The binary format works like the JSON one, except that the data are written
+// with `datum_serialize`, which copies data read from disk as they are, and the
+// small stuff goes into a JSON header in front of them (see `ql2.proto`).
+class response_t {
+public:
+    explicit response_t(response_format_t format);
+
+    response_format_t format() const { return format_; }
+
+    // Drops everything that has been added so far.
+    void clear();
+
+    void set_token(int64_t token) { pb.set_token(token); }
+    int64_t token() const { return pb.token(); }
+
+    void set_type(Response::ResponseType type) { pb.set_type(type); }
+    Response::ResponseType type() const { return pb.type(); }
+
+    void add_note(Response::ResponseNote note) { pb.add_notes(note); }
+
+    // Only matters for the JSON format: documents are looked up in the current
+    // thread's cache in `caches`, if it's not NULL.
+    void set_json_caches(json_caches_t *caches) { json_caches = caches; }
+
+    // `use_json` only matters for the protobuf format.  If `datum` can't be
+    // serialized this throws and leaves the response as it was.
+    void add_datum(const datum_t &datum, use_json_t use_json);
+    size_t datum_count() const { return datum_count_; }
+
+    void set_profile(const datum_t &profile, use_json_t use_json);
+
+    // Replaces the data (and profile) with an error message.
+    void set_error(Response::ResponseType type,
+                   const std::string &message,
+                   datum_t backtrace);
+
+    // Only for `response_format_t::PROTOBUF`.
+    const Response &protobuf() const;
+
+    // Only for `response_format_t::JSON`.  Closes the JSON object and returns it;
+    // nothing can be added to the response after this.
+    const chained_buffer_t &finish_json();
+
+    // Only for `response_format_t::BINARY`.  Appends iovecs for the whole
+    // response to `out` and returns its size; nothing can be added to the
+    // response after this.  The iovecs point into the response.
+    size_t finish_binary(std::vector<iovec> *out);
+
+private:
+    void start_json();
+    // Appends the JSON for a document that `json_cache_t` can cache, from the
+    // cache if it's there.
+    void add_cacheable_json(const datum_t &datum, const json_cache_t::key_t &key);
+    // Writes the type, notes, backtrace and profile as the fields of a JSON
+    // object, without the braces.
+    void write_json_fields();
+
+    const response_format_t format_;
+    // Everything for the protobuf format, and everything but the data and the
+    // profile for the JSON and binary formats.
+    Response pb;
+    size_t datum_count_;
+
+    // The JSON and binary formats.  For JSON `json_data` holds `{"r":[` followed
+    // by the data; for binary it's empty until it gets the header.
+    chained_buffer_t json_data;
+    rapidjson::Writer<chained_buffer_t> json_writer;
+    rapidjson::StringBuffer json_profile;
+    bool has_json_profile;
+    bool json_finished;
+    json_caches_t *json_caches;
+
+    // The binary format only: each datum with a 32-bit size in front of it, and
+    // the size of the header, which is sent from here.
+    scoped_ptr_t<write_message_t> binary_data;
+    uint32_t binary_header_size;
+
+    DISABLE_COPYING(response_t);
+};
+
+} // namespace ql
+
+#endif // RDB_PROTOCOL_RESPONSE_HPP_
@@ -0,0 +1,730 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/result_cache.hpp"
+
+#include <algorithm>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace ql {
+
+// How long to wait before trying to open a table's changefeed again.
+static const int64_t watch_retry_ms = 1000;
+
+// A rough guess at what the hash table and the allocator add to each entry.
+static const size_t entry_overhead = 128;
+
+// Returns true for the terms whose value only depends on their arguments and the
+// contents of the tables they read.
+static bool term_is_cacheable(Term::TermType type) {
+    switch (type) {
+    case Term::DATUM:
+    case Term::MAKE_ARRAY:
+    case Term::MAKE_OBJ:
+    case Term::BINARY:
+    case Term::VAR:
+    case Term::IMPLICIT_VAR:
+    case Term::FUNC:
+    case Term::FUNCALL:
+    case Term::ARGS:
+    case Term::ERROR:
+    case Term::DB:
+    case Term::TABLE:
+    case Term::GET:
+    case Term::GET_ALL:
+    case Term::BETWEEN_DEPRECATED:
+    case Term::BETWEEN:
+    case Term::GET_INTERSECTING:
+    case Term::GET_NEAREST:
+    case Term::EQ:
+    case Term::NE:
+    case Term::LT:
+    case Term::LE:
+    case Term::GT:
+    case Term::GE:
+    case Term::NOT:
+    case Term::AND:
+    case Term::OR:
+    case Term::BRANCH:
+    case Term::DEFAULT:
+    case Term::ADD:
+    case Term::SUB:
+    case Term::MUL:
+    case Term::DIV:
+    case Term::MOD:
+    case Term::FLOOR:
+    case Term::CEIL:
+    case Term::ROUND:
+    case Term::APPEND:
+    case Term::PREPEND:
+    case Term::DIFFERENCE:
+    case Term::SET_INSERT:
+    case Term::SET_INTERSECTION:
+    case Term::SET_UNION:
+    case Term::SET_DIFFERENCE:
+    case Term::SLICE:
+    case Term::SKIP:
+    case Term::LIMIT:
+    case Term::OFFSETS_OF:
+    case Term::CONTAINS:
+    case Term::GET_FIELD:
+    case Term::KEYS:
+    case Term::OBJECT:
+    case Term::HAS_FIELDS:
+    case Term::WITH_FIELDS:
+    case Term::PLUCK:
+    case Term::WITHOUT:
+    case Term::MERGE:
+    case Term::LITERAL:
+    case Term::REDUCE:
+    case Term::MAP:
+    case Term::FILTER:
+    case Term::CONCAT_MAP:
+    case Term::ORDER_BY:
+    case Term::ASC:
+    case Term::DESC:
+    case Term::DISTINCT:
+    case Term::COUNT:
+    case Term::IS_EMPTY:
+    case Term::UNION:
+    case Term::NTH:
+    case Term::BRACKET:
+    case Term::INNER_JOIN:
+    case Term::OUTER_JOIN:
+    case Term::EQ_JOIN:
+    case Term::ZIP:
+    case Term::RANGE:
+    case Term::INSERT_AT:
+    case Term::DELETE_AT:
+    case Term::CHANGE_AT:
+    case Term::SPLICE_AT:
+    case Term::COERCE_TO:
+    case Term::TYPE_OF:
+    case Term::GROUP:
+    case Term::SUM:
+    case Term::AVG:
+    case Term::MIN:
+    case Term::MAX:
+    case Term::UNGROUP:
+    case Term::MATCH:
+    case Term::SPLIT:
+    case Term::UPCASE:
+    case Term::DOWNCASE:
+    case Term::JSON:
+    case Term::TO_JSON_STRING:
+    case Term::ISO8601:
+    case Term::TO_ISO8601:
+    case Term::EPOCH_TIME:
+    case Term::TO_EPOCH_TIME:
+    case Term::IN_TIMEZONE:
+    case Term::DURING:
+    case Term::DATE:
+    case Term::TIME_OF_DAY:
+    case Term::TIMEZONE:
+    case Term::TIME:
+    case Term::YEAR:
+    case Term::MONTH:
+    case Term::DAY:
+    case Term::DAY_OF_WEEK:
+    case Term::DAY_OF_YEAR:
+    case Term::HOURS:
+    case Term::MINUTES:
+    case Term::SECONDS:
+    case Term::MONDAY:
+    case Term::TUESDAY:
+    case Term::WEDNESDAY:
+    case Term::THURSDAY:
+    case Term::FRIDAY:
+    case Term::SATURDAY:
+    case Term::SUNDAY:
+    case Term::JANUARY:
+    case Term::FEBRUARY:
+    case Term::MARCH:
+    case Term::APRIL:
+    case Term::MAY:
+    case Term::JUNE:
+    case Term::JULY:
+    case Term::AUGUST:
+    case Term::SEPTEMBER:
+    case Term::OCTOBER:
+    case Term::NOVEMBER:
+    case Term::DECEMBER:
+    case Term::GEOJSON:
+    case Term::TO_GEOJSON:
+    case Term::POINT:
+    case Term::LINE:
+    case Term::POLYGON:
+    case Term::DISTANCE:
+    case Term::INTERSECTS:
+    case Term::INCLUDES:
+    case Term::CIRCLE:
+    case Term::FILL:
+    case Term::POLYGON_SUB:
+    case Term::MINVAL:
+    case Term::MAXVAL:
+        return true;
+    // Writes, and terms whose value depends on the time, randomness, the outside
+    // world or the cluster's configuration.
+    case Term::INSERT:
+    case Term::UPDATE:
+    case Term::REPLACE:
+    case Term::DELETE:
+    case Term::FOR_EACH:
+    case Term::DB_CREATE:
+    case Term::DB_DROP:
+    case Term::DB_LIST:
+    case Term::TABLE_CREATE:
+    case Term::TABLE_DROP:
+    case Term::TABLE_LIST:
+    case Term::CONFIG:
+    case Term::STATUS:
+    case Term::WAIT:
+    case Term::RECONFIGURE:
+    case Term::REBALANCE:
+    case Term::SYNC:
+    case Term::INDEX_CREATE:
+    case Term::INDEX_DROP:
+    case Term::INDEX_LIST:
+    case Term::INDEX_STATUS:
+    case Term::INDEX_WAIT:
+    case Term::INDEX_RENAME:
+    case Term::CHANGES:
+    case Term::INFO:
+    case Term::SAMPLE:
+    case Term::NOW:
+    case Term::RANDOM:
+    case Term::UUID:
+    case Term::HTTP:
+    case Term::JAVASCRIPT:
+        return false;
+    default: unreachable();
+    }
+}
+
+// Returns true for writes whose tables we can find, by looking for the table terms
+// in the query.
+static bool term_is_data_write(Term::TermType type) {
+    return type == Term::INSERT
+        || type == Term::UPDATE
+        || type == Term::REPLACE
+        || type == Term::DELETE;
+}
+
+// Returns true for meta queries that can change what a table name refers to, or
+// whether queries on a table succeed.
+static bool term_is_meta_write(Term::TermType type) {
+    return type == Term::DB_CREATE
+        || type == Term::DB_DROP
+        || type == Term::TABLE_CREATE
+        || type == Term::TABLE_DROP
+        || type == Term::INDEX_CREATE
+        || type == Term::INDEX_DROP
+        || type == Term::INDEX_RENAME
+        || type == Term::RECONFIGURE
+        || type == Term::REBALANCE;
+}
+
+// Length-prefixes `s`, so that no two different terms have the same key.
+static void append_string(const std::string &s, std::string *out) {
+    const uint64_t size = s.size();
+    out->append(reinterpret_cast<const char *>(&size), sizeof(size));
+    out->append(s);
+}
+
+static void append_int(int64_t i, std::string *out) {
+    out->append(reinterpret_cast<const char *>(&i), sizeof(i));
+}
+
+// Returns the string in `term` if it's a string datum.
+static bool get_literal_string(const Term &term, std::string *str_out) {
+    if (term.type() != Term::DATUM || !term.has_datum()
+        || term.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *str_out = term.datum().r_str();
+    return true;
+}
+
+static bool get_db_name(const Term &term, std::string *name_out) {
+    return term.type() == Term::DB && term.args_size() == 1
+        && get_literal_string(term.args(0), name_out);
+}
+
+// Returns the optargs of `pairs` ordered by key.
+template <class pairs_t>
+static std::vector<std::pair<std::string, const Term *> > sorted_optargs(
+        const pairs_t &pairs) {
+    std::vector<std::pair<std::string, const Term *> > res;
+    res.reserve(pairs.size());
+    for (int i = 0; i < pairs.size(); ++i) {
+        res.push_back(std::make_pair(pairs.Get(i).key(), &pairs.Get(i).val()));
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+result_cache_t::thread_cache_t::thread_cache_t(size_t _max_memory)
+    : max_memory(_max_memory), memory_usage(0) { }
+
+result_cache_t::thread_cache_t::~thread_cache_t() {
+    while (entry_t *entry = lru.head()) {
+        remove(entry);
+    }
+}
+
+void result_cache_t::thread_cache_t::remove(entry_t *entry) {
+    memory_usage -= entry->memory_usage;
+    entries.erase(entry->query);
+    lru.remove(entry);
+    delete entry;
+}
+
+result_cache_t::write_t::write_t(const written_tables_t &_tables)
+    : tables(_tables) {
+    for (table_t *table : tables) {
+        table->bump();
+    }
+}
+
+result_cache_t::write_t::~write_t() {
+    for (table_t *table : tables) {
+        table->bump();
+    }
+}
+
+result_cache_t::result_cache_t(rdb_context_t *_ctx,
+                               const result_cache_config_t &config)
+    : ctx(_ctx),
+      thread_caches(config.max_memory / get_num_threads()),
+      configs_watched(false) {
+    if (!config.tables.empty()) {
+        coro_t::spawn_sometime(std::bind(&result_cache_t::watch_table_configs,
+                                         this, drainer.lock()));
+    }
+    for (const auto &name : config.tables) {
+        scoped_ptr_t<table_t> table(new table_t(name.first, name.second));
+        coro_t::spawn_sometime(std::bind(&result_cache_t::watch_table,
+                                         this, table.get(), drainer.lock()));
+        tables.insert(std::make_pair(
+            std::make_pair(name.first.str(), name.second.str()), std::move(table)));
+    }
+    guarantee(ctx->result_cache == NULL);
+    ctx->result_cache = this;
+}
+
+result_cache_t::~result_cache_t() {
+    ctx->result_cache = NULL;
+}
+
+bool result_cache_t::make_key(const Query &query,
+                              key_t *key_out,
+                              written_tables_t *written_out) const {
+    if (!query.has_query()) {
+        return false;
+    }
+
+    const Term *default_db = NULL;
+    bool cacheable = true;
+    for (int i = 0; i < query.global_optargs_size(); ++i) {
+        const Query::AssocPair &optarg = query.global_optargs(i);
+        if (optarg.key() == "db") {
+            default_db = &optarg.val();
+        } else if (optarg.key() == "noreply" || optarg.key() == "profile") {
+            // Neither is worth caching, and profiles aren't deterministic.
+            cacheable = false;
+        }
+    }
+
+    if (cacheable) {
+        std::set<table_t *> read_tables;
+        std::string key;
+        if (append_term(query.query(), default_db, &key, &read_tables)) {
+            for (const auto &optarg : sorted_optargs(query.global_optargs())) {
+                append_string(optarg.first, &key);
+                if (!append_term(*optarg.second, NULL, &key, &read_tables)) {
+                    cacheable = false;
+                    break;
+                }
+            }
+            // A query that doesn't read a table is cheap to run anyway.
+            if (cacheable && !read_tables.empty()) {
+                std::vector<std::pair<table_t *, uint64_t> > versions;
+                for (table_t *table : read_tables) {
+                    const uint64_t version = table->get_version();
+                    if (version % 2 != 0) {
+                        // The table isn't watched, so we can't tell when it
+                        // changes.
+                        return false;
+                    }
+                    versions.push_back(std::make_pair(table, version));
+                }
+                key_out->query = std::move(key);
+                key_out->versions = std::move(versions);
+                return true;
+            }
+        }
+    }
+
+    write_scan_t scan;
+    find_writes(query.query(), default_db, &scan);
+    if (scan.writes) {
+        written_out->clear();
+        if (scan.all_tables) {
+            for (const auto &pair : tables) {
+                written_out->push_back(pair.second.get());
+            }
+        } else {
+            written_out->assign(scan.tables.begin(), scan.tables.end());
+        }
+    }
+    return false;
+}
+
+bool result_cache_t::append_term(const Term &term,
+                                 const Term *default_db,
+                                 std::string *key_out,
+                                 std::set<table_t *> *tables_out) const {
+    if (!term_is_cacheable(term.type())) {
+        return false;
+    }
+    if (term.type() == Term::DB) {
+        std::string db_name;
+        if (!get_db_name(term, &db_name)) {
+            return false;
+        }
+    } else if (term.type() == Term::TABLE) {
+        table_t *table;
+        if (!find_table(term, default_db, &table) || table == NULL) {
+            return false;
+        }
+        tables_out->insert(table);
+    }
+
+    append_int(term.type(), key_out);
+    if (term.type() == Term::DATUM) {
+        if (!term.has_datum()) {
+            return false;
+        }
+        append_string(term.datum().SerializeAsString(), key_out);
+    }
+    append_int(term.args_size(), key_out);
+    for (int i = 0; i < term.args_size(); ++i) {
+        if (!append_term(term.args(i), default_db, key_out, tables_out)) {
+            return false;
+        }
+    }
+    append_int(term.optargs_size(), key_out);
+    for (const auto &optarg : sorted_optargs(term.optargs())) {
+        append_string(optarg.first, key_out);
+        if (!append_term(*optarg.second, default_db, key_out, tables_out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool result_cache_t::find_table(const Term &term,
+                                const Term *default_db,
+                                table_t **table_out) const {
+    guarantee(term.type() == Term::TABLE);
+    std::string db_name;
+    std::string table_name;
+    if (term.args_size() == 1) {
+        if (default_db == NULL) {
+            db_name = default_db_name;
+        } else if (!get_db_name(*default_db, &db_name)) {
+            return false;
+        }
+        if (!get_literal_string(term.args(0), &table_name)) {
+            return false;
+        }
+    } else if (term.args_size() == 2) {
+        if (!get_db_name(term.args(0), &db_name)
+            || !get_literal_string(term.args(1), &table_name)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    auto it = tables.find(std::make_pair(db_name, table_name));
+    *table_out = it == tables.end() ? NULL : it->second.get();
+    return true;
+}
+
+void result_cache_t::find_writes(const Term &term,
+                                 const Term *default_db,
+                                 write_scan_t *scan) const {
+    if (term_is_data_write(term.type())) {
+        scan->writes = true;
+    } else if (term_is_meta_write(term.type())) {
+        scan->writes = true;
+        scan->all_tables = true;
+    } else if (term.type() == Term::TABLE) {
+        table_t *table;
+        if (!find_table(term, default_db, &table)) {
+            scan->all_tables = true;
+        } else if (table != NULL) {
+            scan->tables.insert(table);
+        } else if (term.args_size() == 2) {
+            // Writes to the system tables can rename or delete tables.
+            std::string db_name;
+            if (get_db_name(term.args(0), &db_name) && db_name == "rethinkdb") {
+                scan->all_tables = true;
+            }
+        }
+    }
+    for (int i = 0; i < term.args_size(); ++i) {
+        find_writes(term.args(i), default_db, scan);
+    }
+    for (int i = 0; i < term.optargs_size(); ++i) {
+        find_writes(term.optargs(i).val(), default_db, scan);
+    }
+}
+
+datum_t result_cache_t::find(const key_t &key) {
+    thread_cache_t *cache = thread_caches.get();
+    auto it = cache->entries.find(key.query);
+    if (it != cache->entries.end()) {
+        entry_t *entry = it->second;
+        if (entry->versions == key.versions) {
+            cache->lru.remove(entry);
+            cache->lru.push_front(entry);
+            ++ctx->stats.result_cache_hits;
+            return entry->result;
+        }
+        // One of the tables has changed since.
+        cache->remove(entry);
+    }
+    ++ctx->stats.result_cache_misses;
+    return datum_t();
+}
+
+void result_cache_t::insert(const key_t &key, const datum_t &result) {
+    thread_cache_t *cache = thread_caches.get();
+    const size_t memory_usage = sizeof(entry_t) + entry_overhead
+        + 2 * key.query.size()
+        + key.versions.size() * sizeof(key.versions[0])
+        + datum_serialized_size(result, check_datum_serialization_errors_t::NO);
+    // Don't let one large result flush out everything else.
+    if (memory_usage > cache->max_memory / 4) {
+        return;
+    }
+
+    auto it = cache->entries.find(key.query);
+    if (it != cache->entries.end()) {
+        cache->remove(it->second);
+    }
+    entry_t *entry = new entry_t;
+    entry->query = key.query;
+    entry->versions = key.versions;
+    entry->result = result;
+    entry->memory_usage = memory_usage;
+    cache->entries.insert(std::make_pair(entry->query, entry));
+    cache->lru.push_front(entry);
+    cache->memory_usage += memory_usage;
+
+    while (cache->memory_usage > cache->max_memory) {
+        cache->remove(cache->lru.tail());
+    }
+}
+
+void result_cache_t::watch_table(table_t *table, auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    try {
+        for (;;) {
+            cond_t stale;
+            wait_any_t interruptor(&stale, keepalive.get_drain_signal());
+            table->stale = &stale;
+            try {
+                watch_table_once(table, &interruptor);
+            } catch (const interrupted_exc_t &) {
+                if (keepalive.get_drain_signal()->is_pulsed()) {
+                    table->stale = NULL;
+                    throw;
+                }
+            } catch (const base_exc_t &) {
+                // The table doesn't exist, or isn't available; we'll try again.
+            }
+            table->stale = NULL;
+            if (table->get_version() % 2 == 0) {
+                // Stop using the results we have, and don't cache any more.
+                __sync_add_and_fetch(&table->version, 1);
+            }
+            if (!stale.is_pulsed()) {
+                nap(watch_retry_ms, keepalive.get_drain_signal());
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're shutting down.
+    }
+}
+
+void result_cache_t::watch_table_once(table_t *table, signal_t *interruptor) {
+    if (!configs_watched) {
+        // We wouldn't notice if the name stopped referring to the table.
+        return;
+    }
+
+    env_t env(ctx,
+              return_empty_normal_batches_t::NO,
+              interruptor,
+              std::map<std::string, wire_func_t>(),
+              nullptr);
+
+    counted_t<const db_t> db;
+    counted_t<base_table_t> base_table;
+    std::string error;
+    if (!ctx->cluster_interface->db_find(table->db_name, interruptor, &db, &error)
+        || !ctx->cluster_interface->table_find(table->table_name, db, boost::none,
+                                               interruptor, &base_table, &error)) {
+        return;
+    }
+
+    counted_t<datum_stream_t> feed = base_table->read_changes(
+        &env,
+        counted_t<datum_stream_t>(),
+        datum_t::boolean(false),
+        false,
+        changefeed::keyspec_t::range_t{
+            std::vector<transform_variant_t>(),
+            boost::none,
+            sorting_t::UNORDERED,
+            datum_range_t::universe()},
+        backtrace_id_t::empty(),
+        table->table_name.str());
+
+    // Only now are we sure to see every change, so results from before don't
+    // count.
+    const uint64_t old_version = __sync_fetch_and_add(&table->version, 1);
+    const bool was_watched = old_version % 2 == 0;
+    guarantee(!was_watched);
+
+    try {
+        for (;;) {
+            std::vector<datum_t> changes = feed->next_batch(
+                &env, batchspec_t::default_for(batch_type_t::NORMAL));
+            if (!changes.empty()) {
+                table->bump();
+            }
+        }
+    } catch (const base_exc_t &) {
+        // The table was deleted or became unavailable.
+    }
+}
+
+void result_cache_t::watch_table_configs(auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    try {
+        for (;;) {
+            try {
+                watch_table_configs_once(keepalive.get_drain_signal());
+            } catch (const base_exc_t &) {
+                // `table_config` isn't available; we'll try again.
+            }
+            nap(watch_retry_ms, keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're shutting down.
+    }
+}
+
+void result_cache_t::watch_table_configs_once(signal_t *interruptor) {
+    env_t env(ctx,
+              return_empty_normal_batches_t::NO,
+              interruptor,
+              std::map<std::string, wire_func_t>(),
+              nullptr);
+
+    counted_t<const db_t> db;
+    counted_t<base_table_t> config_table;
+    std::string error;
+    if (!ctx->cluster_interface->db_find(name_string_t::guarantee_valid("rethinkdb"),
+                                         interruptor, &db, &error)
+        || !ctx->cluster_interface->table_find(
+            name_string_t::guarantee_valid("table_config"), db, boost::none,
+            interruptor, &config_table, &error)) {
+        return;
+    }
+
+    counted_t<datum_stream_t> feed = config_table->read_changes(
+        &env,
+        counted_t<datum_stream_t>(),
+        datum_t::boolean(false),
+        false,
+        changefeed::keyspec_t::range_t{
+            std::vector<transform_variant_t>(),
+            boost::none,
+            sorting_t::UNORDERED,
+            datum_range_t::universe()},
+        backtrace_id_t::empty(),
+        "table_config");
+
+    // The tables only start watching now, so they resolve their names after any
+    // change we could have missed.
+    configs_watched = true;
+    try {
+        for (;;) {
+            std::vector<datum_t> changes = feed->next_batch(
+                &env, batchspec_t::default_for(batch_type_t::NORMAL));
+            for (const datum_t &change : changes) {
+                on_table_config_change(change);
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        configs_watched = false;
+        throw;
+    } catch (const base_exc_t &) {
+        // The changefeed was cut off.
+    }
+    // We might miss renames until it's open again.
+    configs_watched = false;
+    restart_all_tables();
+}
+
+void result_cache_t::on_table_config_change(const datum_t &change) {
+    for (const char *field : {"old_val", "new_val"}) {
+        datum_t config = change.get_field(field, NOTHROW);
+        if (!config.has() || config.get_type() != datum_t::R_OBJECT) {
+            continue;
+        }
+        datum_t db_name = config.get_field("db", NOTHROW);
+        datum_t table_name = config.get_field("name", NOTHROW);
+        if (!db_name.has() || db_name.get_type() != datum_t::R_STR
+            || !table_name.has() || table_name.get_type() != datum_t::R_STR) {
+            continue;
+        }
+        auto it = tables.find(std::make_pair(db_name.as_str().to_std(),
+                                             table_name.as_str().to_std()));
+        if (it != tables.end()) {
+            table_t *table = it->second.get();
+            // The results we have may be for another table by now.  The watch
+            // stops using them once it notices, but that's a coroutine switch
+            // away.
+            table->bump();
+            if (table->stale != NULL) {
+                table->stale->pulse_if_not_already_pulsed();
+            }
+        }
+    }
+}
+
+void result_cache_t::restart_all_tables() {
+    for (const auto &pair : tables) {
+        table_t *table = pair.second.get();
+        table->bump();
+        if (table->stale != NULL) {
+            table->stale->pulse_if_not_already_pulsed();
+        }
+    }
+}
+
+}  // namespace ql
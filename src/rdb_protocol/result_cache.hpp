@@ -0,0 +1,211 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESULT_CACHE_HPP_
+#define RDB_PROTOCOL_RESULT_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "containers/intrusive_list.hpp"
+#include "containers/name_string.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "threading.hpp"
+
+class Query;
+class Term;
+class rdb_context_t;
+class signal_t;
+
+namespace ql {
+
+// Which tables' read results `result_cache_t` keeps, and how much memory it may
+// use.  Set from the command line; the cache is off unless `tables` is non-empty.
+class result_cache_config_t {
+public:
+    result_cache_config_t() : max_memory(0) { }
+
+    // By database name and table name.
+    std::set<std::pair<name_string_t, name_string_t> > tables;
+    // Split evenly among the threads.
+    size_t max_memory;
+};
+
+// Remembers the results of read queries that are sent over and over, such as the
+// ones dashboards poll with, so they can be answered without running them.  Only
+// queries on the tables named in the config are cached, and only queries made
+// entirely of terms that always give the same result for the same table
+// contents; `r.now()`, `r.random()`, `r.js()`, `r.http()`, changefeeds and meta
+// queries never are.  (`term_t::is_deterministic` can't be used to pick them
+// out, since every table term counts as non-deterministic.)  Results are cached
+// under the query's terms and global optargs, with optargs in a canonical order.
+//
+// Every cached table has a version, and a cached result is only used if the
+// versions of all the tables it read are the same as when the query that
+// produced it started.  The version is bumped for every change the table's
+// changefeed reports, and before and after every write that goes through this
+// server, so a client that reads its own writes through this server never sees
+// stale results.  Writes that go through other servers are only seen once their
+// changes arrive, which is as soon as a changefeed would see them.  While a
+// table has no changefeed open, because it's unavailable or doesn't exist, its
+// results aren't cached.
+//
+// A table's changefeed follows the table, not its name, so the cache also keeps a
+// changefeed open on `rethinkdb.table_config`.  When a cached table's name comes
+// or goes there, because a table or database was renamed, dropped or created,
+// its results are dropped and its changefeed is opened again under the name.
+// While that changefeed isn't open, nothing is cached.
+//
+// There's one LRU cache per thread, so that cached results are only ever used on
+// the thread they were created on.
+class result_cache_t : public home_thread_mixin_t {
+private:
+    class table_t;
+public:
+    // Sets `ctx->result_cache` for as long as the cache exists.
+    // `ctx->cluster_interface` must stay valid until the cache is destroyed.
+    result_cache_t(rdb_context_t *ctx, const result_cache_config_t &config);
+    ~result_cache_t();
+
+    // Where a query's result is cached, along with the versions of the tables it
+    // reads as of when the key was made.
+    class key_t {
+    public:
+        key_t() { }
+    private:
+        friend class result_cache_t;
+        std::string query;
+        std::vector<std::pair<table_t *, uint64_t> > versions;
+        DISABLE_COPYING(key_t);
+    };
+
+    // The tables a query might write to.
+    typedef std::vector<table_t *> written_tables_t;
+
+    // Bumps the versions of the tables a write goes to when the write starts and
+    // again when it's done.
+    class write_t {
+    public:
+        explicit write_t(const written_tables_t &tables);
+        ~write_t();
+    private:
+        const written_tables_t &tables;
+        DISABLE_COPYING(write_t);
+    };
+
+    // Returns true and fills in `key_out` if the result of `query` can be cached.
+    // Otherwise fills in `written_out` with the cached tables that `query` might
+    // write to, if any.  This must be called before the query is preprocessed,
+    // since preprocessing replaces `r.now()` with the current time.
+    bool make_key(const Query &query,
+                  key_t *key_out,
+                  written_tables_t *written_out) const;
+
+    // Returns the result for `key`, or an empty `datum_t`.  Counts a hit or a
+    // miss.
+    datum_t find(const key_t &key);
+
+    void insert(const key_t &key, const datum_t &result);
+
+private:
+    class table_t {
+    public:
+        table_t(const name_string_t &_db_name, const name_string_t &_table_name)
+            : db_name(_db_name), table_name(_table_name), version(1), stale(NULL) { }
+
+        // Bumps the version without changing whether the table is watched.
+        void bump() { __sync_add_and_fetch(&version, 2); }
+        uint64_t get_version() const {
+            return __sync_add_and_fetch(const_cast<uint64_t *>(&version), 0);
+        }
+
+        const name_string_t db_name;
+        const name_string_t table_name;
+        // Even while the table's changefeed is open, odd otherwise.  Only the
+        // coroutine that watches the table changes whether it's odd.
+        uint64_t version;
+        // Pulsed to make the coroutine that watches the table start over.  Only
+        // used on the cache's home thread.
+        cond_t *stale;
+    };
+
+    class entry_t : public intrusive_list_node_t<entry_t> {
+    public:
+        std::string query;
+        std::vector<std::pair<table_t *, uint64_t> > versions;
+        datum_t result;
+        size_t memory_usage;
+    };
+
+    class thread_cache_t {
+    public:
+        explicit thread_cache_t(size_t _max_memory);
+        ~thread_cache_t();
+
+        const size_t max_memory;
+        std::unordered_map<std::string, entry_t *> entries;
+        // Most recently used first.
+        intrusive_list_t<entry_t> lru;
+        size_t memory_usage;
+
+        void remove(entry_t *entry);
+    private:
+        DISABLE_COPYING(thread_cache_t);
+    };
+
+    // Adds `term` to `key_out` in canonical form.  Returns false if the term can't
+    // be cached, or reads a table that isn't cached.
+    bool append_term(const Term &term,
+                     const Term *default_db,
+                     std::string *key_out,
+                     std::set<table_t *> *tables_out) const;
+    // Returns false if `term` isn't a literal table name.
+    bool find_table(const Term &term,
+                    const Term *default_db,
+                    table_t **table_out) const;
+    // What `find_writes` found out about the writes in a query.
+    class write_scan_t {
+    public:
+        write_scan_t() : writes(false), all_tables(false) { }
+        bool writes;
+        // True if we can't tell which tables are written to.
+        bool all_tables;
+        std::set<table_t *> tables;
+    };
+    void find_writes(const Term &term,
+                     const Term *default_db,
+                     write_scan_t *scan) const;
+
+    void watch_table(table_t *table, auto_drainer_t::lock_t keepalive);
+    // Returns when the table's changefeed stops.
+    void watch_table_once(table_t *table, signal_t *interruptor);
+    void watch_table_configs(auto_drainer_t::lock_t keepalive);
+    // Returns when the `table_config` changefeed stops.
+    void watch_table_configs_once(signal_t *interruptor);
+    // Makes the tables that `change` renames, drops or creates start over.
+    void on_table_config_change(const datum_t &change);
+    void restart_all_tables();
+
+    rdb_context_t *const ctx;
+    std::map<std::pair<std::string, std::string>, scoped_ptr_t<table_t> > tables;
+    one_per_thread_t<thread_cache_t> thread_caches;
+    // True while the `table_config` changefeed is open.  Tables are only watched
+    // while it is.
+    bool configs_watched;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(result_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESULT_CACHE_HPP_
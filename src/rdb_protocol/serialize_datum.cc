@@ -1,8 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/serialize_datum.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include <limits>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -17,7 +20,8 @@
 
 namespace ql {
 
-
+// These values are also sent to clients by the BINARY protocol (see **BINARY DATUM
+// FORMAT** in ql2.proto), so they can't be renumbered.
 enum class datum_serialized_type_t {
     R_ARRAY = 1,
     R_BOOL = 2,
@@ -153,6 +157,21 @@ datum_offset_size_t get_offset_size_from_inner_size(uint64_t inner_size) {
     unreachable();
 }
 
+size_t offset_serialized_size(datum_offset_size_t offset_size) {
+    switch (offset_size) {
+    case datum_offset_size_t::U8BIT:
+        return serialize_universal_size_t<uint8_t>::value;
+    case datum_offset_size_t::U16BIT:
+        return serialize_universal_size_t<uint16_t>::value;
+    case datum_offset_size_t::U32BIT:
+        return serialize_universal_size_t<uint32_t>::value;
+    case datum_offset_size_t::U64BIT:
+        return serialize_universal_size_t<uint64_t>::value;
+    default:
+        unreachable();
+    }
+}
+
 size_t read_inner_serialized_size_from_buf(const shared_buf_ref_t<char> &buf) {
     buffer_read_stream_t s(buf.get(), buf.get_safety_boundary());
     uint64_t sz = 0;
@@ -847,19 +866,7 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &ser_size),
                               "datum decode array");
     const datum_offset_size_t offset_size = get_offset_size_from_inner_size(ser_size);
-    size_t serialized_offset_size;
-    switch (offset_size) {
-    case datum_offset_size_t::U8BIT:
-        serialized_offset_size = serialize_universal_size_t<uint8_t>::value; break;
-    case datum_offset_size_t::U16BIT:
-        serialized_offset_size = serialize_universal_size_t<uint16_t>::value; break;
-    case datum_offset_size_t::U32BIT:
-        serialized_offset_size = serialize_universal_size_t<uint32_t>::value; break;
-    case datum_offset_size_t::U64BIT:
-        serialized_offset_size = serialize_universal_size_t<uint64_t>::value; break;
-    default:
-        unreachable();
-    }
+    const size_t serialized_offset_size = offset_serialized_size(offset_size);
 
     uint64_t num_elements = 0;
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &num_elements),
@@ -960,4 +967,118 @@ MUST_USE archive_result_t datum_deserialize(
     return archive_result_t::SUCCESS;
 }
 
+/* The format of a serialized object is:
+     type BUF_R_OBJECT
+     varint ser_size
+     varint num_pairs
+     uint*_t offsets[num_pairs - 1] // counted from `pairs`, first pair omitted
+     (datum_string_t, datum_t) pairs[num_pairs] // sorted by key
+   We read the type and the two sizes, then the offset table, and then only the
+   keys and values we actually need. */
+datum_t datum_deserialize_object_fields(
+        size_t serialized_size,
+        const std::function<void(size_t, size_t, char *)> &read_range,
+        const std::vector<datum_string_t> &fields,
+        bool exclude) {
+    const size_t max_varint_size = 10;
+    char header[1 + 2 * max_varint_size];
+    const size_t header_size = std::min(sizeof(header), serialized_size);
+    if (header_size == 0) {
+        return datum_t();
+    }
+    read_range(0, header_size, header);
+    buffer_read_stream_t header_stream(header, header_size);
+    datum_serialized_type_t type = datum_serialized_type_t::R_NULL;
+    if (bad(datum_deserialize(&header_stream, &type))
+        || type != datum_serialized_type_t::BUF_R_OBJECT) {
+        return datum_t();
+    }
+    // Everything below is relative to the start of the object buffer, like the
+    // offsets that `datum_get_element_offset` returns.
+    const size_t buf_start = static_cast<size_t>(header_stream.tell());
+    uint64_t ser_size = 0;
+    guarantee_deserialization(deserialize_varint_uint64(&header_stream, &ser_size),
+                              "datum decode object");
+    uint64_t num_pairs = 0;
+    guarantee_deserialization(deserialize_varint_uint64(&header_stream, &num_pairs),
+                              "datum decode object");
+    const size_t buf_size = varint_uint64_serialized_size(ser_size) + ser_size;
+    guarantee(buf_start + buf_size <= serialized_size);
+    if (num_pairs == 0) {
+        return datum_t::empty_object();
+    }
+
+    const size_t index_size =
+        static_cast<size_t>(header_stream.tell()) - buf_start
+        + (num_pairs - 1) * offset_serialized_size(
+            get_offset_size_from_inner_size(ser_size));
+    counted_t<shared_buf_t> index_buf = shared_buf_t::create(index_size);
+    read_range(buf_start, index_size, index_buf->data());
+    const shared_buf_ref_t<char> index(index_buf, 0);
+
+    auto pair_end = [&](size_t i) -> size_t {
+        return i + 1 < num_pairs ? datum_get_element_offset(index, i + 1) : buf_size;
+    };
+    auto read_key = [&](size_t i) -> datum_string_t {
+        const size_t pair_offset = datum_get_element_offset(index, i);
+        char size_buf[max_varint_size];
+        const size_t size_buf_size =
+            std::min(sizeof(size_buf), pair_end(i) - pair_offset);
+        read_range(buf_start + pair_offset, size_buf_size, size_buf);
+        buffer_read_stream_t size_stream(size_buf, size_buf_size);
+        uint64_t key_size = 0;
+        guarantee_deserialization(deserialize_varint_uint64(&size_stream, &key_size),
+                                  "datum decode object key");
+        const size_t key_ser_size = varint_uint64_serialized_size(key_size) + key_size;
+        counted_t<shared_buf_t> key_buf = shared_buf_t::create(key_ser_size);
+        read_range(buf_start + pair_offset, key_ser_size, key_buf->data());
+        return datum_string_t(shared_buf_ref_t<char>(std::move(key_buf), 0));
+    };
+    auto read_value = [&](size_t i, const datum_string_t &key) -> datum_t {
+        const size_t value_offset =
+            datum_get_element_offset(index, i) + datum_serialized_size(key);
+        const size_t value_size = pair_end(i) - value_offset;
+        counted_t<shared_buf_t> value_buf = shared_buf_t::create(value_size);
+        read_range(buf_start + value_offset, value_size, value_buf->data());
+        return datum_deserialize_from_buf(
+            shared_buf_ref_t<char>(std::move(value_buf), 0), 0);
+    };
+
+    std::map<datum_string_t, datum_t> pairs;
+    if (exclude) {
+        for (size_t i = 0; i < num_pairs; ++i) {
+            datum_string_t key = read_key(i);
+            if (!std::binary_search(fields.begin(), fields.end(), key)) {
+                datum_t value = read_value(i, key);
+                pairs.insert(std::make_pair(std::move(key), std::move(value)));
+            }
+        }
+    } else {
+        // `fields` is sorted too, so each search can start where the last one
+        // left off.
+        size_t lo = 0;
+        for (const auto &field : fields) {
+            size_t hi = num_pairs;
+            while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (read_key(mid) < field) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo == num_pairs) {
+                break;
+            }
+            datum_string_t key = read_key(lo);
+            if (key == field) {
+                datum_t value = read_value(lo, key);
+                pairs.insert(std::make_pair(std::move(key), std::move(value)));
+                ++lo;
+            }
+        }
+    }
+    return datum_t(std::move(pairs), datum_t::no_sanitize_ptype_t());
+}
+
 }  // namespace ql
@@ -1,7 +1,9 @@
 #ifndef RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 #define RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 
+#include <functional>
 #include <utility>
+#include <vector>
 
 #include "containers/archive/archive.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -58,6 +60,20 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
 // Reads the number of elements in the array stored in the buffer
 size_t datum_get_array_size(const shared_buf_ref_t<char> &array);
 
+// Deserializes just some of the top-level fields of a serialized object, reading
+// it through `read_range(offset, size, out)` (offsets are relative to the start
+// of the serialization).  With `exclude` false we keep exactly `fields`, and
+// only read the offset table, the keys a binary search touches and the values
+// we keep; with `exclude` true we read every key but skip the values of
+// `fields`.  `fields` must be sorted.  Returns an uninitialized datum if the
+// serialization isn't an object, in which case the caller should read the
+// whole thing.
+datum_t datum_deserialize_object_fields(
+        size_t serialized_size,
+        const std::function<void(size_t, size_t, char *)> &read_range,
+        const std::vector<datum_string_t> &fields,
+        bool exclude);
+
 size_t datum_serialized_size(const datum_string_t &s);
 serialization_result_t datum_serialize(write_message_t *wm, const datum_string_t &s);
 
@@ -1,15 +1,22 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
+#include "concurrency/cond_var.hpp"
+#include "concurrency/stealable_chunks.hpp"
 #include "debug.hpp"
+#include "math.hpp"
+#include "rdb_protocol/datum_hash_map.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "time.hpp"
 
 bool reversed(sorting_t sorting) { return sorting == sorting_t::DESCENDING; }
 
@@ -66,14 +73,14 @@ private:
                                          const store_key_t &key,
                                          const datum_t &sindex_val) {
         for (auto it = groups->begin(); it != groups->end(); ++it) {
-            auto pair = acc.insert(std::make_pair(it->first, default_val));
-            auto t_it = pair.first;
-            bool keep = !pair.second;
+            bool inserted;
+            T *t = find_or_insert_group(it->first, &inserted);
+            bool keep = !inserted;
             for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second, key, sindex_val);
+                keep |= accumulate(env, *el, t, key, sindex_val);
             }
             if (!keep) {
-                acc.erase(t_it);
+                erase_group(it->first);
             }
         }
         return should_send_batch() ? done_traversing_t::YES : done_traversing_t::NO;
@@ -89,15 +96,15 @@ private:
 
     virtual void finish_impl(result_t *out) {
         *out = grouped_t<T>();
-        boost::get<grouped_t<T> >(*out).swap(acc);
-        guarantee(acc.size() == 0);
+        move_groups_to(boost::get<grouped_t<T> >(out));
+        guarantee(groups.empty());
     }
 
     virtual void unshard(env_t *env,
                          const store_key_t &last_key,
                          const std::vector<result_t *> &results) {
-        guarantee(acc.size() == 0);
-        std::map<datum_t, std::vector<T *>, optional_datum_less_t> vecs;
+        guarantee(groups.empty());
+        datum_hash_map_t<std::vector<T *> > vecs;
         for (auto res = results.begin(); res != results.end(); ++res) {
             guarantee(*res);
             grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
@@ -105,12 +112,12 @@ private:
             // `gres`'s ordering doesn't affect things here because we're putting the
             // values into a parallel map.
             for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
-                vecs[kv->first].push_back(&kv->second);
+                vecs.find_or_insert(kv->first)->push_back(&kv->second);
             }
         }
+        // Each group is unsharded on its own, so their order doesn't matter.
         for (auto kv = vecs.begin(); kv != vecs.end(); ++kv) {
-            auto t_it = acc.insert(std::make_pair(kv->first, default_val)).first;
-            unshard_impl(env, &t_it->second, last_key, kv->second);
+            unshard_impl(env, find_or_insert_group(kv.key(), NULL), last_key, kv.value());
         }
     }
     virtual void unshard_impl(env_t *env,
@@ -120,10 +127,44 @@ private:
 
 protected:
     const T *get_default_val() { return &default_val; }
-    grouped_t<T> *get_acc() { return &acc; }
+    datum_hash_map_t<T> *get_groups() { return &groups; }
+
+    // Returns the accumulated value for `group`, inserting `default_val` if
+    // there isn't one yet.  The pointer is only good until the next insertion.
+    T *find_or_insert_group(const datum_t &group, bool *inserted_out) {
+        return groups.find_or_insert(group, default_val, inserted_out);
+    }
+    void erase_group(const datum_t &group) {
+        groups.erase(group);
+    }
+
+    // Moves the accumulated values into `out`, which must be empty.  We sort them
+    // first, so that each one goes in at the end of `out`'s map instead of being
+    // looked up in it.
+    void move_groups_to(grouped_t<T> *out) {
+        std::vector<std::pair<datum_t, T *> > sorted;
+        sorted.reserve(groups.size());
+        for (auto it = groups.begin(); it != groups.end(); ++it) {
+            sorted.push_back(std::make_pair(it.key(), &it.value()));
+        }
+        const optional_datum_less_t less;
+        std::sort(sorted.begin(), sorted.end(),
+                  [&less](const std::pair<datum_t, T *> &a,
+                          const std::pair<datum_t, T *> &b) {
+                      return less(a.first, b.first);
+                  });
+        std::map<datum_t, T, optional_datum_less_t> *m = out->get_underlying_map();
+        guarantee(m->empty());
+        for (auto &&pair : sorted) {
+            m->emplace_hint(m->end(), std::move(pair.first), std::move(*pair.second));
+        }
+        groups.clear();
+    }
 private:
     const T default_val;
-    grouped_t<T> acc;
+    // Each group is stored once, here, while we accumulate; a `grouped_t` is only
+    // built when we're done, by `move_groups_to`.
+    datum_hash_map_t<T> groups;
 };
 
 class append_t : public grouped_acc_t<stream_t> {
@@ -399,17 +440,15 @@ protected:
     explicit terminal_t(T &&t) : grouped_acc_t<T>(std::move(t)) { }
 private:
     virtual void operator()(env_t *env, groups_t *groups) {
-        grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
-        const T *default_val = grouped_acc_t<T>::get_default_val();
         for (auto it = groups->begin(); it != groups->end(); ++it) {
-            auto pair = acc->insert(std::make_pair(it->first, *default_val));
-            auto t_it = pair.first;
-            bool keep = !pair.second;
+            bool inserted;
+            T *t = grouped_acc_t<T>::find_or_insert_group(it->first, &inserted);
+            bool keep = !inserted;
             for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second);
+                keep |= accumulate(env, *el, t);
             }
             if (!keep) {
-                acc->erase(t_it);
+                grouped_acc_t<T>::erase_group(it->first);
             }
         }
         groups->clear();
@@ -419,47 +458,47 @@ private:
                                              bool is_grouped,
                                              UNUSED const configured_limits_t &limits) {
         accumulator_t::mark_finished();
-        grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
+        datum_hash_map_t<T> *groups = grouped_acc_t<T>::get_groups();
         const T *default_val = grouped_acc_t<T>::get_default_val();
         scoped_ptr_t<val_t> retval;
         if (is_grouped) {
             counted_t<grouped_data_t> ret(new grouped_data_t());
-            // The order of `acc` doesn't matter here because we're putting stuff
+            // The order of `groups` doesn't matter here because we're putting stuff
             // into the parallel map, `ret`.
-            for (auto kv = acc->begin(); kv != acc->end(); ++kv) {
-                ret->insert(std::make_pair(kv->first, unpack(&kv->second)));
+            for (auto kv = groups->begin(); kv != groups->end(); ++kv) {
+                ret->insert(std::make_pair(kv.key(), unpack(&kv.value())));
             }
             retval = make_scoped<val_t>(std::move(ret), bt);
-        } else if (acc->size() == 0) {
+        } else if (groups->size() == 0) {
             T t(*default_val);
             retval = make_scoped<val_t>(unpack(&t), bt);
         } else {
             // Order doesnt' matter here because the size is 1.
-            r_sanity_check(acc->size() == 1 && !acc->begin()->first.has());
-            retval = make_scoped<val_t>(unpack(&acc->begin()->second), bt);
+            r_sanity_check(groups->size() == 1 && !groups->begin().key().has());
+            retval = make_scoped<val_t>(unpack(&groups->begin().value()), bt);
         }
-        acc->clear();
+        groups->clear();
         return retval;
     }
     virtual datum_t unpack(T *t) = 0;
 
     virtual void add_res(env_t *env, result_t *res) {
-        grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
-        const T *default_val = grouped_acc_t<T>::get_default_val();
+        datum_hash_map_t<T> *groups = grouped_acc_t<T>::get_groups();
         if (auto e = boost::get<exc_t>(res)) {
             throw *e;
         }
         grouped_t<T> *gres = boost::get<grouped_t<T> >(res);
         r_sanity_check(gres);
-        if (acc->size() == 0) {
-            acc->swap(*gres);
-        } else {
-            // Order in fact does NOT matter here.  The reason is, each `kv->first`
-            // value is different, which means each operation works on a different
-            // key/value pair of `acc`.
-            for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
-                auto t_it = acc->insert(std::make_pair(kv->first, *default_val)).first;
-                unshard_impl(env, &t_it->second, &kv->second);
+        const bool first_result = groups->empty();
+        // Order in fact does NOT matter here.  The reason is, each `kv->first`
+        // value is different, which means each operation works on a different
+        // key/value pair of `groups`.
+        for (auto kv = gres->begin(); kv != gres->end(); ++kv) {
+            T *t = grouped_acc_t<T>::find_or_insert_group(kv->first, NULL);
+            if (first_result) {
+                *t = std::move(kv->second);
+            } else {
+                unshard_impl(env, t, &kv->second);
             }
         }
     }
@@ -692,6 +731,103 @@ private:
     counted_t<const func_t> f;
 };
 
+// Keeps the first `n` rows of each group under an `order_by` ordering.  Each
+// group's rows are held in a heap with the row that sorts last on top, so a new
+// row costs one comparison unless it actually makes the cut.  The heap entries
+// are arrays of the form `[key_0, ..., key_m, seq, row]`, where `key_i` is `[]`
+// if the `i`th function didn't produce a value for `row` (which makes it sort
+// first, as `order_by` does) and `[val]` otherwise.  `seq` is the order in which
+// we saw the row, so that ties are broken the same way a stable sort would.
+class top_n_terminal_t : public terminal_t<datums_t> {
+public:
+    explicit top_n_terminal_t(const top_n_wire_func_t &f)
+        : terminal_t<datums_t>(datums_t()),
+          n(f.get_n()),
+          comparisons(f.compile_comparisons()),
+          lt(this),
+          next_seq(0) { }
+private:
+    class entry_lt_t {
+    public:
+        explicit entry_lt_t(const top_n_terminal_t *_parent) : parent(_parent) { }
+        bool operator()(const datum_t &l, const datum_t &r) const {
+            const std::vector<std::pair<counted_t<const func_t>, bool> > &cmps
+                = parent->comparisons;
+            for (size_t i = 0; i < cmps.size(); ++i) {
+                int cmp_res = l.get(i).cmp(r.get(i));
+                if (cmp_res != 0) {
+                    return (cmp_res < 0) != cmps[i].second;
+                }
+            }
+            return l.get(cmps.size()).as_num() < r.get(cmps.size()).as_num();
+        }
+    private:
+        const top_n_terminal_t *parent;
+    };
+
+    virtual bool accumulate(env_t *env,
+                            const datum_t &el,
+                            datums_t *heap) {
+        std::vector<datum_t> entry;
+        entry.reserve(comparisons.size() + 2);
+        for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+            try {
+                try {
+                    std::vector<datum_t> key;
+                    key.push_back(it->first->call(env, el)->as_datum());
+                    entry.push_back(datum_t(std::move(key), env->limits()));
+                } catch (const base_exc_t &e) {
+                    if (e.get_type() == base_exc_t::NON_EXISTENCE) {
+                        entry.push_back(datum_t::empty_array());
+                    } else {
+                        throw;
+                    }
+                }
+            } catch (const datum_exc_t &e) {
+                throw exc_t(e, it->first->backtrace(), 1);
+            }
+        }
+        entry.push_back(datum_t(static_cast<double>(next_seq++)));
+        entry.push_back(el);
+        insert(datum_t(std::move(entry), env->limits()), heap);
+        return true;
+    }
+
+    void insert(datum_t &&entry, datums_t *heap) {
+        if (heap->size() < n) {
+            heap->push_back(std::move(entry));
+            std::push_heap(heap->begin(), heap->end(), lt);
+        } else if (n != 0 && lt(entry, heap->front())) {
+            std::pop_heap(heap->begin(), heap->end(), lt);
+            heap->back() = std::move(entry);
+            std::push_heap(heap->begin(), heap->end(), lt);
+        }
+    }
+
+    virtual datum_t unpack(datums_t *heap) {
+        std::sort_heap(heap->begin(), heap->end(), lt);
+        std::vector<datum_t> rows;
+        rows.reserve(heap->size());
+        for (auto it = heap->begin(); it != heap->end(); ++it) {
+            rows.push_back(it->get(comparisons.size() + 1));
+        }
+        // `n` was checked against the array size limit when the query was built.
+        return datum_t(std::move(rows), datum_t::no_array_size_limit_check_t());
+    }
+
+    virtual void unshard_impl(env_t *, datums_t *out, datums_t *el) {
+        for (auto it = el->begin(); it != el->end(); ++it) {
+            insert(std::move(*it), out);
+        }
+        el->clear();
+    }
+
+    const uint64_t n;
+    const std::vector<std::pair<counted_t<const func_t>, bool> > comparisons;
+    const entry_lt_t lt;
+    uint64_t next_seq;
+};
+
 template<class T>
 class terminal_visitor_t : public boost::static_visitor<T *> {
 public:
@@ -717,6 +853,9 @@ public:
         return new limit_append_t(
             lr.is_primary, lr.n, lr.sorting, lr.ops);
     }
+    T *operator()(const top_n_wire_func_t &f) const {
+        return new top_n_terminal_t(f);
+    }
 };
 
 scoped_ptr_t<accumulator_t> make_terminal(const terminal_variant_t &t) {
@@ -763,6 +902,11 @@ private:
                             const datum_t &sindex_val) {
         if (groups->size() == 0) return;
         r_sanity_check(groups->size() == 1 && !groups->begin()->first.has());
+        // We bucket the batch through a hash table rather than inserting every
+        // row into `groups` directly, so each row costs a hash and an equality
+        // check instead of a full tree of datum comparisons.  Only the distinct
+        // groups of the batch are inserted into `groups` at the end.
+        datum_hash_map_t<datums_t> batch_groups;
         datums_t *ds = &groups->begin()->second;
         for (auto el = ds->begin(); el != ds->end(); ++el) {
             std::vector<datum_t> arr;
@@ -789,7 +933,7 @@ private:
             r_sanity_check(arr.size() == (funcs.size() + append_index));
 
             if (!multi) {
-                add(groups, std::move(arr), *el, env->limits());
+                add(&batch_groups, std::move(arr), *el, env->limits());
             } else {
                 std::vector<std::vector<datum_t> > perms(arr.size());
                 for (size_t i = 0; i < arr.size(); ++i) {
@@ -804,21 +948,26 @@ private:
                 }
                 std::vector<datum_t> instance;
                 instance.reserve(perms.size());
-                add_perms(groups, &instance, &perms, 0, *el, env->limits());
+                add_perms(&batch_groups, &instance, &perms, 0, *el, env->limits());
                 r_sanity_check(instance.size() == 0);
             }
 
             rcheck_src(bt,
-                       groups->size() <= env->limits().array_size_limit(),
+                       batch_groups.size() <= env->limits().array_size_limit(),
                        base_exc_t::GENERIC,
                        strprintf("Too many groups (> %zu).",
                                  env->limits().array_size_limit()));
         }
         size_t erased = groups->erase(datum_t());
         r_sanity_check(erased == 1);
+        for (auto it = batch_groups.begin(); it != batch_groups.end(); ++it) {
+            auto res = groups->insert(
+                std::make_pair(it.key(), std::move(it.value())));
+            r_sanity_check(res.second);
+        }
     }
 
-    void add(groups_t *groups,
+    void add(datum_hash_map_t<datums_t> *groups,
              std::vector<datum_t> &&arr,
              const datum_t &el,
              const configured_limits_t &limits) {
@@ -826,10 +975,10 @@ private:
             ? std::move(arr[0])
             : datum_t(std::move(arr), limits);
         r_sanity_check(group.has());
-        (*groups)[group].push_back(el);
+        groups->find_or_insert(group)->push_back(el);
     }
 
-    void add_perms(groups_t *groups,
+    void add_perms(datum_hash_map_t<datums_t> *groups,
                    std::vector<datum_t> *instance,
                    std::vector<std::vector<datum_t> > *arr,
                    size_t index,
@@ -860,6 +1009,15 @@ private:
     backtrace_id_t bt;
 };
 
+// A deterministic map is timed over its first chunk of rows, and the rest are only
+// mapped in chunks that idle threads can take (see `run_stealable_chunks`) if they're
+// expected to take at least `STEALABLE_MAP_MIN_TICKS`.  One more thread is offered
+// the chunks for every `STEALABLE_MAP_MIN_TICKS` of expected work, up to
+// `STEALABLE_MAP_MAX_HELPERS`, so that a cheap map doesn't wake up every thread.
+const size_t STEALABLE_MAP_CHUNK_ROWS = 32;
+const ticks_t STEALABLE_MAP_MIN_TICKS = 500 * THOUSAND;
+const int STEALABLE_MAP_MAX_HELPERS = 4;
+
 class map_trans_t : public ungrouped_op_t {
 public:
     explicit map_trans_t(const map_wire_func_t &_f)
@@ -868,27 +1026,112 @@ private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
         try {
-            for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+            // A deterministic function touches nothing but its arguments, so it can
+            // run on any thread.
+            if (lst->size() > STEALABLE_MAP_CHUNK_ROWS && f->is_deterministic()) {
+                const ticks_t start = get_ticks();
+                for (size_t i = 0; i < STEALABLE_MAP_CHUNK_ROWS; ++i) {
+                    (*lst)[i] = f->call(env, (*lst)[i])->as_datum();
+                }
+                const ticks_t expected = (get_ticks() - start)
+                    * (lst->size() - STEALABLE_MAP_CHUNK_ROWS)
+                    / STEALABLE_MAP_CHUNK_ROWS;
+                if (expected >= STEALABLE_MAP_MIN_TICKS) {
+                    const int max_helpers = static_cast<int>(std::min<ticks_t>(
+                        expected / STEALABLE_MAP_MIN_TICKS, STEALABLE_MAP_MAX_HELPERS));
+                    stealable_map(env, lst, STEALABLE_MAP_CHUNK_ROWS, max_helpers);
+                } else {
+                    for (size_t i = STEALABLE_MAP_CHUNK_ROWS; i < lst->size(); ++i) {
+                        (*lst)[i] = f->call(env, (*lst)[i])->as_datum();
+                    }
+                }
+            } else {
+                for (auto it = lst->begin(); it != lst->end(); ++it) {
+                    *it = f->call(env, *it)->as_datum();
+                }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace(), 1);
         }
     }
+
+    // Maps the rows from `first_row` on.  When profiling, every chunk gets a trace of
+    // its own, and they're added to `env->trace` as parallel jobs.
+    void stealable_map(env_t *env, datums_t *lst, size_t first_row, int max_helpers) {
+        const threadnum_t home_thread = get_thread_id();
+        const return_empty_normal_batches_t return_empty_normal_batches =
+            env->return_empty_normal_batches;
+        const reql_version_t reql_version = env->reql_version();
+        const configured_limits_t limits = env->limits();
+        const bool profiling = env->trace != NULL;
+        const size_t num_chunks =
+            ceil_divide(lst->size() - first_row, STEALABLE_MAP_CHUNK_ROWS);
+        // Each one is only set by the thread that ran the chunk.
+        std::vector<profile::event_log_t> event_logs(profiling ? num_chunks : 0);
+
+        profile::splitter_t splitter(env->trace);
+        run_stealable_chunks(
+            num_chunks,
+            max_helpers,
+            [&](size_t chunk) {
+                const size_t begin = first_row + chunk * STEALABLE_MAP_CHUNK_ROWS;
+                const size_t end =
+                    std::min(begin + STEALABLE_MAP_CHUNK_ROWS, lst->size());
+                const bool on_home_thread =
+                    get_thread_id().threadnum == home_thread.threadnum;
+                if (on_home_thread && !profiling) {
+                    for (size_t i = begin; i < end; ++i) {
+                        (*lst)[i] = f->call(env, (*lst)[i])->as_datum();
+                    }
+                    return;
+                }
+                cond_t non_interruptor;
+                scoped_ptr_t<profile::trace_t> trace = profiling
+                    ? make_scoped<profile::trace_t>()
+                    : scoped_ptr_t<profile::trace_t>();
+                env_t chunk_env(on_home_thread ? env->interruptor : &non_interruptor,
+                                return_empty_normal_batches, reql_version, limits,
+                                trace.get_or_null());
+                {
+                    profile::starter_t starter(
+                        on_home_thread
+                            ? "Map rows."
+                            : "Map rows on another thread.",
+                        trace);
+                    for (size_t i = begin; i < end; ++i) {
+                        (*lst)[i] = f->call(&chunk_env, (*lst)[i])->as_datum();
+                    }
+                }
+                if (trace.has()) {
+                    event_logs[chunk] = std::move(*trace).extract_event_log();
+                    // Ends this chunk's part of the split, like a shard's read.
+                    event_logs[chunk].push_back(profile::stop_t());
+                }
+            });
+
+        profile::event_log_t event_log;
+        for (const profile::event_log_t &chunk_log : event_logs) {
+            event_log.insert(event_log.end(), chunk_log.begin(), chunk_log.end());
+        }
+        splitter.give_splits(event_logs.size(), event_log);
+    }
+
     counted_t<const func_t> f;
 };
 
 // Note: this removes duplicates ONLY TO SAVE NETWORK TRAFFIC.  It's possible
 // for duplicates to survive, either because they're on different shards or
 // because they span batch boundaries.  `ordered_distinct_datum_stream_t` in
-// `datum_stream.cc` removes any duplicates that survive this `lst_transform`.
+// `datum_stream.cc` (or, for unordered streams, `distinct_term_t`) removes any
+// duplicates that survive this `lst_transform`.
 class distinct_trans_t : public ungrouped_op_t {
 public:
-    explicit distinct_trans_t(const distinct_wire_func_t &f) : use_index(f.use_index) { }
+    explicit distinct_trans_t(const distinct_wire_func_t &f)
+        : use_index(f.use_index), ordered(f.ordered) { }
 private:
     // sindex_val may be NULL
     virtual void lst_transform(
-        env_t *, datums_t *lst, const datum_t &sindex_val) {
+        env_t *env, datums_t *lst, const datum_t &sindex_val) {
         auto it = lst->begin();
         auto loc = it;
         for (; it != lst->end(); ++it) {
@@ -896,7 +1139,10 @@ private:
                 r_sanity_check(sindex_val.has());
                 *it = sindex_val;
             }
-            if (!last_val.has() || *it != last_val) {
+            const bool keep = ordered
+                ? (!last_val.has() || *it != last_val)
+                : first_sighting(env, *it);
+            if (keep) {
                 std::swap(*loc, *it);
                 last_val = *loc;
                 ++loc;
@@ -904,11 +1150,35 @@ private:
         }
         lst->erase(loc, lst->end());
     }
+    bool first_sighting(env_t *env, const datum_t &d) {
+        // This lives for the whole read, so on a shard it deduplicates everything
+        // the read traverses.  If there are too many distinct values we start
+        // over rather than grow without bound; the parsing node catches whatever
+        // gets through.
+        if (seen.size() >= env->limits().array_size_limit()) {
+            seen.clear();
+        }
+        bool inserted;
+        seen.find_or_insert(d, true, &inserted);
+        return inserted;
+    }
     bool use_index;
+    bool ordered;
     datum_t last_val;
+    datum_hash_map_t<bool> seen;
 };
 
 
+// The projection itself is done by the btree read (see `rget_cb_t`) when this
+// is the first transformation; anywhere else the rows are left alone, since the
+// transformation after this one only looks at the projected fields anyway.
+class project_trans_t : public op_t {
+public:
+    explicit project_trans_t(const project_wire_func_t &) { }
+private:
+    virtual void operator()(env_t *, groups_t *, const datum_t &) { }
+};
+
 class filter_trans_t : public ungrouped_op_t {
 public:
     explicit filter_trans_t(const filter_wire_func_t &_f)
@@ -1002,6 +1272,9 @@ public:
     op_t *operator()(const zip_wire_func_t &f) const {
         return new zip_trans_t(f);
     }
+    op_t *operator()(const project_wire_func_t &f) const {
+        return new project_trans_t(f);
+    }
 };
 
 scoped_ptr_t<op_t> make_op(const transform_variant_t &tv) {
@@ -284,6 +284,7 @@ typedef boost::variant<
     grouped_t<ql::datum_t>, // Reduce (may be NULL)
     grouped_t<optimizer_t>, // min, max
     grouped_t<stream_t>, // No terminal.
+    grouped_t<datums_t>, // top_n
     exc_t // Don't re-order (we don't want this to initialize to an error.)
     > result_t;
 
@@ -292,7 +293,8 @@ typedef boost::variant<map_wire_func_t,
                        filter_wire_func_t,
                        concatmap_wire_func_t,
                        distinct_wire_func_t,
-                       zip_wire_func_t
+                       zip_wire_func_t,
+                       project_wire_func_t
                        > transform_variant_t;
 
 class op_t {
@@ -321,7 +323,8 @@ typedef boost::variant<count_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
                        reduce_wire_func_t,
-                       limit_read_t
+                       limit_read_t,
+                       top_n_wire_func_t
                        > terminal_variant_t;
 
 class accumulator_t {
@@ -2,6 +2,7 @@
 #include "rdb_protocol/term.hpp"
 
 #include "arch/address.hpp"
+#include "arch/runtime/slab_allocator.hpp"
 #include "clustering/administration/jobs/report.hpp"
 #include "containers/cow_ptr.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
@@ -219,7 +220,7 @@ void maybe_release_query_id(query_id_t &&id,
 
 void run(query_id_t &&query_id,
          protob_t<Query> q,
-         Response *res,
+         response_t *res,
          query_cache_t *query_cache,
          signal_t *interruptor) {
     try {
@@ -258,6 +259,17 @@ void run(query_id_t &&query_id,
                 query_cache->get(token, use_json, interruptor);
             query_ref->fill_response(res);
         } break;
+        case Query_QueryType_PREPARE: {
+            query_cache->prepare(token, q);
+            res->set_type(Response::SUCCESS_ATOM);
+            res->add_datum(datum_t::null(), use_json);
+        } break;
+        case Query_QueryType_EXECUTE: {
+            maybe_release_query_id(std::move(query_id), q);
+            scoped_ptr_t<query_cache_t::ref_t> query_ref =
+                query_cache->execute(token, q, use_json, interruptor);
+            query_ref->fill_response(res);
+        } break;
         case Query_QueryType_STOP: {
             query_cache->terminate_query(token);
             res->set_type(Response::SUCCESS_SEQUENCE);
@@ -278,6 +290,14 @@ runtime_term_t::runtime_term_t(backtrace_id_t bt)
 
 runtime_term_t::~runtime_term_t() { }
 
+void *runtime_term_t::operator new(size_t size) {
+    return slab_malloc(size);
+}
+
+void runtime_term_t::operator delete(void *ptr) {
+    slab_free(ptr);
+}
+
 term_t::term_t(protob_t<const Term> _src)
     : runtime_term_t(backtrace_id_t(_src.get())),
       src(_src) { }
@@ -308,6 +328,24 @@ protob_t<const Term> term_t::get_src() const {
 }
 
 scoped_ptr_t<val_t> runtime_term_t::eval(scope_env_t *env, eval_flags_t eval_flags) const {
+    return eval_internal(env, eval_flags, NULL);
+}
+
+scoped_ptr_t<val_t> runtime_term_t::eval_prefix(scope_env_t *env,
+                                                size_t n,
+                                                eval_flags_t eval_flags) const {
+    return eval_internal(env, eval_flags, &n);
+}
+
+scoped_ptr_t<val_t> runtime_term_t::term_eval_prefix(scope_env_t *env,
+                                                     size_t,
+                                                     eval_flags_t eval_flags) const {
+    return term_eval(env, eval_flags);
+}
+
+scoped_ptr_t<val_t> runtime_term_t::eval_internal(scope_env_t *env,
+                                                  eval_flags_t eval_flags,
+                                                  const size_t *prefix_n) const {
     // This is basically a hook for unit tests to change things mid-query
     profile::starter_t starter(strprintf("Evaluating %s.", name()), env->env->trace);
     env->env->do_eval_callback();
@@ -322,7 +360,9 @@ scoped_ptr_t<val_t> runtime_term_t::eval(scope_env_t *env, eval_flags_t eval_fla
     try {
 #endif // INSTRUMENT
         try {
-            scoped_ptr_t<val_t> ret = term_eval(env, eval_flags);
+            scoped_ptr_t<val_t> ret = prefix_n == NULL
+                ? term_eval(env, eval_flags)
+                : term_eval_prefix(env, *prefix_n, eval_flags);
             DEC_DEPTH;
             DBG("%s returned %s\n", name(), ret->print().c_str());
             return ret;
@@ -31,7 +31,17 @@ class runtime_term_t : public slow_atomic_countable_t<runtime_term_t>,
 public:
     virtual ~runtime_term_t();
 
+    // Every query compiles a tree of these, so they come from the slab allocator.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
+
     scoped_ptr_t<val_t> eval(scope_env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
+    // Like `eval`, but the caller will only look at the first `n` elements of the
+    // resulting sequence, which lets some terms (e.g. an unindexed `order_by`) do
+    // less work.  By default this is the same as `eval`.
+    scoped_ptr_t<val_t> eval_prefix(scope_env_t *env,
+                                    size_t n,
+                                    eval_flags_t eval_flags = NO_FLAGS) const;
 
     virtual const char *name() const = 0;
 
@@ -48,7 +58,14 @@ protected:
     explicit runtime_term_t(backtrace_id_t bt);
 
 private:
+    // `prefix_n` is NULL unless we're evaluating for `eval_prefix`.
+    scoped_ptr_t<val_t> eval_internal(scope_env_t *env,
+                                      eval_flags_t eval_flags,
+                                      const size_t *prefix_n) const;
     virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t) const = 0;
+    virtual scoped_ptr_t<val_t> term_eval_prefix(scope_env_t *env,
+                                                 size_t n,
+                                                 eval_flags_t eval_flags) const;
 };
 
 class term_t : public runtime_term_t {
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/arr.hpp"
 
+#include <limits>
+
 #include "math.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
@@ -317,8 +319,24 @@ private:
 class limit_term_t : public op_term_t {
 public:
     limit_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2)) { }
+        : op_term_t(env, term, argspec_t(2)) {
+        // If the limit is a constant we know up front how much of the sequence
+        // we'll need, which lets e.g. an unindexed `order_by` only keep the
+        // first `n` rows instead of sorting everything.
+        if (term->args_size() == 2 && term->args(1).type() == Term::DATUM) {
+            const Datum &d = term->args(1).datum();
+            if (d.type() == Datum::R_NUM
+                && d.r_num() >= 0
+                && d.r_num() <= std::numeric_limits<int32_t>::max()
+                && d.r_num() == static_cast<int32_t>(d.r_num())) {
+                const_limit = static_cast<size_t>(d.r_num());
+            }
+        }
+    }
 private:
+    virtual boost::optional<size_t> arg0_prefix_size() const {
+        return const_limit;
+    }
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
         scoped_ptr_t<val_t> v = args->arg(env, 0);
@@ -340,6 +358,8 @@ private:
             : new_val(env->env, new_ds);
     }
     virtual const char *name() const { return "limit"; }
+
+    boost::optional<size_t> const_limit;
 };
 
 class set_insert_term_t : public op_term_t {
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <functional>
+#include <vector>
 
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
@@ -44,6 +45,23 @@ obj_or_seq_op_impl_t::obj_or_seq_op_impl_t(
     }
 
     propagate_backtrace(func.get(), self->backtrace());
+
+    const Term::TermType type = term->type();
+    if (type == Term::PLUCK || type == Term::WITHOUT
+        || type == Term::GET_FIELD || type == Term::BRACKET) {
+        std::vector<std::string> fields;
+        for (int i = 1; i < term->args_size(); ++i) {
+            const Term &arg = term->args(i);
+            if (arg.type() != Term::DATUM || arg.datum().type() != Datum::R_STR) {
+                return;
+            }
+            fields.push_back(arg.datum().r_str());
+        }
+        if (!fields.empty()) {
+            projection = project_wire_func_t(std::move(fields),
+                                             type == Term::WITHOUT);
+        }
+    }
 }
 
 scoped_ptr_t<val_t> obj_or_seq_op_impl_t::eval_impl_dereferenced(
@@ -93,6 +111,9 @@ scoped_ptr_t<val_t> obj_or_seq_op_impl_t::eval_impl_dereferenced(
         counted_t<const func_t> f = func_term->eval_to_func(env->scope);
 
         counted_t<datum_stream_t> stream = v0->as_seq(env->env);
+        if (projection && !stream->is_array()) {
+            stream->add_transformation(*projection, target->backtrace());
+        }
         switch (poly_type) {
         case MAP:
             stream->add_transformation(map_wire_func_t(f), target->backtrace());
@@ -4,11 +4,15 @@
 
 #include <functional>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "containers/counted.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/wire_func.hpp"
 #include "utils.hpp"
 
 namespace ql {
@@ -34,6 +38,8 @@ public:
 private:
     poly_type_t poly_type;
     protob_t<Term> func;
+    // Set if the term only ever looks at some literal top-level fields.
+    boost::optional<project_wire_func_t> projection;
     const term_t *parent;
     const std::set<std::string> acceptable_ptypes;
 
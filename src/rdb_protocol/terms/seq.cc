@@ -351,6 +351,7 @@ struct rcheck_transform_visitor_t : public bt_rcheckable_t,
     NORETURN void operator()(const zip_wire_func_t &) const {
         rfail(base_exc_t::GENERIC, "Cannot call `changes` after `zip`.");
     }
+    void operator()(const project_wire_func_t &) const { }
 };
 
 struct rcheck_spec_visitor_t : public bt_rcheckable_t,
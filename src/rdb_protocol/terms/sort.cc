@@ -1,13 +1,16 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "rdb_protocol/datum_hash_map.hpp"
 #include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/disk_spill.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -111,6 +114,17 @@ private:
 
     virtual scoped_ptr_t<val_t>
     eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        return eval_order_by(env, args, NULL);
+    }
+
+    virtual scoped_ptr_t<val_t> eval_impl_prefix(
+            scope_env_t *env, args_t *args, size_t n, eval_flags_t) const {
+        return eval_order_by(env, args, &n);
+    }
+
+    // `prefix_n` is non-NULL if only the first `*prefix_n` rows are needed.
+    scoped_ptr_t<val_t> eval_order_by(
+            scope_env_t *env, args_t *args, const size_t *prefix_n) const {
         std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons;
         for (size_t i = 1; i < args->num_args(); ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
@@ -176,7 +190,33 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
+            if (prefix_n != NULL
+                && *prefix_n <= env->env->limits().array_size_limit()) {
+                // Only the first `n` rows are wanted, so instead of sorting the
+                // whole sequence we keep the best `n` in a heap.  For tables this
+                // runs on the shards, and only `n` rows per shard come back.
+                std::vector<std::pair<counted_t<const func_t>, bool> > top_n_cmps;
+                for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                    top_n_cmps.push_back(std::make_pair(it->second, it->first == DESC));
+                }
+                datum_t top_n = seq->run_terminal(
+                    env->env, top_n_wire_func_t(*prefix_n, top_n_cmps))->as_datum();
+                seq = make_counted<array_datum_stream_t>(top_n, backtrace());
+                return tbl_slice.has()
+                    ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
+                    : new_val(env->env, seq);
+            }
+            // If the input doesn't fit under the array size limit and we have
+            // somewhere to put it, we sort it one limit-sized run at a time and
+            // spill the sorted runs to disk, to be merged as the result is read.
+            const bool can_spill = can_spill_to_disk(env->env);
+            counted_t<spilled_sort_datum_stream_t> spilled;
             std::vector<datum_t> to_sort;
+            auto sort_run = [&](std::vector<datum_t> *run) {
+                profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
+                auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
+                std::stable_sort(run->begin(), run->end(), fn);
+            };
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
                 std::vector<datum_t> data
@@ -185,14 +225,27 @@ private:
                     break;
                 }
                 std::move(data.begin(), data.end(), std::back_inserter(to_sort));
+                if (can_spill
+                    && to_sort.size() > env->env->limits().array_size_limit()) {
+                    sort_run(&to_sort);
+                    if (!spilled.has()) {
+                        spilled = make_counted<spilled_sort_datum_stream_t>(
+                            lt_cmp, backtrace());
+                    }
+                    spilled->add_sorted_run(env->env, to_sort);
+                    to_sort.clear();
+                }
                 rcheck_array_size(to_sort, env->env->limits(), base_exc_t::GENERIC);
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
+            sort_run(&to_sort);
+            if (!spilled.has()) {
+                seq = make_counted<array_datum_stream_t>(
+                    datum_t(std::move(to_sort), env->env->limits()),
+                    backtrace());
+            } else {
+                spilled->add_sorted_run(env->env, to_sort);
+                seq = spilled;
+            }
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -243,23 +296,66 @@ private:
         rcheck(!idx, base_exc_t::GENERIC,
                "Can only perform an indexed distinct on a TABLE.");
         counted_t<datum_stream_t> s = v->as_seq(env->env);
-        // The reql_version matters here, because we copy `results` into `toret`
-        // in ascending order.
-        std::set<datum_t, optional_datum_less_t> results;
+        if (!s->is_array()) {
+            // Have the shards throw out the duplicates they see, so that for
+            // low-cardinality data we only ship a handful of rows per batch.
+            s->add_transformation(distinct_wire_func_t(false, false), backtrace());
+        }
+        // We deduplicate through a hash table and only sort the distinct values
+        // at the end (the result is in ascending order).  If there are more of
+        // them than fit in an array and we have somewhere to put them, we sort
+        // and spill them to disk one limit-sized run at a time, and merge the
+        // runs (dropping the duplicates between them) as the result is read.
+        const bool can_spill = can_spill_to_disk(env->env);
+        auto lt = [](env_t *, profile::sampler_t *,
+                     const datum_t &l, const datum_t &r) {
+            return l < r;
+        };
+        counted_t<spilled_sort_datum_stream_t> spilled;
+        std::vector<datum_t> distinct_vals;
+        datum_hash_map_t<bool> seen;
+        auto sort_run = [&]() {
+            profile::sampler_t sampler("Sorting distinct values.", env->env->trace);
+            std::sort(distinct_vals.begin(), distinct_vals.end());
+        };
         batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
         {
             profile::sampler_t sampler("Evaluating elements in distinct.",
                                        env->env->trace);
-            datum_t d;
-            while (d = s->next(env->env, batchspec), d.has()) {
-                results.insert(std::move(d));
-                rcheck_array_size(results, env->env->limits(), base_exc_t::GENERIC);
-                sampler.new_sample();
+            for (;;) {
+                std::vector<datum_t> data = s->next_batch(env->env, batchspec);
+                if (data.size() == 0) {
+                    break;
+                }
+                for (auto &&d : data) {
+                    bool inserted;
+                    seen.find_or_insert(d, true, &inserted);
+                    if (inserted) {
+                        distinct_vals.push_back(std::move(d));
+                    }
+                    sampler.new_sample();
+                }
+                if (can_spill
+                    && distinct_vals.size() > env->env->limits().array_size_limit()) {
+                    sort_run();
+                    if (!spilled.has()) {
+                        spilled = make_counted<spilled_sort_datum_stream_t>(
+                            lt, backtrace());
+                    }
+                    spilled->add_sorted_run(env->env, distinct_vals);
+                    distinct_vals.clear();
+                    seen.clear();
+                }
+                rcheck_array_size(distinct_vals, env->env->limits(),
+                                  base_exc_t::GENERIC);
             }
         }
-        std::vector<datum_t> toret;
-        std::move(results.begin(), results.end(), std::back_inserter(toret));
-        return new_val(datum_t(std::move(toret), env->env->limits()));
+        sort_run();
+        if (!spilled.has()) {
+            return new_val(datum_t(std::move(distinct_vals), env->env->limits()));
+        }
+        spilled->add_sorted_run(env->env, distinct_vals);
+        return new_val(env->env, spilled->ordered_distinct());
     }
 
     virtual const char *name() const { return "distinct"; }
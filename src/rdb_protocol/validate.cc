@@ -49,7 +49,9 @@
 
 void validate_pb(const Query &q) {
     check_type(Query, q);
-    if (q.type() == Query::START) {
+    if (q.type() == Query::START
+        || q.type() == Query::PREPARE
+        || q.type() == Query::EXECUTE) {
         check_has(q, has_query, "query");
         validate_pb(q.query());
     } else {
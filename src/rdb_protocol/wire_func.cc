@@ -274,12 +274,41 @@ backtrace_id_t group_wire_func_t::get_bt() const {
 
 RDB_IMPL_SERIALIZABLE_4_SINCE_v1_13(group_wire_func_t, funcs, append_index, multi, bt);
 
+top_n_wire_func_t::top_n_wire_func_t(
+        uint64_t _n,
+        const std::vector<std::pair<counted_t<const func_t>, bool> > &_comparisons)
+    : n(_n) {
+    comparisons.reserve(_comparisons.size());
+    for (auto it = _comparisons.begin(); it != _comparisons.end(); ++it) {
+        comparisons.push_back(std::make_pair(wire_func_t(it->first), it->second));
+    }
+}
+
+uint64_t top_n_wire_func_t::get_n() const {
+    return n;
+}
+
+std::vector<std::pair<counted_t<const func_t>, bool> >
+top_n_wire_func_t::compile_comparisons() const {
+    std::vector<std::pair<counted_t<const func_t>, bool> > ret;
+    ret.reserve(comparisons.size());
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        ret.push_back(std::make_pair(it->first.compile_wire_func(), it->second));
+    }
+    return ret;
+}
+
+RDB_IMPL_SERIALIZABLE_2(top_n_wire_func_t, n, comparisons);
+INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(top_n_wire_func_t);
+
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(count_wire_func_t);
 
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(zip_wire_func_t);
 
 RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(filter_wire_func_t, filter_func, default_filter_val);
 
-RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(distinct_wire_func_t, use_index);
+RDB_MAKE_SERIALIZABLE_2_FOR_CLUSTER(distinct_wire_func_t, use_index, ordered);
+
+RDB_MAKE_SERIALIZABLE_2_FOR_CLUSTER(project_wire_func_t, fields, exclude);
 
 }  // namespace ql
@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "containers/uuid.hpp"
@@ -137,12 +138,57 @@ private:
 
 class distinct_wire_func_t {
 public:
-    distinct_wire_func_t() : use_index(false) { }
-    explicit distinct_wire_func_t(bool _use_index) : use_index(_use_index) { }
+    distinct_wire_func_t() : use_index(false), ordered(true) { }
+    explicit distinct_wire_func_t(bool _use_index)
+        : use_index(_use_index), ordered(true) { }
+    distinct_wire_func_t(bool _use_index, bool _ordered)
+        : use_index(_use_index), ordered(_ordered) { }
     bool use_index;
+    // If the stream is ordered, duplicates are adjacent and we only need to
+    // remember the last value; otherwise we remember what we've seen in a hash
+    // table.
+    bool ordered;
 };
+// Adding `ordered` changed the serialized form of this type without a new
+// `cluster_version_t`.  It's only ever serialized between servers, never to disk,
+// so the one consequence is that a cluster can't mix servers from before and
+// after the change.  Once a release has shipped with this format, changing it
+// again needs a new cluster version.
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distinct_wire_func_t);
 
+// An unindexed `order_by` followed by `limit(n)`.  Each shard keeps just the
+// first `n` rows under the ordering, so we never ship or sort the whole table.
+class top_n_wire_func_t {
+public:
+    top_n_wire_func_t() : n(0) { }
+    // Each function is paired with whether it sorts in descending order.
+    top_n_wire_func_t(
+        uint64_t _n,
+        const std::vector<std::pair<counted_t<const func_t>, bool> > &_comparisons);
+    uint64_t get_n() const;
+    std::vector<std::pair<counted_t<const func_t>, bool> > compile_comparisons() const;
+    RDB_DECLARE_ME_SERIALIZABLE(top_n_wire_func_t);
+private:
+    uint64_t n;
+    std::vector<std::pair<wire_func_t, bool> > comparisons;
+};
+
+// Says that only some top-level fields of the rows are going to be used: the
+// ones in `fields`, or, if `exclude` is set, all but those.  `pluck`, `without`
+// and `get_field` with literal field names put this in front of their own
+// transformation, so that when it's the first transformation of a primary index
+// read the btree can decode just those fields out of the stored documents.
+// It doesn't change the rows anywhere else.
+class project_wire_func_t {
+public:
+    project_wire_func_t() : exclude(false) { }
+    project_wire_func_t(std::vector<std::string> &&_fields, bool _exclude)
+        : fields(std::move(_fields)), exclude(_exclude) { }
+    std::vector<std::string> fields;
+    bool exclude;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(project_wire_func_t);
+
 template <class T>
 class skip_terminal_t;
 
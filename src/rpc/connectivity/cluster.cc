@@ -761,6 +761,10 @@ void connectivity_cluster_t::run_t::handle(
         peerstr = peer_addr.to_string();
     const char *peername = peerstr.c_str();
 
+    // Messages between servers can be large (think backfills), so don't let the
+    // writes for them go out as a trail of short segments.
+    conn->get_underlying_conn()->enable_write_corking();
+
     // Make sure that if we're ordered to shut down, any pending read
     // or write gets interrupted.
     cluster_conn_closing_subscription_t conn_closer_1(conn);
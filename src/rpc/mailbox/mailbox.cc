@@ -29,6 +29,11 @@ peer_id_t raw_mailbox_t::address_t::get_peer() const {
     return peer;
 }
 
+threadnum_t raw_mailbox_t::address_t::get_thread() const {
+    guarantee(!is_nil(), "A nil address has no thread");
+    return threadnum_t(thread);
+}
+
 std::string raw_mailbox_t::address_t::human_readable() const {
     return strprintf("%s:%d:%" PRIu64, uuid_to_str(peer.get_uuid()).c_str(), thread, mailbox_id);
 }
@@ -87,6 +87,10 @@ public:
         fails. */
         peer_id_t get_peer() const;
 
+        /* Returns the thread on the peer that the mailbox lives on. If the address
+        is nil, fails. */
+        threadnum_t get_thread() const;
+
         // Returns a friendly human-readable peer:thread:mailbox_id string.
         std::string human_readable() const;
 
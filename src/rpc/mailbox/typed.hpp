@@ -22,6 +22,7 @@ public:
     }
     bool is_nil() const { return addr.is_nil(); }
     peer_id_t get_peer() const { return addr.get_peer(); }
+    threadnum_t get_thread() const { return addr.get_thread(); }
 
     friend class mailbox_t<T>;
 
@@ -1,5 +1,6 @@
 #include "serializer/buf_ptr.hpp"
 
+#include "arch/runtime/slab_allocator.hpp"
 #include "math.hpp"
 
 buf_ptr_t buf_ptr_t::alloc_uninitialized(block_size_t size) {
@@ -7,7 +8,7 @@ buf_ptr_t buf_ptr_t::alloc_uninitialized(block_size_t size) {
     const size_t count = compute_aligned_block_size(size);
     buf_ptr_t ret;
     ret.block_size_ = size;
-    ret.ser_buffer_.init(malloc_aligned(count, DEVICE_BLOCK_SIZE));
+    ret.ser_buffer_.init(slab_malloc(count));
     return ret;
 }
 
@@ -22,7 +23,7 @@ scoped_malloc_t<ser_buffer_t> help_allocate_copy(const ser_buffer_t *copyee,
                                                  size_t amount_to_copy,
                                                  size_t reserved_size) {
     rassert(amount_to_copy <= reserved_size);
-    void *buf = malloc_aligned(reserved_size, DEVICE_BLOCK_SIZE);
+    void *buf = slab_malloc(reserved_size);
     memcpy(buf, copyee, amount_to_copy);
     memset(reinterpret_cast<char *>(buf) + amount_to_copy,
            0,
@@ -0,0 +1,34 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "unittest/benchmark.hpp"
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+benchmark_timer_t::benchmark_timer_t() : start_(current_microtime()) { }
+
+void benchmark_timer_t::record_rate(const char *name, uint64_t ops) {
+    const microtime_t elapsed = std::max<microtime_t>(elapsed_and_restart(), 1);
+    ::testing::Test::RecordProperty(
+        name, strprintf("%" PRIu64, static_cast<uint64_t>(ops * MILLION / elapsed)).c_str());
+}
+
+void benchmark_timer_t::record_elapsed(const char *name) {
+    ::testing::Test::RecordProperty(
+        name, strprintf("%" PRIu64, elapsed_and_restart()).c_str());
+}
+
+microtime_t benchmark_timer_t::elapsed_and_restart() {
+    const microtime_t now = current_microtime();
+    const microtime_t elapsed = now - start_;
+    start_ = now;
+    return elapsed;
+}
+
+}  // namespace unittest
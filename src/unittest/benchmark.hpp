@@ -0,0 +1,39 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef UNITTEST_BENCHMARK_HPP_
+#define UNITTEST_BENCHMARK_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include "time.hpp"
+
+namespace unittest {
+
+/* Benchmarks are tests whose names start with `DISABLED_`, so they only run with
+`--gtest_also_run_disabled_tests`.  They time themselves with a `benchmark_timer_t`,
+which doesn't print anything: it records each result as a property of the test, and
+`--gtest_output=xml` writes them out with the test. */
+class benchmark_timer_t {
+public:
+    // Starts timing.
+    benchmark_timer_t();
+
+    // Records how many operations per second `ops` operations since the timer was
+    // started or last recorded come to, and starts timing again.
+    void record_rate(const char *name, uint64_t ops);
+
+    // Records how many microseconds have passed since the timer was started or last
+    // recorded, and starts timing again.
+    void record_elapsed(const char *name);
+
+private:
+    microtime_t elapsed_and_restart();
+
+    microtime_t start_;
+
+    DISABLE_COPYING(benchmark_timer_t);
+};
+
+}  // namespace unittest
+
+#endif  // UNITTEST_BENCHMARK_HPP_
@@ -75,5 +75,25 @@ TPTEST(ClusteringNamespaceInterface, ReadOutdated) {
     EXPECT_EQ("", mock_parse_read_response(rr));
 }
 
+TPTEST(ClusteringNamespaceInterface, ReadThread, 2) {
+    test_cluster_group_t cluster_group(2);
+
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("p,s"));
+
+    cluster_group.wait_until_blueprint_is_satisfied("p,s");
+
+    /* The primary is on server 0, which handles reads on the thread its reactor is
+    on, so only server 0 knows a read thread. */
+    scoped_ptr_t<cluster_namespace_interface_t> primary_if
+        = cluster_group.make_namespace_interface(0);
+    threadnum_t thread = INVALID_THREAD;
+    ASSERT_TRUE(primary_if->get_read_thread(store_key_t("a"), &thread));
+    EXPECT_EQ(get_thread_id().threadnum, thread.threadnum);
+
+    scoped_ptr_t<cluster_namespace_interface_t> secondary_if
+        = cluster_group.make_namespace_interface(1);
+    EXPECT_FALSE(secondary_if->get_read_thread(store_key_t("a"), &thread));
+}
+
 }   /* namespace unittest */
 
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
@@ -198,5 +200,96 @@ TEST(ClusteringQuery, BroadcasterProblem) {
     unittest::run_in_thread_pool(&run_broadcaster_problem_test);
 }
 
+/* The `LocalMasterThread` test checks that a `master_access_t` knows which thread a
+master on the same server handles its requests on, and that reads sent from that
+thread get there and back without any thread switches, while reads sent from another
+thread take at least two each. */
+
+// Returns the number of thread switches the reads took.
+static int64_t read_from_master(master_access_t *master_access, int num_reads) {
+    count_thread_switches_t thread_switches;
+    for (int i = 0; i < num_reads; ++i) {
+        read_response_t rr;
+        cond_t fake_interruptor;
+        fifo_enforcer_sink_t::exit_read_t read_token;
+        master_access->new_read_token(&read_token);
+        master_access->read(mock_read("a"), &rr, order_token_t::ignore,
+                            &read_token, &fake_interruptor);
+    }
+    return thread_switches.get();
+}
+
+static void run_local_master_thread_test() {
+    order_source_t order_source;
+    simple_mailbox_cluster_t cluster;
+    in_memory_branch_history_manager_t branch_history_manager;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    mock_store_t initial_store((binary_blob_t(version_range_t(version_t::zero()))));
+    rdb_context_t rdb_context;
+
+    cond_t interruptor;
+    broadcaster_t broadcaster(cluster.get_mailbox_manager(),
+                              &rdb_context,
+                              &branch_history_manager,
+                              &initial_store,
+                              &get_global_perfmon_collection(),
+                              &order_source,
+                              &interruptor);
+
+    watchable_variable_t<boost::optional<broadcaster_business_card_t> > broadcaster_metadata_controller(
+        boost::optional<broadcaster_business_card_t>(broadcaster.get_business_card()));
+
+    listener_t initial_listener(
+        base_path_t("."),
+        &io_backender,
+        cluster.get_mailbox_manager(),
+        generate_uuid(),
+        broadcaster_metadata_controller.get_watchable()->subview(&wrap_in_optional),
+        &branch_history_manager,
+        &broadcaster,
+        &get_global_perfmon_collection(),
+        &interruptor,
+        &order_source);
+
+    replier_t initial_replier(&initial_listener, cluster.get_mailbox_manager(), &branch_history_manager);
+
+    fake_ack_checker_t ack_checker(1);
+    master_t master(cluster.get_mailbox_manager(), &ack_checker, region_t::universe(), &broadcaster);
+    const master_business_card_t master_business_card = master.get_business_card();
+
+    const int num_reads = 100;
+    {
+        watchable_variable_t<boost::optional<boost::optional<master_business_card_t> > > master_directory_view(
+            boost::make_optional(boost::make_optional(master_business_card)));
+        cond_t non_interruptor;
+        master_access_t master_access(
+            cluster.get_mailbox_manager(),
+            master_directory_view.get_watchable(),
+            &non_interruptor);
+        EXPECT_EQ(get_thread_id().threadnum, master_access.get_master_thread().threadnum);
+
+        EXPECT_EQ(0, read_from_master(&master_access, num_reads));
+    }
+
+    const threadnum_t master_thread = get_thread_id();
+    {
+        on_thread_t thread_switcher((threadnum_t(1)));
+        watchable_variable_t<boost::optional<boost::optional<master_business_card_t> > > master_directory_view(
+            boost::make_optional(boost::make_optional(master_business_card)));
+        cond_t non_interruptor;
+        master_access_t master_access(
+            cluster.get_mailbox_manager(),
+            master_directory_view.get_watchable(),
+            &non_interruptor);
+        EXPECT_EQ(master_thread.threadnum, master_access.get_master_thread().threadnum);
+
+        EXPECT_GE(read_from_master(&master_access, num_reads), 2 * num_reads);
+    }
+}
+
+TEST(ClusteringQuery, LocalMasterThread) {
+    unittest::run_in_thread_pool(&run_local_master_thread_test, 2);
+}
+
 }   /* namespace unittest */
 
@@ -0,0 +1,70 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <unistd.h>
+
+#include <set>
+#include <vector>
+
+#include "arch/runtime/coro_stack_arena.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(CoroStackArena, HandsOutDistinctStacks) {
+    perfmon_counter_t pm_reserved_bytes;
+    const size_t stack_size = COROUTINE_STACK_SIZE;
+    const size_t page_size = getpagesize();
+    coro_stack_arena_t arena(stack_size, &pm_reserved_bytes);
+    // Enough to need a second chunk.
+    const size_t num_stacks = COROUTINE_STACK_CHUNK_SIZE / stack_size + 10;
+    std::vector<void *> stacks;
+    std::set<char *> seen;
+    for (size_t i = 0; i < num_stacks; ++i) {
+        char *stack = static_cast<char *>(arena.allocate());
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(stack) % page_size);
+        ASSERT_TRUE(seen.insert(stack).second);
+        // Everything but the guard page is usable.
+        stack[page_size] = 1;
+        stack[stack_size - 1] = 1;
+        stacks.push_back(stack);
+    }
+    ASSERT_EQ(static_cast<size_t>(2 * COROUTINE_STACK_CHUNK_SIZE), arena.reserved_bytes());
+
+    // Released stacks get reused, most recent first, without reserving more.
+    arena.release(stacks[5]);
+    arena.release(stacks[7]);
+    ASSERT_EQ(stacks[7], arena.allocate());
+    ASSERT_EQ(stacks[5], arena.allocate());
+    ASSERT_EQ(static_cast<size_t>(2 * COROUTINE_STACK_CHUNK_SIZE), arena.reserved_bytes());
+
+    for (void *stack : stacks) {
+        arena.release(stack);
+    }
+}
+
+void wait_for(cond_t *go, int *remaining, cond_t *done) {
+    go->wait();
+    if (--*remaining == 0) {
+        done->pulse();
+    }
+}
+
+TPTEST(CoroStackArena, ManyCoroutines) {
+    // Two rounds, so the second one runs on recycled stacks.
+    for (int round = 0; round < 2; ++round) {
+        const int num_coros = 10000;
+        cond_t go, done;
+        int remaining = num_coros;
+        for (int i = 0; i < num_coros; ++i) {
+            coro_t::spawn_sometime(std::bind(&wait_for, &go, &remaining, &done));
+        }
+        go.pulse();
+        done.wait();
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,118 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cross_thread_mutex.hpp"
+#include "concurrency/cross_thread_semaphore.hpp"
+#include "concurrency/pmap.hpp"
+#include "unittest/benchmark.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Every thread takes the mutex `per_thread` times, and sometimes yields while
+// holding it so that the others have to wait.
+void lock_mutex_on_thread(cross_thread_mutex_t *mutex, int per_thread, int *counter,
+                          int64_t thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    for (int i = 0; i < per_thread; ++i) {
+        cross_thread_mutex_t::acq_t acq(mutex);
+        const int value = *counter;
+        if (i % 16 == 0) {
+            coro_t::yield();
+        }
+        *counter = value + 1;
+    }
+}
+
+// The same, with a semaphore that has one item.
+void lock_semaphore_on_thread(cross_thread_semaphore_t<int> *semaphore, int per_thread,
+                              int64_t thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    for (int i = 0; i < per_thread; ++i) {
+        cross_thread_semaphore_t<int>::lock_t lock(semaphore, NULL);
+        const int value = *lock.get_value();
+        if (i % 16 == 0) {
+            coro_t::yield();
+        }
+        *lock.get_value() = value + 1;
+    }
+}
+
+TPTEST(CrossThreadLock, RecursiveMutex) {
+    cross_thread_mutex_t mutex(true);
+    cross_thread_mutex_t::acq_t outer(&mutex);
+    {
+        cross_thread_mutex_t::acq_t inner(&mutex);
+        ASSERT_TRUE(mutex.is_locked());
+    }
+    ASSERT_TRUE(mutex.is_locked());
+    outer.reset();
+    ASSERT_FALSE(mutex.is_locked());
+}
+
+TPTEST(CrossThreadLock, ContendedMutex, 4) {
+    const int per_thread = 10000;
+    cross_thread_mutex_t mutex;
+    int counter = 0;
+    pmap(static_cast<int64_t>(get_num_threads()),
+         std::bind(&lock_mutex_on_thread, &mutex, per_thread, &counter, ph::_1));
+    ASSERT_EQ(per_thread * get_num_threads(), counter);
+    ASSERT_FALSE(mutex.is_locked());
+}
+
+TPTEST(CrossThreadLock, ContendedSemaphore, 4) {
+    const int per_thread = 10000;
+    int counter;
+    {
+        cross_thread_semaphore_t<int> semaphore(1, 0);
+        pmap(static_cast<int64_t>(get_num_threads()),
+             std::bind(&lock_semaphore_on_thread, &semaphore, per_thread, ph::_1));
+        cross_thread_semaphore_t<int>::lock_t lock(&semaphore, NULL);
+        counter = *lock.get_value();
+    }
+    ASSERT_EQ(per_thread * get_num_threads(), counter);
+}
+
+TPTEST(CrossThreadLock, DISABLED_Benchmark, 4) {
+    const int uncontended_ops = 1000000;
+    const int per_thread = 100000;
+    {
+        cross_thread_mutex_t mutex;
+        benchmark_timer_t timer;
+        for (int i = 0; i < uncontended_ops; ++i) {
+            cross_thread_mutex_t::acq_t acq(&mutex);
+        }
+        timer.record_rate("mutex_uncontended_per_sec", uncontended_ops);
+    }
+    {
+        cross_thread_mutex_t mutex;
+        int counter = 0;
+        benchmark_timer_t timer;
+        pmap(static_cast<int64_t>(get_num_threads()),
+             std::bind(&lock_mutex_on_thread, &mutex, per_thread, &counter, ph::_1));
+        timer.record_rate("mutex_contended_per_sec", per_thread * get_num_threads());
+    }
+    {
+        cross_thread_semaphore_t<int> semaphore(1, 0);
+        benchmark_timer_t timer;
+        for (int i = 0; i < uncontended_ops; ++i) {
+            cross_thread_semaphore_t<int>::lock_t lock(&semaphore, NULL);
+        }
+        timer.record_rate("semaphore_uncontended_per_sec", uncontended_ops);
+    }
+    {
+        cross_thread_semaphore_t<int> semaphore(1, 0);
+        benchmark_timer_t timer;
+        pmap(static_cast<int64_t>(get_num_threads()),
+             std::bind(&lock_semaphore_on_thread, &semaphore, per_thread, ph::_1));
+        timer.record_rate("semaphore_contended_per_sec",
+                          per_thread * get_num_threads());
+    }
+}
+
+}  // namespace unittest
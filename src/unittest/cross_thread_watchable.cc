@@ -65,4 +65,69 @@ TPTEST(CrossThreadWatchable, CrossThreadWatchableTest) {
     }
 }
 
+// Counts the updates to a watchable on its thread.
+class update_counter_t {
+public:
+    explicit update_counter_t(const clone_ptr_t<watchable_t<int> > &watchable) :
+        num_updates(0), subs(std::bind(&update_counter_t::on_update, this)) {
+        watchable_t<int>::freeze_t freeze(watchable);
+        subs.reset(watchable, &freeze);
+    }
+
+    int num_updates;
+
+private:
+    void on_update() {
+        ++num_updates;
+    }
+
+    watchable_t<int>::subscription_t subs;
+};
+
+/* Many quick changes should arrive as fewer updates, the last of which has the last
+value. */
+TPTEST(CrossThreadWatchable, CoalescesUpdates) {
+    scoped_ptr_t<watchable_variable_t<int> > watchable;
+    scoped_ptr_t<cross_thread_watchable_variable_t<int> > ctw;
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        watchable.init(new watchable_variable_t<int>(0));
+        ctw.init(new cross_thread_watchable_variable_t<int>(
+            watchable->get_watchable(), threadnum_t(1)));
+    }
+
+    scoped_ptr_t<update_counter_t> counter;
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        counter.init(new update_counter_t(ctw->get_watchable()));
+    }
+
+    const int num_changes = 1000;
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        for (int i = 1; i <= num_changes; ++i) {
+            watchable->set_value(i);
+            if (i % 100 == 0) {
+                coro_t::yield();
+            }
+        }
+    }
+
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        signal_timer_t timer;
+        timer.start(5000);
+        ctw->get_watchable()->run_until_satisfied(
+            boost::bind(&equals, num_changes, _1), &timer);
+        ASSERT_LT(counter->num_updates, num_changes);
+        counter.reset();
+    }
+
+    {
+        on_thread_t thread_switcher(threadnum_t(0));
+        ctw.reset();
+        watchable.reset();
+    }
+}
+
 } //namespace unittest
@@ -2,8 +2,10 @@
 
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_hash_map.hpp"
 #include "rdb_protocol/datum_string.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -24,6 +26,8 @@ void test_datum_serialization(const ql::datum_t datum) {
                                                              &deserialized_datum);
         ASSERT_EQ(archive_result_t::SUCCESS, res);
         ASSERT_EQ(datum, deserialized_datum);
+        // The deserialized datum may be buffer-backed; it must still hash the same.
+        ASSERT_EQ(datum.hash(), deserialized_datum.hash());
     }
 
     // Re-serialize the just deserialized datum a second time. This might use
@@ -205,4 +209,134 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+TEST(DatumTest, HashConsistentWithEquality) {
+    ql::configured_limits_t limits;
+    ASSERT_EQ(ql::datum_t(0.0).hash(), ql::datum_t(-0.0).hash());
+    ASSERT_NE(ql::datum_t(1.0).hash(), ql::datum_t(2.0).hash());
+    ASSERT_NE(ql::datum_t("1").hash(), ql::datum_t(1.0).hash());
+    ql::datum_t arr1(std::vector<ql::datum_t>{ql::datum_t("a"), ql::datum_t(1.0)},
+                     limits);
+    ql::datum_t arr2(std::vector<ql::datum_t>{ql::datum_t("a"), ql::datum_t(1.0)},
+                     limits);
+    ql::datum_t arr3(std::vector<ql::datum_t>{ql::datum_t(1.0), ql::datum_t("a")},
+                     limits);
+    ASSERT_EQ(arr1, arr2);
+    ASSERT_EQ(arr1.hash(), arr2.hash());
+    ASSERT_NE(arr1.hash(), arr3.hash());
+    ql::datum_t obj1(std::map<datum_string_t, ql::datum_t>{
+            std::make_pair(datum_string_t("a"), arr1),
+            std::make_pair(datum_string_t("b"), ql::datum_t::null())});
+    ql::datum_t obj2(std::map<datum_string_t, ql::datum_t>{
+            std::make_pair(datum_string_t("b"), ql::datum_t::null()),
+            std::make_pair(datum_string_t("a"), arr2)});
+    ASSERT_EQ(obj1, obj2);
+    ASSERT_EQ(obj1.hash(), obj2.hash());
+    test_datum_serialization(obj1);
+}
+
+TEST(DatumTest, HashMap) {
+    ql::datum_hash_map_t<uint64_t> map;
+    const uint64_t n = 10000;
+    for (uint64_t i = 0; i < n; ++i) {
+        bool inserted;
+        *map.find_or_insert(ql::datum_t(static_cast<double>(i % (n / 2))), 0,
+                            &inserted) += 1;
+        ASSERT_EQ(i < n / 2, inserted);
+    }
+    ASSERT_EQ(n / 2, map.size());
+    // The uninitialized datum is a valid key, distinct from everything else.
+    *map.find_or_insert(ql::datum_t()) = 7;
+    ASSERT_EQ(n / 2 + 1, map.size());
+    ASSERT_EQ(7u, *map.find(ql::datum_t()));
+
+    for (uint64_t i = 0; i < n / 2; i += 2) {
+        ASSERT_TRUE(map.erase(ql::datum_t(static_cast<double>(i))));
+        ASSERT_FALSE(map.erase(ql::datum_t(static_cast<double>(i))));
+    }
+    for (uint64_t i = 0; i < n / 2; ++i) {
+        uint64_t *val = map.find(ql::datum_t(static_cast<double>(i)));
+        if (i % 2 == 0) {
+            ASSERT_TRUE(val == NULL);
+        } else {
+            ASSERT_TRUE(val != NULL);
+            ASSERT_EQ(2u, *val);
+        }
+    }
+
+    size_t seen = 0;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        ++seen;
+    }
+    ASSERT_EQ(map.size(), seen);
+}
+
+std::string serialize_for_projection(const ql::datum_t &datum) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, datum);
+    int write_res = send_write_message(&write_stream, &wm);
+    guarantee(write_res == 0);
+    return write_stream.str();
+}
+
+ql::datum_t project_fields(const std::string &serialized,
+                           const std::vector<datum_string_t> &fields,
+                           bool exclude,
+                           size_t *bytes_read_out) {
+    *bytes_read_out = 0;
+    return ql::datum_deserialize_object_fields(
+        serialized.size(),
+        [&](size_t offset, size_t size, char *out) {
+            guarantee(offset + size <= serialized.size());
+            memcpy(out, serialized.data() + offset, size);
+            *bytes_read_out += size;
+        },
+        fields,
+        exclude);
+}
+
+TEST(DatumTest, ObjectFieldProjection) {
+    // Big enough values that the object needs 32 bit offsets.
+    std::map<datum_string_t, ql::datum_t> pairs;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        pairs.insert(std::make_pair(
+            datum_string_t(std::string(1, c)),
+            ql::datum_t(datum_string_t(std::string(4000 + c, c)))));
+    }
+    pairs.insert(std::make_pair(datum_string_t("id"), ql::datum_t(1.0)));
+    const ql::datum_t object(std::move(pairs));
+    const std::string serialized = serialize_for_projection(object);
+
+    size_t bytes_read;
+    ql::datum_t res = project_fields(
+        serialized,
+        {datum_string_t("b"), datum_string_t("id"), datum_string_t("missing")},
+        false,
+        &bytes_read);
+    ASSERT_EQ(ql::datum_t(std::map<datum_string_t, ql::datum_t>{
+                  std::make_pair(datum_string_t("b"), object.get_field("b")),
+                  std::make_pair(datum_string_t("id"), object.get_field("id"))}),
+              res);
+    // We should only have had to read the one long value.
+    ASSERT_LT(bytes_read, 2u * (4000 + 'b'));
+
+    res = project_fields(serialized, {}, false, &bytes_read);
+    ASSERT_EQ(ql::datum_t::empty_object(), res);
+
+    std::vector<datum_string_t> excluded;
+    for (char c = 'a'; c <= 'y'; ++c) {
+        excluded.push_back(datum_string_t(std::string(1, c)));
+    }
+    res = project_fields(serialized, excluded, true, &bytes_read);
+    ASSERT_EQ(ql::datum_t(std::map<datum_string_t, ql::datum_t>{
+                  std::make_pair(datum_string_t("id"), object.get_field("id")),
+                  std::make_pair(datum_string_t("z"), object.get_field("z"))}),
+              res);
+
+    // Anything but an object has to be read the usual way.
+    res = project_fields(serialize_for_projection(ql::datum_t(1.0)),
+                         {datum_string_t("a")}, false, &bytes_read);
+    ASSERT_FALSE(res.has());
+}
+
 }  // namespace unittest
@@ -0,0 +1,124 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "concurrency/cond_var.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/response.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// A data directory for queries to spill into, which is removed afterwards.
+class temp_data_directory_t {
+public:
+    temp_data_directory_t() : path(make_directory()) {
+        recreate_temporary_directory(path);
+    }
+    ~temp_data_directory_t() {
+        remove_directory_recursive(path.path().c_str());
+    }
+
+    const base_path_t path;
+
+private:
+    static base_path_t make_directory() {
+        char tmpl[] = "/tmp/rdb_unittest_spill.XXXXXX";
+        guarantee_err(mkdtemp(tmpl) != NULL, "Couldn't create a temporary directory");
+        return base_path_t(tmpl);
+    }
+
+    DISABLE_COPYING(temp_data_directory_t);
+};
+
+// Runs `term` with both the array size limit and the batch size set to `limit`,
+// and returns everything it produced.  Sets `*streamed_out` to whether the result
+// came back as a stream rather than as one array.
+std::vector<ql::datum_t> run_with_limit(rdb_context_t *ctx,
+                                        ql::r::reql_t &&term,
+                                        double limit,
+                                        bool *streamed_out) {
+    ql::query_cache_t query_cache(ctx, ip_and_port_t(),
+                                  ql::return_empty_normal_batches_t::NO);
+    ql::protob_t<Query> query = ql::make_counted_query();
+    query->set_type(Query::START);
+    query->set_token(1);
+    term.swap(*query->mutable_query());
+    for (const char *key : {"array_limit", "max_batch_rows"}) {
+        Query::AssocPair *optarg = query->add_global_optargs();
+        optarg->set_key(key);
+        ql::r::expr(limit).swap(*optarg->mutable_val());
+    }
+
+    std::vector<ql::datum_t> ret;
+    cond_t non_interruptor;
+    scoped_ptr_t<ql::response_t> res(
+        new ql::response_t(ql::response_format_t::PROTOBUF));
+    query_cache.create(1, query, ql::use_json_t::NO, &non_interruptor)
+        ->fill_response(res.get());
+    *streamed_out = res->type() != Response::SUCCESS_ATOM;
+    for (;;) {
+        const Response &pb = res->protobuf();
+        for (int i = 0; i < pb.response_size(); ++i) {
+            ql::datum_t d = ql::to_datum(&pb.response(i),
+                                         ql::configured_limits_t::unlimited,
+                                         reql_version_t::LATEST);
+            if (pb.type() == Response::SUCCESS_ATOM) {
+                for (size_t j = 0; j < d.arr_size(); ++j) {
+                    ret.push_back(d.get(j));
+                }
+            } else {
+                ret.push_back(d);
+            }
+        }
+        if (pb.type() != Response::SUCCESS_PARTIAL) {
+            EXPECT_TRUE(pb.type() == Response::SUCCESS_ATOM
+                        || pb.type() == Response::SUCCESS_SEQUENCE);
+            return ret;
+        }
+        res.init(new ql::response_t(ql::response_format_t::PROTOBUF));
+        query_cache.get(1, ql::use_json_t::NO, &non_interruptor)
+            ->fill_response(res.get());
+    }
+}
+
+// `r.range(num_rows).map(x -> x % num_distinct).distinct()`.
+ql::r::reql_t distinct_of_range(double num_rows, double num_distinct) {
+    const ql::pb::dummy_var_t x = ql::pb::dummy_var_t::DISTINCT_ROW;
+    return ql::r::reql_t(Term::RANGE, num_rows)
+        .map(ql::r::fun(x, ql::r::var(x).call(Term::MOD, num_distinct)))
+        .call(Term::DISTINCT);
+}
+
+TPTEST(DistinctSpill, MatchesInMemoryResult) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    temp_data_directory_t data_directory;
+    rdb_context_t ctx(NULL, NULL, NULL,
+                      boost::shared_ptr<semilattice_readwrite_view_t<
+                          auth_semilattice_metadata_t> >(),
+                      &get_global_perfmon_collection(), std::string(),
+                      &io_backender, data_directory.path);
+
+    bool streamed;
+    std::vector<ql::datum_t> in_memory
+        = run_with_limit(&ctx, distinct_of_range(2000, 300), 100000, &streamed);
+    ASSERT_FALSE(streamed);
+    ASSERT_EQ(300u, in_memory.size());
+
+    // With 10-row batches every run holds at most 20 values, so the 300 distinct
+    // values, and the duplicates between runs, make many more runs than are kept
+    // open at once.
+    std::vector<ql::datum_t> spilled
+        = run_with_limit(&ctx, distinct_of_range(2000, 300), 10, &streamed);
+    ASSERT_TRUE(streamed);
+    ASSERT_EQ(in_memory, spilled);
+}
+
+}  // namespace unittest
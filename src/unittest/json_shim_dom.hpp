@@ -0,0 +1,20 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef UNITTEST_JSON_SHIM_DOM_HPP_
+#define UNITTEST_JSON_SHIM_DOM_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+
+class Query;
+
+namespace unittest {
+
+// Does the same as `json_shim::parse_json_pb`, but by building a rapidjson DOM first
+// and then converting it, the way the server used to.  That's slower, but simple
+// enough to serve as a reference for `parse_json_pb`.
+MUST_USE bool parse_json_pb_dom(Query *q, int64_t token, char *str);
+
+}  // namespace unittest
+
+#endif  // UNITTEST_JSON_SHIM_DOM_HPP_
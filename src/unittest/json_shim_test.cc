@@ -0,0 +1,77 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "protob/json_shim.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/benchmark.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/json_shim_dom.hpp"
+
+namespace unittest {
+
+// Parses `json` both ways and checks that the results agree.
+void check_same_parse(const std::string &json) {
+    std::string copy1 = json;
+    std::string copy2 = json;
+    Query streamed;
+    Query via_dom;
+    const bool streamed_ok = json_shim::parse_json_pb(&streamed, 17, &copy1[0]);
+    const bool via_dom_ok = parse_json_pb_dom(&via_dom, 17, &copy2[0]);
+    ASSERT_EQ(via_dom_ok, streamed_ok) << json;
+    if (streamed_ok) {
+        ASSERT_EQ(via_dom.SerializeAsString(), streamed.SerializeAsString()) << json;
+    }
+}
+
+TEST(JsonShim, SameAsDom) {
+    const std::vector<std::string> queries = {
+        // r.table('tbl').get('a', ...) with global optargs
+        "[1,[16,[[15,[[14,[\"test\"]],\"tbl\"]],\"a\"]],"
+        "{\"db\":[14,[\"test\"]],\"noreply\":true}]",
+        // Datum arguments of every type, and nested objects
+        "[1,[2,[1,2.5,-3,null,true,false,\"s\",{\"k\":[2,[1,2]]}]],{}]",
+        "[1,[2,[9007199254740993,18446744073709551615,1e300,-0.0]]]",
+        "[1,[2,[\"esc\\\"aped\\u00e9\\n\"]]]",
+        // Arguments given as an object, and empty optional argument arrays
+        "[1,[2,{\"x\":1,\"y\":[2,[3]]}],[]]",
+        "[1,[2,[1],[]]]",
+        // Trailing elements are ignored
+        "[1,[2,[1],{\"a\":{\"b\":1}}],{},[1,{\"z\":[]}],7]",
+        "[1,[2,[],{},[1,2,{\"q\":3}]]]",
+        // Incomplete queries and terms
+        "[]", "[1]", "[1,2]", "[1,[]]", "[2]",
+        // Duplicate optional arguments
+        "[1,[1,[],{\"a\":1,\"a\":2}]]",
+        // Malformed queries
+        "{}", "1", "[1.5,[2]]", "[\"a\",[2]]", "[1,[2,1]]", "[1,[2,[1],[1]]]",
+        "[1,[2.0,[],{}],3]", "[1,[null,[]]]", "[1,[3,[]]] x", "[1,[3,[]",
+        "[1,[2,[],[{\"a\":1}]]]", "",
+    };
+    for (const auto &query : queries) {
+        check_same_parse(query);
+    }
+}
+
+TEST(JsonShim, DISABLED_ParseBenchmark) {
+    const std::string query =
+        "[1,[16,[[15,[[14,[\"test\"]],\"tbl\"]],"
+        "\"3f2504e0-4f89-11d3-9a0c-0305e82c3301\"]],"
+        "{\"db\":[14,[\"test\"]],\"durability\":\"soft\"}]";
+    const int iterations = 100000;
+    benchmark_timer_t timer;
+    for (int dom = 0; dom < 2; ++dom) {
+        for (int i = 0; i < iterations; ++i) {
+            std::string copy = query;
+            Query q;
+            const bool ok = dom
+                ? parse_json_pb_dom(&q, i, &copy[0])
+                : json_shim::parse_json_pb(&q, i, &copy[0]);
+            ASSERT_TRUE(ok);
+        }
+        timer.record_rate(dom ? "via_dom_queries_per_sec" : "streamed_queries_per_sec",
+                          iterations);
+    }
+}
+
+}  // namespace unittest
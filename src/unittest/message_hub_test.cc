@@ -0,0 +1,108 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/runtime_utils.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/benchmark.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Records where it came from when it arrives on thread 0, and pulses `done` once
+// `expected` messages have.
+class recording_msg_t : public linux_thread_message_t {
+public:
+    recording_msg_t() : sender(-1), seq(-1), arrivals(NULL), expected(0), done(NULL) { }
+    void on_thread_switch() {
+        ASSERT_EQ(0, get_thread_id().threadnum);
+        arrivals->push_back(std::make_pair(sender, seq));
+        if (arrivals->size() == expected) {
+            done->pulse();
+        }
+    }
+    int sender;
+    int seq;
+    std::vector<std::pair<int, int> > *arrivals;
+    size_t expected;
+    cond_t *done;
+};
+
+// `msgs` has `per_sender` messages for each thread.
+static void send_to_thread_zero(scoped_array_t<recording_msg_t> *msgs,
+                                int per_sender,
+                                int64_t sender) {
+    on_thread_t thread_switcher((threadnum_t(sender)));
+    for (int i = 0; i < per_sender; ++i) {
+        recording_msg_t *msg = &(*msgs)[sender * per_sender + i];
+        bool on_thread = continue_on_thread(threadnum_t(0), msg);
+        guarantee(!on_thread);
+        // Spread the messages over several batches.
+        if (i % 100 == 99) {
+            coro_t::yield();
+        }
+    }
+}
+
+// Starts sending `per_sender` messages from each of the threads but thread 0 to
+// thread 0, and waits for them all to arrive.
+static void fan_in(int per_sender, std::vector<std::pair<int, int> > *arrivals) {
+    const int num_threads = get_num_threads();
+    const size_t expected = static_cast<size_t>(num_threads - 1) * per_sender;
+    cond_t done;
+    scoped_array_t<recording_msg_t> msgs(num_threads * per_sender);
+    for (int sender = 1; sender < num_threads; ++sender) {
+        for (int seq = 0; seq < per_sender; ++seq) {
+            recording_msg_t *msg = &msgs[sender * per_sender + seq];
+            msg->sender = sender;
+            msg->seq = seq;
+            msg->arrivals = arrivals;
+            msg->expected = expected;
+            msg->done = &done;
+        }
+    }
+    arrivals->reserve(expected);
+    pmap(static_cast<int64_t>(1), static_cast<int64_t>(num_threads),
+         std::bind(&send_to_thread_zero, &msgs, per_sender, ph::_1));
+    done.wait();
+}
+
+TPTEST(MessageHub, FanInKeepsOrder, 4) {
+    const int per_sender = 10000;
+    std::vector<std::pair<int, int> > arrivals;
+    fan_in(per_sender, &arrivals);
+
+    std::vector<int> next_seq(get_num_threads(), 0);
+    for (const auto &arrival : arrivals) {
+        ASSERT_EQ(next_seq[arrival.first], arrival.second);
+        ++next_seq[arrival.first];
+    }
+    for (int sender = 1; sender < get_num_threads(); ++sender) {
+        ASSERT_EQ(per_sender, next_seq[sender]);
+    }
+}
+
+TPTEST(MessageHub, DISABLED_FanInBenchmark, 8) {
+    const int per_sender = 200000;
+    std::vector<std::pair<int, int> > arrivals;
+    benchmark_timer_t timer;
+    fan_in(per_sender, &arrivals);
+    timer.record_rate("fan_in_messages_per_sec", arrivals.size());
+}
+
+TPTEST(MessageHub, DISABLED_PingPongBenchmark, 2) {
+    const int round_trips = 200000;
+    benchmark_timer_t timer;
+    for (int i = 0; i < round_trips; ++i) {
+        on_thread_t thread_switcher((threadnum_t(1)));
+    }
+    timer.record_rate("round_trips_per_sec", round_trips);
+}
+
+}  // namespace unittest
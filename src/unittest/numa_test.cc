@@ -0,0 +1,53 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <sched.h>
+
+#include <set>
+
+#include "arch/runtime/numa.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TEST(Numa, TopologyHasEveryCpuOnce) {
+    numa_topology_t topology;
+    ASSERT_GT(topology.num_nodes(), 0u);
+    std::set<int> cpus;
+    for (size_t i = 0; i < topology.cpus_by_node().size(); ++i) {
+        ASSERT_TRUE(cpus.insert(topology.cpus_by_node()[i]).second);
+        ASSERT_GE(topology.node_of(i), 0);
+        // A node's CPUs are all together.
+        if (i > 0 && topology.node_of(i) != topology.node_of(i - 1)) {
+            for (size_t j = 0; j < i; ++j) {
+                ASSERT_NE(topology.node_of(i), topology.node_of(j));
+            }
+        }
+    }
+}
+
+void check_placement(int64_t thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    ASSERT_NE(-1, get_thread_numa_node(get_thread_id()));
+#ifdef _GNU_SOURCE
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(mask), &mask));
+    ASSERT_EQ(1, CPU_COUNT(&mask));
+#endif
+}
+
+TEST(Numa, PinsThreads) {
+    set_numa_placement(true);
+    run_in_thread_pool([]() {
+        pmap(static_cast<int64_t>(get_num_threads()), &check_placement);
+    }, 3);
+    set_numa_placement(false);
+}
+
+TPTEST(Numa, OffByDefault) {
+    ASSERT_EQ(-1, get_thread_numa_node(get_thread_id()));
+}
+
+}  // namespace unittest
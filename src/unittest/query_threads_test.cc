@@ -0,0 +1,258 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/interruptor.hpp"
+#include "perfmon/collect.hpp"
+#include "protob/protob.hpp"
+#include "protob/query_threads.hpp"
+#include "rdb_protocol/backtrace.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/response.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Stands in for the query server: remembers where each query ran, and answers
+// START, CONTINUE and EXECUTE queries as if they returned endless streams.
+class recording_handler_t : public query_handler_t, public home_thread_mixin_t {
+public:
+    struct call_t {
+        Query::QueryType type;
+        threadnum_t thread;
+        ql::query_cache_t *query_cache;
+    };
+
+    void run_query(UNUSED ql::query_id_t &&query_id,
+                   const ql::protob_t<Query> &query,
+                   ql::response_t *res,
+                   ql::query_cache_t *query_cache,
+                   signal_t *interruptor) {
+        const call_t call = { query->type(), get_thread_id(), query_cache };
+        on_thread_t thread_switcher(home_thread());
+        calls[query->token()].push_back(call);
+
+        auto it = blockers.find(query->token());
+        if (it != blockers.end() && query->type() == Query::START) {
+            cond_t *started = it->second.first;
+            cond_t *release = it->second.second;
+            blockers.erase(it);
+            started->pulse();
+            wait_interruptible(release, interruptor);
+        }
+
+        switch (query->type()) {
+        case Query::START: // fallthru
+        case Query::CONTINUE: // fallthru
+        case Query::EXECUTE:
+            res->set_type(Response::SUCCESS_PARTIAL);
+            break;
+        case Query::PREPARE:
+            res->set_type(Response::SUCCESS_ATOM);
+            break;
+        case Query::STOP: // fallthru
+        case Query::NOREPLY_WAIT:
+            res->set_type(Response::SUCCESS_SEQUENCE);
+            break;
+        default:
+            unreachable();
+        }
+    }
+
+    // The next START query for `token` pulses `started` and then waits for
+    // `release`.
+    void block(int64_t token, cond_t *started, cond_t *release) {
+        blockers[token] = std::make_pair(started, release);
+    }
+
+    std::map<int64_t, std::vector<call_t> > calls;
+
+private:
+    std::map<int64_t, std::pair<cond_t *, cond_t *> > blockers;
+};
+
+class query_threads_fixture_t {
+public:
+    explicit query_threads_fixture_t(rdb_context_t *ctx)
+        : home_query_cache(ctx, ip_and_port_t(),
+                           ql::return_empty_normal_batches_t::NO),
+          threads(ctx, ip_and_port_t(), ql::return_empty_normal_batches_t::NO,
+                  &home_query_cache) { }
+
+    // Returns the type of the response.
+    Response::ResponseType run(Query::QueryType type, int64_t token) {
+        ql::protob_t<Query> query = ql::make_counted_query();
+        query->set_type(type);
+        query->set_token(token);
+        return run(query);
+    }
+
+    Response::ResponseType run(const ql::protob_t<Query> &query) {
+        ql::response_t response(ql::response_format_t::PROTOBUF);
+        cond_t non_interruptor;
+        threads.run_query(&handler, ql::query_id_t(&home_query_cache), query,
+                          &response, &non_interruptor);
+        return response.type();
+    }
+
+    // Runs a START query for `token` that keeps running until `release` is pulsed,
+    // and pulses `done` after that.
+    void start_blocked(int64_t token, cond_t *release, cond_t *done) {
+        cond_t started;
+        handler.block(token, &started, release);
+        coro_t::spawn_sometime([this, token, done]() {
+            run(Query::START, token);
+            done->pulse();
+        });
+        started.wait();
+    }
+
+    ql::query_cache_t home_query_cache;
+    query_threads_t threads;
+    recording_handler_t handler;
+};
+
+TPTEST(QueryThreads, ContinueAndStopFollowTheirStart, 4) {
+    rdb_context_t ctx;
+    query_threads_fixture_t f(&ctx);
+    // While token 1 is running, the other START queries are spread over the
+    // threads.
+    cond_t release, done;
+    f.start_blocked(1, &release, &done);
+    const int64_t num_tokens = 10;
+    for (int64_t token = 2; token <= num_tokens; ++token) {
+        ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(Query::START, token));
+    }
+    for (int64_t token = 2; token <= num_tokens; ++token) {
+        ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(Query::CONTINUE, token));
+        ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, token));
+    }
+    release.pulse();
+    done.wait();
+
+    std::set<int> threads_used;
+    for (int64_t token = 2; token <= num_tokens; ++token) {
+        const std::vector<recording_handler_t::call_t> &calls = f.handler.calls[token];
+        ASSERT_EQ(3u, calls.size());
+        threads_used.insert(calls[0].thread.threadnum);
+        for (const recording_handler_t::call_t &call : calls) {
+            ASSERT_EQ(calls[0].thread.threadnum, call.thread.threadnum);
+            ASSERT_EQ(calls[0].query_cache, call.query_cache);
+        }
+    }
+    ASSERT_EQ(static_cast<size_t>(get_num_db_threads()), threads_used.size());
+
+    // Once a token is stopped, its CONTINUE goes to the home thread, whose query
+    // cache would report that it's gone.
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(Query::CONTINUE, 2));
+    ASSERT_EQ(&f.home_query_cache, f.handler.calls[2].back().query_cache);
+}
+
+TPTEST(QueryThreads, RejectsDuplicateTokens, 4) {
+    rdb_context_t ctx;
+    query_threads_fixture_t f(&ctx);
+    cond_t release, done;
+    f.start_blocked(1, &release, &done);
+
+    // A running query, a stream that might be continued, and a prepared query all
+    // keep their tokens, wherever they are.
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(Query::START, 2));
+    ASSERT_EQ(Response::SUCCESS_ATOM, f.run(Query::PREPARE, 3));
+    for (int64_t token = 1; token <= 3; ++token) {
+        ASSERT_EQ(Response::CLIENT_ERROR, f.run(Query::START, token));
+        ASSERT_EQ(Response::CLIENT_ERROR, f.run(Query::PREPARE, token));
+        ASSERT_EQ(Response::CLIENT_ERROR, f.run(Query::EXECUTE, token));
+    }
+    ASSERT_EQ(1u, f.handler.calls[1].size());
+    ASSERT_EQ(1u, f.handler.calls[2].size());
+    ASSERT_EQ(1u, f.handler.calls[3].size());
+
+    // A STOP while the query is running doesn't free the token yet.
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, 1));
+    ASSERT_EQ(Response::CLIENT_ERROR, f.run(Query::START, 1));
+    release.pulse();
+    done.wait();
+
+    // Once they're done, the tokens can be used again.
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, 2));
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, 3));
+    for (int64_t token = 1; token <= 3; ++token) {
+        ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(Query::START, token));
+    }
+}
+
+ql::protob_t<Query> make_start_query(int64_t token, ql::r::reql_t &&term) {
+    ql::protob_t<Query> query = ql::make_counted_query();
+    query->set_type(Query::START);
+    query->set_token(token);
+    term.swap(*query->mutable_query());
+    return query;
+}
+
+int64_t get_queries_on_read_thread() {
+    return perfmon_get_stats().get_field("query_engine")
+        .get_field("queries_on_read_thread").as_int();
+}
+
+void run_point_get_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    rdb_context_t *ctx = env_instance->get_rdb_context();
+    const threadnum_t read_thread(2);
+    env_instance->set_read_thread(name_string_t::guarantee_valid("db"),
+                                  name_string_t::guarantee_valid("table"),
+                                  read_thread);
+    query_threads_fixture_t f(ctx);
+    ASSERT_NE(read_thread.threadnum, get_thread_id().threadnum);
+
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(make_start_query(
+        1, ql::r::db("db").table("table").get_("key"))));
+    ql::protob_t<Query> with_optarg = make_start_query(
+        2, ql::r::reql_t(Term::TABLE, "table").get_(1.0));
+    Query::AssocPair *db_optarg = with_optarg->add_global_optargs();
+    db_optarg->set_key("db");
+    ql::r::db("db").swap(*db_optarg->mutable_val());
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(with_optarg));
+    for (int64_t token = 1; token <= 2; ++token) {
+        ASSERT_EQ(1u, f.handler.calls[token].size());
+        ASSERT_EQ(read_thread.threadnum, f.handler.calls[token][0].thread.threadnum);
+    }
+    ASSERT_EQ(2, get_queries_on_read_thread());
+
+    // Anything that isn't a point `get` with a literal key runs where it would
+    // have anyway, which for a connection with nothing else running is its own
+    // thread.
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, 1));
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, 2));
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(make_start_query(
+        3, ql::r::db("db").table("table"))));
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(make_start_query(
+        4, ql::r::db("db").table("table").get_(ql::r::expr(1.0) + 1.0))));
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, f.run(make_start_query(
+        5, ql::r::db("db").table("other").get_("key"))));
+    for (int64_t token = 3; token <= 5; ++token) {
+        ASSERT_EQ(get_thread_id().threadnum,
+                  f.handler.calls[token][0].thread.threadnum);
+        ASSERT_EQ(Response::SUCCESS_SEQUENCE, f.run(Query::STOP, token));
+    }
+    ASSERT_EQ(2, get_queries_on_read_thread());
+}
+
+TEST(QueryThreads, PointGetsRunOnTheirReadThread) {
+    // The environment has to be set up outside of the thread pool.
+    test_rdb_env_t test_env;
+    test_env.add_database("db");
+    test_env.add_table("db", "table", "id");
+    test_env.add_table("db", "other", "id");
+    unittest::run_in_thread_pool(std::bind(&run_point_get_test, &test_env), 4);
+}
+
+}  // namespace unittest
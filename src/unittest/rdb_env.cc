@@ -46,6 +46,19 @@ void mock_namespace_interface_t::write(const write_t &query,
     boost::apply_visitor(v, query.write);
 }
 
+bool mock_namespace_interface_t::get_read_thread(UNUSED const store_key_t &key,
+                                                 threadnum_t *thread_out) {
+    if (!read_thread) {
+        return false;
+    }
+    *thread_out = *read_thread;
+    return true;
+}
+
+void mock_namespace_interface_t::set_read_thread(threadnum_t thread) {
+    read_thread = thread;
+}
+
 std::map<store_key_t, ql::datum_t> *mock_namespace_interface_t::get_data() {
     return &data;
 }
@@ -337,6 +350,8 @@ test_rdb_env_t::instance_t::instance_t(test_rdb_env_t &&test_env) :
                 env.get()));
         tables[std::make_pair(db_it->second, db_table_pair.first.second)] =
             std::move(storage);
+        table_ids[std::make_pair(db_it->second, db_table_pair.first.second)] =
+            generate_uuid();
     }
 
     test_env.databases.clear();
@@ -360,6 +375,15 @@ std::map<store_key_t, ql::datum_t> *test_rdb_env_t::instance_t::get_data(
     return table_it->second->get_data();
 }
 
+void test_rdb_env_t::instance_t::set_read_thread(
+        name_string_t db, name_string_t table, threadnum_t thread) {
+    auto db_it = databases.find(db);
+    guarantee(db_it != databases.end());
+    auto table_it = tables.find(std::make_pair(db_it->second, table));
+    guarantee(table_it != tables.end());
+    table_it->second->set_read_thread(thread);
+}
+
 void test_rdb_env_t::instance_t::interrupt() {
     interruptor.pulse();
 }
@@ -465,12 +489,26 @@ bool test_rdb_env_t::instance_t::table_find(const name_string_t &name,
         static fake_ref_tracker_t fake_ref_tracker;
         namespace_interface_access_t table_access(
             it->second.get(), &fake_ref_tracker, get_thread_id());
-        table_out->reset(new real_table_t(nil_uuid(), table_access,
+        table_out->reset(new real_table_t(table_ids.at(it->first), table_access,
                                           it->second->get_primary_key(), NULL));
         return true;
     }
 }
 
+bool test_rdb_env_t::instance_t::table_get_read_thread(
+        const namespace_id_t &table_id, ql::datum_t pval,
+        bool *table_gone_out, threadnum_t *thread_out) {
+    *table_gone_out = false;
+    for (const auto &pair : table_ids) {
+        if (pair.second == table_id) {
+            return tables.at(pair.first)->get_read_thread(
+                store_key_t(pval.print_primary()), thread_out);
+        }
+    }
+    *table_gone_out = true;
+    return false;
+}
+
 bool test_rdb_env_t::instance_t::table_estimate_doc_counts(
         UNUSED counted_t<const ql::db_t> db,
         UNUSED const name_string_t &name,
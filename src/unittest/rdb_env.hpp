@@ -9,6 +9,7 @@
 #include <utility>
 
 #include "errors.hpp"
+#include <boost/optional.hpp>
 #include <boost/variant.hpp>
 
 #include "clustering/administration/main/ports.hpp"
@@ -59,6 +60,10 @@ public:
 
     bool check_readiness(table_readiness_t readiness, signal_t *interruptor);
 
+    // Returns the thread set with `set_read_thread`, for every key.
+    bool get_read_thread(const store_key_t &key, threadnum_t *thread_out);
+    void set_read_thread(threadnum_t thread);
+
     std::map<store_key_t, ql::datum_t> *get_data();
 
     std::string get_primary_key() const;
@@ -68,6 +73,7 @@ private:
     datum_string_t primary_key;
     std::map<store_key_t, ql::datum_t> data;
     ql::env_t *env;
+    boost::optional<threadnum_t> read_thread;
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const point_read_t &get);
@@ -157,6 +163,8 @@ public:
 
         std::map<store_key_t, ql::datum_t> *get_data(name_string_t db,
                                                      name_string_t table);
+        void set_read_thread(name_string_t db, name_string_t table,
+                             threadnum_t thread);
 
 
         bool db_create(const name_string_t &name, signal_t *interruptor,
@@ -189,6 +197,8 @@ public:
                 boost::optional<admin_identifier_format_t> identifier_format,
                 signal_t *interruptor, counted_t<base_table_t> *table_out,
                 std::string *error_out);
+        bool table_get_read_thread(const namespace_id_t &table_id,
+                ql::datum_t pval, bool *table_gone_out, threadnum_t *thread_out);
         bool table_estimate_doc_counts(
                 counted_t<const ql::db_t> db,
                 const name_string_t &name,
@@ -259,6 +269,7 @@ public:
         std::map<name_string_t, database_id_t> databases;
         std::map<std::pair<database_id_t, name_string_t>,
                  scoped_ptr_t<mock_namespace_interface_t> > tables;
+        std::map<std::pair<database_id_t, name_string_t>, namespace_id_t> table_ids;
         scoped_ptr_t<ql::env_t> env;
         cond_t interruptor;
     };
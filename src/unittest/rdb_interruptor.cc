@@ -12,6 +12,7 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/response.hpp"
 #include "unittest/gtest.hpp"
 #include "unittest/rdb_env.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -257,7 +258,7 @@ public:
 
     void run_query(UNUSED ql::query_id_t &&query_id,
                    const ql::protob_t<Query> &query,
-                   Response *res,
+                   ql::response_t *res,
                    UNUSED ql::query_cache_t *query_cache,
                    signal_t *interruptor) {
         assert_thread();
@@ -417,7 +418,7 @@ void tcp_interrupt_test(
     scoped_ptr_t<query_server_t> server(
         new query_server_t(env_instance->get_rdb_context(),
                            std::set<ip_address_t>({ip_address_t("127.0.0.1")}),
-                           0, &hanger, 2));
+                           0, false, &hanger, 2));
 
     scoped_ptr_t<tcp_conn_stream_t> conn = connect_client(server->get_port());
     send_query(test_token, r_uuid_json, conn.get());
@@ -532,7 +533,7 @@ void http_interrupt_test(test_rdb_env_t *test_env,
     scoped_ptr_t<query_server_t> server(
         new query_server_t(env_instance->get_rdb_context(),
                            std::set<ip_address_t>({ip_address_t("127.0.0.1")}),
-                           0, &hanger, 2));
+                           0, false, &hanger, 2));
 
     cond_t http_app_interruptor;
     http_res_t result;
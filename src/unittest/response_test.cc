@@ -0,0 +1,368 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "containers/archive/string_stream.hpp"
+#include "containers/chained_buffer.hpp"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "rdb_protocol/backtrace.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/json_cache.hpp"
+#include "rdb_protocol/response.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+std::string chained_buffer_contents(const chained_buffer_t &buf) {
+    std::string res;
+    buf.append_to_string(&res);
+    return res;
+}
+
+TEST(ChainedBuffer, AppendAndTruncate) {
+    chained_buffer_t buf;
+    std::string expected;
+    // Enough to span several blocks of different sizes.
+    for (size_t i = 0; i < 300 * KILOBYTE; ++i) {
+        const char c = 'a' + (i % 26);
+        if (i % 3 == 0) {
+            buf.Put(c);
+        } else {
+            buf.append(&c, 1);
+        }
+        expected.push_back(c);
+    }
+    ASSERT_EQ(expected.size(), buf.size());
+    ASSERT_EQ(expected, chained_buffer_contents(buf));
+
+    std::vector<iovec> iovs;
+    buf.append_iovecs(&iovs);
+    ASSERT_LT(1u, iovs.size());
+    size_t total = 0;
+    for (const auto &iov : iovs) {
+        ASSERT_LE(iov.iov_len, chained_buffer_t::max_block_size);
+        total += iov.iov_len;
+    }
+    ASSERT_EQ(expected.size(), total);
+
+    // Truncating in the middle of a block, at a block boundary and to nothing.
+    const std::vector<size_t> new_sizes = {
+        100 * KILOBYTE + 17, chained_buffer_t::min_block_size, 0 };
+    for (size_t new_size : new_sizes) {
+        buf.truncate(new_size);
+        expected.resize(new_size);
+        ASSERT_EQ(expected, chained_buffer_contents(buf));
+        buf.append("xyz", 3);
+        expected.append("xyz");
+        ASSERT_EQ(expected, chained_buffer_contents(buf));
+    }
+}
+
+std::string datum_to_json(const ql::datum_t &d) {
+    rapidjson::StringBuffer buf;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+    d.write_json(&writer);
+    return std::string(buf.GetString(), buf.GetSize());
+}
+
+std::string json_value_to_string(const rapidjson::Value &v) {
+    rapidjson::StringBuffer buf;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+    v.Accept(writer);
+    return std::string(buf.GetString(), buf.GetSize());
+}
+
+void parse_response(ql::response_t *response, rapidjson::Document *doc_out) {
+    std::string json = chained_buffer_contents(response->finish_json());
+    doc_out->Parse(json.c_str());
+    ASSERT_FALSE(doc_out->HasParseError()) << json;
+    ASSERT_TRUE(doc_out->IsObject()) << json;
+}
+
+TEST(Response, JsonData) {
+    ql::configured_limits_t limits;
+    std::vector<ql::datum_t> data;
+    data.push_back(ql::datum_t(1.5));
+    data.push_back(ql::datum_t("a \"string\"\n"));
+    data.push_back(ql::datum_t::null());
+    data.push_back(ql::datum_t::binary(datum_string_t("\x01\x02")));
+    data.push_back(ql::datum_t(std::vector<ql::datum_t>(data), limits));
+
+    ql::response_t response(ql::response_format_t::JSON);
+    response.set_token(5);
+    response.set_type(Response::SUCCESS_PARTIAL);
+    response.add_note(Response::SEQUENCE_FEED);
+    for (const auto &d : data) {
+        response.add_datum(d, ql::use_json_t::YES);
+    }
+    // Data that can't be written as JSON leave the response as it was.
+    ASSERT_THROW(response.add_datum(ql::datum_t::minval(), ql::use_json_t::YES),
+                 ql::base_exc_t);
+    ASSERT_EQ(data.size(), response.datum_count());
+    response.set_profile(ql::datum_t("profile"), ql::use_json_t::YES);
+
+    rapidjson::Document doc;
+    parse_response(&response, &doc);
+    ASSERT_EQ(Response::SUCCESS_PARTIAL, doc["t"].GetInt());
+    ASSERT_EQ(1u, doc["n"].Size());
+    ASSERT_EQ(Response::SEQUENCE_FEED, doc["n"][0].GetInt());
+    ASSERT_FALSE(doc.HasMember("b"));
+    ASSERT_EQ("\"profile\"", json_value_to_string(doc["p"]));
+    ASSERT_EQ(data.size(), doc["r"].Size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        ASSERT_EQ(datum_to_json(data[i]),
+                  json_value_to_string(doc["r"][static_cast<rapidjson::SizeType>(i)]));
+    }
+}
+
+TEST(Response, JsonError) {
+    ql::configured_limits_t limits;
+    ql::response_t response(ql::response_format_t::JSON);
+    response.set_type(Response::SUCCESS_PARTIAL);
+    response.add_datum(ql::datum_t(1.0), ql::use_json_t::YES);
+    response.set_profile(ql::datum_t("profile"), ql::use_json_t::YES);
+
+    std::vector<ql::datum_t> frames;
+    frames.push_back(ql::datum_t(2.0));
+    frames.push_back(ql::datum_t("opt"));
+    ql::fill_error(&response, Response::RUNTIME_ERROR, "oops",
+                   ql::datum_t(std::move(frames), limits));
+
+    rapidjson::Document doc;
+    parse_response(&response, &doc);
+    ASSERT_EQ(Response::RUNTIME_ERROR, doc["t"].GetInt());
+    ASSERT_EQ("[\"oops\"]", json_value_to_string(doc["r"]));
+    ASSERT_EQ("[2,\"opt\"]", json_value_to_string(doc["b"]));
+    ASSERT_FALSE(doc.HasMember("p"));
+}
+
+TEST(Response, Protobuf) {
+    ql::response_t response(ql::response_format_t::PROTOBUF);
+    response.set_type(Response::SUCCESS_ATOM);
+    response.add_datum(ql::datum_t(3.0), ql::use_json_t::NO);
+    ASSERT_THROW(response.add_datum(ql::datum_t::maxval(), ql::use_json_t::NO),
+                 ql::base_exc_t);
+    const Response &pb = response.protobuf();
+    ASSERT_EQ(Response::SUCCESS_ATOM, pb.type());
+    ASSERT_EQ(1, pb.response_size());
+    ASSERT_EQ(3.0, pb.response(0).r_num());
+
+    response.clear();
+    ASSERT_EQ(0u, response.datum_count());
+    ASSERT_EQ(0, response.protobuf().response_size());
+}
+
+std::string iovecs_to_string(const std::vector<iovec> &iovs) {
+    std::string res;
+    for (const auto &iov : iovs) {
+        res.append(static_cast<const char *>(iov.iov_base), iov.iov_len);
+    }
+    return res;
+}
+
+std::string serialize_for_test(const ql::datum_t &d) {
+    write_message_t wm;
+    ql::datum_serialize(&wm, d, ql::check_datum_serialization_errors_t::NO);
+    string_stream_t stream;
+    guarantee(send_write_message(&stream, &wm) == 0);
+    return stream.str();
+}
+
+// Returns a datum that's backed by its serialization, like the ones read from disk.
+ql::datum_t deserialize_from_buf_for_test(const std::string &serialization) {
+    counted_t<shared_buf_t> buf = shared_buf_t::create(serialization.size());
+    memcpy(buf->data(), serialization.data(), serialization.size());
+    return ql::datum_deserialize_from_buf(shared_buf_ref_t<char>(buf, 0), 0);
+}
+
+TPTEST(Response, JsonCache) {
+    ql::configured_limits_t limits;
+    std::map<datum_string_t, ql::datum_t> fields;
+    fields[datum_string_t("id")] = ql::datum_t("session");
+    fields[datum_string_t("n")] = ql::datum_t(2.0);
+    fields[datum_string_t("tags")] = ql::datum_t(
+        std::vector<ql::datum_t>{ql::datum_t("a"), ql::datum_t::null()}, limits);
+    const ql::datum_t obj(std::move(fields));
+    const std::string expected = datum_to_json(obj);
+
+    // A copy of the document, as another read would return it.
+    const std::string serialization = serialize_for_test(obj);
+    const ql::datum_t first = deserialize_from_buf_for_test(serialization);
+    const ql::datum_t second = deserialize_from_buf_for_test(serialization);
+
+    ql::json_cache_t cache(MEGABYTE);
+    ql::json_cache_t::key_t key;
+    ASSERT_FALSE(ql::json_cache_t::make_key(obj, &key));
+    ASSERT_FALSE(ql::json_cache_t::make_key(ql::datum_t(1.0), &key));
+
+    // The first time the document is seen it's only remembered.
+    ASSERT_TRUE(ql::json_cache_t::make_key(first, &key));
+    ASSERT_TRUE(cache.find(key) == NULL);
+    ASSERT_FALSE(cache.should_insert(key));
+    ASSERT_EQ(0u, cache.size());
+
+    ASSERT_TRUE(ql::json_cache_t::make_key(second, &key));
+    ASSERT_TRUE(cache.find(key) == NULL);
+    ASSERT_TRUE(cache.should_insert(key));
+    cache.insert(key, expected.data(), expected.size());
+    ASSERT_EQ(1u, cache.size());
+
+    ASSERT_TRUE(ql::json_cache_t::make_key(first, &key));
+    const std::string *json = cache.find(key);
+    ASSERT_TRUE(json != NULL);
+    ASSERT_EQ(expected, *json);
+
+    // A modified document has a different serialization, so it misses.
+    std::string modified = serialization;
+    modified[modified.size() - 2] ^= 1;
+    ASSERT_TRUE(ql::json_cache_t::make_key(deserialize_from_buf_for_test(modified),
+                                           &key));
+    ASSERT_TRUE(cache.find(key) == NULL);
+
+    // The responses are the same whether the JSON comes from the thread's cache
+    // or not, and without the caches nothing is cached.
+    rdb_context_t ctx;
+    for (int with_caches = 0; with_caches < 2; ++with_caches) {
+        scoped_ptr_t<ql::json_caches_t> caches;
+        if (with_caches) {
+            caches.init(new ql::json_caches_t(&ctx, MEGABYTE));
+        }
+        for (int i = 0; i < 3; ++i) {
+            ql::response_t response(ql::response_format_t::JSON);
+            response.set_json_caches(ctx.json_caches);
+            response.set_type(Response::SUCCESS_ATOM);
+            response.add_datum(deserialize_from_buf_for_test(serialization),
+                               ql::use_json_t::YES);
+            response.add_datum(ql::datum_t(1.0), ql::use_json_t::YES);
+            rapidjson::Document doc;
+            parse_response(&response, &doc);
+            ASSERT_EQ("[" + expected + ",1]", json_value_to_string(doc["r"]));
+        }
+        if (with_caches) {
+            ASSERT_TRUE(ql::json_cache_t::make_key(first, &key));
+            ASSERT_TRUE(ctx.json_caches->get()->find(key) != NULL);
+        } else {
+            ASSERT_TRUE(ctx.json_caches == NULL);
+        }
+    }
+    ASSERT_TRUE(ctx.json_caches == NULL);
+}
+
+TEST(Response, Binary) {
+    ql::configured_limits_t limits;
+    std::vector<ql::datum_t> data;
+    data.push_back(ql::datum_t(-7.0));
+    data.push_back(ql::datum_t::binary(datum_string_t(std::string(10000, '\x7f'))));
+
+    // A buffer-backed object, like the ones read from disk.
+    std::map<datum_string_t, ql::datum_t> fields;
+    fields[datum_string_t("a")] = ql::datum_t(1.0);
+    fields[datum_string_t("b")] = ql::datum_t("two");
+    const ql::datum_t obj(std::move(fields));
+    const std::string obj_serialization = serialize_for_test(obj);
+    data.push_back(deserialize_from_buf_for_test(obj_serialization));
+
+    ql::response_t response(ql::response_format_t::BINARY);
+    response.set_type(Response::SUCCESS_SEQUENCE);
+    for (const auto &d : data) {
+        response.add_datum(d, ql::use_json_t::NO);
+    }
+
+    std::vector<iovec> iovs;
+    const size_t size = response.finish_binary(&iovs);
+    const std::string payload = iovecs_to_string(iovs);
+    ASSERT_EQ(size, payload.size());
+
+    uint32_t header_size;
+    ASSERT_LE(sizeof(header_size), payload.size());
+    memcpy(&header_size, payload.data(), sizeof(header_size));
+    size_t pos = sizeof(header_size);
+    rapidjson::Document header;
+    header.Parse(payload.substr(pos, header_size).c_str());
+    ASSERT_FALSE(header.HasParseError());
+    ASSERT_EQ(Response::SUCCESS_SEQUENCE, header["t"].GetInt());
+    ASSERT_FALSE(header.HasMember("r"));
+    pos += header_size;
+
+    for (const auto &expected : data) {
+        uint32_t datum_size;
+        ASSERT_LE(pos + sizeof(datum_size), payload.size());
+        memcpy(&datum_size, payload.data() + pos, sizeof(datum_size));
+        pos += sizeof(datum_size);
+        ASSERT_LE(pos + datum_size, payload.size());
+        ql::datum_t d;
+        string_read_stream_t stream(payload.substr(pos, datum_size), 0);
+        ASSERT_EQ(archive_result_t::SUCCESS, ql::datum_deserialize(&stream, &d));
+        ASSERT_EQ(expected, d);
+        if (expected.get_type() == ql::datum_t::R_OBJECT) {
+            // Sent exactly as it was stored.
+            ASSERT_EQ(obj_serialization, payload.substr(pos, datum_size));
+        }
+        pos += datum_size;
+    }
+    ASSERT_EQ(payload.size(), pos);
+}
+
+// Clients decode what the BINARY protocol sends according to the documented
+// BINARY_DATUM_V1 format (see ql2.proto), so any change to these bytes needs a new
+// `VersionDummy::BinaryFormat`.
+TEST(Response, BinaryDatumFormat) {
+    ql::configured_limits_t limits;
+    std::vector<std::pair<ql::datum_t, std::string> > cases;
+    cases.push_back(std::make_pair(ql::datum_t::null(), std::string("\x03", 1)));
+    cases.push_back(std::make_pair(ql::datum_t::boolean(true),
+                                   std::string("\x02\x01", 2)));
+    cases.push_back(std::make_pair(ql::datum_t(300.0), std::string("\x08\xac\x02", 3)));
+    cases.push_back(std::make_pair(ql::datum_t(-3.0), std::string("\x07\x03", 2)));
+    cases.push_back(std::make_pair(ql::datum_t(-0.0), std::string("\x07\x00", 2)));
+    cases.push_back(std::make_pair(
+        ql::datum_t(1.5),
+        std::string("\x04\x00\x00\x00\x00\x00\x00\xf8\x3f", 9)));
+    cases.push_back(std::make_pair(ql::datum_t("ab"), std::string("\x06\x02" "ab", 4)));
+    cases.push_back(std::make_pair(
+        ql::datum_t::binary(datum_string_t(std::string("\x00\x01", 2))),
+        std::string("\x09\x02\x00\x01", 4)));
+
+    std::vector<ql::datum_t> arr;
+    arr.push_back(ql::datum_t(1.0));
+    arr.push_back(ql::datum_t("a"));
+    // Type, inner size, count, the offset of the second element, the elements.
+    cases.push_back(std::make_pair(
+        ql::datum_t(std::move(arr), limits),
+        std::string("\x0a\x07\x02\x02" "\x08\x01" "\x06\x01" "a", 9)));
+
+    std::map<datum_string_t, ql::datum_t> fields;
+    fields[datum_string_t("b")] = ql::datum_t::null();
+    fields[datum_string_t("a")] = ql::datum_t(1.0);
+    // Keys are strings without a type byte, and come in order.
+    cases.push_back(std::make_pair(
+        ql::datum_t(std::move(fields)),
+        std::string("\x0b\x09\x02\x04" "\x01" "a" "\x08\x01" "\x01" "b" "\x03",
+                    11)));
+
+    for (const auto &c : cases) {
+        ql::response_t response(ql::response_format_t::BINARY);
+        response.set_type(Response::SUCCESS_ATOM);
+        response.add_datum(c.first, ql::use_json_t::NO);
+        std::vector<iovec> iovs;
+        response.finish_binary(&iovs);
+        const std::string payload = iovecs_to_string(iovs);
+
+        uint32_t header_size;
+        memcpy(&header_size, payload.data(), sizeof(header_size));
+        const size_t pos = sizeof(header_size) + header_size;
+        const uint32_t expected_size = c.second.size();
+        ASSERT_EQ(std::string(reinterpret_cast<const char *>(&expected_size),
+                              sizeof(expected_size)) + c.second,
+                  payload.substr(pos));
+    }
+}
+
+}  // namespace unittest
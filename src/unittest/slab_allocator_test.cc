@@ -0,0 +1,157 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/slab_allocator.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "unittest/benchmark.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(SlabAllocator, SizeClasses) {
+    for (size_t size = 0; size <= SLAB_ALLOCATOR_MAX_OBJECT_SIZE; ++size) {
+        const int size_class = slab_allocator_t::size_class_of(size);
+        ASSERT_LT(size_class, slab_allocator_t::NUM_SIZE_CLASSES);
+        ASSERT_GE(slab_allocator_t::object_size(size_class), size);
+        if (size_class > 0) {
+            ASSERT_LT(slab_allocator_t::object_size(size_class - 1), size);
+        }
+    }
+}
+
+TPTEST(SlabAllocator, AllocatesDistinctAlignedObjects) {
+    std::vector<std::pair<char *, size_t> > objects;
+    for (size_t size = 1; size <= 2 * SLAB_ALLOCATOR_MAX_OBJECT_SIZE; size += 97) {
+        for (int i = 0; i < 10; ++i) {
+            char *ptr = static_cast<char *>(slab_malloc(size));
+            ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(ptr) % 16);
+            memset(ptr, static_cast<int>(objects.size() % 256), size);
+            objects.push_back(std::make_pair(ptr, size));
+        }
+    }
+    for (size_t size = DEVICE_BLOCK_SIZE;
+         size <= 2 * SLAB_ALLOCATOR_MAX_OBJECT_SIZE;
+         size += DEVICE_BLOCK_SIZE) {
+        char *ptr = static_cast<char *>(slab_malloc(size));
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(ptr) % DEVICE_BLOCK_SIZE);
+        memset(ptr, static_cast<int>(objects.size() % 256), size);
+        objects.push_back(std::make_pair(ptr, size));
+    }
+    // Nothing overwrote anything else.
+    for (size_t i = 0; i < objects.size(); ++i) {
+        for (size_t j = 0; j < objects[i].second; ++j) {
+            ASSERT_EQ(static_cast<char>(i % 256), objects[i].first[j]);
+        }
+        slab_free(objects[i].first);
+    }
+}
+
+TPTEST(SlabAllocator, ReusesLocalFrees) {
+    void *ptr = slab_malloc(100);
+    slab_free(ptr);
+    ASSERT_EQ(ptr, slab_malloc(100));
+    slab_free(ptr);
+}
+
+void free_on_thread(const std::vector<void *> &objects, threadnum_t thread) {
+    on_thread_t thread_switcher(thread);
+    for (void *ptr : objects) {
+        slab_free(ptr);
+    }
+}
+
+TPTEST(SlabAllocator, ReturnsRemoteFrees, 2) {
+    const size_t num_objects = 3 * SLAB_ALLOCATOR_REMOTE_BATCH_SIZE + 1;
+    std::vector<void *> objects;
+    for (size_t i = 0; i < num_objects; ++i) {
+        objects.push_back(slab_malloc(64));
+    }
+    free_on_thread(objects, threadnum_t(1));
+    // Switching threads twice gives both event loops time to send and take the
+    // last batch.
+    for (int i = 0; i < 2; ++i) {
+        on_thread_t thread_switcher((threadnum_t(1)));
+        coro_t::yield();
+    }
+    coro_t::yield();
+
+    std::set<void *> freed(objects.begin(), objects.end());
+    for (size_t i = 0; i < num_objects; ++i) {
+        ASSERT_EQ(1u, freed.count(slab_malloc(64)));
+    }
+}
+
+static void free_all(const std::vector<void *> &objects) {
+    for (void *ptr : objects) {
+        slab_free(ptr);
+    }
+}
+
+TPTEST(SlabAllocator, ReturnsFreesFromOutsideThePool) {
+    const size_t num_objects = 100;
+    std::vector<void *> objects;
+    for (size_t i = 0; i < num_objects; ++i) {
+        objects.push_back(slab_malloc(64));
+    }
+    linux_thread_pool_t::run_in_blocker_pool(std::bind(&free_all, objects));
+    // The objects come back the next time around the event loop.
+    coro_t::yield();
+
+    std::set<void *> freed(objects.begin(), objects.end());
+    for (size_t i = 0; i < num_objects; ++i) {
+        ASSERT_EQ(1u, freed.count(slab_malloc(64)));
+    }
+}
+
+TPTEST(SlabAllocator, HandsBackEmptySlabs) {
+    slab_allocator_t *allocator = &linux_thread_pool_t::get_thread()->slab_allocator;
+    const size_t slabs_before = allocator->num_slabs();
+    const size_t num_objects = 16 * SLAB_ALLOCATOR_MAX_CACHED_BYTES / 64;
+    std::vector<void *> objects;
+    for (size_t i = 0; i < num_objects; ++i) {
+        objects.push_back(slab_malloc(64));
+    }
+    ASSERT_LT(slabs_before + 8, allocator->num_slabs());
+    free_all(objects);
+    // At most `SLAB_ALLOCATOR_MAX_CACHED_BYTES` of free objects stay around, plus
+    // the slab that's still being handed out.
+    ASSERT_GE(slabs_before
+              + SLAB_ALLOCATOR_MAX_CACHED_BYTES / SLAB_ALLOCATOR_SLAB_SIZE + 2,
+              allocator->num_slabs());
+}
+
+TPTEST(SlabAllocator, DISABLED_Benchmark) {
+    const int rounds = 1000;
+    const int per_round = 1000;
+    std::vector<void *> objects(per_round);
+    benchmark_timer_t timer;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < per_round; ++i) {
+            objects[i] = slab_malloc(16 + (i % 16) * 16);
+        }
+        for (int i = 0; i < per_round; ++i) {
+            slab_free(objects[i]);
+        }
+    }
+    timer.record_rate("slab_malloc_per_sec", rounds * per_round);
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < per_round; ++i) {
+            objects[i] = rmalloc(16 + (i % 16) * 16);
+        }
+        for (int i = 0; i < per_round; ++i) {
+            free(objects[i]);
+        }
+    }
+    timer.record_rate("malloc_per_sec", rounds * per_round);
+}
+
+}  // namespace unittest
@@ -0,0 +1,48 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/stealable_chunks.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(StealableChunks, RunsEachChunkOnce, 4) {
+    const size_t num_chunks = 1000;
+    std::vector<int> runs(num_chunks, 0);
+    run_stealable_chunks(num_chunks, 3, [&](size_t chunk) {
+        __sync_fetch_and_add(&runs[chunk], 1);
+        // Give the other threads a chance to take some.
+        if (chunk % 10 == 0) {
+            coro_t::yield();
+        }
+    });
+    for (size_t i = 0; i < num_chunks; ++i) {
+        ASSERT_EQ(1, runs[i]);
+    }
+}
+
+TPTEST(StealableChunks, NoChunks, 4) {
+    run_stealable_chunks(0, 3, [](size_t) {
+        ADD_FAILURE();
+    });
+}
+
+TPTEST(StealableChunks, RethrowsLowestError, 4) {
+    const size_t num_chunks = 100;
+    try {
+        run_stealable_chunks(num_chunks, 3, [&](size_t chunk) {
+            if (chunk == 40 || chunk == 60) {
+                throw std::runtime_error(std::to_string(chunk));
+            }
+        });
+        ADD_FAILURE();
+    } catch (const std::runtime_error &e) {
+        ASSERT_EQ(std::string("40"), e.what());
+    }
+}
+
+}  // namespace unittest
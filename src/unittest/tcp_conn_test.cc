@@ -0,0 +1,261 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arch/io/event_watcher.hpp"
+#include "arch/io/io_utils.hpp"
+#include "arch/io/network.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/benchmark.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Both ends of a connection over the loopback interface.
+class loopback_conns_t {
+public:
+    loopback_conns_t() {
+        const ip_address_t loopback("127.0.0.1");
+        std::set<ip_address_t> addresses;
+        addresses.insert(loopback);
+        listener.init(new tcp_listener_t(
+            addresses, 0, std::bind(&loopback_conns_t::on_conn, this, ph::_1)));
+        cond_t non_interruptor;
+        client.init(new tcp_conn_t(loopback, listener->get_port(), &non_interruptor));
+        accepted.wait();
+    }
+
+    scoped_ptr_t<tcp_conn_t> client;
+    scoped_ptr_t<tcp_conn_t> server;
+
+private:
+    void on_conn(scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+        nconn->make_overcomplicated(&server);
+        accepted.pulse();
+    }
+
+    scoped_ptr_t<tcp_listener_t> listener;
+    cond_t accepted;
+};
+
+std::string make_pattern(size_t size, char first) {
+    std::string s;
+    for (size_t i = 0; i < size; ++i) {
+        s += static_cast<char>(first + i % 26);
+    }
+    return s;
+}
+
+void write_mixed(tcp_conn_t *conn, std::string *expected_out, cond_t *done) {
+    cond_t non_closer;
+    const std::string small = make_pattern(100, 'a');
+    const std::string large = make_pattern(300 * KILOBYTE, 'A');
+    const std::string chunk = make_pattern(20 * KILOBYTE, '0');
+
+    conn->write_buffered(small.data(), small.size(), &non_closer);
+    conn->write_buffered(large.data(), large.size(), &non_closer);
+    conn->write_buffered(chunk.data(), chunk.size(), &non_closer);
+    conn->write_buffered(small.data() + 10, 50, &non_closer);
+    conn->write(large.data() + 1000, 100 * KILOBYTE, &non_closer);
+    iovec iov[2];
+    iov[0].iov_base = const_cast<char *>(small.data());
+    iov[0].iov_len = small.size();
+    iov[1].iov_base = const_cast<char *>(chunk.data());
+    iov[1].iov_len = chunk.size();
+    conn->writev(iov, 2, &non_closer);
+    conn->write_buffered(small.data(), small.size(), &non_closer);
+    conn->flush_buffer(&non_closer);
+
+    *expected_out = small + large + chunk + small.substr(10, 50)
+        + large.substr(1000, 100 * KILOBYTE) + small + chunk + small;
+    done->pulse();
+}
+
+TPTEST(TcpConn, WritesArriveInOrder) {
+    loopback_conns_t conns;
+    conns.server->enable_write_corking();
+
+    std::string expected;
+    cond_t written;
+    coro_t::spawn_sometime(std::bind(&write_mixed, conns.server.get(), &expected, &written));
+
+    // Computed the same way as `expected`, which isn't set until everything has
+    // been written.
+    const size_t total = 100 + 300 * KILOBYTE + 20 * KILOBYTE + 50
+        + 100 * KILOBYTE + 100 + 20 * KILOBYTE + 100;
+    std::string received(total, '\0');
+    cond_t non_closer;
+    conns.client->read(&received[0], total, &non_closer);
+    written.wait();
+    ASSERT_EQ(expected.size(), total);
+    ASSERT_TRUE(expected == received);
+}
+
+void accept_on_thread(std::vector<int> *accepted,
+                      scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    scoped_ptr_t<tcp_conn_t> conn;
+    nconn->make_overcomplicated(&conn);
+    ASSERT_EQ(get_thread_id().threadnum, conn->home_thread().threadnum);
+    ++(*accepted)[get_thread_id().threadnum];
+    cond_t non_closer;
+    const char byte = 'x';
+    conn->write(&byte, 1, &non_closer);
+}
+
+TPTEST(TcpConn, ReuseportListener, 4) {
+    if (!tcp_reuseport_listener_t::is_supported()) {
+        return;
+    }
+    const int num_threads = 4;
+    std::vector<int> accepted(num_threads, 0);
+    const ip_address_t loopback("127.0.0.1");
+    std::set<ip_address_t> addresses;
+    addresses.insert(loopback);
+    tcp_reuseport_listener_t listener(
+        addresses, 0, num_threads, std::bind(&accept_on_thread, &accepted, ph::_1));
+
+    // Each connection is only counted once its byte has arrived.
+    const int num_conns = 64;
+    cond_t non_interruptor;
+    for (int i = 0; i < num_conns; ++i) {
+        tcp_conn_t client(loopback, listener.get_port(), &non_interruptor);
+        char byte;
+        client.read(&byte, 1, &non_interruptor);
+        ASSERT_EQ('x', byte);
+    }
+    int total = 0;
+    for (int n : accepted) {
+        total += n;
+    }
+    ASSERT_EQ(num_conns, total);
+}
+
+void write_for_benchmark(tcp_conn_t *conn, int method, size_t total, cond_t *done) {
+    cond_t non_closer;
+    const size_t small_size = KILOBYTE;
+    const size_t large_size = 64 * KILOBYTE;
+    std::string data(large_size, 'x');
+    for (size_t sent = 0; sent < total; ) {
+        switch (method) {
+        case 0:
+            conn->write_buffered(data.data(), small_size, &non_closer);
+            sent += small_size;
+            break;
+        case 1:
+            conn->write_buffered(data.data(), large_size, &non_closer);
+            sent += large_size;
+            break;
+        default: unreachable();
+        }
+    }
+    conn->flush_buffer(&non_closer);
+    done->pulse();
+}
+
+TPTEST(TcpConn, DISABLED_ThroughputBenchmark) {
+    const char *const methods[] = {
+        "write_buffered_1kb_mb_per_sec",
+        "write_buffered_64kb_mb_per_sec"
+    };
+    const size_t total = 256 * MEGABYTE;
+    for (int method = 0; method < 2; ++method) {
+        loopback_conns_t conns;
+        benchmark_timer_t timer;
+        cond_t written;
+        coro_t::spawn_sometime(std::bind(&write_for_benchmark,
+                                         conns.server.get(), method, total, &written));
+        scoped_array_t<char> buf(256 * KILOBYTE);
+        cond_t non_closer;
+        for (size_t received = 0; received < total; ) {
+            received += conns.client->read_some(buf.data(), buf.size(), &non_closer);
+        }
+        written.wait();
+        timer.record_rate(methods[method], total / MEGABYTE);
+    }
+}
+
+#if defined(__linux) && !defined(NO_EPOLL)
+class ignore_errors_t : public linux_event_callback_t {
+public:
+    void on_event(int) { }
+};
+
+// Reads exactly `size` bytes the way `tcp_conn_t` does.
+void read_with_watcher(fd_t fd, linux_event_watcher_t *watcher, char *buf, size_t size) {
+    while (size > 0) {
+        const ssize_t res = ::read(fd, buf, size);
+        if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
+            watcher->clear_ready(poll_event_in);
+            linux_event_watcher_t::watch_t watch(watcher, poll_event_in);
+            watch.wait();
+            continue;
+        }
+        guarantee_err(res > 0, "read() failed");
+        buf += res;
+        size -= res;
+    }
+}
+
+void echo_with_watcher(fd_t fd, linux_event_watcher_t *watcher, int num_requests,
+                       size_t size, cond_t *done) {
+    std::string buf(size, '\0');
+    for (int i = 0; i < num_requests; ++i) {
+        read_with_watcher(fd, watcher, &buf[0], size);
+        guarantee_err(::write(fd, buf.data(), size) == static_cast<ssize_t>(size),
+                      "write() failed");
+    }
+    done->pulse();
+}
+
+// Returns how many times `epoll_ctl()` was called per request and response that
+// went over a pair of sockets.
+double epoll_ctl_calls_per_request(bool edge_triggered) {
+    const int num_requests = 10000;
+    const size_t size = 100;
+    int fds[2];
+    guarantee_err(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair() failed");
+    scoped_fd_t client_fd(fds[0]);
+    scoped_fd_t server_fd(fds[1]);
+    guarantee_err(fcntl(client_fd.get(), F_SETFL, O_NONBLOCK) == 0, "fcntl() failed");
+    guarantee_err(fcntl(server_fd.get(), F_SETFL, O_NONBLOCK) == 0, "fcntl() failed");
+
+    const epoll_event_queue_t *queue = &linux_thread_pool_t::get_thread()->queue;
+    ignore_errors_t ignore_errors;
+    linux_event_watcher_t client(client_fd.get(), &ignore_errors, edge_triggered);
+    linux_event_watcher_t server(server_fd.get(), &ignore_errors, edge_triggered);
+
+    const uint64_t ctl_calls_before = queue->num_ctl_calls();
+    cond_t done;
+    coro_t::spawn_sometime(std::bind(&echo_with_watcher, server_fd.get(), &server,
+                                     num_requests, size, &done));
+    std::string request(size, 'x');
+    std::string response(size, '\0');
+    for (int i = 0; i < num_requests; ++i) {
+        guarantee_err(::write(client_fd.get(), request.data(), size)
+                      == static_cast<ssize_t>(size), "write() failed");
+        read_with_watcher(client_fd.get(), &client, &response[0], size);
+    }
+    done.wait();
+    return static_cast<double>(queue->num_ctl_calls() - ctl_calls_before) / num_requests;
+}
+
+TPTEST(TcpConn, EdgeTriggeredWatchersSkipEpollCtl) {
+    const double level = epoll_ctl_calls_per_request(false);
+    const double edge = epoll_ctl_calls_per_request(true);
+    ASSERT_LT(edge, level);
+    ASSERT_LT(edge, 0.01);
+}
+#endif  // defined(__linux) && !defined(NO_EPOLL)
+
+}  // namespace unittest
@@ -1,8 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <algorithm>
+#include <vector>
 
 #include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/pmap.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/benchmark.hpp"
 #include "unittest/gtest.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "utils.hpp"
@@ -32,5 +36,68 @@ TPTEST(TimerTest, TestApproximateWaitTimes) {
     pmap(2, walk_wait_times);
 }
 
+// Records when it fired, and pulses `done` once `*remaining` reaches zero.
+class recording_timer_t : public timer_callback_t {
+public:
+    void on_timer() {
+        fired_at = get_ticks();
+        order->push_back(ms);
+        if (--*remaining == 0) {
+            done->pulse();
+        }
+    }
+    int64_t ms;
+    ticks_t fired_at;
+    std::vector<int64_t> *order;
+    int *remaining;
+    cond_t *done;
+};
+
+TPTEST(TimerTest, FiresInOrder) {
+    // Some of these go past the first turn of the wheel's lowest level.
+    const int64_t delays[] = { 300, 1, 258, 40, 254, 3, 512, 256, 6, 100 };
+    const int num_timers = sizeof(delays) / sizeof(delays[0]);
+    std::vector<int64_t> order;
+    int remaining = num_timers;
+    cond_t done;
+    recording_timer_t timers[num_timers];
+    const ticks_t start = get_ticks();
+    for (int i = 0; i < num_timers; ++i) {
+        timers[i].ms = delays[i];
+        timers[i].order = &order;
+        timers[i].remaining = &remaining;
+        timers[i].done = &done;
+        fire_timer_once(delays[i], &timers[i]);
+    }
+    // Canceled timers, including far-off ones, never fire.
+    recording_timer_t canceled;
+    cancel_timer(fire_timer_once(3, &canceled));
+    cancel_timer(fire_timer_once(3 * 24 * 3600 * 1000LL, &canceled));
+    done.wait();
+
+    std::vector<int64_t> sorted(delays, delays + num_timers);
+    std::sort(sorted.begin(), sorted.end());
+    ASSERT_EQ(sorted, order);
+    for (int i = 0; i < num_timers; ++i) {
+        ASSERT_GE(static_cast<int64_t>(timers[i].fired_at - start), delays[i] * MILLION);
+    }
+}
+
+// Like when every connection has a timeout.
+TPTEST(TimerTest, DISABLED_AddCancelBenchmark) {
+    const int num_timers = 1000000;
+    recording_timer_t never;
+    scoped_array_t<timer_token_t *> tokens(num_timers);
+    benchmark_timer_t timer;
+    for (int i = 0; i < num_timers; ++i) {
+        // Spread them from a second to about three hours out.
+        tokens[i] = fire_timer_once(1000 + (i * 7919LL) % 10000000, &never);
+    }
+    timer.record_elapsed("add_us");
+    for (int i = 0; i < num_timers; ++i) {
+        cancel_timer(tokens[i]);
+    }
+    timer.record_elapsed("cancel_us");
+}
 
 }  // namespace unittest
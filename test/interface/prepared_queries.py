@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+# Copyright 2010-2015 RethinkDB, all rights reserved.
+
+'''Tests PREPARE and EXECUTE queries, through `Connection.prepare`.'''
+
+import os, sys, time
+
+sys.path.append(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common'))
+import rdb_unittest
+
+class PreparedQueryTestCase(rdb_unittest.RdbTestCase):
+
+    recordsToGenerate = 100
+
+    def test_get(self):
+        with self.conn.prepare(lambda key: self.table.get(key)) as get:
+            for key in range(1, 101):
+                self.assertEqual(get.run(key), {'id': key})
+            self.assertEqual(get.run(1000), None)
+
+    def test_arguments(self):
+        r = self.r
+        with self.conn.prepare(lambda a, b: r.expr(a).add(b)) as add:
+            self.assertEqual(add.run(1, 2), 3)
+            self.assertEqual(add.run([1], [2, {'x': 'y'}]), [1, 2, {'x': 'y'}])
+            self.assertRaisesRegexp(r.RqlRuntimeError, 'Expected 2 arguments but found 1',
+                                    add.run, 1)
+            self.assertRaisesRegexp(r.RqlRuntimeError, 'Expected type NUMBER but found STRING',
+                                    add.run, 1, 'a')
+
+    def test_stream(self):
+        with self.conn.prepare(lambda n: self.table.order_by(index='id').limit(n)['id']) as first:
+            self.assertEqual(list(first.run(5)), [1, 2, 3, 4, 5])
+            # This returns a stream rather than an array.
+            self.assertEqual(list(first.run(100)), list(range(1, 101)))
+
+    def test_write(self):
+        with self.conn.prepare(lambda key, value: self.table.get(key).update({'value': value})) as update:
+            self.assertEqual(update.run(1, 'a')['replaced'], 1)
+            self.assertEqual(update.run(2, 'b')['replaced'], 1)
+        self.assertEqual(self.table.get(1)['value'].run(self.conn), 'a')
+        self.assertEqual(self.table.get(2)['value'].run(self.conn), 'b')
+
+    def test_now(self):
+        r = self.r
+        with self.conn.prepare(lambda x: r.now().to_epoch_time()) as now:
+            first = now.run(0)
+            time.sleep(1.5)
+            self.assertGreater(now.run(0), first + 1)
+
+    def test_errors(self):
+        r = self.r
+        get = self.conn.prepare(lambda key: self.table.get(key))
+        get.close()
+        self.assertRaisesRegexp(r.RqlClientError, 'is not a prepared query', get.run, 1)
+        with self.conn.prepare(lambda key: self.table.get(key)) as get:
+            self.assertRaisesRegexp(r.RqlCompileError, 'must be literal values',
+                                    get.run, r.expr(1).add(1))
+            self.assertRaisesRegexp(r.RqlCompileError, 'global optional argument `db`',
+                                    get.run, 1, db='test')
+            self.assertEqual(get.run(1), {'id': 1})
+
+if __name__ == '__main__':
+    import unittest
+    unittest.main()
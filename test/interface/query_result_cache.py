@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+# Copyright 2015 RethinkDB, all rights reserved.
+
+'''Checks that `--query-result-cache` answers repeated reads from the cache, that writes, both through this server and through another one, invalidate the cached results, and that renaming the table does too.'''
+
+from __future__ import print_function
+
+import os, sys, time
+
+startTime = time.time()
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, scenario_common, utils, vcoptparse
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+r = utils.import_python_driver()
+
+cache_options = serve_options + ['--query-result-cache', 'test.cached']
+
+print("Spinning up two servers (%.2fs)" % (time.time() - startTime))
+with driver.Cluster(initial_servers=['cached', 'other'], output_folder='.', command_prefix=command_prefix, extra_options=cache_options, wait_until_ready=True) as cluster:
+    cluster.check()
+    cached_server, other_server = cluster[0], cluster[1]
+    conn = r.connect(host=cached_server.host, port=cached_server.driver_port)
+    other_conn = r.connect(host=other_server.host, port=other_server.driver_port)
+
+    print("Creating tables (%.2fs)" % (time.time() - startTime))
+    r.db_create("test").run(conn)
+    r.db("test").table_create("cached").run(conn)
+    r.db("test").table_create("uncached").run(conn)
+    r.db("test").wait().run(conn)
+    r.table("cached").insert([{"id": i, "value": i} for i in range(10)]).run(conn)
+    r.table("uncached").insert([{"id": i, "value": i} for i in range(10)]).run(conn)
+
+    server_id = r.db("rethinkdb").table("server_status") \
+                 .filter({"name": cached_server.name}).nth(0)["id"].run(conn)
+
+    def get_cache_stats():
+        qe = r.db("rethinkdb").table("stats").get(["server", server_id])["query_engine"].run(conn)
+        return qe["result_cache_hits"], qe["result_cache_misses"]
+
+    def total_value():
+        return r.table("cached")["value"].sum().run(conn)
+
+    print("Waiting for the cache to watch the table (%.2fs)" % (time.time() - startTime))
+    deadline = time.time() + 30
+    while True:
+        hits_before, _ = get_cache_stats()
+        assert total_value() == 45
+        assert total_value() == 45
+        hits_after, _ = get_cache_stats()
+        if hits_after > hits_before:
+            break
+        assert time.time() < deadline, "Repeated reads never hit the cache"
+        time.sleep(0.5)
+
+    print("Checking that uncacheable queries aren't cached (%.2fs)" % (time.time() - startTime))
+    hits, misses = get_cache_stats()
+    r.table("uncached")["value"].sum().run(conn)
+    r.table("uncached")["value"].sum().run(conn)
+    r.table("cached").sample(1).run(conn)
+    r.table("cached").sample(1).run(conn)
+    r.table("cached").filter(r.row["value"].lt(r.random())).count().run(conn)
+    assert get_cache_stats() == (hits, misses), (get_cache_stats(), hits, misses)
+
+    print("Checking that local writes invalidate the cache (%.2fs)" % (time.time() - startTime))
+    assert total_value() == 45
+    r.table("cached").get(0).update({"value": 100}).run(conn)
+    assert total_value() == 145
+
+    print("Checking that writes through another server invalidate the cache (%.2fs)" % (time.time() - startTime))
+    assert total_value() == 145
+    r.table("cached").get(1).update({"value": 101}).run(other_conn)
+    deadline = time.time() + 10
+    while total_value() != 245:
+        assert time.time() < deadline, "The cached result was never invalidated"
+        time.sleep(0.1)
+
+    print("Checking that renaming the table invalidates the cache (%.2fs)" % (time.time() - startTime))
+    assert total_value() == 245
+    assert total_value() == 245
+    res = r.table("cached").config().update({"name": "renamed"}).run(other_conn)
+    assert res["replaced"] == 1, res
+    # The cache hears about the rename from its `table_config` changefeed.
+    deadline = time.time() + 5
+    while True:
+        try:
+            total_value()
+        except r.RqlRuntimeError:
+            break
+        assert time.time() < deadline, "The cache kept answering for a table that was renamed"
+        time.sleep(0.1)
+    assert r.table("renamed")["value"].sum().run(conn) == 245
+
+    print("Checking that a new table with the same name isn't answered from the cache (%.2fs)" % (time.time() - startTime))
+    r.db("test").table_create("cached").run(other_conn)
+    r.table("cached").wait().run(other_conn)
+    r.table("cached").insert({"id": 0, "value": 7}).run(other_conn)
+    deadline = time.time() + 10
+    while True:
+        try:
+            value = total_value()
+        except r.RqlRuntimeError:
+            value = None
+        if value == 7:
+            break
+        assert value != 245, "The cache answered for the renamed table"
+        assert time.time() < deadline, "The new table was never read"
+        time.sleep(0.1)
+
+    cluster.check_and_stop()
+print("Done. (%.2fs)" % (time.time() - startTime))
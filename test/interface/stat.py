@@ -292,8 +292,15 @@ with driver.Metacluster() as metacluster:
         debug_stats_1 = r.db('rethinkdb').table('_debug_stats') \
                          .get(servers[1]["id"]).run(conn)
         assert debug_stats_0["stats"]["eventloop"]["total"] > 0
+        assert "coro_profile" not in debug_stats_0["stats"]
         assert "error" in debug_stats_1
 
+        # Basic test of the `_debug_coro_profile` table
+        coro_profile_0 = r.db('rethinkdb').table('_debug_coro_profile') \
+                          .get(servers[0]["id"]).run(conn)
+        assert coro_profile_0["profile"]["samples"] > 0
+        assert len(coro_profile_0["profile"]["sites"]) > 0
+
         # Restart server
         print("Restarting second server...")
         servers[1]['process'] = driver.Process(cluster, servers[1]['files'],